@@ -0,0 +1,15 @@
+#ifndef ECG_ISD_ESP32_CRC32_H
+#define ECG_ISD_ESP32_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 as used by zip and gzip (reflected polynomial 0xedb88320). The
+// running value can be passed back in to checksum data piece by piece.
+uint32_t crc32_update(uint32_t crc, const void* data, size_t length);
+
+inline uint32_t crc32(const void* data, size_t length) {
+	return crc32_update(0, data, length);
+}
+
+#endif
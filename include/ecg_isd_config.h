@@ -4,6 +4,12 @@
 
 #include <Arduino.h>
 
+// Records per second and samples per record as stored on the card
+constexpr uint32_t ECG_SAMPLE_RATE_HZ = 500;
+constexpr uint8_t ECG_CHANNELS = 8;
+// Unit of the calibrated samples, named in exports that carry units
+constexpr const char* ECG_SAMPLE_UNIT = "mV";
+
 #ifdef ARDUINO_TTGO_LoRa32_V1
 
 constexpr int8_t SD_CS = 5;
@@ -0,0 +1,485 @@
+#ifndef ECG_ISD_ESP32_EXPORTSTREAM_H
+#define ECG_ISD_ESP32_EXPORTSTREAM_H
+
+#include <memory>
+#include <vector>
+
+#include "deflate.h"
+#include "ecg_isd_config.h"
+#include "metrics.h"
+#include "responsePool.h"
+#include "storage.h"
+#include "textFormat.h"
+#include "wfdb.h"
+
+// Body of a web export, produced piece by piece into the caller's buffer so
+// no export ever holds a whole recording in memory
+class ExportStream {
+public:
+	virtual ~ExportStream();
+
+	// Fills buffer completely unless the end is reached, returns 0 at the end
+	virtual size_t read(uint8_t* buffer, size_t length) = 0;
+
+	// Drops up to length bytes, returns how many were dropped. Skipping
+	// SIZE_MAX bytes measures the remaining length of the body.
+	virtual size_t skip(size_t length);
+
+	// Every request creates one or two, response_pool recycles their memory.
+	// With std::nothrow nullptr is returned when the heap has no room.
+	static void* operator new(size_t size);
+	static void* operator new(size_t size, const std::nothrow_t&) noexcept;
+	static void operator delete(void* block);
+	static void operator delete(void* block, const std::nothrow_t&) noexcept;
+};
+
+// A body that is already in memory, a constant
+class MemoryExport : public ExportStream {
+	const uint8_t* _data;
+	size_t _length;
+	size_t _offset = 0;
+
+public:
+	// The data has to outlive the export
+	MemoryExport(const void* data, size_t length);
+	~MemoryExport() override;
+
+	size_t get_length() const;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+	size_t skip(size_t length) override;
+};
+
+// Room of a TextExport, a catalog page of WEB_CATALOG_MAX_LIMIT recordings
+// fits
+constexpr size_t EXPORT_TEXT_SIZE = 16384;
+
+// Text a handler writes at once, like JSON. The buffer is part of the
+// export and comes from the response pool with it.
+class TextExport : public ExportStream {
+	char _text[EXPORT_TEXT_SIZE];
+	TextWriter _writer;
+	size_t _offset = 0;
+
+public:
+	TextExport();
+	~TextExport() override;
+
+	// Append the text before the export is read
+	TextWriter& get_writer();
+
+	// False if the text did not fit
+	bool is_complete() const;
+	size_t get_length() const;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+	size_t skip(size_t length) override;
+};
+
+// The /metrics page, rendered once into a buffer of its own so that counters
+// are read at the same moment and nothing is allocated while rendering
+class MetricsExport : public ExportStream {
+	char _page[METRICS_PAGE_SIZE];
+	size_t _length;
+	size_t _offset = 0;
+
+public:
+	explicit MetricsExport(uint32_t records_acquired);
+	~MetricsExport() override;
+
+	size_t get_length() const;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+};
+
+// Records and channels of a recording to export
+struct ExportSelection {
+	uint32_t first_record = 0;
+	uint32_t record_count = UINT32_MAX;
+	// Channel indexes in output order, all channels if there are none
+	uint8_t channels[UINT8_MAX];
+	uint8_t channel_count = 0;
+
+	bool is_everything() const {
+		return first_record == 0 && record_count == UINT32_MAX &&
+			channel_count == 0;
+	}
+
+	// Copies the selected channels of a record, returns their number.
+	// Channels the record does not have are left out.
+	uint8_t select(const float data[], uint8_t length, float out[]) const;
+
+	// Channel of the recording that select() puts at index for a record of
+	// length channels
+	uint8_t channel(uint8_t index, uint8_t length) const;
+};
+
+// Reads the selected records of a recording, seeking to the first one
+class SelectionReader {
+	std::unique_ptr<RecordingReader> _reader;
+	ExportSelection _selection;
+	uint32_t _records_read = 0;
+	uint8_t _record_length = 0;
+	bool _started = false;
+
+	float _data[UINT8_MAX];
+
+public:
+	SelectionReader(
+		std::unique_ptr<RecordingReader> reader, const ExportSelection& selection);
+
+	const ExportSelection& get_selection() const;
+	// Channels of the last record read, before the selection
+	uint8_t get_record_length() const;
+
+	// Selected channels of the next selected record, 0 at the end
+	int read_record(float out[]);
+};
+
+// What formats with fixed point samples need to know before the first
+// sample is sent
+struct SelectionRange {
+	uint32_t record_count = 0;
+	uint8_t channel_count = 0;
+	// Channels of the longest record, before the selection. Names the
+	// selected channels with ExportSelection::channel().
+	uint8_t record_length = 0;
+	// Range of the finite samples of every selected channel
+	float min[UINT8_MAX];
+	float max[UINT8_MAX];
+};
+
+// Reads the selection once for the number of records and the range of every
+// channel, a number of records per step so a long recording does not hold
+// up the web server
+class SelectionScan {
+	SelectionReader _reader;
+	SelectionRange _range;
+	float _data[UINT8_MAX];
+	bool _done = false;
+
+public:
+	SelectionScan(
+		std::unique_ptr<RecordingReader> reader, const ExportSelection& selection);
+
+	// Reads up to record_count more records, returns true once the whole
+	// selection was read
+	bool step(uint32_t record_count);
+
+	// Complete after step() returned true
+	const SelectionRange& get_range() const;
+};
+
+// One line per record, samples separated by commas
+class CsvExport : public ExportStream {
+	SelectionReader _reader;
+	uint8_t _decimals;
+
+	float _data[UINT8_MAX];
+	uint8_t _sample_count = 0;
+	uint8_t _next_sample = 0;
+	// Usually a whole line. A sample takes up to FORMAT_MAX_LENGTH plus a
+	// separator, a line of long ones is formatted in pieces.
+	char _line[UINT8_MAX * 25];
+	size_t _line_length = 0;
+	size_t _line_sent = 0;
+	bool _done = false;
+
+	// The rest of the current record or the next one, as far as it fits
+	bool format_next_line();
+
+public:
+	CsvExport(
+		std::unique_ptr<RecordingReader> reader,
+		const ExportSelection& selection = ExportSelection(),
+		uint8_t decimals = 6);
+	~CsvExport() override;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+	size_t skip(size_t length) override;
+};
+
+// The recording file as stored, see doc/recording-format.md
+class RawExport : public ExportStream {
+	std::unique_ptr<RecordingReader> _reader;
+	size_t _offset;
+	size_t _end;
+
+public:
+	// Exports the bytes from offset up to end, the readable size by default
+	RawExport(
+		std::unique_ptr<RecordingReader> reader,
+		size_t offset = 0,
+		size_t end = SIZE_MAX);
+	~RawExport() override;
+
+	size_t get_length() const;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+	size_t skip(size_t length) override;
+};
+
+// Min/max envelope of the selected channels over width buckets of records,
+// one line per bucket with its start in milliseconds followed by the minimum and
+// maximum of every channel. Memory and output do not grow with the recording.
+class PreviewExport : public ExportStream {
+	SelectionReader _reader;
+	uint32_t _first_record;
+	uint32_t _bucket_size;
+	uint32_t _bucket = 0;
+	uint32_t _bucket_count;
+	uint8_t _decimals;
+
+	float _data[UINT8_MAX];
+	float _min[UINT8_MAX];
+	float _max[UINT8_MAX];
+	// Minimum and maximum of every channel of the current bucket
+	uint16_t _value_count = 0;
+	uint16_t _next_value = 0;
+	// The column names min_<channel> and max_<channel> go in front of the
+	// first bucket
+	static constexpr size_t HEADER_MAX_LENGTH =
+		sizeof("time_ms\n") + UINT8_MAX * sizeof(",min_255,max_255");
+	// Usually a whole line, like in CsvExport
+	char _line[HEADER_MAX_LENGTH + (2 * UINT8_MAX + 1) * 25];
+	size_t _line_length = 0;
+	size_t _line_sent = 0;
+	bool _header_done = false;
+
+	// The rest of the current bucket or the next one, as far as it fits
+	bool format_next_line();
+	// Reads the next bucket and writes the start of its line, with the
+	// header in front of the first
+	bool format_next_bucket(char*& out);
+
+public:
+	// record_count is the number of selected records available
+	PreviewExport(
+		std::unique_ptr<RecordingReader> reader,
+		const ExportSelection& selection,
+		uint32_t record_count,
+		uint16_t width,
+		uint8_t decimals = 4);
+	~PreviewExport() override;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+};
+
+// Another export compressed on the fly as a gzip stream (RFC 1952)
+class GzipExport : public ExportStream {
+	std::unique_ptr<ExportStream> _source;
+	Deflate _deflate;
+
+	uint8_t _input[512];
+	size_t _input_length = 0;
+	size_t _input_used = 0;
+	uint32_t _crc = 0;
+	uint32_t _size = 0;
+
+	uint8_t _frame[10];
+	size_t _frame_length = 0;
+	size_t _frame_sent = 0;
+	enum class Part { Header, Body, Trailer, Done } _part = Part::Header;
+
+public:
+	GzipExport(
+		std::unique_ptr<ExportStream> source,
+		uint8_t level = DEFLATE_DEFAULT_LEVEL);
+	~GzipExport() override;
+
+	// Streams that exist right now, each holds a compressor of about 35 KB
+	static size_t get_open_count();
+
+	size_t read(uint8_t* buffer, size_t length) override;
+};
+
+// Data records of an EDF+ export hold this many records of every channel,
+// one second
+constexpr uint32_t EDF_RECORD_SAMPLES = ECG_SAMPLE_RATE_HZ;
+// Bytes of the annotation signal per data record, it holds the onset
+constexpr size_t EDF_ANNOTATION_SIZE = 32;
+constexpr int16_t EDF_DIGITAL_MIN = -32768;
+constexpr int16_t EDF_DIGITAL_MAX = 32767;
+
+// EDF+ (European Data Format) of the selected records and channels. Samples
+// are scaled to 16 bits between the physical minimum and maximum of their
+// channel, one data record per second is converted at a time. An extra
+// signal carries the onset of every data record.
+class EdfExport : public ExportStream {
+	SelectionReader _reader;
+	uint32_t _first_record;
+	uint32_t _record_count;
+	uint32_t _records_read = 0;
+	uint8_t _channel_count;
+	uint32_t _data_record = 0;
+	uint32_t _data_record_count;
+
+	// Physical minimum and scale of every channel as written in the header
+	float _offset[UINT8_MAX];
+	float _gain[UINT8_MAX];
+	float _data[UINT8_MAX];
+
+	// The header, then one data record after the other. From the response
+	// pool, its size repeats with the channel count.
+	std::unique_ptr<uint8_t[], ResponsePoolRelease> _out;
+	size_t _out_length = 0;
+	size_t _out_sent = 0;
+
+	void format_header(const ExportSelection& selection, const SelectionRange& range);
+	bool format_data_record();
+
+public:
+	// range from a SelectionScan of the same selection. Records added to a
+	// live recording since the scan are left out.
+	EdfExport(
+		std::unique_ptr<RecordingReader> reader,
+		const ExportSelection& selection,
+		const SelectionRange& range);
+	~EdfExport() override;
+
+	static size_t get_length(const SelectionRange& range);
+
+	size_t read(uint8_t* buffer, size_t length) override;
+};
+
+// First sample and checksum of every signal of a WFDB signal file, which
+// its header lists. Only known once the whole file was encoded.
+struct WfdbSums {
+	WfdbFormat format = WfdbFormat::Packed212;
+	uint8_t channel_count = 0;
+	int16_t initial_value[UINT8_MAX];
+	uint16_t checksum[UINT8_MAX];
+};
+
+// WFDB signal file of the selected records and channels. Each channel is
+// scaled to its range and the records are converted a block at a time.
+class WfdbExport : public ExportStream {
+	SelectionReader _reader;
+	WfdbEncoder _encoder;
+	uint32_t _record_count;
+	uint32_t _records_read = 0;
+	uint8_t _channel_count;
+
+	float _data[UINT8_MAX];
+	float _frames[WFDB_BLOCK_SAMPLES];
+	uint8_t _out[WFDB_BLOCK_BYTES];
+	size_t _out_length = 0;
+	size_t _out_sent = 0;
+	bool _done = false;
+
+	bool produce();
+
+public:
+	// range from a SelectionScan of the same selection. Records added to a
+	// live recording since the scan are left out.
+	WfdbExport(
+		std::unique_ptr<RecordingReader> reader,
+		const ExportSelection& selection,
+		const SelectionRange& range,
+		WfdbFormat format);
+	~WfdbExport() override;
+
+	static size_t get_length(const SelectionRange& range, WfdbFormat format);
+
+	// Checksums and initial values cover what was read so far
+	void get_sums(WfdbSums& sums) const;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+};
+
+// Writes the .hea header for a WfdbExport of the same selection and range,
+// sums from the whole signal file. Returns the length the header needs, like
+// snprintf.
+size_t format_wfdb_header(
+	char* out,
+	size_t size,
+	const char* record_name,
+	const ExportSelection& selection,
+	const SelectionRange& range,
+	const WfdbSums& sums);
+
+// Longest recording name stored in an archive, without the ".rec"
+constexpr size_t ZIP_MAX_NAME = 48;
+
+// Store-only ZIP of whole recordings, each as "<name>.rec". Recordings are
+// opened one after another and their CRC is taken while the data passes, so
+// every entry is followed by a data descriptor. Besides the list of entries
+// memory does not grow with the archive.
+class ZipExport : public ExportStream {
+	std::shared_ptr<Storage> _storage;
+	// Sizes are taken when the archive is set up, a recording that grows
+	// afterwards is archived up to that size
+	std::vector<StorageEntry> _recordings;
+	std::vector<uint32_t> _crcs;
+	uint64_t _length = 0;
+
+	size_t _entry = 0;
+	std::unique_ptr<RawExport> _data;
+	size_t _data_left = 0;
+	uint32_t _crc = 0;
+	// Archive offset of the local header of _entry while the central
+	// directory is written
+	uint32_t _entry_offset = 0;
+	uint32_t _directory_offset = 0;
+	uint32_t _directory_size = 0;
+
+	uint8_t _frame[46 + ZIP_MAX_NAME + 4];
+	size_t _frame_length = 0;
+	size_t _frame_sent = 0;
+	enum class Part {
+		LocalHeader, Data, Descriptor, Directory, End, Done
+	} _part = Part::LocalHeader;
+
+	size_t entry_name(size_t index, char* name) const;
+	void frame_local_header();
+	void frame_descriptor();
+	void frame_directory_entry();
+	void frame_end();
+	bool next_part();
+
+public:
+	// Recordings with a name longer than ZIP_MAX_NAME are left out
+	ZipExport(std::shared_ptr<Storage> storage, std::vector<StorageEntry> recordings);
+	~ZipExport() override;
+
+	// Known up front. Archives from 4 GB on would need ZIP64, which this
+	// does not write.
+	uint64_t get_length() const;
+	size_t get_entry_count() const;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+};
+
+// A version 2 recording of only the selected records and channels, written
+// with the lossless DeltaFloat32 codec and ending with an index
+class SelectionExport : public ExportStream {
+	SelectionReader _reader;
+
+	recording_format::BlockBuffer _block;
+	recording_format::IndexBuilder _index;
+	float _data[UINT8_MAX];
+	// Record read that did not fit into the previous block
+	uint8_t _pending_length = 0;
+
+	uint8_t _out[
+		sizeof(recording_format::BlockHeader) +
+		recording_format::BLOCK_MAX_PAYLOAD];
+	size_t _out_length = 0;
+	size_t _out_sent = 0;
+	size_t _written_size = 0;
+	uint32_t _next_record = 0;
+	enum class Part { Header, Blocks, Index, Done } _part = Part::Header;
+
+	bool produce();
+	void emit_block(
+		const recording_format::BlockHeader& header, size_t payload_size);
+
+public:
+	SelectionExport(
+		std::unique_ptr<RecordingReader> reader, const ExportSelection& selection);
+	~SelectionExport() override;
+
+	size_t read(uint8_t* buffer, size_t length) override;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef ECG_ISD_ESP32_HTTPSERVER_H
+#define ECG_ISD_ESP32_HTTPSERVER_H
+
+#include <functional>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "exportStream.h"
+#include "responsePool.h"
+
+constexpr uint16_t HTTP_PORT = 80;
+
+// Clients served at the same time, more wait in the listen backlog
+constexpr size_t HTTP_MAX_CONNECTIONS = 4;
+constexpr int HTTP_BACKLOG = 4;
+
+// Request line and headers, longer requests are answered with 431
+constexpr size_t HTTP_REQUEST_SIZE = 1024;
+// Headers a handler adds to its response
+constexpr size_t HTTP_HEADERS_SIZE = 512;
+// Body bytes produced per turn of a connection
+constexpr size_t HTTP_CHUNK_SIZE = 4096;
+// Longest body sent as text, longer ones are sent as a stream
+constexpr size_t HTTP_TEXT_SIZE = 256;
+
+constexpr uint8_t HTTP_MAX_HEADERS = 16;
+constexpr uint8_t HTTP_MAX_ARGS = 8;
+constexpr uint8_t HTTP_MAX_PATH_ARGS = 2;
+constexpr size_t HTTP_PATH_ARG_SIZE = 32;
+
+// A connection without progress for this long is closed
+constexpr uint32_t HTTP_IDLE_TIMEOUT_MS = 10000;
+// A kept alive connection waiting for its next request is closed earlier,
+// and right away when a new client needs its place
+constexpr uint32_t HTTP_KEEP_ALIVE_TIMEOUT_MS = 5000;
+// Longest wait for socket events, bounds how late timeouts are noticed
+constexpr uint32_t HTTP_POLL_INTERVAL_MS = 100;
+// Longest wait while a connection pushes data as it arrives
+constexpr uint32_t HTTP_PUSH_INTERVAL_MS = 20;
+
+constexpr size_t HTTP_LENGTH_UNKNOWN = SIZE_MAX;
+
+enum class HttpMethod : uint8_t { Get, Head, Post, Put, Delete, Other };
+
+// A parsed request. Everything points into the receive buffer of its
+// connection, nothing is copied or allocated.
+class HttpRequest {
+	HttpMethod _method = HttpMethod::Other;
+	const char* _path = "";
+	bool _http_1_0 = false;
+
+	const char* _header_names[HTTP_MAX_HEADERS];
+	const char* _header_values[HTTP_MAX_HEADERS];
+	uint8_t _header_count = 0;
+
+	const char* _arg_names[HTTP_MAX_ARGS];
+	const char* _arg_values[HTTP_MAX_ARGS];
+	uint8_t _arg_count = 0;
+
+	char _path_args[HTTP_MAX_PATH_ARGS][HTTP_PATH_ARG_SIZE];
+	uint8_t _path_arg_count = 0;
+
+	bool parse(char* text);
+	void parse_query(char* query);
+	bool match(const char* pattern);
+
+	friend class HttpServer;
+
+public:
+	HttpMethod get_method() const;
+	const char* get_path() const;
+
+	// Parts of the path matched by "{}" in the route pattern
+	const char* path_arg(uint8_t index) const;
+
+	// Query arguments, URL decoded. Missing ones are "".
+	bool has_arg(const char* name) const;
+	const char* arg(const char* name) const;
+
+	// Header names are compared case insensitively. Missing ones are "".
+	bool has_header(const char* name) const;
+	const char* header(const char* name) const;
+
+	// HTTP_LENGTH_UNKNOWN without a valid Content-Length header or with a
+	// Transfer-Encoding
+	size_t get_content_length() const;
+};
+
+// Body of a response that stays open and is sent as data arrives, like a
+// WebSocket or an event stream. It runs in the server task.
+class HttpPushSource {
+public:
+	virtual ~HttpPushSource();
+
+	// Called whenever the previous output is sent, and at least every
+	// HTTP_PUSH_INTERVAL_MS. Writes what is available, possibly nothing.
+	// Returns false to close the connection once written is sent.
+	virtual bool produce(uint8_t* buffer, size_t length, size_t& written) = 0;
+
+	// Bytes the client sent after the request. Returns false to close the
+	// connection right away.
+	virtual bool consume(const uint8_t* data, size_t length) = 0;
+
+	// Recycled by response_pool like the bodies of other responses
+	static void* operator new(size_t size);
+	static void* operator new(size_t size, const std::nothrow_t&) noexcept;
+	static void operator delete(void* block);
+	static void operator delete(void* block, const std::nothrow_t&) noexcept;
+};
+
+class HttpResponse;
+
+// Work a response needs before its header, like formatting a whole
+// recording once to learn its length. It runs in the server task one step
+// per turn, so the other clients are served in between.
+class HttpPreparation {
+public:
+	virtual ~HttpPreparation();
+
+	// Does a bounded piece of the work, returns true once all is done
+	virtual bool step() = 0;
+	// Sets up the response after the last step
+	virtual void respond(HttpResponse& response) = 0;
+
+	static void* operator new(size_t size);
+	static void* operator new(size_t size, const std::nothrow_t&) noexcept;
+	static void operator delete(void* block);
+	static void operator delete(void* block, const std::nothrow_t&) noexcept;
+};
+
+// Takes the body of a request as it arrives, like an upload, before there
+// is a response. It runs in the server task.
+class HttpBodySink {
+public:
+	virtual ~HttpBodySink();
+
+	// The next piece of the body, at most HTTP_CHUNK_SIZE bytes. Returns
+	// false to stop reading, the rest of the body is not waited for.
+	virtual bool consume(const uint8_t* data, size_t length) = 0;
+
+	// Sets up the response, after the whole body or once consume() returned
+	// false
+	virtual void respond(HttpResponse& response) = 0;
+
+	static void* operator new(size_t size);
+	static void* operator new(size_t size, const std::nothrow_t&) noexcept;
+	static void operator delete(void* block);
+	static void operator delete(void* block, const std::nothrow_t&) noexcept;
+};
+
+// Set up by a handler, sent by the server afterwards
+class HttpResponse {
+	int _status = 0;
+	const char* _content_type = nullptr;
+	char _headers[HTTP_HEADERS_SIZE];
+	size_t _headers_length = 0;
+
+	char _text[HTTP_TEXT_SIZE];
+	size_t _text_length = 0;
+	std::unique_ptr<ExportStream> _body;
+	size_t _length = 0;
+	std::unique_ptr<HttpPushSource> _push;
+	std::unique_ptr<HttpBodySink> _sink;
+	std::unique_ptr<HttpPreparation> _preparation;
+
+	void clear();
+
+	friend class HttpServer;
+
+public:
+	// Returns false if there is no room left for the header
+	bool set_header(const char* name, const char* value);
+
+	// A short body, copied
+	void send(int status, const char* content_type = nullptr, const char* text = nullptr);
+	// 503 for a body, source, sink or preparation that found no memory,
+	// without the headers set for it. The calls below that take one send
+	// this when given nullptr, as new (std::nothrow) returns then.
+	void send_no_memory();
+
+	// A body produced piece by piece while the server takes turns between
+	// clients. An unknown length is sent chunked.
+	void send(
+		int status,
+		const char* content_type,
+		std::unique_ptr<ExportStream> body,
+		size_t length = HTTP_LENGTH_UNKNOWN);
+
+	// Keeps the connection open for data sent as it arrives. With status 101
+	// the handler sets the Connection and Upgrade headers itself.
+	void push(
+		int status,
+		const char* content_type,
+		std::unique_ptr<HttpPushSource> source);
+
+	// Reads the request body into sink first, which then sets up the
+	// response. The body needs a Content-Length, otherwise the request is
+	// answered with 411.
+	void receive(std::unique_ptr<HttpBodySink> sink);
+	// Runs preparation step by step first, which then sets up the response.
+	// Headers set so far are kept.
+	void prepare(std::unique_ptr<HttpPreparation> preparation);
+};
+
+using HttpHandler = std::function<void(HttpRequest&, HttpResponse&)>;
+
+// HTTP/1.1 server on BSD sockets. A single task waits in select() for all
+// connections and gives every client one chunk per turn, so a slow download
+// never holds up the others. Connections are kept alive between requests.
+// Pipelined requests are answered one after another, the next one is only
+// read once the previous response is sent, so a connection never holds
+// more than its fixed buffers.
+class HttpServer {
+	struct Route {
+		const char* pattern;
+		HttpMethod method;
+		HttpHandler handler;
+	};
+
+	enum class ConnectionState : uint8_t {
+		Free,
+		Reading,
+		Receiving,
+		Preparing,
+		Writing,
+		Pushing,
+	};
+
+	struct Connection {
+		int socket = -1;
+		ConnectionState state = ConnectionState::Free;
+		uint32_t last_activity = 0;
+		// Requests answered so far, and whether the connection stays open
+		// after the current one
+		uint32_t request_count = 0;
+		bool keep_alive = false;
+
+		char request_text[HTTP_REQUEST_SIZE + 1];
+		size_t request_length = 0;
+		// Where the body starts in request_text, and where the next
+		// pipelined request starts after it
+		size_t body_offset = 0;
+		size_t next_request = 0;
+		HttpRequest request;
+		HttpResponse response;
+
+		bool chunked = false;
+		bool send_body = false;
+		// Body bytes left to receive, and then to send
+		size_t remaining = 0;
+
+		// Room for a chunk with its size line in front and the last chunk.
+		// Takes the request body while it is received.
+		uint8_t output[HTTP_CHUNK_SIZE + 16];
+		size_t output_start = 0;
+		size_t output_length = 0;
+	};
+
+	uint16_t _port;
+	int _listener = -1;
+	std::vector<Route> _routes;
+	HttpHandler _not_found;
+	std::unique_ptr<Connection[]> _connections;
+	size_t _next_turn = 0;
+
+	bool open_listener();
+	Connection* find_idle_connection();
+	void accept_connection();
+	void close_connection(Connection& connection);
+	void receive(Connection& connection);
+	void parse_buffered(Connection& connection);
+	void dispatch(Connection& connection);
+	void start_body(Connection& connection);
+	void consume_body(Connection& connection, const uint8_t* data, size_t length);
+	void receive_body(Connection& connection);
+	void prepare_response(Connection& connection);
+	void start_response(Connection& connection);
+	bool fill_output(Connection& connection);
+	bool write_output(Connection& connection);
+	void transmit(Connection& connection);
+	void finish_response(Connection& connection);
+	void receive_pushed(Connection& connection);
+	void transmit_pushed(Connection& connection);
+
+public:
+	explicit HttpServer(uint16_t port = HTTP_PORT);
+	~HttpServer();
+
+	// HEAD requests are served by the GET routes
+	void on(const char* pattern, HttpMethod method, HttpHandler handler);
+	void on_not_found(HttpHandler handler);
+
+	// Waits up to timeout_ms for socket events and handles them
+	void poll(uint32_t timeout_ms = HTTP_POLL_INTERVAL_MS);
+
+	size_t get_connection_count() const;
+};
+
+#endif
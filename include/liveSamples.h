@@ -0,0 +1,33 @@
+#ifndef ECG_ISD_ESP32_LIVESAMPLES_H
+#define ECG_ISD_ESP32_LIVESAMPLES_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ecg_isd_config.h"
+
+// Records kept for live viewers, about a second. A power of 2 so positions
+// keep mapping to the same slot when they wrap.
+constexpr uint32_t LIVE_BUFFER_RECORDS = 512;
+
+// Ring buffer of the latest records from acquisition. The writer never waits
+// for readers, a reader that falls more than the buffer behind loses records
+// instead.
+class LiveSamples {
+	float _records[LIVE_BUFFER_RECORDS][ECG_CHANNELS];
+	// Position of the next record to be written, counts all records
+	std::atomic<uint32_t> _position{ 0 };
+
+public:
+	// Acquisition task only. Missing channels are stored as NAN.
+	void push(const float data[], uint8_t length);
+
+	uint32_t get_position() const;
+
+	// Copies ECG_CHANNELS samples of the record at position. Returns false
+	// if it is not written yet or was overwritten.
+	bool read(uint32_t position, float out[]) const;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef ECG_ISD_ESP32_LIVESTREAM_H
+#define ECG_ISD_ESP32_LIVESTREAM_H
+
+#include <memory>
+
+#include "exportStream.h"
+#include "httpServer.h"
+#include "liveSamples.h"
+
+// Samples are sent in packets of about this length
+constexpr uint32_t LIVE_PACKET_MS = 50;
+constexpr uint32_t LIVE_PACKET_RECORDS = ECG_SAMPLE_RATE_HZ * LIVE_PACKET_MS / 1000;
+
+// Records averaged into one at most, slow clients are decimated up to this
+constexpr uint16_t LIVE_MAX_DECIMATION = 64;
+
+// Length of a Sec-WebSocket-Accept value with its terminating 0
+constexpr size_t WEBSOCKET_ACCEPT_SIZE = 29;
+
+// Starts every binary WebSocket message, followed by record_count records
+// of channel_count floats
+struct LivePacketHeader {
+	// Position of the first averaged record since acquisition started
+	uint32_t first_record;
+	uint16_t record_count;
+	uint16_t decimation;
+	uint8_t channel_count;
+	uint8_t flags;
+	uint16_t reserved;
+};
+static_assert(sizeof(LivePacketHeader) == 12, "LivePacketHeader is packed");
+
+// Set in LivePacketHeader::flags if records were left out before the packet
+constexpr uint8_t LIVE_PACKET_RECORDS_LOST = 1;
+
+// Value of Sec-WebSocket-Accept for the Sec-WebSocket-Key of a request
+void websocket_accept(const char* key, char out[WEBSOCKET_ACCEPT_SIZE]);
+
+// Follows the live samples from the moment it is created, averaging every
+// decimation records into one. A client that falls behind is decimated twice
+// as hard each time, and dropped when that is not enough.
+class LiveStream : public HttpPushSource {
+	std::shared_ptr<const LiveSamples> _samples;
+	ExportSelection _selection;
+	uint32_t _next;
+
+protected:
+	uint16_t _decimation;
+	bool _lost = false;
+
+	uint32_t get_next_position() const;
+	uint8_t get_channel_count() const;
+
+	// Returns false if the client is too slow to keep
+	bool catch_up();
+
+	// Averaged records to send now, up to max. 0 until a packet is due.
+	uint32_t get_packet_records(uint32_t max) const;
+
+	// The next averaged record, returns the number of selected channels
+	uint8_t read_record(float out[]);
+
+public:
+	LiveStream(
+		std::shared_ptr<const LiveSamples> samples,
+		const ExportSelection& selection,
+		uint16_t decimation);
+	~LiveStream() override;
+};
+
+// Binary messages with a LivePacketHeader each. The client is not expected
+// to send anything but control frames.
+class LiveWebSocket : public LiveStream {
+	// Frames from the client, control frames are at most this long
+	uint8_t _incoming[2 + 4 + 125];
+	size_t _incoming_length = 0;
+	// Pong or close frame to send before anything else
+	uint8_t _reply[2 + 125];
+	size_t _reply_length = 0;
+	bool _closing = false;
+
+	void queue_reply(uint8_t opcode, const uint8_t* payload, size_t length);
+
+public:
+	using LiveStream::LiveStream;
+	~LiveWebSocket() override;
+
+	bool produce(uint8_t* buffer, size_t length, size_t& written) override;
+	bool consume(const uint8_t* data, size_t length) override;
+};
+
+// Server-sent events for clients without WebSocket. Every event starts with
+// a line "first_record,decimation,lost" followed by one line per record.
+class LiveEventStream : public LiveStream {
+public:
+	using LiveStream::LiveStream;
+	~LiveEventStream() override;
+
+	bool produce(uint8_t* buffer, size_t length, size_t& written) override;
+	bool consume(const uint8_t* data, size_t length) override;
+};
+
+#endif
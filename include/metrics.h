@@ -0,0 +1,85 @@
+#ifndef ECG_ISD_ESP32_METRICS_H
+#define ECG_ISD_ESP32_METRICS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Upper bounds of the latency buckets in microseconds, a last bucket takes
+// everything slower
+constexpr size_t METRICS_LATENCY_BUCKETS = 10;
+constexpr uint32_t METRICS_LATENCY_BOUNDS_US[METRICS_LATENCY_BUCKETS] = {
+	500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000
+};
+
+// Tasks whose stack is watched
+constexpr size_t METRICS_MAX_TASKS = 8;
+
+// Room for the whole /metrics page, rendered at once
+constexpr size_t METRICS_PAGE_SIZE = 8192;
+
+// Counts of how long an operation took. Observing is a couple of relaxed
+// atomic increments, it never takes a lock.
+class LatencyHistogram {
+	std::atomic<uint32_t> _counts[METRICS_LATENCY_BUCKETS + 1];
+	std::atomic<uint32_t> _sum_us{ 0 };
+
+public:
+	LatencyHistogram();
+
+	void observe(uint32_t microseconds);
+
+	// Appends the buckets, sum and count in Prometheus text format. Returns
+	// the length the text needs, like snprintf.
+	size_t render(char* out, size_t size, const char* name, const char* help) const;
+};
+
+// Health counters of the whole device, written by whichever task does the
+// work and read by the web server. Counters are 32 bits because the ESP32
+// has no lock-free 64 bit atomics, Prometheus takes a wrap for a restart.
+struct Metrics {
+	// Records that reached the recording and records lost on the way
+	std::atomic<uint32_t> records_stored{ 0 };
+	std::atomic<uint32_t> records_dropped{ 0 };
+
+	// Furthest any live client was behind acquisition, and records live
+	// clients skipped to catch up
+	std::atomic<uint32_t> live_lag_high_water{ 0 };
+	std::atomic<uint32_t> live_records_skipped{ 0 };
+
+	LatencyHistogram card_write;
+	LatencyHistogram card_sync;
+	// Time the bus is held to remove a recording, and recordings removed
+	LatencyHistogram card_remove;
+	std::atomic<uint32_t> recordings_removed{ 0 };
+
+	std::atomic<uint32_t> http_connections{ 0 };
+	std::atomic<uint32_t> http_connections_accepted{ 0 };
+	std::atomic<uint32_t> http_requests{ 0 };
+	std::atomic<uint32_t> http_body_bytes{ 0 };
+	// Memory blocks of response objects the pool took from the heap and
+	// handed out again, and the bytes it keeps for reuse
+	std::atomic<uint32_t> http_pool_allocations{ 0 };
+	std::atomic<uint32_t> http_pool_reuses{ 0 };
+	std::atomic<uint32_t> http_pool_kept_bytes{ 0 };
+
+	std::atomic<TaskHandle_t> tasks[METRICS_MAX_TASKS] = {};
+	std::atomic<size_t> task_count{ 0 };
+
+	// Raises a high-water mark without a lock
+	static void raise(std::atomic<uint32_t>& mark, uint32_t value);
+
+	// From setup(), reports the smallest free stack the task ever had
+	void watch_task(TaskHandle_t task);
+
+	// The page in Prometheus text format. records_acquired is the position
+	// of acquisition. Returns the length the page needs, like snprintf.
+	size_t render(char* out, size_t size, uint32_t records_acquired) const;
+};
+
+extern Metrics metrics;
+
+#endif
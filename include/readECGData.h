@@ -1,14 +1,20 @@
 #ifndef ECG_ISD_ESP32_READECGDATA_H
 #define ECG_ISD_ESP32_READECGDATA_H
 
+#include <memory>
+
+class LiveSamples;
 class SPIClass;
 
 class ReadECGData {
 	SPIClass& _spi;
+	std::shared_ptr<LiveSamples> _live_samples;
 
 public:
 	ReadECGData(SPIClass& spi);
 	~ReadECGData();
+	// Every record read is also pushed here for live viewers
+	void set_live_samples(std::shared_ptr<LiveSamples> live_samples);
 	void loop();
 };
 
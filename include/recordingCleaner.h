@@ -0,0 +1,85 @@
+#ifndef ECG_ISD_ESP32_RECORDINGCLEANER_H
+#define ECG_ISD_ESP32_RECORDINGCLEANER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "storage.h"
+
+// Recordings in one removal job, bounds the memory of its name list
+constexpr size_t CLEANER_MAX_RECORDINGS = 500;
+// Recordings listed at a time while looking for expired ones
+constexpr size_t CLEANER_LIST_PAGE = 100;
+
+// How often the retention policy is checked, and how often the task looks
+// for a requested job
+constexpr uint32_t CLEANER_CHECK_MS = 60000;
+constexpr uint32_t CLEANER_POLL_MS = 200;
+
+// The running removal job as far as it got, or the last one once it is done
+struct RemovalProgress {
+	bool running = false;
+	// Started by the retention policy rather than a request
+	bool retention = false;
+	uint32_t total = 0;
+	uint32_t removed = 0;
+	// In use, like the recording being written, or already gone
+	uint32_t skipped = 0;
+	uint64_t bytes = 0;
+	uint32_t duration_ms = 0;
+};
+
+// Removes recordings in the background, one at a time, and steps aside
+// whenever the recording writer waits for the bus. Runs the jobs requested
+// through remove() and the ones the retention policy calls for, one job at
+// a time.
+class RecordingCleaner {
+	std::shared_ptr<Storage> _storage;
+
+	mutable std::mutex _mutex;
+	std::vector<std::string> _queued;
+	RemovalProgress _progress;
+	RetentionPolicy _policy;
+	bool _policy_changed = false;
+
+	// Record counts of the recordings kept at the last check. A count is
+	// only read again when the size of its recording changed, the live
+	// recording's comes from the writer.
+	struct RetainedEntry {
+		std::string name;
+		size_t size;
+		uint32_t record_count;
+	};
+	std::vector<StorageEntry> _recordings;
+	std::vector<RetainedEntry> _retained;
+	std::vector<RetainedEntry> _retained_next;
+	uint32_t _checked_generation = 0;
+	uint32_t _last_check = 0;
+
+	bool queue_locked(std::vector<std::string>& names, bool retention);
+	uint32_t record_count(const StorageEntry& recording);
+	void run(const std::vector<std::string>& names);
+
+public:
+	RecordingCleaner(std::shared_ptr<Storage> storage);
+	~RecordingCleaner();
+
+	// Removes the named recordings in this order. Returns false without
+	// names and while another job waits or runs.
+	bool remove(std::vector<std::string> names);
+	RemovalProgress get_progress() const;
+
+	RetentionPolicy get_policy() const;
+	// Checked right away and saved on the card by the cleaner task
+	void set_policy(const RetentionPolicy& policy);
+
+	// Names of the recordings the policy removes, oldest first and at most
+	// CLEANER_MAX_RECORDINGS. The newest recording is always kept.
+	void find_expired(const RetentionPolicy& policy, std::vector<std::string>& names);
+
+	void loop();
+};
+
+#endif
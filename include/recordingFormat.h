@@ -0,0 +1,217 @@
+#ifndef ECG_ISD_ESP32_RECORDINGFORMAT_H
+#define ECG_ISD_ESP32_RECORDINGFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On-card layout of .rec files, see doc/recording-format.md. All values are
+// little endian.
+namespace recording_format {
+	// Version 1 files have no header and start directly with the length byte
+	// of the first record, which is never 0
+	constexpr uint8_t FILE_MAGIC[4] = { 0x00, 'E', 'C', 'G' };
+	constexpr uint8_t FILE_VERSION = 2;
+
+	// "EBLK"
+	constexpr uint32_t BLOCK_MAGIC = 0x4b4c4245;
+	// "EIDX"
+	constexpr uint32_t INDEX_MAGIC = 0x58444945;
+
+	constexpr uint16_t BLOCK_MAX_RECORDS = 256;
+	constexpr uint16_t BLOCK_MAX_SAMPLES = 1024;
+	constexpr size_t BLOCK_MAX_PAYLOAD =
+		BLOCK_MAX_RECORDS + BLOCK_MAX_SAMPLES * sizeof(float);
+
+	// Blocks sampled into the index, closed recordings end with an index block
+	constexpr uint16_t INDEX_MAX_ENTRIES = 256;
+
+	enum class BlockCodec : uint8_t {
+		Float32 = 0,
+		// Lossless, zigzag varint of the difference to the bit pattern of the
+		// same sample in the previous record
+		DeltaFloat32 = 1,
+		// Lossy, value = offset + scale * q with a scale and offset per block
+		// and q a packed signed 16 or 24 bit integer
+		Int16 = 2,
+		Int24 = 3,
+		Index = 0xff,
+	};
+
+	struct FileHeader {
+		uint8_t magic[4];
+		uint8_t version;
+		uint8_t reserved;
+		uint16_t header_size;
+		// CRC32 of the first FILE_HEADER_BASE_SIZE bytes with this field set
+		// to 0, all that readers of the first version 2 files know
+		uint32_t crc;
+		// Random, tells apart recordings that were given the same name. Files
+		// without it have a header_size of FILE_HEADER_BASE_SIZE.
+		uint32_t recording_id;
+	};
+	static_assert(sizeof(FileHeader) == 16, "FileHeader layout");
+	constexpr size_t FILE_HEADER_BASE_SIZE = 12;
+
+	struct BlockHeader {
+		uint32_t magic;
+		uint32_t payload_size;
+		// Index of the first record of the block within the recording
+		uint32_t first_record;
+		uint16_t record_count;
+		uint8_t codec;
+		uint8_t flags;
+		// CRC32 of the header with this field set to 0, followed by the payload
+		uint32_t crc;
+	};
+	static_assert(sizeof(BlockHeader) == 20, "BlockHeader layout");
+
+	// Records of one block in decoded form: the length of every record
+	// followed by all samples back to back
+	struct BlockBuffer {
+		uint8_t lengths[BLOCK_MAX_RECORDS];
+		float samples[BLOCK_MAX_SAMPLES];
+		uint16_t record_count = 0;
+		uint16_t sample_count = 0;
+
+		bool fits(uint8_t length) const {
+			return record_count < BLOCK_MAX_RECORDS &&
+				sample_count + length <= BLOCK_MAX_SAMPLES;
+		}
+
+		void append(const float data[], uint8_t length);
+
+		void clear() {
+			record_count = 0;
+			sample_count = 0;
+		}
+	};
+
+	struct IndexEntry {
+		uint32_t offset;
+		uint32_t first_record;
+	};
+	static_assert(sizeof(IndexEntry) == 8, "IndexEntry layout");
+
+	// Last bytes of the index block and so of a closed recording
+	struct IndexTrailer {
+		uint32_t record_count;
+		uint32_t block_offset;
+		uint32_t magic;
+	};
+	static_assert(sizeof(IndexTrailer) == 12, "IndexTrailer layout");
+
+	// Keeps at most INDEX_MAX_ENTRIES evenly spaced blocks of a recording of
+	// any length, every other entry is dropped when it runs full
+	struct IndexBuilder {
+		IndexEntry entries[INDEX_MAX_ENTRIES];
+		uint16_t entry_count = 0;
+		uint32_t stride = 1;
+		uint32_t block_count = 0;
+
+		void add(uint32_t offset, uint32_t first_record);
+
+		void clear() {
+			entry_count = 0;
+			stride = 1;
+			block_count = 0;
+		}
+	};
+
+	void init_file_header(FileHeader& header, uint32_t recording_id);
+	// Checks the first FILE_HEADER_BASE_SIZE bytes, the only ones older
+	// files have
+	bool check_file_header(const FileHeader& header);
+
+	// Encodes the block into payload (at least BLOCK_MAX_PAYLOAD bytes) and
+	// fills in the block header, returns the payload size. Falls back to
+	// Float32 where the codec would not save space.
+	size_t encode_block(
+		const BlockBuffer& block,
+		BlockCodec codec,
+		uint32_t first_record,
+		BlockHeader& header,
+		uint8_t payload[]);
+
+	size_t encode_index(
+		const IndexBuilder& index,
+		uint32_t record_count,
+		uint32_t block_offset,
+		BlockHeader& header,
+		uint8_t payload[]);
+
+	bool check_block_header(const BlockHeader& header);
+	bool check_block_crc(const BlockHeader& header, const uint8_t payload[]);
+
+	// Scale and offset in front of the samples of the Int16 and Int24 codecs
+	struct IntScaling {
+		float scale;
+		float offset;
+	};
+	static_assert(sizeof(IntScaling) == 8, "IntScaling layout");
+
+	// Quantizes count samples to bytes_per_sample (2 or 3) byte integers
+	IntScaling pack_ints(
+		const float samples[], size_t count, int bytes_per_sample, uint8_t out[]);
+	void unpack_ints(
+		const uint8_t in[],
+		size_t count,
+		int bytes_per_sample,
+		IntScaling scaling,
+		float samples[]);
+
+	// Index blocks decode to an empty block
+	bool decode_block(
+		const BlockHeader& header, const uint8_t payload[], BlockBuffer& block);
+
+	// Checks a recording file while it arrives piece by piece, the way a
+	// reader would take it: version 1 records, or the version 2 header and
+	// blocks with their CRC, numbering and codec, and the index as the last
+	// block. Holds one block at a time.
+	class FileValidator {
+		enum class Part : uint8_t {
+			Start,
+			FileHeader,
+			HeaderRest,
+			RecordLength,
+			RecordSamples,
+			BlockHeader,
+			Payload,
+			End,
+			Invalid,
+		};
+
+		Part _part = Part::Start;
+		size_t _needed = 1;
+		size_t _collected = 0;
+		size_t _offset = 0;
+
+		uint8_t _version = 0;
+		uint32_t _record_count = 0;
+		size_t _block_offset = 0;
+
+		FileHeader _file_header;
+		BlockHeader _block_header;
+		uint8_t _record_length = 0;
+		uint8_t _payload[BLOCK_MAX_PAYLOAD];
+		BlockBuffer _block;
+
+		void expect(Part part, size_t needed);
+		uint8_t* target();
+		bool advance();
+
+	public:
+		// Returns false at the first byte that can not belong to a
+		// recording, and for anything after it
+		bool update(const uint8_t data[], size_t length);
+
+		// True if the bytes so far end with a whole record or block, or
+		// with the index
+		bool is_complete() const;
+
+		// 0 until the first byte
+		uint8_t get_version() const;
+		uint32_t get_record_count() const;
+	};
+}  // namespace recording_format
+
+#endif
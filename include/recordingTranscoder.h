@@ -0,0 +1,25 @@
+#ifndef ECG_ISD_ESP32_RECORDINGTRANSCODER_H
+#define ECG_ISD_ESP32_RECORDINGTRANSCODER_H
+
+#include <memory>
+
+#include "storage.h"
+
+// Converts version 1 recordings in the background, one file at a time. The
+// last converted name is kept on the card, so work resumes after a reboot.
+class RecordingTranscoder {
+	std::shared_ptr<Storage> _storage;
+	ConversionStats _stats;
+
+	void run_pass();
+
+public:
+	RecordingTranscoder(std::shared_ptr<Storage> storage);
+	~RecordingTranscoder();
+
+	const ConversionStats& get_stats() const;
+
+	void loop();
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef ECG_ISD_ESP32_RESPONSEPOOL_H
+#define ECG_ISD_ESP32_RESPONSEPOOL_H
+
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+
+// Blocks are sized in steps of this, a kept block is handed to the next
+// object of the same step
+constexpr size_t RESPONSE_POOL_STEP = 512;
+// Free blocks kept for reuse, and the memory they may take together
+constexpr size_t RESPONSE_POOL_SLOTS = 16;
+constexpr size_t RESPONSE_POOL_MAX_BYTES = 96 * 1024;
+
+// Memory of the objects a response needs while it is sent: its body, push
+// source or body sink. A request needs one or two of them, in a handful of
+// sizes that repeat, so a released block is kept and taken by the next
+// object of its size. Once every kind of response was served, requests no
+// longer allocate from the heap and do not cut it up. trim() gives the
+// kept blocks back once the server has nothing to do.
+class ResponsePool {
+	union BlockHeader;
+
+	std::mutex _mutex;
+	BlockHeader* _kept[RESPONSE_POOL_SLOTS];
+	size_t _kept_count = 0;
+	size_t _kept_bytes = 0;
+
+	void count_kept_bytes();
+	void* take_kept(size_t size);
+
+public:
+	// Like operator new, from the heap if no kept block fits
+	void* allocate(size_t size);
+	// nullptr instead when the heap has no room
+	void* allocate(size_t size, const std::nothrow_t&) noexcept;
+	void release(void* block);
+
+	void trim();
+};
+
+extern ResponsePool response_pool;
+
+// Deleter of a std::unique_ptr to an array of trivial objects taken from the
+// pool with allocate()
+struct ResponsePoolRelease {
+	void operator()(void* block) const { response_pool.release(block); }
+};
+
+#endif
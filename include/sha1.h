@@ -0,0 +1,13 @@
+#ifndef ECG_ISD_ESP32_SHA1_H
+#define ECG_ISD_ESP32_SHA1_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr size_t SHA1_DIGEST_SIZE = 20;
+
+// SHA-1 (RFC 3174), only used where a protocol requires it, like the
+// WebSocket handshake. Not for anything security related.
+void sha1(const void* data, size_t length, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+#endif
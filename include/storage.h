@@ -1,11 +1,22 @@
 #ifndef ECG_ISD_ESP32_STORAGE_H
 #define ECG_ISD_ESP32_STORAGE_H
 
+#include <atomic>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <string>
+#include <vector>
 
 #include <SD.h>
 
+#include "recordingFormat.h"
+
 class SPIClass;
+class Storage;
+
+// Room for the path of a recording file, /recordings/001/00123.rec
+constexpr size_t STORAGE_PATH_SIZE = 64;
 
 enum class StorageError {
 	None,
@@ -20,7 +31,34 @@ enum class StorageState {
 	Idle,
 	Error,
 	Recording,
-	Reading,
+};
+
+// Why Storage::create_upload() or an upload failed
+enum class UploadError {
+	None,
+	InvalidName,
+	Exists,
+	Busy,
+	NoSpace,
+	InvalidFormat,
+	FileSystemError,
+};
+
+enum class StorageUsageLevel {
+	Normal,
+	Warning,
+	Critical,
+	Full,
+};
+
+// Card usage as accounted by Storage, reading it never touches the card
+struct StorageUsage {
+	uint64_t total_bytes;
+	uint64_t used_bytes;
+	uint64_t quota_bytes;
+	// Left within both the quota and the card
+	uint64_t free_bytes;
+	StorageUsageLevel level;
 };
 
 class StorageEntry {
@@ -42,18 +80,279 @@ public:
 	friend class Storage;
 };
 
+// Consecutive damaged bytes found by Storage::verify_recording(). blocks counts
+// the blocks in the range whose header was intact but whose CRC did not match.
+struct CorruptRange {
+	size_t offset;
+	size_t size;
+	uint32_t first_block;
+	uint32_t blocks;
+};
+
+struct VerifyReport {
+	uint32_t blocks = 0;
+	uint32_t corrupt_blocks = 0;
+	size_t bytes = 0;
+	uint32_t duration_ms = 0;
+	std::vector<CorruptRange> corrupt_ranges;
+};
+
+struct ConversionStats {
+	uint32_t files = 0;
+	size_t bytes_in = 0;
+	size_t bytes_out = 0;
+	uint32_t duration_ms = 0;
+};
+
+// Which old recordings are removed on their own, 0 turns a limit off. The
+// device has no clock, so age is counted in recorded signal: the newest
+// recordings that hold keep_days days of records are kept.
+struct RetentionPolicy {
+	uint16_t keep_days = 0;
+	// Of the quota, or of the card without one
+	uint8_t max_percent = 0;
+};
+
+// Progress of the recording that is currently being written, shared with the
+// readers tailing it. Only bytes below committed_size have been flushed to the
+// card and are safe to read through another file handle, they hold
+// committed_records records.
+struct LiveRecording {
+	std::atomic<size_t> committed_size{ 0 };
+	std::atomic<uint32_t> committed_records{ 0 };
+	std::atomic<bool> closed{ false };
+};
+
+// Independent read handle for one recording, with its own file and cursor.
+// Any number of readers can be open next to the writer, including readers of
+// the recording that is still being written.
+class RecordingReader {
+	Storage& _storage;
+	std::mutex& _spi_mutex;
+
+	char _name[STORAGE_PATH_SIZE];
+	char _path[STORAGE_PATH_SIZE];
+	File _file;
+	size_t _position = 0;
+	size_t _file_size = 0;
+	std::shared_ptr<const LiveRecording> _live;
+
+	uint8_t _version = 0;
+	size_t _data_offset = 0;
+	uint32_t _recording_id = 0;
+	bool _damaged = false;
+	uint32_t _corrupt_blocks = 0;
+	recording_format::BlockBuffer _block;
+	uint8_t _payload[recording_format::BLOCK_MAX_PAYLOAD];
+	uint16_t _block_record = 0;
+	uint16_t _block_sample = 0;
+
+	RecordingReader(
+		Storage& storage,
+		std::mutex& spi_mutex,
+		const char* name,
+		const char* path,
+		File file,
+		std::shared_ptr<const LiveRecording> live);
+
+	size_t readable_size() const;
+	bool reopen();
+	bool read_bytes(size_t offset, void* data, size_t length, size_t limit);
+	bool read_header(size_t limit);
+	bool read_block(size_t limit);
+	int read_v1_record(float data[], uint8_t length, size_t limit);
+	void yield_seek(uint32_t step, std::unique_lock<std::mutex>& lock);
+	bool seek_v1_record(
+		uint32_t record, size_t limit, std::unique_lock<std::mutex>& lock);
+	bool read_index_trailer(
+		size_t limit, recording_format::IndexTrailer& trailer);
+	size_t find_indexed_block(uint32_t record, size_t limit);
+	bool seek_block_record(
+		uint32_t record, size_t limit, std::unique_lock<std::mutex>& lock);
+	bool verify(VerifyReport& report);
+	bool is_complete() const;
+
+public:
+	RecordingReader(const RecordingReader&) = delete;
+	RecordingReader& operator=(const RecordingReader&) = delete;
+	~RecordingReader();
+
+	// Mostly one per web response, response_pool recycles their memory.
+	// With std::nothrow nullptr is returned when the heap has no room.
+	static void* operator new(size_t size);
+	static void* operator new(size_t size, const std::nothrow_t&) noexcept;
+	static void operator delete(void* block);
+	static void operator delete(void* block, const std::nothrow_t&) noexcept;
+
+	const char* get_name() const;
+
+	// 1 or 2, reads the file header if that did not happen yet
+	uint8_t get_version();
+
+	// True while the writer still appends to this recording, a read returning
+	// 0 then only means that no more data has been flushed yet.
+	bool is_live() const;
+	size_t get_position() const;
+	size_t get_size() const;
+
+	// Blocks skipped so far because their CRC did not match
+	uint32_t get_corrupt_blocks() const;
+
+	// Identifies the content of a closed version 2 recording, which never
+	// changes again: the random id in its header and the CRCs of its first
+	// block and of its index. False for live recordings, version 1
+	// recordings, which are converted later, and recordings without a
+	// readable block.
+	bool get_fingerprint(uint32_t& fingerprint);
+
+	int read_record(float data[], uint8_t length);
+
+	// Number of records readable now. The writer publishes it for the
+	// recording it writes and closed recordings store it in their index,
+	// otherwise the block headers or record lengths are counted. The read
+	// position is not changed.
+	uint32_t get_record_count();
+
+	// Continues reading at the record with the given index. Uses the index
+	// of closed recordings and reads only block headers after that. Returns
+	// false if the recording has no such record (yet).
+	bool seek_record(uint32_t record);
+
+	// Reads the file as stored, independent of the record position. Returns
+	// fewer bytes than requested only at the end of the readable data.
+	size_t read_raw(size_t offset, uint8_t* buffer, size_t length);
+
+	friend class Storage;
+};
+
+// Writes a version 2 recording block by block, callers hold the SPI mutex
+class RecordingWriter {
+	File _file;
+	recording_format::BlockCodec _codec = recording_format::BlockCodec::Float32;
+	size_t _written_size = 0;
+	uint32_t _next_record = 0;
+	recording_format::BlockBuffer _block;
+	recording_format::IndexBuilder _index;
+	uint8_t _payload[recording_format::BLOCK_MAX_PAYLOAD];
+
+	bool write(const void* data, size_t length);
+
+public:
+	bool begin(File file, recording_format::BlockCodec codec);
+	bool append(const float data[], uint8_t length);
+	bool write_block();
+	void sync();
+
+	// Writes the last block and the index and closes the file
+	bool finish();
+	void abort();
+
+	size_t get_written_size() const;
+	// Records in the blocks written so far
+	uint32_t get_written_records() const;
+};
+
+// A recording sent to the device. It is written as /recordings/<name>.part
+// in pieces of STORAGE_WRITE_CHUNK and checked on the way, then moved into
+// its bucket once complete. Its size counts against the quota from the
+// start. An upload destroyed before it is finished leaves nothing behind.
+class RecordingUpload {
+	Storage& _storage;
+	std::mutex& _spi_mutex;
+
+	std::string _name;
+	std::string _path;
+	File _file;
+	size_t _size;
+	size_t _received = 0;
+	uint32_t _start_ms;
+	uint32_t _duration_ms = 0;
+	bool _finished = false;
+	UploadError _error = UploadError::None;
+
+	std::unique_ptr<recording_format::FileValidator> _validator;
+	std::unique_ptr<uint8_t[]> _buffer;
+	size_t _buffered = 0;
+
+	RecordingUpload(
+		Storage& storage,
+		std::mutex& spi_mutex,
+		std::string name,
+		std::string path,
+		File file,
+		size_t size);
+
+	bool fail(UploadError error);
+	bool write_buffer();
+
+public:
+	RecordingUpload(const RecordingUpload&) = delete;
+	RecordingUpload& operator=(const RecordingUpload&) = delete;
+	~RecordingUpload();
+
+	// The bytes of the file in order, no more than announced. Returns false
+	// as soon as they can not belong to a recording or can not be written.
+	bool write(const uint8_t data[], size_t length);
+
+	// Once all bytes are written, checks that the recording is complete and
+	// moves it in place
+	bool finish();
+
+	UploadError get_error() const;
+	const char* get_name() const;
+	size_t get_size() const;
+	// From the start until finish()
+	uint32_t get_duration_ms() const;
+
+	friend class Storage;
+};
+
 class Storage {
 	SPIClass& _spi;
 	std::mutex& _spi_mutex;
 
-	int _last_file_index = 0;
-	File _current_file;
+	int _next_file_index = 0;
+	int _max_bucket = -1;
+	size_t _flat_recordings = 0;
+	// Recordings on the card, counted once a directory at a time and kept up
+	// to date after, -1 until then. While counting, changes to directories
+	// already read go to _counted_recordings, later ones are read anyway.
+	std::mutex _count_mutex;
+	int32_t _recording_count = -1;
+	bool _counting = false;
+	int _counted_bucket = -1;
+	size_t _counted_recordings = 0;
 	std::string _current_recording_name;
+	std::string _upload_name;
+	std::shared_ptr<LiveRecording> _live;
+	RecordingWriter _writer;
+	size_t _accounted_size = 0;
+	std::atomic<bool> _writer_waiting{ false };
+	std::vector<const RecordingReader*> _readers;
 	StorageState _state = StorageState::Idle;
 	StorageError _error = StorageError::None;
 
+	std::atomic<uint64_t> _total_bytes{ 0 };
+	std::atomic<uint64_t> _used_bytes{ 0 };
+	std::atomic<uint64_t> _quota_bytes{ 0 };
+	std::atomic<uint32_t> _catalog_generation{ 0 };
+	StorageUsageLevel _reported_level = StorageUsageLevel::Normal;
+
 	bool init();
 	void set_error(StorageError error);
+	bool scan_locked();
+	std::string find_recording_path_locked(const char* name) const;
+	bool find_recording_path_locked(
+		const char* name, char (&path)[STORAGE_PATH_SIZE]) const;
+	bool make_bucket_locked(const char* name);
+	void lock_for_writer(std::unique_lock<std::mutex>& lock);
+	void publish_locked();
+	void account_locked(int64_t bytes);
+	bool is_in_use_locked(const char* name) const;
+	void unregister_reader_locked(const RecordingReader* reader);
+	void count_recording_locked(const std::string& path, int change);
+	bool close_recording_locked();
+	void load_quota_locked();
 
 public:
 	Storage(SPIClass& spi, std::mutex& spi_mutex);
@@ -62,17 +361,81 @@ public:
 	StorageError get_error() const;
 	bool clear_error();
 
-	std::vector<StorageEntry> list_recordings();
+	StorageUsage get_usage() const;
+	// Limits the bytes used on the card, 0 for the whole card. Kept on the
+	// card and applied again on every mount, false if it could not be saved.
+	bool set_quota(uint64_t bytes);
+	uint32_t get_remaining_recording_seconds(
+		recording_format::BlockCodec codec =
+			recording_format::BlockCodec::Float32) const;
+
+	// Replaces the content of recordings with up to max recordings whose
+	// names sort after the given name, sorted. Listing into the same vector
+	// again keeps its memory, names as short as the numbered ones are stored
+	// without allocating. The bus is released between directories.
+	bool list_recordings(
+		std::vector<StorageEntry>& recordings, const char* after, size_t max);
+	// The other way round, up to max recordings whose names sort before the
+	// given name, the newest first. nullptr starts at the newest recording.
+	bool list_recordings_before(
+		std::vector<StorageEntry>& recordings, const char* before, size_t max);
+	// Recordings on the card. The first call reads every directory, later
+	// ones are answered without touching the card.
+	size_t get_recording_count();
+	// Changes whenever a recording is created, grows or is removed and when
+	// the quota changes, without touching the card. Starts at a random value
+	// on every mount.
+	uint32_t get_catalog_generation() const;
 	bool remove_recording(const char* name);
+	// Also tells the bytes the recording took on the card
+	bool remove_recording(const char* name, size_t& size);
 
-	const char* create_new_recording();
+	// Int16 and Int24 store samples at a reduced resolution, reads return
+	// calibrated values in any case
+	const char* create_new_recording(
+		recording_format::BlockCodec codec = recording_format::BlockCodec::Float32);
+	// At the quota the recording is closed and false returned
 	bool write_record(const float data[], uint8_t length);
-
-	bool open_recording(const char* name);
-	int read_record(float data[], uint8_t length);
+	bool flush_recording();
 
 	bool is_recording_open() const;
+	// Records flushed so far if name is the recording being written, false
+	// for any other. Never touches the card.
+	bool get_live_record_count(const char* name, uint32_t& record_count);
+	// False if the last block or the index could not be written. The file
+	// is closed anyway and storage reports FileSystemError.
 	bool close_recording();
+
+	std::unique_ptr<RecordingReader> open_recording(const char* name);
+
+	// Starts storing a recording of size bytes sent from elsewhere, under a
+	// name like the ones create_new_recording() gives. One upload at a time.
+	std::unique_ptr<RecordingUpload> create_upload(
+		const char* name, size_t size, UploadError& error);
+
+	// Streams through the whole recording and checks the CRC of every block
+	bool verify_recording(const char* name, VerifyReport& report);
+
+	// Sorted names of up to max recordings that sort after the given name
+	std::vector<std::string> list_recording_names(const char* after, size_t max);
+
+	// Rewrites a version 1 recording as a compressed and indexed version 2
+	// recording. The new file replaces the old one only once it is complete,
+	// an interrupted conversion is rolled back or forward on the next mount.
+	bool convert_recording(const char* name, ConversionStats& stats);
+
+	// Blocks background work while the recording writer waits for the bus
+	void yield_to_writer();
+
+	std::string load_conversion_cursor();
+	bool save_conversion_cursor(const char* name);
+
+	// Kept on the card next to the conversion cursor, none stored is no limit
+	RetentionPolicy load_retention_policy();
+	bool save_retention_policy(const RetentionPolicy& policy);
+
+	friend class RecordingReader;
+	friend class RecordingUpload;
 };
 
 #endif
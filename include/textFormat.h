@@ -0,0 +1,47 @@
+#ifndef ECG_ISD_ESP32_TEXTFORMAT_H
+#define ECG_ISD_ESP32_TEXTFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest output of format_fixed() and format_uint(), a sign, the 39 digits
+// of the largest float, the point and 9 decimals
+constexpr size_t FORMAT_MAX_LENGTH = 50;
+
+// Writes value with a fixed number of decimals (at most 9) like "%.*f" would,
+// without going through printf. Returns the number of characters written, no
+// terminating 0 is added.
+size_t format_fixed(char* out, float value, uint8_t decimals);
+
+size_t format_uint(char* out, uint32_t value);
+
+// Appends text to a fixed buffer, which stays 0 terminated, and keeps
+// counting once it is full, so the caller learns how much room the text
+// needs. Nothing is allocated.
+class TextWriter {
+	char* _out;
+	size_t _size;
+	size_t _length = 0;
+
+public:
+	TextWriter(char* out, size_t size);
+
+	// Where the next text goes and how much fits there, for functions that
+	// write like snprintf. add() then takes the length they returned.
+	char* get_end() const;
+	size_t get_room() const;
+	void add(size_t length);
+
+	void append(const char* text);
+	void append(const char* text, size_t length);
+	void print(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+	// text as a JSON string with quotes
+	void append_json_string(const char* text);
+
+	// Including what did not fit
+	size_t get_length() const;
+	bool is_truncated() const;
+};
+
+#endif
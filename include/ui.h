@@ -13,6 +13,7 @@
 #include "setupWiFi.h"
 
 class SPIClass;
+class Storage;
 
 class UI;
 
@@ -62,14 +63,17 @@ class UI {
 	std::shared_ptr<UIScreen> _main_menu;
 	std::shared_ptr<UIScreen> _wifi_menu;
 	std::shared_ptr<UIScreen> _measurement_menu;
+	std::shared_ptr<UIScreen> _storage_screen;
 
 	std::shared_ptr<SetupWiFi> _setup_wifi;
+	std::shared_ptr<Storage> _storage;
 
 public:
 	UI(SPIClass& spi, std::mutex& spi_mutex);
 	~UI();
 
 	void set_setup_wifi(std::shared_ptr<SetupWiFi> setup_wifi);
+	void set_storage(std::shared_ptr<Storage> storage);
 
 	void pop(unsigned num = 1);
 	void push(std::shared_ptr<UIScreen> screen);
@@ -1,21 +1,211 @@
 #ifndef ECG_ISD_ESP32_WEBACCESS_H
 #define ECG_ISD_ESP32_WEBACCESS_H
 
+#include "httpServer.h"
 #include "storage.h"
-#include <WebServer.h>
-// WebServer server(80);
+
+class LiveSamples;
+class RecordingCleaner;
+
+class ExportStream;
+struct ExportSelection;
+
+// Buckets of a plot preview unless the request asks for a width
+constexpr uint16_t WEB_PREVIEW_WIDTH = 1000;
+constexpr uint16_t WEB_PREVIEW_MAX_WIDTH = 4000;
+
+// Recordings per page of the catalog unless the request asks for a limit
+constexpr uint32_t WEB_CATALOG_LIMIT = 50;
+constexpr uint32_t WEB_CATALOG_MAX_LIMIT = 200;
+
+// Channel ranges of EDF+ and WFDB exports remembered, each takes about 4 KB
+constexpr size_t WEB_RANGE_CACHE = 2;
+
+// Recordings in one ZIP download, bounds the memory of its entry list
+constexpr size_t WEB_ARCHIVE_MAX_RECORDINGS = 500;
+
+// Number of CSV body lengths remembered for Range requests
+constexpr size_t WEB_CSV_LENGTH_CACHE = 4;
+
+// CSV bytes formatted per server turn while a range is prepared, so other
+// clients wait a few milliseconds at most
+constexpr size_t WEB_PREPARATION_STEP = 16384;
+
+// Records read per server turn while the channel ranges of an EDF+ or WFDB
+// export are found, about as long as a CSV preparation step
+constexpr uint32_t WEB_SCAN_STEP = 1000;
+
+// Recording name and query of a remembered selection, longer ones are not
+// remembered
+constexpr size_t WEB_SELECTION_KEY_SIZE = 96;
+
+// Memory kept for responses goes back to the heap after this long without
+// a connection
+constexpr uint32_t WEB_POOL_TRIM_MS = 30000;
+
+// Compressed responses sent at once, each compressor takes about 35 KB.
+// Other clients get the body uncompressed meanwhile.
+constexpr size_t WEB_MAX_GZIP_STREAMS = 1;
+
+// Byte range of a Range request header, before it is applied to a body
+struct ByteRange {
+	bool suffix;  // The last `last` bytes, first is unused
+	size_t first;
+	size_t last;  // Inclusive, SIZE_MAX if open ended
+};
+
+// Exports that need the range of every channel before the first byte
+enum class RangeExport : uint8_t {
+	Edf,
+	WfdbData,
+	WfdbHeader,
+};
 
 class WebAccess {
-	WebServer _server/* (80) */;
+	friend class CsvRangePreparation;
+	friend class RangePreparation;
+
+	HttpServer _server;
 	std::shared_ptr<Storage> _storage;
+	std::shared_ptr<const LiveSamples> _live_samples;
+	std::shared_ptr<RecordingCleaner> _cleaner;
+
+	// Start of the hash of the running firmware, which formats the exports
+	uint32_t _firmware_tag = 0;
+
+	// CSV bodies are generated, their length is only known after formatting
+	// a whole recording once. Closed recordings never change, so the result
+	// is kept for resumed and parallel partial downloads.
+	struct CsvLength {
+		char key[WEB_SELECTION_KEY_SIZE] = "";
+		size_t size = 0;
+		size_t length = 0;
+	};
+	CsvLength _csv_lengths[WEB_CSV_LENGTH_CACHE];
+	size_t _csv_length_next = 0;
+
+	// Recordings listed from the card a page at a time, keeps its memory
+	// from request to request
+	std::vector<StorageEntry> _listing;
+
+	// Name of the recording before catalog position _cursor_offset, the
+	// next page is listed from there instead of from the first recording
+	std::string _cursor_name;
+	uint32_t _cursor_offset = 0;
+	uint32_t _cursor_generation = 0;
+
+	// Record counts of the last catalog page. The page is listed again once
+	// the catalog generation changed, a count is only read again when the
+	// size of its recording changed.
+	struct CatalogEntry {
+		std::string name;
+		size_t size;
+		uint32_t record_count;
+		bool live;
+	};
+	std::vector<CatalogEntry> _catalog;
+	std::vector<CatalogEntry> _catalog_next;
+	uint32_t _catalog_generation = 0;
+	uint32_t _catalog_offset = 0;
+	uint32_t _catalog_limit = 0;
+	bool _catalog_listed = false;
+
+	uint32_t _last_connection = 0;
+
+	// EDF+ and WFDB headers need the range of every channel before the
+	// first sample. Finding it reads the whole selection a step per server
+	// turn, closed recordings are only read for that once. A WFDB header
+	// also needs the sums of the signal file in its format, found by
+	// encoding it once after the range.
+	struct RangeScan {
+		char key[WEB_SELECTION_KEY_SIZE] = "";
+		size_t size = 0;
+		SelectionRange range;
+		bool summed = false;
+		WfdbSums sums;
+	};
+	RangeScan _ranges[WEB_RANGE_CACHE];
+	size_t _range_next = 0;
+
+	bool requestedSelection(const HttpRequest& request, ExportSelection& selection);
+	bool requestedRange(const HttpRequest& request, ByteRange& range);
+	void sendRangeNotSatisfiable(HttpResponse& response, size_t size);
+	void setContentRange(HttpResponse& response, size_t first, size_t end, size_t size);
+	bool isNotModified(const HttpRequest& request, const char* etag);
+	bool revalidateRecording(
+		const HttpRequest& request,
+		HttpResponse& response,
+		RecordingReader& reader,
+		const char* variant);
+	bool acceptsGzip(const HttpRequest& request);
+	bool sendsGzip(const HttpRequest& request);
+	void sendCompressible(
+		const HttpRequest& request,
+		HttpResponse& response,
+		std::unique_ptr<ExportStream> stream,
+		const char* content_type);
+	bool selectionKey(
+		const HttpRequest& request, const char* recording_name, char* key, size_t size);
+	bool listCatalogPage(uint32_t offset, uint32_t limit, uint32_t generation);
+	bool appendRecording(
+		const char* name, size_t length, std::vector<StorageEntry>& recordings);
+	bool selectedRecordings(
+		const HttpRequest& request,
+		HttpResponse& response,
+		std::vector<StorageEntry>& selected,
+		size_t max);
+	void sendRetention(HttpResponse& response, int status);
+	void sendQuota(HttpResponse& response);
+	void sendRangeExport(
+		const HttpRequest& request,
+		HttpResponse& response,
+		RangeExport kind,
+		const char* recording_name,
+		const ExportSelection& selection,
+		WfdbFormat format);
+	void respondRangeExport(
+		HttpResponse& response,
+		RangeExport kind,
+		const char* recording_name,
+		const ExportSelection& selection,
+		WfdbFormat format,
+		const SelectionRange& range,
+		const WfdbSums& sums,
+		std::unique_ptr<RecordingReader> reader);
+	// nullptr if the range of the selection is not remembered
+	RangeScan* cachedRange(const char* key, size_t size);
+	// sums is nullptr if the signal file was not encoded
+	void rememberRange(
+		const char* key, size_t size, const SelectionRange& range, const WfdbSums* sums);
+	bool requestedWfdbFormat(const HttpRequest& request, WfdbFormat& format);
+	// False if the length of the selection is not remembered
+	bool cachedCsvLength(const char* key, size_t size, size_t& length);
+	void rememberCsvLength(const char* key, size_t size, size_t length);
 
 public:
-	WebAccess(std::shared_ptr<Storage> storage);
+	explicit WebAccess(std::shared_ptr<Storage> storage, uint16_t port = HTTP_PORT);
 	~WebAccess();
-	void handleRoot(); 
-	void handleRecordingCsv();
-	void handleRemoveRecording();
-	void handleNotFound();
+	void setLiveSamples(std::shared_ptr<const LiveSamples> live_samples);
+	void setRecordingCleaner(std::shared_ptr<RecordingCleaner> cleaner);
+	void handleAsset(HttpRequest& request, HttpResponse& response);
+	void handleCatalog(HttpRequest& request, HttpResponse& response);
+	void handleRecordingCsv(HttpRequest& request, HttpResponse& response);
+	void handleRecordingRaw(HttpRequest& request, HttpResponse& response);
+	void handleRecordingEdf(HttpRequest& request, HttpResponse& response);
+	void handleRecordingWfdbData(HttpRequest& request, HttpResponse& response);
+	void handleRecordingWfdbHeader(HttpRequest& request, HttpResponse& response);
+	void handleArchive(HttpRequest& request, HttpResponse& response);
+	void handleRecordingPreview(HttpRequest& request, HttpResponse& response);
+	void handleLive(HttpRequest& request, HttpResponse& response);
+	void handleMetrics(HttpRequest& request, HttpResponse& response);
+	void handleUpload(HttpRequest& request, HttpResponse& response);
+	void handleRemoveRecording(HttpRequest& request, HttpResponse& response);
+	void handleRemoveRecordings(HttpRequest& request, HttpResponse& response);
+	void handleRetention(HttpRequest& request, HttpResponse& response);
+	void handleSetRetention(HttpRequest& request, HttpResponse& response);
+	void handleQuota(HttpRequest& request, HttpResponse& response);
+	void handleSetQuota(HttpRequest& request, HttpResponse& response);
+	void handleNotFound(HttpRequest& request, HttpResponse& response);
 	void loop();
 };
 
@@ -0,0 +1,23 @@
+#ifndef ECG_ISD_ESP32_WEBASSETS_H
+#define ECG_ISD_ESP32_WEBASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A file of the viewer, gzip compressed at build time and kept in flash.
+// src/webAssets.cpp is generated from web/ by tools/embed_web_assets.py.
+struct WebAsset {
+	const char* path;
+	const char* content_type;
+	const uint8_t* data;
+	size_t length;
+	// Quoted, as sent in the ETag header
+	const char* etag;
+	// The path changes with the content, clients may cache it forever
+	bool immutable;
+};
+
+extern const WebAsset WEB_ASSETS[];
+extern const size_t WEB_ASSET_COUNT;
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef ECG_ISD_ESP32_WFDB_H
+#define ECG_ISD_ESP32_WFDB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// PhysioNet WFDB records: a .hea header and a .dat signal file with the
+// samples of all signals interleaved frame by frame. Plain C++, shared by
+// the web export and tools/rec2wfdb.cpp on the host.
+
+enum class WfdbFormat : uint16_t {
+	// Two 12 bit samples packed into 3 bytes
+	Packed212 = 212,
+	// 16 bit little endian samples
+	Int16 = 16,
+};
+
+// Samples converted and packed per call of WfdbEncoder::encode()
+constexpr size_t WFDB_BLOCK_SAMPLES = 512;
+// Room encode() needs for a full block in either format. Format 16 takes
+// the most, 212 with a sample left over from the previous call less.
+constexpr size_t WFDB_BLOCK_BYTES = WFDB_BLOCK_SAMPLES * sizeof(int16_t);
+static_assert(
+	(WFDB_BLOCK_SAMPLES + 2) / 2 * 3 <= WFDB_BLOCK_BYTES, "WFDB_BLOCK_BYTES");
+
+// Scaling of a signal, physical = (digital - baseline) / gain. Initial
+// value and checksum describe the samples encoded so far.
+struct WfdbSignal {
+	float gain = 1;
+	int32_t baseline = 0;
+	int32_t initial_value = 0;
+	uint16_t checksum = 0;
+};
+
+bool wfdb_parse_format(const char* text, WfdbFormat& format);
+
+// Maps min and max into the digital range of the format, with a gain that
+// is written to the header without losing digits
+WfdbSignal wfdb_scaling(WfdbFormat format, float min, float max);
+
+// Bytes of a signal file holding sample_count samples
+uint64_t wfdb_data_size(WfdbFormat format, uint64_t sample_count);
+
+// Converts interleaved physical samples to a signal file. Samples are
+// quantized and packed in blocks by loops without branches, NAN becomes the
+// invalid sample value of the format.
+class WfdbEncoder {
+	WfdbFormat _format;
+	uint8_t _channel_count;
+	WfdbSignal _signals[UINT8_MAX];
+	float _gain[UINT8_MAX];
+	float _baseline[UINT8_MAX];
+	uint32_t _sums[UINT8_MAX];
+	bool _started = false;
+
+	int16_t _digital[WFDB_BLOCK_SAMPLES + 1];
+	// Format 212 packs pairs, the odd sample of a block waits for the next
+	bool _pending = false;
+
+public:
+	WfdbEncoder(WfdbFormat format, uint8_t channel_count, const WfdbSignal signals[]);
+
+	// frame_count whole frames of channel_count samples, at most
+	// WFDB_BLOCK_SAMPLES samples. out takes WFDB_BLOCK_BYTES. Returns the
+	// bytes written.
+	size_t encode(const float samples[], size_t frame_count, uint8_t out[]);
+
+	// Writes a sample still waiting for its pair, returns the bytes written
+	size_t finish(uint8_t out[]);
+
+	WfdbFormat get_format() const;
+	uint8_t get_channel_count() const;
+	// Scaling, initial value and checksum of a signal
+	const WfdbSignal& get_signal(uint8_t channel) const;
+};
+
+// Writes the .hea header of a record whose signal file is
+// <record_name>.dat. Signals are described as "ECG <channel>". Returns the
+// length the header needs, like snprintf.
+size_t wfdb_format_header(
+	char* out,
+	size_t size,
+	const char* record_name,
+	uint32_t frequency,
+	uint32_t frame_count,
+	const WfdbEncoder& encoder,
+	const uint8_t channels[],
+	const char* units);
+
+// The same for signals whose initial values and checksums were found
+// before, without the encoder
+size_t wfdb_format_header(
+	char* out,
+	size_t size,
+	const char* record_name,
+	uint32_t frequency,
+	uint32_t frame_count,
+	WfdbFormat format,
+	uint8_t channel_count,
+	const WfdbSignal signals[],
+	const uint8_t channels[],
+	const char* units);
+
+#endif
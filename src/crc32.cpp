@@ -0,0 +1,62 @@
+#include "crc32.h"
+
+#include <string.h>
+
+namespace {
+	struct Crc32Tables {
+		uint32_t t[8][256];
+	};
+
+	constexpr Crc32Tables make_crc32_tables() {
+		Crc32Tables tables{};
+
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+			}
+			tables.t[0][i] = crc;
+		}
+
+		for (uint32_t i = 0; i < 256; i++) {
+			for (int slice = 1; slice < 8; slice++) {
+				uint32_t prev = tables.t[slice - 1][i];
+				tables.t[slice][i] = (prev >> 8) ^ tables.t[0][prev & 0xff];
+			}
+		}
+
+		return tables;
+	}
+
+	// Generated at compile time, lives in flash
+	constexpr Crc32Tables crc32_tables = make_crc32_tables();
+}  // namespace
+
+uint32_t crc32_update(uint32_t crc, const void* data, size_t length) {
+	const auto& t = crc32_tables.t;
+	auto p = static_cast<const uint8_t*>(data);
+
+	crc = ~crc;
+
+	// Slicing-by-8, eight input bytes per step (the ESP32 is little endian)
+	while (length >= 8) {
+		uint32_t one;
+		uint32_t two;
+		memcpy(&one, p, 4);
+		memcpy(&two, p + 4, 4);
+		one ^= crc;
+
+		crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^
+			t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^ t[3][two & 0xff] ^
+			t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+
+		p += 8;
+		length -= 8;
+	}
+
+	while (length--) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+	}
+
+	return ~crc;
+}
@@ -0,0 +1,598 @@
+#include "deflate.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+	constexpr uint16_t LENGTH_BASE[29] = { 3,  4,  5,  6,   7,   8,   9,   10,
+										   11, 13, 15, 17,  19,  23,  27,  31,
+										   35, 43, 51, 59,  67,  83,  99,  115,
+										   131, 163, 195, 227, 258 };
+	constexpr uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+										   1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+										   4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	constexpr uint16_t DISTANCE_BASE[30] = {
+		1,	  2,	3,	  4,	5,	  7,	9,	  13,	 17,	25,
+		33,	  49,	65,	  97,	129,  193,	257,  385,	 513,	769,
+		1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+	};
+	constexpr uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+											 4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+											 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Order in which the code length code lengths are stored
+	constexpr uint8_t CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8,  7, 9,
+												6,	10, 5,	11, 4, 12, 3,
+												13, 2,	14, 1,	15 };
+
+	constexpr uint8_t CODE_LENGTH_EXTRA[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+												0, 0, 0, 0, 0, 0, 2, 3, 7 };
+
+	uint8_t log2(uint32_t value) {
+		return 31 - __builtin_clz(value);
+	}
+
+	// Code 257 + result for a match of length MIN_MATCH + value
+	uint8_t length_code(uint8_t value) {
+		if (value < 8) {
+			return value;
+		}
+		if (value == 255) {
+			return 28;
+		}
+
+		uint8_t bits = log2(value);
+		return 4 * (bits - 1) + ((value >> (bits - 2)) & 3);
+	}
+
+	uint8_t distance_code(uint16_t distance) {
+		uint16_t value = distance - 1;
+
+		if (value < 4) {
+			return value;
+		}
+
+		uint8_t bits = log2(value);
+		return 2 * bits + ((value >> (bits - 1)) & 1);
+	}
+
+	// In-place code lengths for weights sorted in ascending order, see
+	// Moffat and Katajainen, "In-Place Calculation of Minimum-Redundancy
+	// Codes". Needs at least two weights.
+	void minimum_redundancy(uint32_t a[], int n) {
+		int root = 0;
+		int leaf = 2;
+
+		a[0] += a[1];
+
+		for (int next = 1; next < n - 1; next++) {
+			if (leaf >= n || a[root] < a[leaf]) {
+				a[next] = a[root];
+				a[root++] = next;
+			} else {
+				a[next] = a[leaf++];
+			}
+
+			if (leaf >= n || (root < next && a[root] < a[leaf])) {
+				a[next] += a[root];
+				a[root++] = next;
+			} else {
+				a[next] += a[leaf++];
+			}
+		}
+
+		a[n - 2] = 0;
+		for (int next = n - 3; next >= 0; next--) {
+			a[next] = a[a[next]] + 1;
+		}
+
+		int available = 1;
+		int used = 0;
+		uint32_t depth = 0;
+		root = n - 2;
+		int next = n - 1;
+
+		while (available > 0) {
+			while (root >= 0 && a[root] == depth) {
+				used++;
+				root--;
+			}
+			while (available > used) {
+				a[next--] = depth;
+				available--;
+			}
+			available = 2 * used;
+			depth++;
+			used = 0;
+		}
+	}
+
+	// Huffman code lengths of at most max_length bits. At least two symbols
+	// get a code, some decoders reject a single code of one bit.
+	void build_lengths(
+		const uint16_t freq[],
+		uint16_t count,
+		uint8_t max_length,
+		uint8_t lengths[]) {
+		uint16_t sorted[288];
+		uint32_t weights[288];
+		uint16_t used = 0;
+
+		for (uint16_t symbol = 0; symbol < count; symbol++) {
+			lengths[symbol] = 0;
+			if (freq[symbol] > 0) {
+				sorted[used++] = symbol;
+			}
+		}
+
+		for (uint16_t symbol = 0; used < 2; symbol++) {
+			if (freq[symbol] == 0) {
+				sorted[used++] = symbol;
+			}
+		}
+
+		std::sort(sorted, sorted + used, [freq](uint16_t a, uint16_t b) {
+			return freq[a] < freq[b] || (freq[a] == freq[b] && a < b);
+		});
+
+		for (uint16_t i = 0; i < used; i++) {
+			weights[i] = freq[sorted[i]];
+		}
+
+		minimum_redundancy(weights, used);
+
+		// Lengths over the limit are shortened and the Kraft sum is restored
+		// by lengthening the deepest codes that still fit
+		uint16_t length_count[32] = {};
+		for (uint16_t i = 0; i < used; i++) {
+			length_count[std::min<uint32_t>(weights[i], max_length)]++;
+		}
+
+		uint32_t total = 0;
+		for (uint8_t length = max_length; length > 0; length--) {
+			total += (uint32_t) length_count[length] << (max_length - length);
+		}
+
+		while (total > (1u << max_length)) {
+			length_count[max_length]--;
+			for (uint8_t length = max_length - 1; length > 0; length--) {
+				if (length_count[length] > 0) {
+					length_count[length]--;
+					length_count[length + 1] += 2;
+					break;
+				}
+			}
+			total--;
+		}
+
+		// The least frequent symbols come first and get the longest codes
+		uint16_t next = 0;
+		for (uint8_t length = max_length; length > 0; length--) {
+			for (uint16_t i = 0; i < length_count[length]; i++) {
+				lengths[sorted[next++]] = length;
+			}
+		}
+	}
+
+	// Canonical codes, bit reversed since deflate sends them first bit first
+	void build_codes(const uint8_t lengths[], uint16_t count, uint16_t codes[]) {
+		uint16_t length_count[16] = {};
+		uint16_t next_code[16];
+
+		for (uint16_t symbol = 0; symbol < count; symbol++) {
+			length_count[lengths[symbol]]++;
+		}
+		length_count[0] = 0;
+
+		uint16_t code = 0;
+		for (uint8_t bits = 1; bits < 16; bits++) {
+			code = (code + length_count[bits - 1]) << 1;
+			next_code[bits] = code;
+		}
+
+		for (uint16_t symbol = 0; symbol < count; symbol++) {
+			uint8_t length = lengths[symbol];
+			if (length == 0) {
+				continue;
+			}
+
+			uint16_t value = next_code[length]++;
+			uint16_t reversed = 0;
+			for (uint8_t bit = 0; bit < length; bit++) {
+				reversed = (reversed << 1) | ((value >> bit) & 1);
+			}
+			codes[symbol] = reversed;
+		}
+	}
+
+	uint8_t fixed_literal_length(uint16_t symbol) {
+		return symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+	}
+}  // namespace
+
+Deflate::Deflate(uint8_t level) : _level(std::max<uint8_t>(level, 1)) {
+	reset();
+}
+
+void Deflate::reset() {
+	memset(_head, 0, sizeof(_head));
+	memset(_literal_freq, 0, sizeof(_literal_freq));
+	memset(_distance_freq, 0, sizeof(_distance_freq));
+
+	_position = 0;
+	_lookahead = 0;
+	_symbol_count = 0;
+	_output_length = 0;
+	_output_read = 0;
+	_bits = 0;
+	_bit_count = 0;
+	_emitted = 0;
+	_emitting = false;
+	_final_block = false;
+	_finishing = false;
+	_done = false;
+}
+
+void Deflate::put_bits(uint32_t value, uint8_t count) {
+	_bits |= value << _bit_count;
+	_bit_count += count;
+
+	while (_bit_count >= 8) {
+		_output[_output_length++] = _bits;
+		_bits >>= 8;
+		_bit_count -= 8;
+	}
+}
+
+uint16_t Deflate::insert_hash(size_t position) {
+	const uint8_t* p = _window + position;
+	uint32_t hash = ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >>
+		(32 - DEFLATE_HASH_BITS);
+
+	uint16_t previous = _head[hash];
+	_prev[position & (DEFLATE_WINDOW_SIZE - 1)] = previous;
+	_head[hash] = position + 1;
+
+	return previous;
+}
+
+uint16_t Deflate::find_match(
+	size_t position, size_t max_length, uint16_t& distance) {
+	const uint8_t* current = _window + position;
+	uint16_t candidate = insert_hash(position);
+	uint16_t best = 0;
+
+	for (uint8_t tries = _level; candidate != 0 && tries > 0; tries--) {
+		size_t match = candidate - 1;
+
+		// Older entries of _prev are already overwritten
+		if (position - match >= DEFLATE_WINDOW_SIZE) {
+			break;
+		}
+
+		const uint8_t* previous = _window + match;
+
+		if (previous[best] == current[best] && previous[0] == current[0] &&
+			previous[1] == current[1]) {
+			uint16_t length = 2;
+			while (length < max_length && previous[length] == current[length]) {
+				length++;
+			}
+
+			if (length > best) {
+				best = length;
+				distance = position - match;
+
+				if (length == max_length) {
+					break;
+				}
+			}
+		}
+
+		candidate = _prev[match & (DEFLATE_WINDOW_SIZE - 1)];
+	}
+
+	return best >= MIN_MATCH ? best : 0;
+}
+
+void Deflate::compress_input() {
+	// Without the end of input a match may still grow, so MAX_MATCH bytes are
+	// kept ahead of the position
+	while (_symbol_count < DEFLATE_BLOCK_SYMBOLS &&
+		   (_lookahead >= MAX_MATCH || (_finishing && _lookahead > 0))) {
+		uint16_t distance = 0;
+		uint16_t length = 0;
+
+		if (_lookahead >= MIN_MATCH) {
+			length = find_match(
+				_position, std::min<size_t>(_lookahead, MAX_MATCH), distance);
+		}
+
+		if (length == 0) {
+			uint8_t literal = _window[_position];
+			_symbol_literal[_symbol_count] = literal;
+			_symbol_distance[_symbol_count] = 0;
+			_literal_freq[literal]++;
+			length = 1;
+		} else {
+			_symbol_literal[_symbol_count] = length - MIN_MATCH;
+			_symbol_distance[_symbol_count] = distance;
+			_literal_freq[257 + length_code(length - MIN_MATCH)]++;
+			_distance_freq[distance_code(distance)]++;
+
+			for (uint16_t i = 1; i < length && _lookahead - i >= MIN_MATCH; i++) {
+				insert_hash(_position + i);
+			}
+		}
+
+		_symbol_count++;
+		_position += length;
+		_lookahead -= length;
+	}
+}
+
+void Deflate::slide_window() {
+	memmove(_window, _window + DEFLATE_WINDOW_SIZE, DEFLATE_WINDOW_SIZE);
+	_position -= DEFLATE_WINDOW_SIZE;
+
+	for (auto& entry : _head) {
+		entry = entry > DEFLATE_WINDOW_SIZE ? entry - DEFLATE_WINDOW_SIZE : 0;
+	}
+	for (auto& entry : _prev) {
+		entry = entry > DEFLATE_WINDOW_SIZE ? entry - DEFLATE_WINDOW_SIZE : 0;
+	}
+}
+
+void Deflate::start_block() {
+	_final_block = _finishing && _lookahead == 0;
+	_literal_freq[256]++;
+
+	build_lengths(_literal_freq, LITERAL_CODES, 15, _literal_length);
+	build_lengths(_distance_freq, DISTANCE_CODES, 15, _distance_length);
+	_literal_length[286] = 0;
+	_literal_length[287] = 0;
+
+	uint16_t literal_count = LITERAL_CODES;
+	while (literal_count > 257 && _literal_length[literal_count - 1] == 0) {
+		literal_count--;
+	}
+	uint16_t distance_count = DISTANCE_CODES;
+	while (distance_count > 1 && _distance_length[distance_count - 1] == 0) {
+		distance_count--;
+	}
+
+	// Both code length tables in one, run length coded
+	uint8_t lengths[LITERAL_CODES + DISTANCE_CODES];
+	memcpy(lengths, _literal_length, literal_count);
+	memcpy(lengths + literal_count, _distance_length, distance_count);
+	size_t length_count = literal_count + distance_count;
+
+	uint8_t runs[LITERAL_CODES + DISTANCE_CODES];
+	uint8_t run_extra[LITERAL_CODES + DISTANCE_CODES];
+	uint16_t run_freq[19] = {};
+	size_t run_count = 0;
+
+	auto add_run = [&](uint8_t symbol, uint8_t extra) {
+		runs[run_count] = symbol;
+		run_extra[run_count++] = extra;
+		run_freq[symbol]++;
+	};
+
+	for (size_t i = 0; i < length_count;) {
+		uint8_t length = lengths[i];
+		size_t run = 1;
+		while (i + run < length_count && lengths[i + run] == length) {
+			run++;
+		}
+		i += run;
+
+		if (length == 0) {
+			while (run >= 11) {
+				size_t count = std::min<size_t>(run, 138);
+				add_run(18, count - 11);
+				run -= count;
+			}
+			if (run >= 3) {
+				add_run(17, run - 3);
+				run = 0;
+			}
+		} else {
+			add_run(length, 0);
+			run--;
+			while (run >= 3) {
+				size_t count = std::min<size_t>(run, 6);
+				add_run(16, count - 3);
+				run -= count;
+			}
+		}
+
+		for (; run > 0; run--) {
+			add_run(length, 0);
+		}
+	}
+
+	uint8_t run_length[19];
+	uint16_t run_code[19];
+	build_lengths(run_freq, 19, 7, run_length);
+	build_codes(run_length, 19, run_code);
+
+	uint8_t order_count = 19;
+	while (order_count > 4 &&
+		   run_length[CODE_LENGTH_ORDER[order_count - 1]] == 0) {
+		order_count--;
+	}
+
+	// Short blocks are often smaller with the fixed codes and no tables
+	uint32_t dynamic_bits = 14 + 3 * order_count;
+	uint32_t fixed_bits = 0;
+
+	for (uint8_t symbol = 0; symbol < 19; symbol++) {
+		dynamic_bits +=
+			run_freq[symbol] * (run_length[symbol] + CODE_LENGTH_EXTRA[symbol]);
+	}
+	for (uint16_t symbol = 0; symbol < LITERAL_CODES; symbol++) {
+		dynamic_bits += _literal_freq[symbol] * _literal_length[symbol];
+		fixed_bits += _literal_freq[symbol] * fixed_literal_length(symbol);
+	}
+	for (uint8_t symbol = 0; symbol < DISTANCE_CODES; symbol++) {
+		dynamic_bits += _distance_freq[symbol] * _distance_length[symbol];
+		fixed_bits += _distance_freq[symbol] * 5;
+	}
+
+	put_bits(_final_block, 1);
+
+	if (fixed_bits <= dynamic_bits) {
+		put_bits(1, 2);
+
+		for (uint16_t symbol = 0; symbol < 288; symbol++) {
+			_literal_length[symbol] = fixed_literal_length(symbol);
+		}
+		for (uint8_t symbol = 0; symbol < DISTANCE_CODES; symbol++) {
+			_distance_length[symbol] = 5;
+		}
+	} else {
+		put_bits(2, 2);
+		put_bits(literal_count - 257, 5);
+		put_bits(distance_count - 1, 5);
+		put_bits(order_count - 4, 4);
+
+		for (uint8_t i = 0; i < order_count; i++) {
+			put_bits(run_length[CODE_LENGTH_ORDER[i]], 3);
+		}
+		for (size_t i = 0; i < run_count; i++) {
+			put_bits(run_code[runs[i]], run_length[runs[i]]);
+			put_bits(run_extra[i], CODE_LENGTH_EXTRA[runs[i]]);
+		}
+	}
+
+	build_codes(_literal_length, 288, _literal_code);
+	build_codes(_distance_length, DISTANCE_CODES, _distance_code);
+
+	_emitted = 0;
+	_emitting = true;
+}
+
+void Deflate::emit_symbols() {
+	// A symbol takes at most 48 bits
+	while (_emitted < _symbol_count) {
+		if (_output_length + 8 > DEFLATE_OUTPUT_SIZE) {
+			return;
+		}
+
+		uint8_t literal = _symbol_literal[_emitted];
+		uint16_t distance = _symbol_distance[_emitted++];
+
+		if (distance == 0) {
+			put_bits(_literal_code[literal], _literal_length[literal]);
+			continue;
+		}
+
+		uint8_t code = length_code(literal);
+		put_bits(_literal_code[257 + code], _literal_length[257 + code]);
+		put_bits(literal + MIN_MATCH - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+		code = distance_code(distance);
+		put_bits(_distance_code[code], _distance_length[code]);
+		put_bits(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+	}
+
+	if (_output_length + 8 > DEFLATE_OUTPUT_SIZE) {
+		return;
+	}
+
+	put_bits(_literal_code[256], _literal_length[256]);
+
+	if (_final_block) {
+		if (_bit_count > 0) {
+			put_bits(0, 8 - _bit_count);
+		}
+		_done = true;
+	}
+
+	_emitting = false;
+	_symbol_count = 0;
+	memset(_literal_freq, 0, sizeof(_literal_freq));
+	memset(_distance_freq, 0, sizeof(_distance_freq));
+}
+
+bool Deflate::produce() {
+	// Only called once all output was read
+	_output_length = 0;
+	_output_read = 0;
+
+	if (_emitting) {
+		emit_symbols();
+		return true;
+	}
+
+	if (_done) {
+		return false;
+	}
+
+	compress_input();
+
+	if (_symbol_count == DEFLATE_BLOCK_SYMBOLS ||
+		(_finishing && _lookahead == 0)) {
+		start_block();
+		emit_symbols();
+		return true;
+	}
+
+	return false;
+}
+
+size_t Deflate::write(const uint8_t* data, size_t length) {
+	size_t taken = 0;
+
+	if (_finishing) {
+		return 0;
+	}
+
+	while (true) {
+		compress_input();
+
+		if (taken == length || _symbol_count == DEFLATE_BLOCK_SYMBOLS) {
+			break;
+		}
+
+		if (_position + _lookahead == sizeof(_window)) {
+			slide_window();
+		}
+
+		size_t count =
+			std::min(length - taken, sizeof(_window) - _position - _lookahead);
+		memcpy(_window + _position + _lookahead, data + taken, count);
+		_lookahead += count;
+		taken += count;
+	}
+
+	return taken;
+}
+
+void Deflate::finish() {
+	_finishing = true;
+}
+
+size_t Deflate::read(uint8_t* buffer, size_t length) {
+	size_t filled = 0;
+
+	while (filled < length) {
+		if (_output_read == _output_length) {
+			if (!produce()) {
+				break;
+			}
+			continue;
+		}
+
+		size_t count = std::min(length - filled, _output_length - _output_read);
+		memcpy(buffer + filled, _output + _output_read, count);
+		filled += count;
+		_output_read += count;
+	}
+
+	return filled;
+}
+
+bool Deflate::is_done() const {
+	return _done && _output_read == _output_length;
+}
@@ -0,0 +1,1232 @@
+#include "exportStream.h"
+
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Arduino.h>
+
+#include "crc32.h"
+#include "ecg_isd_config.h"
+#include "textFormat.h"
+
+ExportStream::~ExportStream() {}
+
+size_t ExportStream::skip(size_t length) {
+	uint8_t scratch[64];
+	size_t skipped = 0;
+
+	while (skipped < length) {
+		size_t count =
+			read(scratch, std::min(length - skipped, sizeof(scratch)));
+		if (count == 0) {
+			break;
+		}
+		skipped += count;
+	}
+
+	return skipped;
+}
+
+void* ExportStream::operator new(size_t size) {
+	return response_pool.allocate(size);
+}
+
+void* ExportStream::operator new(size_t size, const std::nothrow_t&) noexcept {
+	return response_pool.allocate(size, std::nothrow);
+}
+
+void ExportStream::operator delete(void* block) {
+	response_pool.release(block);
+}
+
+void ExportStream::operator delete(void* block, const std::nothrow_t&) noexcept {
+	response_pool.release(block);
+}
+
+MemoryExport::MemoryExport(const void* data, size_t length)
+	: _data((const uint8_t*) data), _length(length) {}
+
+MemoryExport::~MemoryExport() {}
+
+size_t MemoryExport::get_length() const {
+	return _length - _offset;
+}
+
+size_t MemoryExport::read(uint8_t* buffer, size_t length) {
+	size_t count = std::min(length, get_length());
+	memcpy(buffer, _data + _offset, count);
+	_offset += count;
+
+	return count;
+}
+
+size_t MemoryExport::skip(size_t length) {
+	size_t count = std::min(length, get_length());
+	_offset += count;
+
+	return count;
+}
+
+TextExport::TextExport() : _writer(_text, sizeof(_text)) {}
+
+TextExport::~TextExport() {}
+
+TextWriter& TextExport::get_writer() {
+	return _writer;
+}
+
+bool TextExport::is_complete() const {
+	return !_writer.is_truncated();
+}
+
+size_t TextExport::get_length() const {
+	return std::min(_writer.get_length(), sizeof(_text) - 1) - _offset;
+}
+
+size_t TextExport::read(uint8_t* buffer, size_t length) {
+	size_t count = std::min(length, get_length());
+	memcpy(buffer, _text + _offset, count);
+	_offset += count;
+
+	return count;
+}
+
+size_t TextExport::skip(size_t length) {
+	size_t count = std::min(length, get_length());
+	_offset += count;
+
+	return count;
+}
+
+MetricsExport::MetricsExport(uint32_t records_acquired)
+	: _length(metrics.render(_page, sizeof(_page), records_acquired)) {
+	if (_length >= sizeof(_page)) {
+		log_e("metrics page needs %u bytes", (unsigned) _length + 1);
+
+		// Whole lines only, a scraper rejects a cut one
+		_length = sizeof(_page) - 1;
+		while (_length > 0 && _page[_length - 1] != '\n') {
+			_length--;
+		}
+	}
+}
+
+MetricsExport::~MetricsExport() {}
+
+size_t MetricsExport::get_length() const {
+	return _length - _offset;
+}
+
+size_t MetricsExport::read(uint8_t* buffer, size_t length) {
+	size_t count = std::min(length, get_length());
+	memcpy(buffer, _page + _offset, count);
+	_offset += count;
+
+	return count;
+}
+
+uint8_t ExportSelection::select(
+	const float data[], uint8_t length, float out[]) const {
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < channel_count; i++) {
+		if (channels[i] < length) {
+			out[count++] = data[channels[i]];
+		}
+	}
+
+	return count;
+}
+
+uint8_t ExportSelection::channel(uint8_t index, uint8_t length) const {
+	if (channel_count == 0) {
+		return index;
+	}
+
+	for (uint8_t i = 0; i < channel_count; i++) {
+		if (channels[i] < length && index-- == 0) {
+			return channels[i];
+		}
+	}
+
+	return 0;
+}
+
+SelectionReader::SelectionReader(
+	std::unique_ptr<RecordingReader> reader, const ExportSelection& selection)
+	: _reader(std::move(reader)), _selection(selection) {}
+
+const ExportSelection& SelectionReader::get_selection() const {
+	return _selection;
+}
+
+uint8_t SelectionReader::get_record_length() const {
+	return _record_length;
+}
+
+int SelectionReader::read_record(float out[]) {
+	if (_records_read == _selection.record_count) {
+		return 0;
+	}
+
+	if (!_started) {
+		_started = true;
+
+		// Nothing before the first record is decoded or even read
+		if (_selection.first_record > 0 &&
+			!_reader->seek_record(_selection.first_record)) {
+			_records_read = _selection.record_count;
+			return 0;
+		}
+	}
+
+	int length = _reader->read_record(_data, UINT8_MAX);
+
+	if (length <= 0) {
+		return 0;
+	}
+
+	_records_read++;
+	_record_length = length;
+
+	if (_selection.channel_count == 0) {
+		memcpy(out, _data, sizeof(float) * length);
+		return length;
+	}
+
+	return _selection.select(_data, length, out);
+}
+
+SelectionScan::SelectionScan(
+	std::unique_ptr<RecordingReader> reader, const ExportSelection& selection)
+	: _reader(std::move(reader), selection) {}
+
+bool SelectionScan::step(uint32_t record_count) {
+	SelectionRange& range = _range;
+
+	for (uint32_t read = 0; !_done && read < record_count; read++) {
+		int length = _reader.read_record(_data);
+		if (length <= 0) {
+			_done = true;
+			break;
+		}
+
+		for (int i = range.channel_count; i < length; i++) {
+			range.min[i] = INFINITY;
+			range.max[i] = -INFINITY;
+		}
+		range.channel_count = std::max<int>(range.channel_count, length);
+		range.record_length = std::max(range.record_length, _reader.get_record_length());
+
+		// NAN and infinities never replace a bound
+		for (int i = 0; i < length; i++) {
+			if (isfinite(_data[i])) {
+				range.min[i] = std::min(range.min[i], _data[i]);
+				range.max[i] = std::max(range.max[i], _data[i]);
+			}
+		}
+
+		range.record_count++;
+	}
+
+	if (!_done) {
+		return false;
+	}
+
+	for (uint8_t i = 0; i < range.channel_count; i++) {
+		if (range.min[i] > range.max[i]) {
+			range.min[i] = range.max[i] = 0;
+		}
+	}
+	return true;
+}
+
+const SelectionRange& SelectionScan::get_range() const {
+	return _range;
+}
+
+CsvExport::CsvExport(
+	std::unique_ptr<RecordingReader> reader,
+	const ExportSelection& selection,
+	uint8_t decimals)
+	: _reader(std::move(reader), selection), _decimals(decimals) {}
+
+CsvExport::~CsvExport() {}
+
+bool CsvExport::format_next_line() {
+	if (_next_sample == _sample_count) {
+		int length = _reader.read_record(_data);
+
+		if (length <= 0) {
+			return false;
+		}
+
+		_sample_count = length;
+		_next_sample = 0;
+	}
+
+	char* out = _line;
+	// Room for one more sample and its separator
+	const char* last = _line + sizeof(_line) - (FORMAT_MAX_LENGTH + 1);
+
+	while (_next_sample < _sample_count && out <= last) {
+		out += format_fixed(out, _data[_next_sample], _decimals);
+		_next_sample++;
+		*out++ = _next_sample == _sample_count ? '\n' : ',';
+	}
+
+	_line_length = out - _line;
+	_line_sent = 0;
+
+	return true;
+}
+
+size_t CsvExport::read(uint8_t* buffer, size_t length) {
+	size_t filled = 0;
+
+	while (filled < length) {
+		if (_line_sent == _line_length) {
+			if (_done || !format_next_line()) {
+				_done = true;
+				break;
+			}
+		}
+
+		size_t count = std::min(length - filled, _line_length - _line_sent);
+		memcpy(buffer + filled, _line + _line_sent, count);
+		filled += count;
+		_line_sent += count;
+	}
+
+	return filled;
+}
+
+size_t CsvExport::skip(size_t length) {
+	size_t skipped = 0;
+
+	// Lines are still formatted to know their length, but never copied
+	while (skipped < length) {
+		if (_line_sent == _line_length) {
+			if (_done || !format_next_line()) {
+				_done = true;
+				break;
+			}
+		}
+
+		size_t count = std::min(length - skipped, _line_length - _line_sent);
+		skipped += count;
+		_line_sent += count;
+	}
+
+	return skipped;
+}
+
+RawExport::RawExport(
+	std::unique_ptr<RecordingReader> reader, size_t offset, size_t end)
+	: _reader(std::move(reader)), _offset(offset),
+	  _end(std::min(end, _reader->get_size())) {}
+
+RawExport::~RawExport() {}
+
+size_t RawExport::get_length() const {
+	return _end > _offset ? _end - _offset : 0;
+}
+
+size_t RawExport::read(uint8_t* buffer, size_t length) {
+	if (_offset >= _end) {
+		return 0;
+	}
+
+	// No decoding at all, the bytes go from the card to the socket as stored
+	size_t count =
+		_reader->read_raw(_offset, buffer, std::min(length, _end - _offset));
+	_offset += count;
+
+	return count;
+}
+
+size_t RawExport::skip(size_t length) {
+	size_t count = std::min(length, get_length());
+	_offset += count;
+
+	return count;
+}
+
+PreviewExport::PreviewExport(
+	std::unique_ptr<RecordingReader> reader,
+	const ExportSelection& selection,
+	uint32_t record_count,
+	uint16_t width,
+	uint8_t decimals)
+	: _reader(std::move(reader), selection),
+	  _first_record(selection.first_record), _decimals(decimals) {
+	width = std::max<uint16_t>(width, 1);
+	_bucket_size = std::max<uint32_t>((record_count + width - 1) / width, 1);
+	_bucket_count = (record_count + _bucket_size - 1) / _bucket_size;
+}
+
+PreviewExport::~PreviewExport() {}
+
+bool PreviewExport::format_next_line() {
+	char* out = _line;
+
+	if (_next_value == _value_count) {
+		if (!format_next_bucket(out)) {
+			return false;
+		}
+	}
+
+	// Room for a separator, one more value and the line break
+	const char* last = _line + sizeof(_line) - (FORMAT_MAX_LENGTH + 2);
+
+	while (_next_value < _value_count && out <= last) {
+		uint8_t channel = _next_value / 2;
+		*out++ = ',';
+		out += format_fixed(
+			out, _next_value % 2 ? _max[channel] : _min[channel], _decimals);
+		_next_value++;
+	}
+
+	if (_next_value == _value_count) {
+		*out++ = '\n';
+	}
+
+	_line_length = out - _line;
+	_line_sent = 0;
+
+	return true;
+}
+
+bool PreviewExport::format_next_bucket(char*& out) {
+	if (_bucket == _bucket_count) {
+		return false;
+	}
+
+	uint8_t channels = 0;
+	uint32_t count = 0;
+
+	for (; count < _bucket_size; count++) {
+		int length = _reader.read_record(_data);
+
+		if (length <= 0) {
+			break;
+		}
+
+		if (count == 0) {
+			channels = length;
+			memcpy(_min, _data, sizeof(float) * length);
+			memcpy(_max, _data, sizeof(float) * length);
+
+			// Named after the first record, the selection leaves out the
+			// channels it does not have
+			if (!_header_done) {
+				uint8_t record_length = _reader.get_record_length();
+				const ExportSelection& selection = _reader.get_selection();
+
+				out += sprintf(out, "time_ms");
+				for (uint8_t i = 0; i < channels; i++) {
+					unsigned channel = selection.channel(i, record_length);
+					out += sprintf(out, ",min_%u,max_%u", channel, channel);
+				}
+				*out++ = '\n';
+
+				_header_done = true;
+			}
+			continue;
+		}
+
+		for (uint8_t i = 0; i < std::min<uint8_t>(channels, length); i++) {
+			_min[i] = std::min(_min[i], _data[i]);
+			_max[i] = std::max(_max[i], _data[i]);
+		}
+	}
+
+	if (count == 0) {
+		_bucket = _bucket_count;
+		return false;
+	}
+
+	uint64_t record = _first_record + (uint64_t) _bucket * _bucket_size;
+	out += format_uint(out, record * 1000 / ECG_SAMPLE_RATE_HZ);
+
+	_value_count = 2 * channels;
+	_next_value = 0;
+	_bucket++;
+
+	return true;
+}
+
+size_t PreviewExport::read(uint8_t* buffer, size_t length) {
+	size_t filled = 0;
+
+	while (filled < length) {
+		if (_line_sent == _line_length && !format_next_line()) {
+			break;
+		}
+
+		size_t count = std::min(length - filled, _line_length - _line_sent);
+		memcpy(buffer + filled, _line + _line_sent, count);
+		filled += count;
+		_line_sent += count;
+	}
+
+	return filled;
+}
+
+static std::atomic<size_t> gzip_open_count{ 0 };
+
+GzipExport::GzipExport(std::unique_ptr<ExportStream> source, uint8_t level)
+	: _source(std::move(source)), _deflate(level) {
+	gzip_open_count.fetch_add(1, std::memory_order_relaxed);
+
+	// No name and no time, the operating system is unknown
+	const uint8_t header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+	memcpy(_frame, header, sizeof(header));
+	_frame_length = sizeof(header);
+}
+
+GzipExport::~GzipExport() {
+	gzip_open_count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+size_t GzipExport::get_open_count() {
+	return gzip_open_count.load(std::memory_order_relaxed);
+}
+
+size_t GzipExport::read(uint8_t* buffer, size_t length) {
+	size_t filled = 0;
+
+	while (filled < length && _part != Part::Done) {
+		if (_part == Part::Body) {
+			filled += _deflate.read(buffer + filled, length - filled);
+
+			if (filled == length) {
+				break;
+			}
+			if (_deflate.is_done()) {
+				memcpy(_frame, &_crc, sizeof(_crc));
+				memcpy(_frame + sizeof(_crc), &_size, sizeof(_size));
+				_frame_length = sizeof(_crc) + sizeof(_size);
+				_frame_sent = 0;
+				_part = Part::Trailer;
+				continue;
+			}
+
+			// The compressor wants input
+			if (_input_used == _input_length) {
+				_input_length = _source->read(_input, sizeof(_input));
+				_input_used = 0;
+
+				if (_input_length == 0) {
+					_deflate.finish();
+					continue;
+				}
+
+				_crc = crc32_update(_crc, _input, _input_length);
+				_size += _input_length;
+			}
+
+			_input_used +=
+				_deflate.write(_input + _input_used, _input_length - _input_used);
+			continue;
+		}
+
+		size_t count = std::min(length - filled, _frame_length - _frame_sent);
+		memcpy(buffer + filled, _frame + _frame_sent, count);
+		filled += count;
+		_frame_sent += count;
+
+		if (_frame_sent == _frame_length) {
+			_part = _part == Part::Header ? Part::Body : Part::Done;
+		}
+	}
+
+	return filled;
+}
+
+// Text of an EDF header field, padded with spaces
+static void put_edf_field(uint8_t* field, size_t width, const char* text) {
+	size_t length = std::min(strlen(text), width);
+	memcpy(field, text, length);
+	memset(field + length, ' ', width - length);
+}
+
+// Writes a number into an 8 character header field, rounded away from the
+// samples so that all of them stay in range. Returns the number as written.
+static float put_edf_number(uint8_t* field, float value, bool round_up) {
+	char text[32];
+
+	for (int decimals = 6; decimals >= 0; decimals--) {
+		double unit = pow(10.0, -decimals);
+		double rounded =
+			(round_up ? ceil(value / unit) : floor(value / unit)) * unit;
+		int length = snprintf(text, sizeof(text), "%.*f", decimals, rounded);
+
+		if (length <= 8) {
+			put_edf_field(field, 8, text);
+			return strtof(text, nullptr);
+		}
+	}
+
+	// Beyond what 8 characters hold, the samples are clipped
+	put_edf_field(field, 8, round_up ? "99999999" : "-9999999");
+	return round_up ? 99999999.0f : -9999999.0f;
+}
+
+static size_t edf_header_size(size_t channel_count) {
+	// The general part and one part per signal, the annotations included
+	return 256 * (channel_count + 2);
+}
+
+static size_t edf_data_record_size(size_t channel_count) {
+	return channel_count * EDF_RECORD_SAMPLES * sizeof(int16_t) + EDF_ANNOTATION_SIZE;
+}
+
+EdfExport::EdfExport(
+	std::unique_ptr<RecordingReader> reader,
+	const ExportSelection& selection,
+	const SelectionRange& range)
+	: _reader(std::move(reader), selection),
+	  _first_record(selection.first_record),
+	  _record_count(range.record_count),
+	  _channel_count(range.channel_count),
+	  _data_record_count(
+		  (range.record_count + EDF_RECORD_SAMPLES - 1) / EDF_RECORD_SAMPLES) {
+	_out.reset(static_cast<uint8_t*>(response_pool.allocate(std::max(
+		edf_header_size(_channel_count), edf_data_record_size(_channel_count)))));
+	format_header(selection, range);
+}
+
+EdfExport::~EdfExport() {}
+
+size_t EdfExport::get_length(const SelectionRange& range) {
+	size_t data_records =
+		(range.record_count + EDF_RECORD_SAMPLES - 1) / EDF_RECORD_SAMPLES;
+
+	return edf_header_size(range.channel_count) +
+		data_records * edf_data_record_size(range.channel_count);
+}
+
+void EdfExport::format_header(
+	const ExportSelection& selection, const SelectionRange& range) {
+	// 255 channels and the annotations are 256 signals
+	size_t signal_count = _channel_count + 1;
+	uint8_t* out = _out.get();
+	char text[32];
+
+	// Nobody is identified, the device has no clock and the date is the
+	// one EDF+ sets aside for an unknown one
+	put_edf_field(out, 8, "0");
+	put_edf_field(out + 8, 80, "X X X X");
+	put_edf_field(out + 88, 80, "Startdate X X X ECG-ISD");
+	put_edf_field(out + 168, 8, "01.01.85");
+	put_edf_field(out + 176, 8, "00.00.00");
+	snprintf(text, sizeof(text), "%u", (unsigned) edf_header_size(_channel_count));
+	put_edf_field(out + 184, 8, text);
+	put_edf_field(out + 192, 44, "EDF+C");
+	snprintf(text, sizeof(text), "%u", (unsigned) _data_record_count);
+	put_edf_field(out + 236, 8, text);
+	snprintf(
+		text, sizeof(text), "%u", (unsigned) (EDF_RECORD_SAMPLES / ECG_SAMPLE_RATE_HZ));
+	put_edf_field(out + 244, 8, text);
+	snprintf(text, sizeof(text), "%u", (unsigned) signal_count);
+	put_edf_field(out + 252, 4, text);
+	out += 256;
+
+	// Every field is repeated for all signals before the next one follows
+	for (uint8_t i = 0; i < _channel_count; i++) {
+		snprintf(
+			text, sizeof(text), "ECG %u", selection.channel(i, range.record_length));
+		put_edf_field(out + i * 16, 16, text);
+	}
+	put_edf_field(out + _channel_count * 16, 16, "EDF Annotations");
+	out += signal_count * 16;
+
+	for (size_t i = 0; i < signal_count; i++) {
+		put_edf_field(out + i * 80, 80, "");
+	}
+	out += signal_count * 80;
+
+	for (size_t i = 0; i < signal_count; i++) {
+		put_edf_field(out + i * 8, 8, i < _channel_count ? ECG_SAMPLE_UNIT : "");
+	}
+	out += signal_count * 8;
+
+	for (uint8_t i = 0; i < _channel_count; i++) {
+		_offset[i] = put_edf_number(out + i * 8, range.min[i], false);
+	}
+	put_edf_field(out + _channel_count * 8, 8, "-1");
+	out += signal_count * 8;
+
+	for (uint8_t i = 0; i < _channel_count; i++) {
+		// A flat channel still needs a range
+		float max = range.max[i] > _offset[i] ? range.max[i] : _offset[i] + 1;
+		max = put_edf_number(out + i * 8, max, true);
+		_gain[i] = (EDF_DIGITAL_MAX - EDF_DIGITAL_MIN) / (max - _offset[i]);
+	}
+	put_edf_field(out + _channel_count * 8, 8, "1");
+	out += signal_count * 8;
+
+	snprintf(text, sizeof(text), "%d", EDF_DIGITAL_MIN);
+	for (size_t i = 0; i < signal_count; i++) {
+		put_edf_field(out + i * 8, 8, text);
+	}
+	out += signal_count * 8;
+
+	snprintf(text, sizeof(text), "%d", EDF_DIGITAL_MAX);
+	for (size_t i = 0; i < signal_count; i++) {
+		put_edf_field(out + i * 8, 8, text);
+	}
+	out += signal_count * 8;
+
+	for (size_t i = 0; i < signal_count; i++) {
+		put_edf_field(out + i * 80, 80, "");
+	}
+	out += signal_count * 80;
+
+	for (size_t i = 0; i < signal_count; i++) {
+		snprintf(
+			text, sizeof(text), "%u",
+			(unsigned) (i < _channel_count ? EDF_RECORD_SAMPLES
+										   : EDF_ANNOTATION_SIZE / sizeof(int16_t)));
+		put_edf_field(out + i * 8, 8, text);
+	}
+	out += signal_count * 8;
+
+	for (size_t i = 0; i < signal_count; i++) {
+		put_edf_field(out + i * 32, 32, "");
+	}
+	out += signal_count * 32;
+
+	_out_length = out - _out.get();
+	_out_sent = 0;
+}
+
+bool EdfExport::format_data_record() {
+	if (_data_record == _data_record_count) {
+		return false;
+	}
+
+	// Signal after signal, so the records are spread over the channels
+	int16_t* samples = (int16_t*) _out.get();
+	uint32_t count = 0;
+
+	for (; count < EDF_RECORD_SAMPLES && _records_read < _record_count; count++) {
+		int length = _reader.read_record(_data);
+		if (length <= 0) {
+			break;
+		}
+		_records_read++;
+
+		for (int i = length; i < _channel_count; i++) {
+			_data[i] = NAN;
+		}
+
+		for (uint8_t i = 0; i < _channel_count; i++) {
+			// Clamped before the conversion, NAN ends up at the minimum
+			float digital = (_data[i] - _offset[i]) * _gain[i];
+			digital = std::min(std::max(0.0f, digital), 65535.0f);
+			samples[i * EDF_RECORD_SAMPLES + count] =
+				(int32_t) (digital + 0.5f) + EDF_DIGITAL_MIN;
+		}
+	}
+
+	// The last data record is filled up by holding the last sample
+	for (uint8_t i = 0; i < _channel_count; i++) {
+		int16_t* signal = samples + i * EDF_RECORD_SAMPLES;
+		int16_t last = count > 0 ? signal[count - 1] : 0;
+		std::fill(signal + count, signal + EDF_RECORD_SAMPLES, last);
+	}
+
+	// The time keeping annotation every EDF+ data record starts with
+	char* annotation =
+		(char*) (samples + _channel_count * EDF_RECORD_SAMPLES);
+	uint64_t onset_ms =
+		(_first_record + (uint64_t) _data_record * EDF_RECORD_SAMPLES) * 1000 /
+		ECG_SAMPLE_RATE_HZ;
+	memset(annotation, 0, EDF_ANNOTATION_SIZE);
+	if (onset_ms % 1000 == 0) {
+		snprintf(annotation, EDF_ANNOTATION_SIZE, "+%u\x14\x14", (unsigned) (onset_ms / 1000));
+	} else {
+		snprintf(
+			annotation, EDF_ANNOTATION_SIZE, "+%u.%03u\x14\x14",
+			(unsigned) (onset_ms / 1000), (unsigned) (onset_ms % 1000));
+	}
+
+	_out_length = edf_data_record_size(_channel_count);
+	_out_sent = 0;
+	_data_record++;
+
+	return true;
+}
+
+size_t EdfExport::read(uint8_t* buffer, size_t length) {
+	size_t filled = 0;
+
+	while (filled < length) {
+		if (_out_sent == _out_length && !format_data_record()) {
+			break;
+		}
+
+		size_t count = std::min(length - filled, _out_length - _out_sent);
+		memcpy(buffer + filled, _out.get() + _out_sent, count);
+		filled += count;
+		_out_sent += count;
+	}
+
+	return filled;
+}
+
+// From the response pool, every WFDB request needs them once
+static std::unique_ptr<WfdbSignal[], ResponsePoolRelease> wfdb_signals(
+	const SelectionRange& range, WfdbFormat format) {
+	std::unique_ptr<WfdbSignal[], ResponsePoolRelease> signals(static_cast<WfdbSignal*>(
+		response_pool.allocate(range.channel_count * sizeof(WfdbSignal))));
+	for (uint8_t i = 0; i < range.channel_count; i++) {
+		new (&signals[i]) WfdbSignal(wfdb_scaling(format, range.min[i], range.max[i]));
+	}
+	return signals;
+}
+
+WfdbExport::WfdbExport(
+	std::unique_ptr<RecordingReader> reader,
+	const ExportSelection& selection,
+	const SelectionRange& range,
+	WfdbFormat format)
+	: _reader(std::move(reader), selection),
+	  _encoder(format, range.channel_count, wfdb_signals(range, format).get()),
+	  _record_count(range.record_count),
+	  _channel_count(range.channel_count) {}
+
+WfdbExport::~WfdbExport() {}
+
+size_t WfdbExport::get_length(const SelectionRange& range, WfdbFormat format) {
+	return wfdb_data_size(format, (uint64_t) range.record_count * range.channel_count);
+}
+
+void WfdbExport::get_sums(WfdbSums& sums) const {
+	sums.format = _encoder.get_format();
+	sums.channel_count = _channel_count;
+
+	for (uint8_t i = 0; i < _channel_count; i++) {
+		const WfdbSignal& signal = _encoder.get_signal(i);
+		sums.initial_value[i] = signal.initial_value;
+		sums.checksum[i] = signal.checksum;
+	}
+}
+
+bool WfdbExport::produce() {
+	if (_done) {
+		return false;
+	}
+
+	size_t frame_capacity =
+		_channel_count > 0 ? WFDB_BLOCK_SAMPLES / _channel_count : 0;
+	size_t frame_count = 0;
+
+	// Whole frames into one block. Shorter records are filled up with NAN,
+	// which is written as an invalid sample, and so are records missing
+	// since the scan, the length was promised already.
+	while (frame_count < frame_capacity && _records_read < _record_count) {
+		int length = _reader.read_record(_data);
+
+		float* frame = _frames + frame_count * _channel_count;
+		for (uint8_t i = 0; i < _channel_count; i++) {
+			frame[i] = i < length ? _data[i] : NAN;
+		}
+
+		frame_count++;
+		_records_read++;
+	}
+
+	_out_length = _encoder.encode(_frames, frame_count, _out);
+	if (frame_count == 0) {
+		_out_length += _encoder.finish(_out + _out_length);
+		_done = true;
+	}
+	_out_sent = 0;
+
+	return _out_length > 0;
+}
+
+size_t WfdbExport::read(uint8_t* buffer, size_t length) {
+	size_t filled = 0;
+
+	while (filled < length) {
+		if (_out_sent == _out_length && !produce()) {
+			break;
+		}
+
+		size_t count = std::min(length - filled, _out_length - _out_sent);
+		memcpy(buffer + filled, _out + _out_sent, count);
+		filled += count;
+		_out_sent += count;
+	}
+
+	return filled;
+}
+
+size_t format_wfdb_header(
+	char* out,
+	size_t size,
+	const char* record_name,
+	const ExportSelection& selection,
+	const SelectionRange& range,
+	const WfdbSums& sums) {
+	auto signals = wfdb_signals(range, sums.format);
+	uint8_t channels[UINT8_MAX];
+
+	for (uint8_t i = 0; i < range.channel_count; i++) {
+		signals[i].initial_value = sums.initial_value[i];
+		signals[i].checksum = sums.checksum[i];
+		channels[i] = selection.channel(i, range.record_length);
+	}
+
+	return wfdb_format_header(
+		out, size, record_name, ECG_SAMPLE_RATE_HZ, range.record_count,
+		sums.format, range.channel_count, signals.get(), channels, ECG_SAMPLE_UNIT);
+}
+
+// ZIP fields are little endian, like the ESP32
+static uint8_t* put_u16(uint8_t* out, uint16_t value) {
+	memcpy(out, &value, sizeof(value));
+	return out + sizeof(value);
+}
+
+static uint8_t* put_u32(uint8_t* out, uint32_t value) {
+	memcpy(out, &value, sizeof(value));
+	return out + sizeof(value);
+}
+
+static constexpr uint32_t ZIP_LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static constexpr uint32_t ZIP_DESCRIPTOR_SIGNATURE = 0x08074b50;
+static constexpr uint32_t ZIP_DIRECTORY_SIGNATURE = 0x02014b50;
+static constexpr uint32_t ZIP_END_SIGNATURE = 0x06054b50;
+static constexpr size_t ZIP_LOCAL_HEADER_SIZE = 30;
+static constexpr size_t ZIP_DESCRIPTOR_SIZE = 16;
+static constexpr size_t ZIP_DIRECTORY_ENTRY_SIZE = 46;
+static constexpr size_t ZIP_END_SIZE = 22;
+// Version 2.0, the CRC and sizes follow the data, stored without compression
+static constexpr uint16_t ZIP_VERSION = 20;
+static constexpr uint16_t ZIP_FLAG_DESCRIPTOR = 0x0008;
+static constexpr uint16_t ZIP_METHOD_STORED = 0;
+// Recordings carry no wall clock time, every entry is dated 1980-01-01
+static constexpr uint16_t ZIP_DOS_DATE = (1 << 5) | 1;
+
+ZipExport::ZipExport(
+	std::shared_ptr<Storage> storage, std::vector<StorageEntry> recordings)
+	: _storage(std::move(storage)) {
+	for (auto& recording : recordings) {
+		size_t name_length = strlen(recording.get_name());
+		if (name_length > ZIP_MAX_NAME) {
+			log_w("Recording name %s too long for an archive", recording.get_name());
+			continue;
+		}
+
+		size_t entry_name_length = name_length + sizeof(".rec") - 1;
+		_length += ZIP_LOCAL_HEADER_SIZE + entry_name_length +
+			recording.get_size() + ZIP_DESCRIPTOR_SIZE +
+			ZIP_DIRECTORY_ENTRY_SIZE + entry_name_length;
+		_recordings.push_back(std::move(recording));
+	}
+	_length += ZIP_END_SIZE;
+	_crcs.resize(_recordings.size());
+
+	if (_recordings.empty()) {
+		frame_end();
+	} else {
+		frame_local_header();
+	}
+}
+
+ZipExport::~ZipExport() {}
+
+uint64_t ZipExport::get_length() const {
+	return _length;
+}
+
+size_t ZipExport::get_entry_count() const {
+	return _recordings.size();
+}
+
+size_t ZipExport::entry_name(size_t index, char* name) const {
+	return sprintf(name, "%s.rec", _recordings[index].get_name());
+}
+
+void ZipExport::frame_local_header() {
+	char name[ZIP_MAX_NAME + sizeof(".rec")];
+	size_t name_length = entry_name(_entry, name);
+
+	uint8_t* out = put_u32(_frame, ZIP_LOCAL_HEADER_SIGNATURE);
+	out = put_u16(out, ZIP_VERSION);
+	out = put_u16(out, ZIP_FLAG_DESCRIPTOR);
+	out = put_u16(out, ZIP_METHOD_STORED);
+	out = put_u16(out, 0);
+	out = put_u16(out, ZIP_DOS_DATE);
+	// CRC and sizes are in the data descriptor
+	out = put_u32(out, 0);
+	out = put_u32(out, 0);
+	out = put_u32(out, 0);
+	out = put_u16(out, name_length);
+	out = put_u16(out, 0);
+	memcpy(out, name, name_length);
+
+	_frame_length = ZIP_LOCAL_HEADER_SIZE + name_length;
+	_frame_sent = 0;
+	_part = Part::LocalHeader;
+}
+
+void ZipExport::frame_descriptor() {
+	uint32_t size = _recordings[_entry].get_size();
+
+	uint8_t* out = put_u32(_frame, ZIP_DESCRIPTOR_SIGNATURE);
+	out = put_u32(out, _crcs[_entry]);
+	out = put_u32(out, size);
+	put_u32(out, size);
+
+	_frame_length = ZIP_DESCRIPTOR_SIZE;
+	_frame_sent = 0;
+	_part = Part::Descriptor;
+}
+
+void ZipExport::frame_directory_entry() {
+	char name[ZIP_MAX_NAME + sizeof(".rec")];
+	size_t name_length = entry_name(_entry, name);
+	uint32_t size = _recordings[_entry].get_size();
+
+	uint8_t* out = put_u32(_frame, ZIP_DIRECTORY_SIGNATURE);
+	out = put_u16(out, ZIP_VERSION);
+	out = put_u16(out, ZIP_VERSION);
+	out = put_u16(out, ZIP_FLAG_DESCRIPTOR);
+	out = put_u16(out, ZIP_METHOD_STORED);
+	out = put_u16(out, 0);
+	out = put_u16(out, ZIP_DOS_DATE);
+	out = put_u32(out, _crcs[_entry]);
+	out = put_u32(out, size);
+	out = put_u32(out, size);
+	out = put_u16(out, name_length);
+	// No extra field, comment, disk number or attributes
+	out = put_u16(out, 0);
+	out = put_u16(out, 0);
+	out = put_u16(out, 0);
+	out = put_u16(out, 0);
+	out = put_u32(out, 0);
+	out = put_u32(out, _entry_offset);
+	memcpy(out, name, name_length);
+
+	_frame_length = ZIP_DIRECTORY_ENTRY_SIZE + name_length;
+	_frame_sent = 0;
+	_part = Part::Directory;
+
+	_directory_size += _frame_length;
+	_entry_offset += ZIP_LOCAL_HEADER_SIZE + name_length + size + ZIP_DESCRIPTOR_SIZE;
+}
+
+void ZipExport::frame_end() {
+	uint8_t* out = put_u32(_frame, ZIP_END_SIGNATURE);
+	out = put_u16(out, 0);
+	out = put_u16(out, 0);
+	out = put_u16(out, _recordings.size());
+	out = put_u16(out, _recordings.size());
+	out = put_u32(out, _directory_size);
+	out = put_u32(out, _directory_offset);
+	put_u16(out, 0);
+
+	_frame_length = ZIP_END_SIZE;
+	_frame_sent = 0;
+	_part = Part::End;
+}
+
+bool ZipExport::next_part() {
+	switch (_part) {
+	case Part::LocalHeader: {
+		const StorageEntry& recording = _recordings[_entry];
+		auto reader = _storage->open_recording(recording.get_name());
+		if (!reader) {
+			log_e("Recording %s disappeared from the archive", recording.get_name());
+			return false;
+		}
+
+		_data.reset(
+			new (std::nothrow) RawExport(std::move(reader), 0, recording.get_size()));
+		if (!_data) {
+			return false;
+		}
+		if (_data->get_length() < recording.get_size()) {
+			log_e("Recording %s shrank while archived", recording.get_name());
+			return false;
+		}
+		_data_left = recording.get_size();
+		_crc = 0;
+		_part = Part::Data;
+		return true;
+	}
+	case Part::Data:
+		// Closes the recording before the next one is opened
+		_data.reset();
+		_crcs[_entry] = _crc;
+		frame_descriptor();
+		return true;
+	case Part::Descriptor:
+		_entry_offset +=
+			ZIP_LOCAL_HEADER_SIZE + strlen(_recordings[_entry].get_name()) +
+			sizeof(".rec") - 1 + _recordings[_entry].get_size() + ZIP_DESCRIPTOR_SIZE;
+		if (++_entry < _recordings.size()) {
+			frame_local_header();
+			return true;
+		}
+
+		_directory_offset = _entry_offset;
+		_entry = 0;
+		_entry_offset = 0;
+		frame_directory_entry();
+		return true;
+	case Part::Directory:
+		if (++_entry < _recordings.size()) {
+			frame_directory_entry();
+		} else {
+			frame_end();
+		}
+		return true;
+	default:
+		_part = Part::Done;
+		return false;
+	}
+}
+
+size_t ZipExport::read(uint8_t* buffer, size_t length) {
+	size_t filled = 0;
+
+	while (filled < length && _part != Part::Done) {
+		if (_part == Part::Data) {
+			// Straight from the card into the caller's buffer, the CRC is
+			// taken on the way
+			size_t count =
+				_data->read(buffer + filled, std::min(length - filled, _data_left));
+			if (count == 0 && _data_left > 0) {
+				log_e("Reading %s for the archive failed", _recordings[_entry].get_name());
+				_part = Part::Done;
+				break;
+			}
+
+			_crc = crc32_update(_crc, buffer + filled, count);
+			filled += count;
+			_data_left -= count;
+
+			if (_data_left == 0) {
+				next_part();
+			}
+			continue;
+		}
+
+		size_t count = std::min(length - filled, _frame_length - _frame_sent);
+		memcpy(buffer + filled, _frame + _frame_sent, count);
+		filled += count;
+		_frame_sent += count;
+
+		// A recording that cannot be read ends the archive early, the
+		// client notices the missing bytes
+		if (_frame_sent == _frame_length && !next_part()) {
+			_part = Part::Done;
+		}
+	}
+
+	return filled;
+}
+
+SelectionExport::SelectionExport(
+	std::unique_ptr<RecordingReader> reader, const ExportSelection& selection)
+	: _reader(std::move(reader), selection) {}
+
+SelectionExport::~SelectionExport() {}
+
+void SelectionExport::emit_block(
+	const recording_format::BlockHeader& header, size_t payload_size) {
+	memcpy(_out, &header, sizeof(header));
+	_out_length = sizeof(header) + payload_size;
+	_written_size += _out_length;
+}
+
+bool SelectionExport::produce() {
+	using namespace recording_format;
+
+	if (_part == Part::Done) {
+		return false;
+	}
+
+	_out_sent = 0;
+
+	if (_part == Part::Header) {
+		// Without a random id, the same selection is the same bytes every
+		// time as its ETag promises
+		FileHeader header;
+		init_file_header(header, 0);
+
+		memcpy(_out, &header, sizeof(header));
+		_out_length = sizeof(header);
+		_written_size += _out_length;
+		_part = Part::Blocks;
+
+		return true;
+	}
+
+	BlockHeader header;
+	uint8_t* payload = _out + sizeof(header);
+
+	if (_part == Part::Blocks) {
+		_block.clear();
+
+		if (_pending_length > 0) {
+			_block.append(_data, _pending_length);
+			_pending_length = 0;
+		}
+
+		int length;
+		while ((length = _reader.read_record(_data)) > 0) {
+			if (!_block.fits(length)) {
+				_pending_length = length;
+				break;
+			}
+			_block.append(_data, length);
+		}
+
+		if (_block.record_count > 0) {
+			size_t payload_size = encode_block(
+				_block, BlockCodec::DeltaFloat32, _next_record, header, payload);
+			_index.add(_written_size, _next_record);
+			_next_record += _block.record_count;
+			emit_block(header, payload_size);
+
+			return true;
+		}
+
+		_part = Part::Index;
+	}
+
+	size_t payload_size =
+		encode_index(_index, _next_record, _written_size, header, payload);
+	emit_block(header, payload_size);
+	_part = Part::Done;
+
+	return true;
+}
+
+size_t SelectionExport::read(uint8_t* buffer, size_t length) {
+	size_t filled = 0;
+
+	while (filled < length) {
+		if (_out_sent == _out_length && !produce()) {
+			break;
+		}
+
+		size_t count = std::min(length - filled, _out_length - _out_sent);
+		memcpy(buffer + filled, _out + _out_sent, count);
+		filled += count;
+		_out_sent += count;
+	}
+
+	return filled;
+}
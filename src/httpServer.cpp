@@ -0,0 +1,1134 @@
+#include "httpServer.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <Arduino.h>
+#include <lwip/sockets.h>
+
+#include "metrics.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const char* status_text(int status) {
+	switch (status) {
+		case 101: return "Switching Protocols";
+		case 200: return "OK";
+		case 201: return "Created";
+		case 202: return "Accepted";
+		case 204: return "No Content";
+		case 206: return "Partial Content";
+		case 303: return "See Other";
+		case 304: return "Not Modified";
+		case 400: return "Bad Request";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 409: return "Conflict";
+		case 411: return "Length Required";
+		case 413: return "Payload Too Large";
+		case 416: return "Range Not Satisfiable";
+		case 426: return "Upgrade Required";
+		case 431: return "Request Header Fields Too Large";
+		case 500: return "Internal Server Error";
+		case 503: return "Service Unavailable";
+		case 507: return "Insufficient Storage";
+		default: return "Unknown";
+	}
+}
+
+static HttpMethod parse_method(const char* method) {
+	if (strcmp(method, "GET") == 0) {
+		return HttpMethod::Get;
+	}
+	if (strcmp(method, "HEAD") == 0) {
+		return HttpMethod::Head;
+	}
+	if (strcmp(method, "POST") == 0) {
+		return HttpMethod::Post;
+	}
+	if (strcmp(method, "PUT") == 0) {
+		return HttpMethod::Put;
+	}
+	if (strcmp(method, "DELETE") == 0) {
+		return HttpMethod::Delete;
+	}
+
+	return HttpMethod::Other;
+}
+
+static uint8_t hex_value(char c) {
+	return isdigit((unsigned char) c) ? c - '0' : (tolower(c) - 'a' + 10);
+}
+
+// In place, the text only gets shorter
+static void url_decode(char* text) {
+	char* out = text;
+
+	for (const char* in = text; *in != '\0'; in++) {
+		if (*in == '+') {
+			*out++ = ' ';
+		} else if (
+			*in == '%' && isxdigit((unsigned char) in[1]) &&
+			isxdigit((unsigned char) in[2])) {
+			*out++ = (hex_value(in[1]) << 4) | hex_value(in[2]);
+			in += 2;
+		} else {
+			*out++ = *in;
+		}
+	}
+
+	*out = '\0';
+}
+
+bool HttpRequest::parse(char* text) {
+	_header_count = 0;
+	_arg_count = 0;
+	_path_arg_count = 0;
+
+	// Request line, "GET /path?query HTTP/1.1"
+	char* line_end = strstr(text, "\r\n");
+	if (line_end == nullptr) {
+		return false;
+	}
+	*line_end = '\0';
+
+	char* target = strchr(text, ' ');
+	if (target == nullptr) {
+		return false;
+	}
+	*target++ = '\0';
+
+	char* version = strchr(target, ' ');
+	if (version == nullptr || strncmp(version + 1, "HTTP/1.", 7) != 0) {
+		return false;
+	}
+	*version++ = '\0';
+
+	_method = parse_method(text);
+	_http_1_0 = strcmp(version, "HTTP/1.0") == 0;
+
+	char* query = strchr(target, '?');
+	if (query != nullptr) {
+		*query++ = '\0';
+		parse_query(query);
+	}
+	_path = target;
+
+	// Header lines up to the empty line, which was cut off by the server
+	for (char* line = line_end + 2; *line != '\0';) {
+		line_end = strstr(line, "\r\n");
+		if (line_end == nullptr) {
+			return false;
+		}
+		*line_end = '\0';
+
+		char* colon = strchr(line, ':');
+		if (colon != nullptr && _header_count < HTTP_MAX_HEADERS) {
+			*colon = '\0';
+
+			char* value = colon + 1;
+			while (*value == ' ' || *value == '\t') {
+				value++;
+			}
+			for (char* end = line_end; end > value &&
+				 (end[-1] == ' ' || end[-1] == '\t');) {
+				*--end = '\0';
+			}
+
+			_header_names[_header_count] = line;
+			_header_values[_header_count++] = value;
+		}
+
+		line = line_end + 2;
+	}
+
+	return true;
+}
+
+void HttpRequest::parse_query(char* query) {
+	while (*query != '\0' && _arg_count < HTTP_MAX_ARGS) {
+		char* next = strchr(query, '&');
+		if (next != nullptr) {
+			*next++ = '\0';
+		}
+
+		char* value = strchr(query, '=');
+		if (value != nullptr) {
+			*value++ = '\0';
+		} else {
+			value = query + strlen(query);
+		}
+
+		url_decode(query);
+		url_decode(value);
+		_arg_names[_arg_count] = query;
+		_arg_values[_arg_count++] = value;
+
+		if (next == nullptr) {
+			break;
+		}
+		query = next;
+	}
+}
+
+bool HttpRequest::match(const char* pattern) {
+	const char* path = _path;
+	_path_arg_count = 0;
+
+	while (*pattern != '\0') {
+		if (pattern[0] == '{' && pattern[1] == '}') {
+			pattern += 2;
+
+			// Up to the next character of the pattern, never across a '/'
+			size_t length = 0;
+			while (path[length] != '\0' && path[length] != '/' &&
+				   path[length] != *pattern) {
+				length++;
+			}
+
+			if (length == 0 || length >= HTTP_PATH_ARG_SIZE ||
+				_path_arg_count == HTTP_MAX_PATH_ARGS) {
+				return false;
+			}
+
+			memcpy(_path_args[_path_arg_count], path, length);
+			_path_args[_path_arg_count++][length] = '\0';
+			path += length;
+			continue;
+		}
+
+		if (*pattern++ != *path++) {
+			return false;
+		}
+	}
+
+	return *path == '\0';
+}
+
+HttpMethod HttpRequest::get_method() const {
+	return _method;
+}
+
+const char* HttpRequest::get_path() const {
+	return _path;
+}
+
+const char* HttpRequest::path_arg(uint8_t index) const {
+	return index < _path_arg_count ? _path_args[index] : "";
+}
+
+bool HttpRequest::has_arg(const char* name) const {
+	for (uint8_t i = 0; i < _arg_count; i++) {
+		if (strcmp(_arg_names[i], name) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* HttpRequest::arg(const char* name) const {
+	for (uint8_t i = 0; i < _arg_count; i++) {
+		if (strcmp(_arg_names[i], name) == 0) {
+			return _arg_values[i];
+		}
+	}
+
+	return "";
+}
+
+bool HttpRequest::has_header(const char* name) const {
+	for (uint8_t i = 0; i < _header_count; i++) {
+		if (strcasecmp(_header_names[i], name) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* HttpRequest::header(const char* name) const {
+	for (uint8_t i = 0; i < _header_count; i++) {
+		if (strcasecmp(_header_names[i], name) == 0) {
+			return _header_values[i];
+		}
+	}
+
+	return "";
+}
+
+size_t HttpRequest::get_content_length() const {
+	const char* text = header("Content-Length");
+	char* end = nullptr;
+	unsigned long length = strtoul(text, &end, 10);
+
+	if (!isdigit((unsigned char) *text) || *end != '\0' ||
+		length >= HTTP_LENGTH_UNKNOWN || has_header("Transfer-Encoding")) {
+		return HTTP_LENGTH_UNKNOWN;
+	}
+
+	return length;
+}
+
+HttpPushSource::~HttpPushSource() {}
+
+void* HttpPushSource::operator new(size_t size) {
+	return response_pool.allocate(size);
+}
+
+void* HttpPushSource::operator new(size_t size, const std::nothrow_t&) noexcept {
+	return response_pool.allocate(size, std::nothrow);
+}
+
+void HttpPushSource::operator delete(void* block) {
+	response_pool.release(block);
+}
+
+void HttpPushSource::operator delete(void* block, const std::nothrow_t&) noexcept {
+	response_pool.release(block);
+}
+
+HttpBodySink::~HttpBodySink() {}
+
+void* HttpBodySink::operator new(size_t size) {
+	return response_pool.allocate(size);
+}
+
+void* HttpBodySink::operator new(size_t size, const std::nothrow_t&) noexcept {
+	return response_pool.allocate(size, std::nothrow);
+}
+
+void HttpBodySink::operator delete(void* block) {
+	response_pool.release(block);
+}
+
+void HttpBodySink::operator delete(void* block, const std::nothrow_t&) noexcept {
+	response_pool.release(block);
+}
+
+HttpPreparation::~HttpPreparation() {}
+
+void* HttpPreparation::operator new(size_t size) {
+	return response_pool.allocate(size);
+}
+
+void* HttpPreparation::operator new(size_t size, const std::nothrow_t&) noexcept {
+	return response_pool.allocate(size, std::nothrow);
+}
+
+void HttpPreparation::operator delete(void* block) {
+	response_pool.release(block);
+}
+
+void HttpPreparation::operator delete(void* block, const std::nothrow_t&) noexcept {
+	response_pool.release(block);
+}
+
+void HttpResponse::clear() {
+	_status = 0;
+	_content_type = nullptr;
+	_headers_length = 0;
+	_text_length = 0;
+	_body.reset();
+	_length = 0;
+	_push.reset();
+	_sink.reset();
+	_preparation.reset();
+}
+
+bool HttpResponse::set_header(const char* name, const char* value) {
+	size_t room = sizeof(_headers) - _headers_length;
+	int length = snprintf(
+		_headers + _headers_length, room, "%s: %s\r\n", name, value);
+
+	if (length < 0 || (size_t) length >= room) {
+		log_e("no room for header %s", name);
+		return false;
+	}
+
+	_headers_length += length;
+
+	return true;
+}
+
+void HttpResponse::send(int status, const char* content_type, const char* text) {
+	_status = status;
+	_content_type = content_type;
+	_body.reset();
+	_text_length = 0;
+
+	if (text != nullptr) {
+		_text_length = strlen(text);
+
+		if (_text_length > sizeof(_text)) {
+			log_e("response text too long, %u bytes", (unsigned) _text_length);
+			_text_length = sizeof(_text);
+		}
+
+		memcpy(_text, text, _text_length);
+	}
+
+	_length = _text_length;
+}
+
+void HttpResponse::send_no_memory() {
+	_headers_length = 0;
+	send(503, "text/plain", "503: Out of memory, try again later");
+}
+
+void HttpResponse::send(
+	int status,
+	const char* content_type,
+	std::unique_ptr<ExportStream> body,
+	size_t length) {
+	if (!body) {
+		send_no_memory();
+		return;
+	}
+
+	_status = status;
+	_content_type = content_type;
+	_text_length = 0;
+	_body = std::move(body);
+	_length = length;
+}
+
+void HttpResponse::push(
+	int status,
+	const char* content_type,
+	std::unique_ptr<HttpPushSource> source) {
+	if (!source) {
+		send_no_memory();
+		return;
+	}
+
+	_status = status;
+	_content_type = content_type;
+	_text_length = 0;
+	_body.reset();
+	_length = HTTP_LENGTH_UNKNOWN;
+	_push = std::move(source);
+}
+
+void HttpResponse::receive(std::unique_ptr<HttpBodySink> sink) {
+	if (!sink) {
+		send_no_memory();
+		return;
+	}
+
+	_sink = std::move(sink);
+}
+
+void HttpResponse::prepare(std::unique_ptr<HttpPreparation> preparation) {
+	if (!preparation) {
+		send_no_memory();
+		return;
+	}
+
+	_preparation = std::move(preparation);
+}
+
+HttpServer::HttpServer(uint16_t port)
+	: _port(port), _connections(new Connection[HTTP_MAX_CONNECTIONS]) {}
+
+HttpServer::~HttpServer() {
+	for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+		if (_connections[i].state != ConnectionState::Free) {
+			close_connection(_connections[i]);
+		}
+	}
+
+	if (_listener >= 0) {
+		close(_listener);
+	}
+}
+
+void HttpServer::on(const char* pattern, HttpMethod method, HttpHandler handler) {
+	_routes.push_back({ pattern, method, std::move(handler) });
+}
+
+void HttpServer::on_not_found(HttpHandler handler) {
+	_not_found = std::move(handler);
+}
+
+size_t HttpServer::get_connection_count() const {
+	size_t count = 0;
+
+	for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+		count += _connections[i].state != ConnectionState::Free;
+	}
+
+	return count;
+}
+
+bool HttpServer::open_listener() {
+	int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener < 0) {
+		log_e("can not create socket: %d", errno);
+		return false;
+	}
+
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(_port);
+
+	if (bind(listener, (struct sockaddr*) &address, sizeof(address)) < 0 ||
+		listen(listener, HTTP_BACKLOG) < 0) {
+		log_e("can not listen on port %u: %d", _port, errno);
+		close(listener);
+		return false;
+	}
+
+	fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+	_listener = listener;
+	log_i("listening on port %u", _port);
+
+	return true;
+}
+
+HttpServer::Connection* HttpServer::find_idle_connection() {
+	Connection* idle = nullptr;
+
+	// Kept alive without a request started, the one waiting longest
+	for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+		Connection& connection = _connections[i];
+
+		if (connection.state == ConnectionState::Reading &&
+			connection.request_count > 0 && connection.request_length == 0 &&
+			(idle == nullptr ||
+			 (int32_t) (connection.last_activity - idle->last_activity) < 0)) {
+			idle = &connection;
+		}
+	}
+
+	return idle;
+}
+
+void HttpServer::accept_connection() {
+	int client = accept(_listener, nullptr, nullptr);
+	if (client < 0) {
+		return;
+	}
+
+	Connection* free_connection = nullptr;
+
+	for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+		if (_connections[i].state == ConnectionState::Free) {
+			free_connection = &_connections[i];
+			break;
+		}
+	}
+
+	// A new client goes before one that keeps its connection just in case
+	if (free_connection == nullptr) {
+		free_connection = find_idle_connection();
+
+		if (free_connection != nullptr) {
+			log_d("closing kept alive connection for a new client");
+			close_connection(*free_connection);
+		}
+	}
+
+	// Not listened for while all connections are busy
+	if (free_connection == nullptr) {
+		close(client);
+		return;
+	}
+
+	Connection& connection = *free_connection;
+
+	fcntl(client, F_SETFL, fcntl(client, F_GETFL, 0) | O_NONBLOCK);
+	int no_delay = 1;
+	setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+	connection.socket = client;
+	connection.state = ConnectionState::Reading;
+	connection.request_count = 0;
+	connection.request_length = 0;
+	connection.last_activity = millis();
+	metrics.http_connections.fetch_add(1, std::memory_order_relaxed);
+	metrics.http_connections_accepted.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HttpServer::close_connection(Connection& connection) {
+	close(connection.socket);
+	connection.socket = -1;
+	connection.state = ConnectionState::Free;
+	metrics.http_connections.fetch_sub(1, std::memory_order_relaxed);
+
+	// Releases the recording a download was reading
+	connection.response.clear();
+}
+
+void HttpServer::receive(Connection& connection) {
+	ssize_t count = recv(
+		connection.socket,
+		connection.request_text + connection.request_length,
+		HTTP_REQUEST_SIZE - connection.request_length,
+		MSG_DONTWAIT);
+
+	if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return;
+	}
+	if (count <= 0) {
+		close_connection(connection);
+		return;
+	}
+
+	connection.request_length += count;
+	connection.request_text[connection.request_length] = '\0';
+	connection.last_activity = millis();
+
+	parse_buffered(connection);
+}
+
+void HttpServer::parse_buffered(Connection& connection) {
+	char* end = strstr(connection.request_text, "\r\n\r\n");
+	if (end == nullptr) {
+		if (connection.request_length == HTTP_REQUEST_SIZE) {
+			// The end of the request is unknown, so is the next one
+			connection.keep_alive = false;
+			connection.response.clear();
+			connection.response.send(
+				431, "text/plain", "431: Request header fields too large");
+			start_response(connection);
+		}
+		return;
+	}
+
+	// Keeps the line break of the last header line
+	end[2] = '\0';
+	connection.body_offset = end + 4 - connection.request_text;
+	connection.next_request = connection.body_offset;
+	dispatch(connection);
+}
+
+void HttpServer::dispatch(Connection& connection) {
+	HttpRequest& request = connection.request;
+	HttpResponse& response = connection.response;
+
+	response.clear();
+	connection.request_count++;
+	metrics.http_requests.fetch_add(1, std::memory_order_relaxed);
+
+	if (!request.parse(connection.request_text)) {
+		connection.keep_alive = false;
+		response.send(400, "text/plain", "400: Bad request");
+		start_response(connection);
+		return;
+	}
+
+	// HTTP/1.0 clients are not kept alive, hardly any are left
+	connection.keep_alive = !request._http_1_0 &&
+		strcasecmp(request.header("Connection"), "close") != 0;
+
+	HttpMethod method = request.get_method() == HttpMethod::Head
+		? HttpMethod::Get
+		: request.get_method();
+	bool path_found = false;
+
+	for (auto& route : _routes) {
+		if (!request.match(route.pattern)) {
+			continue;
+		}
+
+		path_found = true;
+
+		if (route.method == method) {
+			route.handler(request, response);
+			start_body(connection);
+			return;
+		}
+	}
+
+	if (path_found) {
+		response.send(405, "text/plain", "405: Method not allowed");
+	} else if (_not_found) {
+		_not_found(request, response);
+	} else {
+		response.send(404, "text/plain", "404: Not found");
+	}
+
+	start_body(connection);
+}
+
+void HttpServer::start_body(Connection& connection) {
+	HttpRequest& request = connection.request;
+	HttpResponse& response = connection.response;
+
+	size_t length = request.get_content_length();
+
+	if (!response._sink) {
+		// A body nobody reads would be taken for the next request
+		if (request.has_header("Transfer-Encoding") ||
+			(request.has_header("Content-Length") && length != 0)) {
+			connection.keep_alive = false;
+		}
+		start_response(connection);
+		return;
+	}
+
+	// Chunked bodies are not taken, every client sending a file knows its
+	// size
+	if (length == HTTP_LENGTH_UNKNOWN) {
+		connection.keep_alive = false;
+		response.clear();
+		response.send(411, "text/plain", "411: Content-Length required");
+		start_response(connection);
+		return;
+	}
+
+	// The client holds the body back until it is asked for it
+	if (strcasecmp(request.header("Expect"), "100-continue") == 0) {
+		static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+		send(connection.socket, CONTINUE, sizeof(CONTINUE) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+	}
+
+	connection.state = ConnectionState::Receiving;
+	connection.remaining = length;
+
+	// Whatever arrived together with the headers goes first
+	size_t received = std::min(
+		connection.request_length - connection.body_offset, connection.remaining);
+	connection.next_request += received;
+	consume_body(
+		connection,
+		(const uint8_t*) connection.request_text + connection.body_offset,
+		received);
+}
+
+void HttpServer::consume_body(
+	Connection& connection, const uint8_t* data, size_t length) {
+	HttpResponse& response = connection.response;
+
+	connection.remaining -= length;
+	bool more = length == 0 || response._sink->consume(data, length);
+
+	if (more && connection.remaining > 0) {
+		return;
+	}
+
+	// A body cut off early is answered anyway, the connection closes after
+	if (connection.remaining > 0) {
+		connection.keep_alive = false;
+	}
+
+	std::unique_ptr<HttpBodySink> sink = std::move(response._sink);
+	sink->respond(response);
+	start_response(connection);
+}
+
+void HttpServer::receive_body(Connection& connection) {
+	ssize_t count = recv(
+		connection.socket, connection.output,
+		std::min(HTTP_CHUNK_SIZE, connection.remaining), MSG_DONTWAIT);
+
+	if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return;
+	}
+	// Gone before the whole body arrived, the sink throws it away
+	if (count <= 0) {
+		close_connection(connection);
+		return;
+	}
+
+	connection.last_activity = millis();
+	consume_body(connection, connection.output, count);
+}
+
+void HttpServer::prepare_response(Connection& connection) {
+	HttpResponse& response = connection.response;
+
+	connection.last_activity = millis();
+
+	if (!response._preparation->step()) {
+		return;
+	}
+
+	std::unique_ptr<HttpPreparation> preparation = std::move(response._preparation);
+	preparation->respond(response);
+	start_response(connection);
+}
+
+void HttpServer::start_response(Connection& connection) {
+	HttpResponse& response = connection.response;
+
+	// The header waits until the preparation is done
+	if (response._preparation) {
+		connection.state = ConnectionState::Preparing;
+		return;
+	}
+
+	if (response._status == 0) {
+		log_e("no response for %s", connection.request.get_path());
+		response.send(500, "text/plain", "500: Internal server error");
+	}
+
+	int status = response._status;
+	connection.send_body = connection.request.get_method() != HttpMethod::Head &&
+		status != 204 && status != 304;
+	connection.chunked = response._body && response._length == HTTP_LENGTH_UNKNOWN &&
+		!connection.request._http_1_0;
+
+	// Pushed responses and bodies of unknown length without chunks end with
+	// the connection
+	if (response._push || (response._body && response._length == HTTP_LENGTH_UNKNOWN &&
+						   !connection.chunked)) {
+		connection.keep_alive = false;
+	}
+
+	char* out = (char*) connection.output;
+	size_t room = sizeof(connection.output) - HTTP_TEXT_SIZE;
+	size_t length = snprintf(
+		out, room, "HTTP/1.1 %d %s\r\n", status, status_text(status));
+
+	if (response._content_type != nullptr) {
+		length += snprintf(
+			out + length, room - length, "Content-Type: %s\r\n",
+			response._content_type);
+	}
+
+	memcpy(out + length, response._headers, response._headers_length);
+	length += response._headers_length;
+
+	if (response._push) {
+		// Ends when the connection is closed
+	} else if (connection.chunked) {
+		length += snprintf(
+			out + length, room - length, "Transfer-Encoding: chunked\r\n");
+	} else if (response._length != HTTP_LENGTH_UNKNOWN && status != 204 && status != 304) {
+		length += snprintf(
+			out + length, room - length, "Content-Length: %u\r\n",
+			(unsigned) response._length);
+	}
+
+	if (status != 101 && !connection.keep_alive) {
+		length += snprintf(out + length, room - length, "Connection: close\r\n");
+	}
+	length += snprintf(out + length, room - length, "\r\n");
+
+	if (connection.send_body) {
+		memcpy(out + length, response._text, response._text_length);
+		length += response._text_length;
+	} else {
+		response._body.reset();
+		response._push.reset();
+	}
+
+	connection.output_start = 0;
+	connection.output_length = length;
+	connection.remaining = response._length;
+	connection.state = response._push ? ConnectionState::Pushing
+									  : ConnectionState::Writing;
+}
+
+bool HttpServer::fill_output(Connection& connection) {
+	auto& body = connection.response._body;
+
+	if (!body) {
+		return false;
+	}
+
+	// The chunk size line goes in front of the data once its size is known
+	constexpr size_t data_start = 8;
+	uint8_t* data = connection.output + data_start;
+	size_t room = std::min(HTTP_CHUNK_SIZE, connection.remaining);
+	size_t count = room > 0 ? body->read(data, room) : 0;
+	bool end = count < room || count == connection.remaining;
+
+	if (connection.remaining != HTTP_LENGTH_UNKNOWN) {
+		connection.remaining -= count;
+	}
+	metrics.http_body_bytes.fetch_add(count, std::memory_order_relaxed);
+
+	size_t start = data_start;
+	size_t length = count;
+
+	if (connection.chunked) {
+		if (count > 0) {
+			char size_line[data_start];
+			int size_length = snprintf(size_line, sizeof(size_line), "%x\r\n", (unsigned) count);
+			start -= size_length;
+			memcpy(connection.output + start, size_line, size_length);
+			memcpy(data + count, "\r\n", 2);
+			length += size_length + 2;
+		}
+
+		if (end) {
+			memcpy(connection.output + start + length, "0\r\n\r\n", 5);
+			length += 5;
+		}
+	}
+
+	if (end) {
+		// A stream that ended before its Content-Length leaves the client
+		// waiting for the rest, only closing tells it
+		if (connection.remaining != HTTP_LENGTH_UNKNOWN && connection.remaining > 0) {
+			log_w("body of %s ended short", connection.request.get_path());
+			connection.keep_alive = false;
+		}
+		body.reset();
+	}
+
+	connection.output_start = start;
+	connection.output_length = start + length;
+
+	return length > 0;
+}
+
+bool HttpServer::write_output(Connection& connection) {
+	ssize_t count = send(
+		connection.socket,
+		connection.output + connection.output_start,
+		connection.output_length - connection.output_start,
+		MSG_DONTWAIT | MSG_NOSIGNAL);
+
+	if (count < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			close_connection(connection);
+			return false;
+		}
+		return true;
+	}
+
+	connection.output_start += count;
+	connection.last_activity = millis();
+
+	return true;
+}
+
+void HttpServer::transmit(Connection& connection) {
+	// One chunk per turn, then the next connection
+	if (connection.output_start == connection.output_length &&
+		!fill_output(connection)) {
+		finish_response(connection);
+		return;
+	}
+
+	if (write_output(connection) &&
+		connection.output_start == connection.output_length &&
+		!connection.response._body) {
+		finish_response(connection);
+	}
+}
+
+void HttpServer::finish_response(Connection& connection) {
+	if (!connection.keep_alive) {
+		close_connection(connection);
+		return;
+	}
+
+	// Releases the recording a download was reading
+	connection.response.clear();
+
+	// A pipelined request that arrived with this one moves to the front
+	size_t next = std::min(connection.next_request, connection.request_length);
+	connection.request_length -= next;
+	memmove(
+		connection.request_text, connection.request_text + next,
+		connection.request_length);
+	connection.request_text[connection.request_length] = '\0';
+	connection.next_request = 0;
+
+	connection.state = ConnectionState::Reading;
+	connection.last_activity = millis();
+
+	if (connection.request_length > 0) {
+		parse_buffered(connection);
+	}
+}
+
+void HttpServer::receive_pushed(Connection& connection) {
+	// The request is handled, its buffer takes what the client sends now
+	ssize_t count = recv(
+		connection.socket, connection.request_text, HTTP_REQUEST_SIZE,
+		MSG_DONTWAIT);
+
+	if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return;
+	}
+
+	auto& source = connection.response._push;
+
+	if (count <= 0 ||
+		(source && !source->consume((const uint8_t*) connection.request_text, count))) {
+		close_connection(connection);
+	}
+}
+
+void HttpServer::transmit_pushed(Connection& connection) {
+	auto& source = connection.response._push;
+
+	if (connection.output_start == connection.output_length) {
+		if (!source) {
+			close_connection(connection);
+			return;
+		}
+
+		size_t written = 0;
+		bool open = source->produce(connection.output, HTTP_CHUNK_SIZE, written);
+
+		connection.output_start = 0;
+		connection.output_length = written;
+		metrics.http_body_bytes.fetch_add(written, std::memory_order_relaxed);
+
+		if (!open) {
+			source.reset();
+		}
+
+		// Nothing new, not waiting for the client either
+		if (written == 0) {
+			connection.last_activity = millis();
+			if (!open) {
+				close_connection(connection);
+			}
+			return;
+		}
+	}
+
+	if (write_output(connection) &&
+		connection.output_start == connection.output_length && !source) {
+		close_connection(connection);
+	}
+}
+
+void HttpServer::poll(uint32_t timeout_ms) {
+	if (_listener < 0 && !open_listener()) {
+		delay(timeout_ms);
+		return;
+	}
+
+	fd_set readable;
+	fd_set writable;
+	FD_ZERO(&readable);
+	FD_ZERO(&writable);
+	int max_socket = -1;
+	bool pushing = false;
+	bool preparing = false;
+
+	if (get_connection_count() < HTTP_MAX_CONNECTIONS ||
+		find_idle_connection() != nullptr) {
+		FD_SET(_listener, &readable);
+		max_socket = _listener;
+	}
+
+	for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+		Connection& connection = _connections[i];
+
+		if (connection.state == ConnectionState::Reading ||
+			connection.state == ConnectionState::Receiving) {
+			FD_SET(connection.socket, &readable);
+		} else if (connection.state == ConnectionState::Writing) {
+			FD_SET(connection.socket, &writable);
+		} else if (connection.state == ConnectionState::Pushing) {
+			// Clients may send something, or close, at any time. Writes are
+			// only waited for while output is pending, otherwise the
+			// source is asked on every turn.
+			FD_SET(connection.socket, &readable);
+			if (connection.output_start != connection.output_length) {
+				FD_SET(connection.socket, &writable);
+			}
+			pushing = true;
+		} else if (connection.state == ConnectionState::Preparing) {
+			// Steps right after the sockets are checked, the client is
+			// not waited for
+			preparing = true;
+			continue;
+		} else {
+			continue;
+		}
+
+		max_socket = std::max(max_socket, connection.socket);
+	}
+
+	if (pushing) {
+		timeout_ms = std::min(timeout_ms, HTTP_PUSH_INTERVAL_MS);
+	}
+	if (preparing) {
+		timeout_ms = 0;
+	}
+
+	struct timeval timeout;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+	// The task sleeps here until a client needs something
+	int ready = select(max_socket + 1, &readable, &writable, nullptr, &timeout);
+	if (ready < 0) {
+		log_e("select failed: %d", errno);
+		delay(timeout_ms);
+		return;
+	}
+
+	if (FD_ISSET(_listener, &readable)) {
+		accept_connection();
+	}
+
+	uint32_t now = millis();
+
+	// Round robin, a different connection goes first every time
+	for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+		Connection& connection =
+			_connections[(_next_turn + i) % HTTP_MAX_CONNECTIONS];
+
+		if (connection.state == ConnectionState::Free) {
+			continue;
+		}
+
+		if (connection.state == ConnectionState::Pushing) {
+			bool pending = connection.output_start != connection.output_length;
+
+			if (FD_ISSET(connection.socket, &readable)) {
+				receive_pushed(connection);
+			}
+			if (connection.state == ConnectionState::Pushing &&
+				(!pending || FD_ISSET(connection.socket, &writable))) {
+				transmit_pushed(connection);
+			}
+			// A client that stops reading times out below
+			if (connection.state != ConnectionState::Pushing ||
+				connection.output_start == connection.output_length) {
+				continue;
+			}
+		}
+
+		if (connection.state == ConnectionState::Preparing) {
+			prepare_response(connection);
+		} else if (
+			connection.state == ConnectionState::Reading &&
+			FD_ISSET(connection.socket, &readable)) {
+			receive(connection);
+		} else if (
+			connection.state == ConnectionState::Receiving &&
+			FD_ISSET(connection.socket, &readable)) {
+			receive_body(connection);
+		} else if (
+			connection.state == ConnectionState::Writing &&
+			FD_ISSET(connection.socket, &writable)) {
+			transmit(connection);
+		} else if (
+			connection.state == ConnectionState::Reading &&
+			connection.request_count > 0 && connection.request_length == 0) {
+			// Kept alive, the client decides when to send the next request
+			if (now - connection.last_activity > HTTP_KEEP_ALIVE_TIMEOUT_MS) {
+				close_connection(connection);
+			}
+		} else if (now - connection.last_activity > HTTP_IDLE_TIMEOUT_MS) {
+			log_w("closing idle connection");
+			close_connection(connection);
+		}
+	}
+
+	_next_turn = (_next_turn + 1) % HTTP_MAX_CONNECTIONS;
+}
@@ -0,0 +1,35 @@
+#include "liveSamples.h"
+
+#include <math.h>
+#include <string.h>
+
+void LiveSamples::push(const float data[], uint8_t length) {
+	uint32_t position = _position.load(std::memory_order_relaxed);
+	float* record = _records[position % LIVE_BUFFER_RECORDS];
+
+	for (uint8_t i = 0; i < ECG_CHANNELS; i++) {
+		record[i] = i < length ? data[i] : NAN;
+	}
+
+	_position.store(position + 1, std::memory_order_release);
+}
+
+uint32_t LiveSamples::get_position() const {
+	return _position.load(std::memory_order_acquire);
+}
+
+bool LiveSamples::read(uint32_t position, float out[]) const {
+	// Differences stay right when the position wraps
+	uint32_t age = _position.load(std::memory_order_acquire) - position;
+	if (age == 0 || age >= LIVE_BUFFER_RECORDS) {
+		return false;
+	}
+
+	memcpy(out, _records[position % LIVE_BUFFER_RECORDS], sizeof(_records[0]));
+
+	// The slot is only written again once the writer is a whole buffer ahead,
+	// if that happened during the copy it may be torn
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	return _position.load(std::memory_order_relaxed) - position < LIVE_BUFFER_RECORDS;
+}
@@ -0,0 +1,309 @@
+#include "liveStream.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "metrics.h"
+#include "sha1.h"
+#include "textFormat.h"
+
+constexpr uint8_t WEBSOCKET_OPCODE_BINARY = 0x2;
+constexpr uint8_t WEBSOCKET_OPCODE_CLOSE = 0x8;
+constexpr uint8_t WEBSOCKET_OPCODE_PING = 0x9;
+constexpr uint8_t WEBSOCKET_OPCODE_PONG = 0xa;
+constexpr uint8_t WEBSOCKET_FINAL = 0x80;
+constexpr uint8_t WEBSOCKET_MASKED = 0x80;
+
+// Status of the close frame sent to clients that can not keep up
+constexpr uint16_t WEBSOCKET_POLICY_VIOLATION = 1008;
+
+// Decimals of samples in event streams
+constexpr uint8_t LIVE_EVENT_DECIMALS = 4;
+
+void websocket_accept(const char* key, char out[WEBSOCKET_ACCEPT_SIZE]) {
+	static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+	static const char alphabet[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	char text[64 + sizeof(guid)];
+	int length = snprintf(text, sizeof(text), "%.64s%s", key, guid);
+
+	uint8_t digest[SHA1_DIGEST_SIZE];
+	sha1(text, length, digest);
+
+	// Base64 of 20 bytes, the last group has two bytes and one '='
+	char* o = out;
+	for (size_t i = 0; i < SHA1_DIGEST_SIZE; i += 3) {
+		uint32_t group = (uint32_t) digest[i] << 16 |
+			(uint32_t) digest[i + 1] << 8 |
+			(i + 2 < SHA1_DIGEST_SIZE ? digest[i + 2] : 0);
+
+		*o++ = alphabet[group >> 18];
+		*o++ = alphabet[(group >> 12) & 0x3f];
+		*o++ = alphabet[(group >> 6) & 0x3f];
+		*o++ = i + 2 < SHA1_DIGEST_SIZE ? alphabet[group & 0x3f] : '=';
+	}
+	*o = '\0';
+}
+
+LiveStream::LiveStream(
+	std::shared_ptr<const LiveSamples> samples,
+	const ExportSelection& selection,
+	uint16_t decimation)
+	: _samples(std::move(samples)), _selection(selection),
+	  _decimation(std::max<uint16_t>(decimation, 1)) {
+	_next = _samples->get_position();
+}
+
+LiveStream::~LiveStream() {}
+
+uint32_t LiveStream::get_next_position() const {
+	return _next;
+}
+
+uint8_t LiveStream::get_channel_count() const {
+	return _selection.channel_count > 0 ? _selection.channel_count
+										: ECG_CHANNELS;
+}
+
+bool LiveStream::catch_up() {
+	uint32_t position = _samples->get_position();
+	uint32_t lag = position - _next;
+	Metrics::raise(metrics.live_lag_high_water, lag);
+
+	// Half the buffer left, the records would soon be overwritten
+	if (lag < LIVE_BUFFER_RECORDS / 2) {
+		return true;
+	}
+
+	if (_decimation >= LIVE_MAX_DECIMATION) {
+		log_w("dropping live client, it can not keep up");
+		return false;
+	}
+
+	_decimation = std::min<uint16_t>(_decimation * 2, LIVE_MAX_DECIMATION);
+	metrics.live_records_skipped.fetch_add(lag, std::memory_order_relaxed);
+	_next = position;
+	_lost = true;
+	log_i("live client falls behind, decimation %u", _decimation);
+
+	return true;
+}
+
+uint32_t LiveStream::get_packet_records(uint32_t max) const {
+	uint32_t available = _samples->get_position() - _next;
+
+	if (available < std::max<uint32_t>(LIVE_PACKET_RECORDS, _decimation)) {
+		return 0;
+	}
+
+	return std::min(available / _decimation, max);
+}
+
+uint8_t LiveStream::read_record(float out[]) {
+	float record[ECG_CHANNELS];
+	float sums[ECG_CHANNELS] = {};
+	uint16_t count = 0;
+
+	for (uint16_t i = 0; i < _decimation; i++) {
+		if (!_samples->read(_next + i, record)) {
+			_lost = true;
+			continue;
+		}
+
+		for (uint8_t channel = 0; channel < ECG_CHANNELS; channel++) {
+			sums[channel] += record[channel];
+		}
+		count++;
+	}
+
+	_next += _decimation;
+
+	for (uint8_t channel = 0; channel < ECG_CHANNELS; channel++) {
+		sums[channel] = count > 0 ? sums[channel] / count : NAN;
+	}
+
+	return _selection.select(sums, ECG_CHANNELS, out);
+}
+
+LiveWebSocket::~LiveWebSocket() {}
+
+void LiveWebSocket::queue_reply(
+	uint8_t opcode, const uint8_t* payload, size_t length) {
+	_reply[0] = WEBSOCKET_FINAL | opcode;
+	_reply[1] = length;
+	memcpy(_reply + 2, payload, length);
+	_reply_length = 2 + length;
+}
+
+bool LiveWebSocket::produce(uint8_t* buffer, size_t length, size_t& written) {
+	written = 0;
+
+	if (_reply_length > 0) {
+		memcpy(buffer, _reply, _reply_length);
+		written = _reply_length;
+		_reply_length = 0;
+		return !_closing;
+	}
+
+	if (_closing) {
+		return false;
+	}
+
+	if (!catch_up()) {
+		const uint8_t status[] = {
+			WEBSOCKET_POLICY_VIOLATION >> 8, WEBSOCKET_POLICY_VIOLATION & 0xff
+		};
+		queue_reply(WEBSOCKET_OPCODE_CLOSE, status, sizeof(status));
+		memcpy(buffer, _reply, _reply_length);
+		written = _reply_length;
+		_reply_length = 0;
+		return false;
+	}
+
+	uint8_t channels = get_channel_count();
+	size_t record_size = channels * sizeof(float);
+	// Frame header with a 16 bit length
+	size_t frame_header = 4;
+	uint32_t count = get_packet_records(
+		(length - frame_header - sizeof(LivePacketHeader)) / record_size);
+
+	if (count == 0) {
+		return true;
+	}
+
+	size_t payload_length = sizeof(LivePacketHeader) + count * record_size;
+	if (payload_length < 126) {
+		frame_header = 2;
+		buffer[1] = payload_length;
+	} else {
+		buffer[1] = 126;
+		buffer[2] = payload_length >> 8;
+		buffer[3] = payload_length & 0xff;
+	}
+	buffer[0] = WEBSOCKET_FINAL | WEBSOCKET_OPCODE_BINARY;
+
+	LivePacketHeader header;
+	header.first_record = get_next_position();
+	header.record_count = count;
+	header.decimation = _decimation;
+	header.channel_count = channels;
+	header.flags = _lost ? LIVE_PACKET_RECORDS_LOST : 0;
+	header.reserved = 0;
+	_lost = false;
+
+	uint8_t* payload = buffer + frame_header;
+	memcpy(payload, &header, sizeof(header));
+
+	float* samples = (float*) (payload + sizeof(header));
+	for (uint32_t i = 0; i < count; i++) {
+		float record[UINT8_MAX];
+		read_record(record);
+		memcpy(samples + i * channels, record, record_size);
+	}
+
+	written = frame_header + payload_length;
+
+	return true;
+}
+
+bool LiveWebSocket::consume(const uint8_t* data, size_t length) {
+	while (length > 0) {
+		size_t count = std::min(length, sizeof(_incoming) - _incoming_length);
+		memcpy(_incoming + _incoming_length, data, count);
+		_incoming_length += count;
+		data += count;
+		length -= count;
+
+		while (_incoming_length >= 2) {
+			uint8_t opcode = _incoming[0] & 0x0f;
+			size_t payload_length = _incoming[1] & 0x7f;
+
+			// Client frames are masked. Anything longer than a control frame
+			// is not expected from a viewer.
+			if (!(_incoming[1] & WEBSOCKET_MASKED) || payload_length > 125) {
+				log_w("unexpected WebSocket frame, closing");
+				return false;
+			}
+
+			size_t frame_length = 2 + 4 + payload_length;
+			if (_incoming_length < frame_length) {
+				break;
+			}
+
+			uint8_t payload[125];
+			for (size_t i = 0; i < payload_length; i++) {
+				payload[i] = _incoming[6 + i] ^ _incoming[2 + i % 4];
+			}
+
+			if (opcode == WEBSOCKET_OPCODE_CLOSE) {
+				// Echoes the status code, the stream ends after the reply
+				queue_reply(
+					WEBSOCKET_OPCODE_CLOSE, payload, std::min<size_t>(payload_length, 2));
+				_closing = true;
+			} else if (opcode == WEBSOCKET_OPCODE_PING) {
+				queue_reply(WEBSOCKET_OPCODE_PONG, payload, payload_length);
+			}
+
+			memmove(_incoming, _incoming + frame_length, _incoming_length - frame_length);
+			_incoming_length -= frame_length;
+		}
+
+		if (_incoming_length == sizeof(_incoming)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+LiveEventStream::~LiveEventStream() {}
+
+bool LiveEventStream::produce(uint8_t* buffer, size_t length, size_t& written) {
+	written = 0;
+
+	if (!catch_up()) {
+		return false;
+	}
+
+	uint8_t channels = get_channel_count();
+	// "data: " and a separator or line break per sample
+	size_t line_size = 6 + channels * (FORMAT_MAX_LENGTH + 1);
+	// The first line and the empty line ending the event
+	size_t event_overhead = 6 + 3 * (FORMAT_MAX_LENGTH + 1) + 1;
+	uint32_t count = get_packet_records((length - event_overhead) / line_size);
+
+	if (count == 0) {
+		return true;
+	}
+
+	char* out = (char*) buffer;
+	size_t used = snprintf(
+		out, length, "data: %u,%u,%u\n", (unsigned) get_next_position(),
+		(unsigned) _decimation, _lost ? 1 : 0);
+	_lost = false;
+
+	for (uint32_t i = 0; i < count; i++) {
+		float record[UINT8_MAX];
+		uint8_t selected = read_record(record);
+
+		memcpy(out + used, "data: ", 6);
+		used += 6;
+
+		for (uint8_t channel = 0; channel < selected; channel++) {
+			used += format_fixed(out + used, record[channel], LIVE_EVENT_DECIMALS);
+			out[used++] = channel + 1 < selected ? ',' : '\n';
+		}
+	}
+
+	out[used++] = '\n';
+	written = used;
+
+	return true;
+}
+
+bool LiveEventStream::consume(const uint8_t* data, size_t length) {
+	// Event stream clients do not send anything after the request
+	return true;
+}
@@ -4,25 +4,37 @@
 #include <SPI.h>
 #include <freertos/FreeRTOS.h>
 
+#include "liveSamples.h"
+#include "metrics.h"
 #include "readECGData.h"
+#include "recordingCleaner.h"
+#include "recordingTranscoder.h"
 #include "setupWiFi.h"
 #include "storage.h"
 #include "storeDataOnSD.h"
 #include "ui.h"
+#include "webAccess.h"
 
 SPIClass vspi(VSPI);  // For ECG
 SPIClass hspi(HSPI);  // For OLED and SD
 std::mutex hspi_mutex;
 
 void readECGDataTask(void* parameter);
+void recordingCleanerTask(void* parameter);
+void recordingTranscoderTask(void* parameter);
 void storeDataOnSDTask(void* parameter);
 void uiTask(void* parameter);
+void webAccessTask(void* parameter);
 
+std::shared_ptr<LiveSamples> liveSamples;
 std::shared_ptr<ReadECGData> readECGData;
+std::shared_ptr<RecordingCleaner> recordingCleaner;
+std::shared_ptr<RecordingTranscoder> recordingTranscoder;
 std::shared_ptr<SetupWiFi> setupWiFi;
 std::shared_ptr<Storage> storage;
 std::shared_ptr<StoreDataOnSD> storeDataOnSD;
 std::unique_ptr<UI> ui;
+std::shared_ptr<WebAccess> webAccess;
 
 void setup() {
 	Serial.begin(921600);
@@ -31,16 +43,40 @@ void setup() {
 
 	Serial.println("Starting");
 
+	liveSamples = std::make_shared<LiveSamples>();
 	readECGData = std::make_shared<ReadECGData>(vspi);
+	readECGData->set_live_samples(liveSamples);
 	setupWiFi = std::make_shared<SetupWiFi>();
 	storage = std::make_shared<Storage>(hspi, hspi_mutex);
 	storeDataOnSD = std::make_shared<StoreDataOnSD>(storage);
+	recordingTranscoder = std::make_shared<RecordingTranscoder>(storage);
+	recordingCleaner = std::make_shared<RecordingCleaner>(storage);
 	ui = std::make_unique<UI>(hspi, hspi_mutex);
 	ui->set_setup_wifi(setupWiFi);
+	ui->set_storage(storage);
+	webAccess = std::make_shared<WebAccess>(storage);
+	webAccess->setLiveSamples(liveSamples);
+	webAccess->setRecordingCleaner(recordingCleaner);
 
-	xTaskCreate(readECGDataTask, "ReadECGData", 5000, nullptr, 1, nullptr);
-	xTaskCreate(storeDataOnSDTask, "StoreDataOnSD", 5000, nullptr, 1, nullptr);
-	xTaskCreate(uiTask, "UI", 5000, nullptr, 1, nullptr);
+	TaskHandle_t task = nullptr;
+	xTaskCreate(readECGDataTask, "ReadECGData", 5000, nullptr, 1, &task);
+	metrics.watch_task(task);
+	xTaskCreate(storeDataOnSDTask, "StoreDataOnSD", 5000, nullptr, 1, &task);
+	metrics.watch_task(task);
+	xTaskCreate(uiTask, "UI", 5000, nullptr, 1, &task);
+	metrics.watch_task(task);
+	// Blocks in select() between client events
+	xTaskCreate(webAccessTask, "WebAccess", 8192, nullptr, 1, &task);
+	metrics.watch_task(task);
+	// Idle priority, only runs when acquisition and UI have nothing to do
+	xTaskCreate(
+		recordingTranscoderTask, "RecordingTranscoder", 5000, nullptr, 0, &task);
+	metrics.watch_task(task);
+	// Removes recordings between the writes of the recording
+	xTaskCreate(recordingCleanerTask, "RecordingCleaner", 5000, nullptr, 0, &task);
+	metrics.watch_task(task);
+	// The Arduino loop task itself
+	metrics.watch_task(xTaskGetCurrentTaskHandle());
 }
 
 void loop() {
@@ -52,6 +88,14 @@ void readECGDataTask(void* parameter) {
 	readECGData->loop();
 }
 
+void recordingCleanerTask(void* parameter) {
+	recordingCleaner->loop();
+}
+
+void recordingTranscoderTask(void* parameter) {
+	recordingTranscoder->loop();
+}
+
 void storeDataOnSDTask(void* parameter) {
 	storeDataOnSD->loop();
 }
@@ -59,3 +103,7 @@ void storeDataOnSDTask(void* parameter) {
 void uiTask(void* parameter) {
 	ui->loop();
 }
+
+void webAccessTask(void* parameter) {
+	webAccess->loop();
+}
@@ -0,0 +1,235 @@
+#include "metrics.h"
+
+#include <stdio.h>
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_wifi.h>
+
+#include "textFormat.h"
+
+Metrics metrics;
+
+// A TextWriter for the Prometheus text format
+class PageWriter : public TextWriter {
+public:
+	using TextWriter::TextWriter;
+
+	// HELP and TYPE lines in front of the samples of a metric
+	void describe(const char* name, const char* type, const char* help) {
+		print("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+	}
+};
+
+LatencyHistogram::LatencyHistogram() {
+	for (auto& count : _counts) {
+		count.store(0, std::memory_order_relaxed);
+	}
+}
+
+void LatencyHistogram::observe(uint32_t microseconds) {
+	size_t bucket = 0;
+	while (bucket < METRICS_LATENCY_BUCKETS &&
+		   microseconds > METRICS_LATENCY_BOUNDS_US[bucket]) {
+		bucket++;
+	}
+
+	_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+	_sum_us.fetch_add(microseconds, std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::render(
+	char* out, size_t size, const char* name, const char* help) const {
+	PageWriter page(out, size);
+	page.describe(name, "histogram", help);
+
+	// Buckets are counted apart and added up here, Prometheus buckets count
+	// everything up to their bound
+	uint32_t count = 0;
+	for (size_t i = 0; i <= METRICS_LATENCY_BUCKETS; i++) {
+		count += _counts[i].load(std::memory_order_relaxed);
+
+		if (i < METRICS_LATENCY_BUCKETS) {
+			uint32_t bound = METRICS_LATENCY_BOUNDS_US[i];
+			page.print(
+				"%s_bucket{le=\"%u.%06u\"} %u\n", name, (unsigned) (bound / 1000000),
+				(unsigned) (bound % 1000000), (unsigned) count);
+		} else {
+			page.print("%s_bucket{le=\"+Inf\"} %u\n", name, (unsigned) count);
+		}
+	}
+
+	uint32_t sum_us = _sum_us.load(std::memory_order_relaxed);
+	page.print(
+		"%s_sum %u.%06u\n%s_count %u\n", name, (unsigned) (sum_us / 1000000),
+		(unsigned) (sum_us % 1000000), name, (unsigned) count);
+
+	return page.get_length();
+}
+
+void Metrics::raise(std::atomic<uint32_t>& mark, uint32_t value) {
+	uint32_t current = mark.load(std::memory_order_relaxed);
+	while (value > current &&
+		   !mark.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
+void Metrics::watch_task(TaskHandle_t task) {
+	size_t index = task_count.load(std::memory_order_relaxed);
+	if (task == nullptr || index >= METRICS_MAX_TASKS) {
+		return;
+	}
+
+	tasks[index].store(task, std::memory_order_relaxed);
+	task_count.store(index + 1, std::memory_order_release);
+}
+
+size_t Metrics::render(char* out, size_t size, uint32_t records_acquired) const {
+	PageWriter page(out, size);
+
+	page.describe(
+		"ecg_records_acquired_total", "counter", "Records read from the ECG front end.");
+	page.print("ecg_records_acquired_total %u\n", (unsigned) records_acquired);
+	page.describe(
+		"ecg_records_stored_total", "counter", "Records written to the current recording.");
+	page.print(
+		"ecg_records_stored_total %u\n",
+		(unsigned) records_stored.load(std::memory_order_relaxed));
+	page.describe(
+		"ecg_records_dropped_total", "counter",
+		"Records lost because the card was full or failed.");
+	page.print(
+		"ecg_records_dropped_total %u\n",
+		(unsigned) records_dropped.load(std::memory_order_relaxed));
+
+	page.describe(
+		"ecg_live_lag_high_water_records", "gauge",
+		"Furthest a live client was behind acquisition.");
+	page.print(
+		"ecg_live_lag_high_water_records %u\n",
+		(unsigned) live_lag_high_water.load(std::memory_order_relaxed));
+	page.describe(
+		"ecg_live_records_skipped_total", "counter",
+		"Records live clients skipped to catch up.");
+	page.print(
+		"ecg_live_records_skipped_total %u\n",
+		(unsigned) live_records_skipped.load(std::memory_order_relaxed));
+
+	page.add(card_write.render(
+		page.get_end(), page.get_room(), "ecg_card_write_seconds",
+		"Time to write a block to the card."));
+	page.add(card_sync.render(
+		page.get_end(), page.get_room(), "ecg_card_sync_seconds",
+		"Time to flush a recording to the card."));
+	page.add(card_remove.render(
+		page.get_end(), page.get_room(), "ecg_card_remove_seconds",
+		"Time the card is held to remove a recording."));
+	page.describe(
+		"ecg_recordings_removed_total", "counter",
+		"Recordings removed, on request or by the retention policy.");
+	page.print(
+		"ecg_recordings_removed_total %u\n",
+		(unsigned) recordings_removed.load(std::memory_order_relaxed));
+
+	page.describe("ecg_http_connections", "gauge", "Open HTTP connections.");
+	page.print(
+		"ecg_http_connections %u\n",
+		(unsigned) http_connections.load(std::memory_order_relaxed));
+	page.describe(
+		"ecg_http_connections_accepted_total", "counter",
+		"HTTP connections accepted, kept alive ones serve several requests.");
+	page.print(
+		"ecg_http_connections_accepted_total %u\n",
+		(unsigned) http_connections_accepted.load(std::memory_order_relaxed));
+	page.describe("ecg_http_requests_total", "counter", "HTTP requests answered.");
+	page.print(
+		"ecg_http_requests_total %u\n",
+		(unsigned) http_requests.load(std::memory_order_relaxed));
+	page.describe(
+		"ecg_http_body_bytes_total", "counter",
+		"Bytes of response bodies sent, exports included.");
+	page.print(
+		"ecg_http_body_bytes_total %u\n",
+		(unsigned) http_body_bytes.load(std::memory_order_relaxed));
+	page.describe(
+		"ecg_http_pool_blocks_total", "counter",
+		"Memory blocks of responses by where they came from, the heap or the response pool.");
+	page.print(
+		"ecg_http_pool_blocks_total{source=\"heap\"} %u\n",
+		(unsigned) http_pool_allocations.load(std::memory_order_relaxed));
+	page.print(
+		"ecg_http_pool_blocks_total{source=\"pool\"} %u\n",
+		(unsigned) http_pool_reuses.load(std::memory_order_relaxed));
+	page.describe(
+		"ecg_http_pool_kept_bytes", "gauge", "Memory the response pool keeps for reuse.");
+	page.print(
+		"ecg_http_pool_kept_bytes %u\n",
+		(unsigned) http_pool_kept_bytes.load(std::memory_order_relaxed));
+
+	// Stack is counted in bytes on the ESP32
+	page.describe(
+		"ecg_task_stack_free_min_bytes", "gauge",
+		"Smallest free stack a task ever had.");
+	size_t count = task_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; i++) {
+		TaskHandle_t task = tasks[i].load(std::memory_order_relaxed);
+		page.print(
+			"ecg_task_stack_free_min_bytes{task=\"%s\"} %u\n", pcTaskGetName(task),
+			(unsigned) uxTaskGetStackHighWaterMark(task));
+	}
+
+	page.describe("ecg_heap_free_bytes", "gauge", "Free heap.");
+	page.print(
+		"ecg_heap_free_bytes{memory=\"internal\"} %u\n",
+		(unsigned) heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+	bool psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+	if (psram) {
+		page.print(
+			"ecg_heap_free_bytes{memory=\"psram\"} %u\n",
+			(unsigned) heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+	}
+	page.describe(
+		"ecg_heap_free_min_bytes", "gauge", "Least free internal heap since boot.");
+	page.print(
+		"ecg_heap_free_min_bytes %u\n",
+		(unsigned) heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+	page.describe(
+		"ecg_heap_largest_free_block_bytes", "gauge",
+		"Largest block that can be allocated at once.");
+	page.print(
+		"ecg_heap_largest_free_block_bytes{memory=\"internal\"} %u\n",
+		(unsigned) heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+	if (psram) {
+		page.print(
+			"ecg_heap_largest_free_block_bytes{memory=\"psram\"} %u\n",
+			(unsigned) heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+	}
+	size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+	page.describe(
+		"ecg_heap_fragmentation_ratio", "gauge",
+		"Share of the free internal heap outside its largest block.");
+	page.print(
+		"ecg_heap_fragmentation_ratio %.3f\n",
+		free_internal > 0
+			? 1 - (double) heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL) / free_internal
+			: 0.0);
+
+	// The device is an access point, the signal is that of each station as
+	// received here
+	wifi_sta_list_t stations;
+	if (esp_wifi_ap_get_sta_list(&stations) != ESP_OK) {
+		stations.num = 0;
+	}
+	page.describe("ecg_wifi_stations", "gauge", "Stations connected to the access point.");
+	page.print("ecg_wifi_stations %d\n", stations.num);
+	page.describe(
+		"ecg_wifi_station_rssi_dbm", "gauge", "Signal strength of a connected station.");
+	for (int i = 0; i < stations.num; i++) {
+		const uint8_t* mac = stations.sta[i].mac;
+		page.print(
+			"ecg_wifi_station_rssi_dbm{station=\"%02x:%02x:%02x:%02x:%02x:%02x\"} %d\n",
+			mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], stations.sta[i].rssi);
+	}
+
+	return page.get_length();
+}
@@ -1,13 +1,75 @@
 #include "readECGData.h"
 
 #include <Arduino.h>
+#include <math.h>
+
+#include "liveSamples.h"
+
+#ifdef ECG_DEMO_SIGNAL
+// Records of the demo signal are pushed in batches this far apart
+constexpr uint32_t READ_ECG_BATCH_MS = 10;
+// 72 beats per minute are 6 beats in 5 s, the signal repeats after this
+// many records
+constexpr uint32_t DEMO_REPEAT_RECORDS = 5 * ECG_SAMPLE_RATE_HZ;
+
+// Lead signal at a heart rate of 72/min: P wave, QRS complex and T wave as
+// bumps, slightly smaller on every further channel. record is below
+// DEMO_REPEAT_RECORDS, so it converts to float without losing the phase.
+static float synthetic_sample(uint32_t record, uint8_t channel) {
+	const float beat_s = 60.0f / 72;
+	float t = fmodf((float) record / ECG_SAMPLE_RATE_HZ, beat_s) / beat_s;
+
+	float value = 0.15f * expf(-powf((t - 0.2f) / 0.03f, 2)) +
+		1.2f * expf(-powf((t - 0.4f) / 0.01f, 2)) +
+		0.3f * expf(-powf((t - 0.65f) / 0.05f, 2));
+
+	return value * (1.0f - channel * 0.1f);
+}
+#endif
 
 ReadECGData::ReadECGData(SPIClass& spi) : _spi(spi) {}
 
 ReadECGData::~ReadECGData() {}
 
+void ReadECGData::set_live_samples(std::shared_ptr<LiveSamples> live_samples) {
+	_live_samples = live_samples;
+}
+
+#ifdef ECG_DEMO_SIGNAL
+void ReadECGData::loop() {
+	// Demo builds push a synthetic signal at the sample rate where the
+	// records of the ADAS1000 will go, so live viewers have something to
+	// show
+	uint32_t last = millis();
+	// Records due times 1000, what is left of a record carries over
+	uint32_t due = 0;
+	uint32_t record = 0;
+	float data[ECG_CHANNELS];
+
+	while (true) {
+		uint32_t now = millis();
+		due += (now - last) * ECG_SAMPLE_RATE_HZ;
+		last = now;
+
+		for (; due >= 1000; due -= 1000) {
+			for (uint8_t channel = 0; channel < ECG_CHANNELS; channel++) {
+				data[channel] = synthetic_sample(record, channel);
+			}
+			record = (record + 1) % DEMO_REPEAT_RECORDS;
+
+			if (_live_samples) {
+				_live_samples->push(data, ECG_CHANNELS);
+			}
+		}
+
+		delay(READ_ECG_BATCH_MS);
+	}
+}
+#else
 void ReadECGData::loop() {
+	// The ADAS1000 is not read yet, nothing is pushed until it is
 	while (true) {
 		delay(1000);
 	}
 }
+#endif
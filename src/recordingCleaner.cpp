@@ -0,0 +1,254 @@
+#include "recordingCleaner.h"
+
+#include <algorithm>
+
+#include <Arduino.h>
+
+#include "ecg_isd_config.h"
+
+RecordingCleaner::RecordingCleaner(std::shared_ptr<Storage> storage)
+	: _storage(storage) {}
+
+RecordingCleaner::~RecordingCleaner() {}
+
+bool RecordingCleaner::queue_locked(std::vector<std::string>& names, bool retention) {
+	if (_progress.running || names.empty()) {
+		return false;
+	}
+
+	_progress = RemovalProgress();
+	_progress.running = true;
+	_progress.retention = retention;
+	_progress.total = names.size();
+	_queued.swap(names);
+
+	return true;
+}
+
+bool RecordingCleaner::remove(std::vector<std::string> names) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	return queue_locked(names, false);
+}
+
+RemovalProgress RecordingCleaner::get_progress() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	return _progress;
+}
+
+RetentionPolicy RecordingCleaner::get_policy() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	return _policy;
+}
+
+void RecordingCleaner::set_policy(const RetentionPolicy& policy) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_policy = policy;
+	_policy_changed = true;
+}
+
+uint32_t RecordingCleaner::record_count(const StorageEntry& recording) {
+	// The live recording grows with every block, it would be read again at
+	// every check
+	uint32_t count;
+	if (_storage->get_live_record_count(recording.get_name(), count)) {
+		return count;
+	}
+
+	auto cached = std::find_if(
+		_retained.begin(), _retained.end(), [&](const RetainedEntry& entry) {
+			return entry.size == recording.get_size() &&
+				entry.name == recording.get_name();
+		});
+
+	if (cached != _retained.end()) {
+		_retained_next.push_back(std::move(*cached));
+		return _retained_next.back().record_count;
+	}
+
+	// Closed recordings have their count in the index trailer
+	_storage->yield_to_writer();
+	auto reader = _storage->open_recording(recording.get_name());
+	count = reader ? reader->get_record_count() : 0;
+	_retained_next.push_back({ recording.get_name(), recording.get_size(), count });
+
+	return count;
+}
+
+void RecordingCleaner::find_expired(
+	const RetentionPolicy& policy, std::vector<std::string>& names) {
+	names.clear();
+
+	// The newest recording is always kept
+	if ((policy.keep_days == 0 && policy.max_percent == 0) ||
+		!_storage->list_recordings_before(_recordings, nullptr, 1) ||
+		_recordings.empty()) {
+		return;
+	}
+
+	std::string newest = _recordings.front().get_name();
+	// Names are zero padded numbers, recordings before this one are too old
+	std::string oldest_kept;
+
+	if (policy.keep_days > 0) {
+		uint64_t keep_records =
+			(uint64_t) policy.keep_days * 24 * 3600 * ECG_SAMPLE_RATE_HZ;
+		uint64_t kept_records = 0;
+		bool more = true;
+
+		_retained_next.clear();
+
+		// Newest first, a page at a time, until enough is kept
+		while (more && kept_records < keep_records) {
+			more = _storage->list_recordings_before(
+					   _recordings, oldest_kept.empty() ? nullptr : oldest_kept.data(),
+					   CLEANER_LIST_PAGE) &&
+				!_recordings.empty();
+
+			for (auto& recording : _recordings) {
+				if (kept_records >= keep_records) {
+					break;
+				}
+				kept_records += record_count(recording);
+				oldest_kept = recording.get_name();
+			}
+		}
+
+		std::swap(_retained, _retained_next);
+
+		// Everything fits, nothing is too old
+		if (kept_records < keep_records) {
+			oldest_kept.clear();
+		}
+	}
+
+	uint64_t limit = 0;
+	uint64_t used = 0;
+
+	if (policy.max_percent > 0) {
+		auto usage = _storage->get_usage();
+		limit = usage.quota_bytes * policy.max_percent / 100;
+		used = usage.used_bytes;
+	}
+
+	// Oldest first, a page at a time, up to the first recording that is
+	// neither too old nor needed to get below the limit. The rest is taken
+	// at the next check.
+	while (names.size() < CLEANER_MAX_RECORDINGS &&
+		   _storage->list_recordings(
+			   _recordings, names.empty() ? "" : names.back().data(),
+			   CLEANER_LIST_PAGE) &&
+		   !_recordings.empty()) {
+		for (auto& recording : _recordings) {
+			bool old = strcmp(recording.get_name(), oldest_kept.data()) < 0;
+
+			if ((!old && used <= limit) || newest == recording.get_name() ||
+				names.size() >= CLEANER_MAX_RECORDINGS) {
+				return;
+			}
+
+			used -= std::min<uint64_t>(used, recording.get_size());
+			names.emplace_back(recording.get_name());
+		}
+	}
+}
+
+void RecordingCleaner::run(const std::vector<std::string>& names) {
+	uint32_t start = millis();
+
+	for (auto& name : names) {
+		// A removal can not be split, the writer gets the bus between two
+		_storage->yield_to_writer();
+
+		size_t size;
+		bool removed = _storage->remove_recording(name.data(), size);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (removed) {
+			_progress.removed++;
+			_progress.bytes += size;
+		} else {
+			_progress.skipped++;
+		}
+		_progress.duration_ms = millis() - start;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_progress.running = false;
+
+	log_i(
+		"removed %u recordings%s: %llu bytes in %u ms (%u KB/s), %u skipped",
+		(unsigned) _progress.removed,
+		_progress.retention ? " by retention policy" : "",
+		(unsigned long long) _progress.bytes,
+		(unsigned) _progress.duration_ms,
+		_progress.duration_ms ? (unsigned) (_progress.bytes / _progress.duration_ms) : 0,
+		(unsigned) _progress.skipped);
+}
+
+void RecordingCleaner::loop() {
+	// Let the other tasks come up first
+	delay(10000);
+
+	RetentionPolicy stored = _storage->load_retention_policy();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_policy_changed) {
+			_policy = stored;
+		}
+	}
+
+	std::vector<std::string> names;
+	bool check = true;
+
+	while (true) {
+		RetentionPolicy policy;
+		bool save;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			names.swap(_queued);
+			policy = _policy;
+			save = _policy_changed;
+			_policy_changed = false;
+		}
+
+		if (save) {
+			_storage->save_retention_policy(policy);
+			check = true;
+		}
+
+		if (!names.empty()) {
+			run(names);
+			// A job cut at the limit continues right away
+			check = names.size() == CLEANER_MAX_RECORDINGS;
+			names.clear();
+			continue;
+		}
+
+		// Without a change there is nothing new to remove
+		uint32_t generation = _storage->get_catalog_generation();
+		if (check ||
+			(millis() - _last_check >= CLEANER_CHECK_MS &&
+			 generation != _checked_generation)) {
+			check = false;
+			_last_check = millis();
+			_checked_generation = generation;
+
+			find_expired(policy, names);
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (names.empty() || !queue_locked(names, true)) {
+				names.clear();
+			}
+			continue;
+		}
+
+		delay(CLEANER_POLL_MS);
+	}
+}
@@ -0,0 +1,549 @@
+#include "recordingFormat.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "crc32.h"
+
+namespace recording_format {
+	void BlockBuffer::append(const float data[], uint8_t length) {
+		lengths[record_count++] = length;
+		memcpy(samples + sample_count, data, sizeof(float) * length);
+		sample_count += length;
+	}
+
+	void IndexBuilder::add(uint32_t offset, uint32_t first_record) {
+		if (block_count++ % stride != 0) {
+			return;
+		}
+
+		if (entry_count == INDEX_MAX_ENTRIES) {
+			for (uint16_t i = 0; i < INDEX_MAX_ENTRIES / 2; i++) {
+				entries[i] = entries[2 * i];
+			}
+			entry_count = INDEX_MAX_ENTRIES / 2;
+			stride *= 2;
+
+			if ((block_count - 1) % stride != 0) {
+				return;
+			}
+		}
+
+		entries[entry_count++] = { offset, first_record };
+	}
+
+	void init_file_header(FileHeader& header, uint32_t recording_id) {
+		memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+		header.version = FILE_VERSION;
+		header.reserved = 0;
+		header.header_size = sizeof(FileHeader);
+		header.crc = 0;
+		header.recording_id = recording_id;
+		header.crc = crc32(&header, FILE_HEADER_BASE_SIZE);
+	}
+
+	bool check_file_header(const FileHeader& header) {
+		if (memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0 ||
+			header.header_size < FILE_HEADER_BASE_SIZE) {
+			return false;
+		}
+
+		FileHeader copy = header;
+		copy.crc = 0;
+
+		return crc32(&copy, FILE_HEADER_BASE_SIZE) == header.crc;
+	}
+
+	static uint32_t block_crc(const BlockHeader& header, const uint8_t payload[]) {
+		BlockHeader copy = header;
+		copy.crc = 0;
+
+		return crc32_update(
+			crc32(&copy, sizeof(copy)), payload, header.payload_size);
+	}
+
+	static void seal_block(
+		BlockHeader& header,
+		BlockCodec codec,
+		uint32_t first_record,
+		uint16_t record_count,
+		size_t payload_size,
+		const uint8_t payload[]) {
+		header.magic = BLOCK_MAGIC;
+		header.payload_size = payload_size;
+		header.first_record = first_record;
+		header.record_count = record_count;
+		header.codec = static_cast<uint8_t>(codec);
+		header.flags = 0;
+		header.crc = block_crc(header, payload);
+	}
+
+	// Returns 0 if the encoded samples would not fit into max_size bytes
+	static size_t encode_delta(
+		const BlockBuffer& block, uint8_t out[], size_t max_size) {
+		uint32_t previous[UINT8_MAX] = {};
+		const float* sample = block.samples;
+		size_t size = 0;
+
+		for (uint16_t r = 0; r < block.record_count; r++) {
+			for (uint8_t c = 0; c < block.lengths[r]; c++) {
+				uint32_t bits;
+				memcpy(&bits, sample++, sizeof(bits));
+
+				uint32_t delta = bits - previous[c];
+				uint32_t zigzag =
+					(delta << 1) ^ (uint32_t) ((int32_t) delta >> 31);
+				previous[c] = bits;
+
+				// A varint takes at most 5 bytes
+				if (size + 5 > max_size) {
+					return 0;
+				}
+
+				while (zigzag >= 0x80) {
+					out[size++] = (zigzag & 0x7f) | 0x80;
+					zigzag >>= 7;
+				}
+				out[size++] = zigzag;
+			}
+		}
+
+		return size;
+	}
+
+	static bool decode_delta(
+		const uint8_t in[], size_t size, BlockBuffer& block) {
+		uint32_t previous[UINT8_MAX] = {};
+		float* sample = block.samples;
+		size_t pos = 0;
+
+		for (uint16_t r = 0; r < block.record_count; r++) {
+			for (uint8_t c = 0; c < block.lengths[r]; c++) {
+				uint32_t zigzag = 0;
+
+				for (int shift = 0;; shift += 7) {
+					if (pos >= size || shift > 28) {
+						return false;
+					}
+
+					uint8_t byte = in[pos++];
+					zigzag |= (uint32_t) (byte & 0x7f) << shift;
+
+					if (!(byte & 0x80)) {
+						break;
+					}
+				}
+
+				uint32_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+				previous[c] += delta;
+				memcpy(sample++, &previous[c], sizeof(float));
+			}
+		}
+
+		return pos == size;
+	}
+
+	static bool all_finite(const float samples[], size_t count) {
+		bool finite = true;
+
+		for (size_t i = 0; i < count; i++) {
+			finite &= isfinite(samples[i]);
+		}
+
+		return finite;
+	}
+
+	// The loops below have no calls and no data dependent branches, so the
+	// compiler can vectorize them
+	IntScaling pack_ints(
+		const float samples[], size_t count, int bytes_per_sample, uint8_t out[]) {
+		float min = count ? samples[0] : 0.0f;
+		float max = min;
+
+		for (size_t i = 0; i < count; i++) {
+			min = samples[i] < min ? samples[i] : min;
+			max = samples[i] > max ? samples[i] : max;
+		}
+
+		const float q_max = bytes_per_sample == 2 ? 32767.0f : 8388607.0f;
+
+		IntScaling scaling;
+		scaling.offset = min / 2 + max / 2;
+		scaling.scale = (max / 2 - min / 2) / q_max;
+
+		// Rounded down where it overshoots, otherwise the largest sample
+		// could come back as infinity near the end of the float range
+		if (scaling.scale * q_max > max / 2 - min / 2) {
+			scaling.scale = nextafterf(scaling.scale, 0.0f);
+		}
+
+		if (!(scaling.scale > 0.0f)) {
+			scaling.scale = 1.0f;
+		}
+
+		const float inverse = 1.0f / scaling.scale;
+
+		if (bytes_per_sample == 2) {
+			for (size_t i = 0; i < count; i++) {
+				float q = (samples[i] - scaling.offset) * inverse;
+				q = q < -q_max ? -q_max : (q > q_max ? q_max : q);
+				int32_t value = (int32_t) (q + (q >= 0.0f ? 0.5f : -0.5f));
+
+				out[2 * i] = value;
+				out[2 * i + 1] = value >> 8;
+			}
+		} else {
+			for (size_t i = 0; i < count; i++) {
+				float q = (samples[i] - scaling.offset) * inverse;
+				q = q < -q_max ? -q_max : (q > q_max ? q_max : q);
+				int32_t value = (int32_t) (q + (q >= 0.0f ? 0.5f : -0.5f));
+
+				out[3 * i] = value;
+				out[3 * i + 1] = value >> 8;
+				out[3 * i + 2] = value >> 16;
+			}
+		}
+
+		return scaling;
+	}
+
+	void unpack_ints(
+		const uint8_t in[],
+		size_t count,
+		int bytes_per_sample,
+		IntScaling scaling,
+		float samples[]) {
+		if (bytes_per_sample == 2) {
+			for (size_t i = 0; i < count; i++) {
+				int16_t value = (int16_t) (in[2 * i] | in[2 * i + 1] << 8);
+				samples[i] = scaling.offset + scaling.scale * value;
+			}
+		} else {
+			for (size_t i = 0; i < count; i++) {
+				// Assemble in the top bytes, the shift back sign extends
+				int32_t value = (int32_t) ((uint32_t) in[3 * i] << 8 |
+										   (uint32_t) in[3 * i + 1] << 16 |
+										   (uint32_t) in[3 * i + 2] << 24) >>
+					8;
+				samples[i] = scaling.offset + scaling.scale * value;
+			}
+		}
+	}
+
+	static int bytes_per_int_sample(BlockCodec codec) {
+		return codec == BlockCodec::Int16 ? 2 : 3;
+	}
+
+	size_t encode_block(
+		const BlockBuffer& block,
+		BlockCodec codec,
+		uint32_t first_record,
+		BlockHeader& header,
+		uint8_t payload[]) {
+		size_t size = 0;
+
+		memcpy(payload, block.lengths, block.record_count);
+		size += block.record_count;
+
+		size_t raw_size = sizeof(float) * block.sample_count;
+		size_t data_size = 0;
+
+		switch (codec) {
+		case BlockCodec::DeltaFloat32:
+			data_size = encode_delta(block, payload + size, raw_size);
+			break;
+		case BlockCodec::Int16:
+		case BlockCodec::Int24:
+			// NaN and infinity have no integer representation
+			if (all_finite(block.samples, block.sample_count)) {
+				IntScaling scaling = pack_ints(
+					block.samples,
+					block.sample_count,
+					bytes_per_int_sample(codec),
+					payload + size + sizeof(IntScaling));
+				memcpy(payload + size, &scaling, sizeof(scaling));
+				data_size = sizeof(scaling) +
+					bytes_per_int_sample(codec) * block.sample_count;
+			}
+			break;
+		default:
+			break;
+		}
+
+		if (data_size == 0) {
+			codec = BlockCodec::Float32;
+			memcpy(payload + size, block.samples, raw_size);
+			data_size = raw_size;
+		}
+
+		size += data_size;
+
+		seal_block(
+			header, codec, first_record, block.record_count, size, payload);
+
+		return size;
+	}
+
+	size_t encode_index(
+		const IndexBuilder& index,
+		uint32_t record_count,
+		uint32_t block_offset,
+		BlockHeader& header,
+		uint8_t payload[]) {
+		size_t size = sizeof(IndexEntry) * index.entry_count;
+		memcpy(payload, index.entries, size);
+
+		IndexTrailer trailer = { record_count, block_offset, INDEX_MAGIC };
+		memcpy(payload + size, &trailer, sizeof(trailer));
+		size += sizeof(trailer);
+
+		seal_block(header, BlockCodec::Index, record_count, 0, size, payload);
+
+		return size;
+	}
+
+	bool check_block_header(const BlockHeader& header) {
+		return header.magic == BLOCK_MAGIC &&
+			header.payload_size <= BLOCK_MAX_PAYLOAD &&
+			header.record_count <= BLOCK_MAX_RECORDS;
+	}
+
+	bool check_block_crc(const BlockHeader& header, const uint8_t payload[]) {
+		return block_crc(header, payload) == header.crc;
+	}
+
+	bool decode_block(
+		const BlockHeader& header, const uint8_t payload[], BlockBuffer& block) {
+		block.clear();
+
+		if (static_cast<BlockCodec>(header.codec) == BlockCodec::Index) {
+			return header.record_count == 0;
+		}
+
+		if (header.payload_size < header.record_count) {
+			return false;
+		}
+
+		memcpy(block.lengths, payload, header.record_count);
+
+		size_t sample_count = 0;
+		for (uint16_t i = 0; i < header.record_count; i++) {
+			sample_count += block.lengths[i];
+		}
+
+		if (sample_count > BLOCK_MAX_SAMPLES) {
+			return false;
+		}
+
+		const uint8_t* data = payload + header.record_count;
+		size_t data_size = header.payload_size - header.record_count;
+
+		switch (static_cast<BlockCodec>(header.codec)) {
+		case BlockCodec::Float32:
+			if (data_size != sizeof(float) * sample_count) {
+				return false;
+			}
+			memcpy(block.samples, data, data_size);
+			break;
+		case BlockCodec::DeltaFloat32:
+			block.record_count = header.record_count;
+			if (!decode_delta(data, data_size, block)) {
+				block.clear();
+				return false;
+			}
+			break;
+		case BlockCodec::Int16:
+		case BlockCodec::Int24: {
+			int bytes_per_sample =
+				bytes_per_int_sample(static_cast<BlockCodec>(header.codec));
+
+			if (data_size !=
+				sizeof(IntScaling) + bytes_per_sample * sample_count) {
+				return false;
+			}
+
+			IntScaling scaling;
+			memcpy(&scaling, data, sizeof(scaling));
+			unpack_ints(
+				data + sizeof(scaling),
+				sample_count,
+				bytes_per_sample,
+				scaling,
+				block.samples);
+			break;
+		}
+		default:
+			return false;
+		}
+
+		block.record_count = header.record_count;
+		block.sample_count = sample_count;
+
+		return true;
+	}
+
+	void FileValidator::expect(Part part, size_t needed) {
+		_part = part;
+		_needed = needed;
+		_collected = 0;
+	}
+
+	uint8_t* FileValidator::target() {
+		switch (_part) {
+		case Part::Start:
+		case Part::FileHeader:
+			return (uint8_t*) &_file_header;
+		case Part::RecordLength:
+			return &_record_length;
+		case Part::BlockHeader:
+			return (uint8_t*) &_block_header;
+		case Part::Payload:
+			return _payload;
+		default:
+			// Passed over without being looked at
+			return nullptr;
+		}
+	}
+
+	bool FileValidator::advance() {
+		switch (_part) {
+		case Part::Start:
+			// Version 1 starts with the length of the first record, never 0
+			if (_file_header.magic[0] != 0) {
+				_version = 1;
+				_record_length = _file_header.magic[0];
+				expect(Part::RecordSamples, sizeof(float) * _record_length);
+				return true;
+			}
+			_part = Part::FileHeader;
+			_needed = FILE_HEADER_BASE_SIZE;
+			return true;
+
+		case Part::FileHeader:
+			if (!check_file_header(_file_header) ||
+				_file_header.version != FILE_VERSION) {
+				return false;
+			}
+			_version = FILE_VERSION;
+			if (_file_header.header_size > FILE_HEADER_BASE_SIZE) {
+				expect(Part::HeaderRest, _file_header.header_size - FILE_HEADER_BASE_SIZE);
+			} else {
+				expect(Part::BlockHeader, sizeof(BlockHeader));
+			}
+			return true;
+
+		case Part::HeaderRest:
+			expect(Part::BlockHeader, sizeof(BlockHeader));
+			return true;
+
+		case Part::RecordLength:
+			if (_record_length == 0) {
+				return false;
+			}
+			expect(Part::RecordSamples, sizeof(float) * _record_length);
+			return true;
+
+		case Part::RecordSamples:
+			_record_count++;
+			expect(Part::RecordLength, 1);
+			return true;
+
+		case Part::BlockHeader:
+			// Records are numbered without gaps, the index has none
+			if (!check_block_header(_block_header) ||
+				(static_cast<BlockCodec>(_block_header.codec) != BlockCodec::Index &&
+				 _block_header.first_record != _record_count)) {
+				return false;
+			}
+			_block_offset = _offset - sizeof(BlockHeader);
+			expect(Part::Payload, _block_header.payload_size);
+			return true;
+
+		case Part::Payload: {
+			if (!check_block_crc(_block_header, _payload) ||
+				!decode_block(_block_header, _payload, _block)) {
+				return false;
+			}
+
+			if (static_cast<BlockCodec>(_block_header.codec) != BlockCodec::Index) {
+				_record_count += _block_header.record_count;
+				expect(Part::BlockHeader, sizeof(BlockHeader));
+				return true;
+			}
+
+			// The index describes the file it ends
+			IndexTrailer trailer;
+			if (_block_header.payload_size < sizeof(trailer)) {
+				return false;
+			}
+			memcpy(
+				&trailer,
+				_payload + _block_header.payload_size - sizeof(trailer),
+				sizeof(trailer));
+			if (trailer.magic != INDEX_MAGIC ||
+				trailer.record_count != _record_count ||
+				trailer.block_offset != _block_offset) {
+				return false;
+			}
+			expect(Part::End, 0);
+			return true;
+		}
+
+		default:
+			return false;
+		}
+	}
+
+	bool FileValidator::update(const uint8_t data[], size_t length) {
+		while (length > 0) {
+			if (_part == Part::End || _part == Part::Invalid) {
+				_part = Part::Invalid;
+				return false;
+			}
+
+			size_t count = std::min(length, _needed - _collected);
+			uint8_t* to = target();
+			if (to != nullptr) {
+				memcpy(to + _collected, data, count);
+			}
+
+			_collected += count;
+			_offset += count;
+			data += count;
+			length -= count;
+
+			// An empty payload is complete as soon as it starts
+			while (_part != Part::End && _collected == _needed) {
+				if (!advance()) {
+					_part = Part::Invalid;
+					return false;
+				}
+			}
+		}
+
+		return _part != Part::Invalid;
+	}
+
+	bool FileValidator::is_complete() const {
+		switch (_part) {
+		case Part::RecordLength:
+			return _collected == 0;
+		case Part::BlockHeader:
+			// Cut short recordings have no index
+			return _collected == 0;
+		case Part::End:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	uint8_t FileValidator::get_version() const {
+		return _version;
+	}
+
+	uint32_t FileValidator::get_record_count() const {
+		return _record_count;
+	}
+}  // namespace recording_format
@@ -0,0 +1,64 @@
+#include "recordingTranscoder.h"
+
+#include <Arduino.h>
+
+// Recordings looked at per directory scan
+constexpr size_t TRANSCODER_BATCH_SIZE = 16;
+
+RecordingTranscoder::RecordingTranscoder(std::shared_ptr<Storage> storage)
+	: _storage(storage) {}
+
+RecordingTranscoder::~RecordingTranscoder() {}
+
+const ConversionStats& RecordingTranscoder::get_stats() const {
+	return _stats;
+}
+
+void RecordingTranscoder::run_pass() {
+	std::string cursor = _storage->load_conversion_cursor();
+	uint32_t converted = _stats.files;
+
+	log_i("converting recordings after '%s'", cursor.data());
+
+	while (true) {
+		auto names =
+			_storage->list_recording_names(cursor.data(), TRANSCODER_BATCH_SIZE);
+
+		if (names.empty()) {
+			break;
+		}
+
+		for (auto& name : names) {
+			_storage->yield_to_writer();
+
+			if (_storage->convert_recording(name.data(), _stats)) {
+				_storage->save_conversion_cursor(name.data());
+			}
+
+			cursor = name;
+		}
+
+		_storage->save_conversion_cursor(cursor.data());
+	}
+
+	if (_stats.files != converted) {
+		log_i(
+			"converted %u recordings: %u -> %u bytes in %u ms (%u KB/s)",
+			_stats.files,
+			_stats.bytes_in,
+			_stats.bytes_out,
+			_stats.duration_ms,
+			_stats.duration_ms ? _stats.bytes_in / _stats.duration_ms : 0);
+	}
+}
+
+void RecordingTranscoder::loop() {
+	// Let the other tasks come up first
+	delay(10000);
+
+	run_pass();
+
+	while (true) {
+		delay(1000);
+	}
+}
@@ -0,0 +1,121 @@
+#include "responsePool.h"
+
+#include <cstddef>
+#include <new>
+
+#include <Arduino.h>
+
+#include "metrics.h"
+
+ResponsePool response_pool;
+
+// In front of every block, keeps the object behind it aligned like
+// operator new does
+union ResponsePool::BlockHeader {
+	size_t size;
+	std::max_align_t align;
+};
+
+static size_t round_to_step(size_t size) {
+	return (size + RESPONSE_POOL_STEP - 1) / RESPONSE_POOL_STEP * RESPONSE_POOL_STEP;
+}
+
+void ResponsePool::count_kept_bytes() {
+	metrics.http_pool_kept_bytes.store(_kept_bytes, std::memory_order_relaxed);
+}
+
+// A kept block of the rounded size, or nullptr
+void* ResponsePool::take_kept(size_t size) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	for (size_t i = 0; i < _kept_count; i++) {
+		BlockHeader* header = _kept[i];
+
+		if (header->size == size) {
+			_kept[i] = _kept[--_kept_count];
+			_kept_bytes -= size;
+			count_kept_bytes();
+			metrics.http_pool_reuses.fetch_add(1, std::memory_order_relaxed);
+
+			return header + 1;
+		}
+	}
+
+	return nullptr;
+}
+
+void* ResponsePool::allocate(size_t size) {
+	size = round_to_step(size);
+
+	void* block = take_kept(size);
+	if (block != nullptr) {
+		return block;
+	}
+
+	BlockHeader* header =
+		static_cast<BlockHeader*>(::operator new(sizeof(BlockHeader) + size));
+	header->size = size;
+	metrics.http_pool_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	return header + 1;
+}
+
+void* ResponsePool::allocate(size_t size, const std::nothrow_t&) noexcept {
+	size = round_to_step(size);
+
+	void* block = take_kept(size);
+	if (block != nullptr) {
+		return block;
+	}
+
+	BlockHeader* header = static_cast<BlockHeader*>(
+		::operator new(sizeof(BlockHeader) + size, std::nothrow));
+	if (header == nullptr) {
+		log_w("no memory for a response of %u bytes", (unsigned) size);
+		return nullptr;
+	}
+	header->size = size;
+	metrics.http_pool_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	return header + 1;
+}
+
+void ResponsePool::release(void* block) {
+	if (block == nullptr) {
+		return;
+	}
+
+	BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_kept_count < RESPONSE_POOL_SLOTS &&
+			_kept_bytes + header->size <= RESPONSE_POOL_MAX_BYTES) {
+			_kept[_kept_count++] = header;
+			_kept_bytes += header->size;
+			count_kept_bytes();
+			return;
+		}
+	}
+
+	::operator delete(header);
+}
+
+void ResponsePool::trim() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_kept_count == 0) {
+		return;
+	}
+
+	log_d("returning %u bytes of responses to the heap", (unsigned) _kept_bytes);
+
+	for (size_t i = 0; i < _kept_count; i++) {
+		::operator delete(_kept[i]);
+	}
+
+	_kept_count = 0;
+	_kept_bytes = 0;
+	count_kept_bytes();
+}
@@ -0,0 +1,90 @@
+#include "sha1.h"
+
+#include <string.h>
+
+static uint32_t rotate_left(uint32_t value, uint8_t count) {
+	return (value << count) | (value >> (32 - count));
+}
+
+static void sha1_block(uint32_t state[5], const uint8_t block[64]) {
+	uint32_t w[80];
+
+	for (int i = 0; i < 16; i++) {
+		w[i] = (uint32_t) block[4 * i] << 24 | (uint32_t) block[4 * i + 1] << 16 |
+			(uint32_t) block[4 * i + 2] << 8 | block[4 * i + 3];
+	}
+	for (int i = 16; i < 80; i++) {
+		w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	}
+
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t e = state[4];
+
+	for (int i = 0; i < 80; i++) {
+		uint32_t f, k;
+
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+
+		uint32_t t = rotate_left(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = rotate_left(b, 30);
+		b = a;
+		a = t;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+void sha1(const void* data, size_t length, uint8_t digest[SHA1_DIGEST_SIZE]) {
+	uint32_t state[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+	};
+	const uint8_t* bytes = (const uint8_t*) data;
+	size_t remaining = length;
+
+	for (; remaining >= 64; remaining -= 64, bytes += 64) {
+		sha1_block(state, bytes);
+	}
+
+	// Padding, a 1 bit, zeros and the length in bits, over one or two blocks
+	uint8_t tail[128] = {};
+	memcpy(tail, bytes, remaining);
+	tail[remaining] = 0x80;
+
+	size_t tail_length = remaining < 56 ? 64 : 128;
+	uint64_t bits = (uint64_t) length * 8;
+	for (int i = 0; i < 8; i++) {
+		tail[tail_length - 1 - i] = bits >> (8 * i);
+	}
+
+	for (size_t offset = 0; offset < tail_length; offset += 64) {
+		sha1_block(state, tail + offset);
+	}
+
+	for (int i = 0; i < 5; i++) {
+		digest[4 * i] = state[i] >> 24;
+		digest[4 * i + 1] = state[i] >> 16;
+		digest[4 * i + 2] = state[i] >> 8;
+		digest[4 * i + 3] = state[i];
+	}
+}
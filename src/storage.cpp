@@ -1,9 +1,38 @@
 #include "storage.h"
 
+#include <algorithm>
+
 #include <Arduino.h>
+#include <esp_system.h>
 #include <freertos/FreeRTOS.h>
 
+#include "crc32.h"
 #include "ecg_isd_config.h"
+#include "metrics.h"
+#include "responsePool.h"
+
+// Writer, readers and the web server each need their own handle
+constexpr uint8_t STORAGE_MAX_OPEN_FILES = 8;
+
+// Recordings per bucket directory, FAT looks up names linearly
+constexpr int STORAGE_BUCKET_SIZE = 100;
+constexpr int STORAGE_MAX_RECORDINGS = 100000;
+
+// Kept free below the quota for the last block and index of open recordings
+constexpr uint64_t STORAGE_QUOTA_RESERVE = 64 * 1024;
+
+// Share of the quota in percent from which usage is reported as such
+constexpr uint64_t STORAGE_WARNING_PERCENT = 90;
+constexpr uint64_t STORAGE_CRITICAL_PERCENT = 97;
+
+// Largest piece read while holding the bus, so the writer never waits long
+constexpr size_t STORAGE_READ_CHUNK = 4096;
+// Block headers or record lengths a seek reads before it lets the writer
+// have the bus
+constexpr uint32_t STORAGE_SEEK_STEP = 32;
+// Uploads are written in pieces of this size, whole sectors the card takes
+// in one multi-block write
+constexpr size_t STORAGE_WRITE_CHUNK = 4096;
 
 const char* storage_error_to_str(StorageError error) {
 	switch (error) {
@@ -24,6 +53,21 @@ const char* storage_error_to_str(StorageError error) {
 	return "<Error>";
 }
 
+const char* storage_usage_level_to_str(StorageUsageLevel level) {
+	switch (level) {
+	case StorageUsageLevel::Normal:
+		return "Normal";
+	case StorageUsageLevel::Warning:
+		return "Warning";
+	case StorageUsageLevel::Critical:
+		return "Critical";
+	case StorageUsageLevel::Full:
+		return "Full";
+	}
+
+	return "<Level>";
+}
+
 const char* storage_state_to_str(StorageState state) {
 	switch (state) {
 	case StorageState::Idle:
@@ -32,8 +76,6 @@ const char* storage_state_to_str(StorageState state) {
 		return "Error";
 	case StorageState::Recording:
 		return "Recording";
-	case StorageState::Reading:
-		return "Reading";
 	}
 
 	return "<State>";
@@ -48,42 +90,188 @@ const char* storage_state_to_str(StorageState state) {
 		return RETURN_VALUE; \
 	}
 
+#define STORAGE_CHECK_NO_ERROR(CURRENT_STATE, RETURN_VALUE) \
+	if (CURRENT_STATE == StorageState::Error) { \
+		log_e("ERROR: in %s state", storage_state_to_str(CURRENT_STATE)); \
+		return RETURN_VALUE; \
+	}
+
+// Older cores return the full path as the name of a directory entry
+static const char* entry_file_name(File& entry) {
+	const char* name = entry.name();
+	const char* slash = strrchr(name, '/');
+
+	return slash ? slash + 1 : name;
+}
+
+static bool has_extension(const char* name, const char* extension) {
+	size_t name_len = strlen(name);
+	size_t extension_len = strlen(extension);
+
+	return name_len > extension_len &&
+		strcasecmp(name + name_len - extension_len, extension) == 0;
+}
+
+// Calls callback(entry, file_name) for every entry of a directory, returns
+// false if the directory can not be opened
+template<typename Callback>
+static bool for_each_entry(const char* path, Callback callback) {
+	File dir = SD.open(path);
+
+	if (!dir) {
+		return false;
+	}
+
+	File entry = dir.openNextFile();
+
+	while (entry) {
+		callback(entry, entry_file_name(entry));
+
+		entry.close();
+		entry = dir.openNextFile();
+	}
+
+	dir.close();
+
+	return true;
+}
+
+// Index of a recording named by create_new_recording(), -1 for other names
+static int parse_recording_index(const char* name, size_t length) {
+	if (length != 5) {
+		return -1;
+	}
+
+	int index = 0;
+
+	for (size_t i = 0; i < length; i++) {
+		if (name[i] < '0' || name[i] > '9') {
+			return -1;
+		}
+		index = index * 10 + (name[i] - '0');
+	}
+
+	return index;
+}
+
+static int parse_recording_index(const char* name) {
+	return parse_recording_index(name, strlen(name));
+}
+
+// Three digit name of a bucket directory
+static int parse_bucket(const char* name) {
+	if (strlen(name) != 3) {
+		return -1;
+	}
+
+	int bucket = 0;
+
+	for (int i = 0; i < 3; i++) {
+		if (name[i] < '0' || name[i] > '9') {
+			return -1;
+		}
+		bucket = bucket * 10 + (name[i] - '0');
+	}
+
+	return bucket;
+}
+
+static std::string build_bucket_path(int bucket) {
+	// Room for any int, a bucket never has more than 3 digits
+	char path[24];
+	snprintf(path, sizeof(path), "/recordings/%03d", bucket);
+	return path;
+}
+
+static std::string build_flat_path(
+	const char* name, const char* extension = ".rec") {
+	std::string path = "/recordings/";
+	path += name;
+	path += extension;
+	return path;
+}
+
+// Recordings live in buckets of STORAGE_BUCKET_SIZE, /recordings/001/00123.rec
+static std::string build_recording_path(const char* name) {
+	int index = parse_recording_index(name);
+
+	if (index < 0) {
+		return build_flat_path(name);
+	}
+
+	std::string path = build_bucket_path(index / STORAGE_BUCKET_SIZE);
+	path += '/';
+	path += name;
+	path += ".rec";
+	return path;
+}
+
+// The same without the heap, in the bucket or the flat layout. False if the
+// path does not fit.
+static bool format_recording_path(
+	char (&path)[STORAGE_PATH_SIZE], const char* name, bool flat) {
+	int index = parse_recording_index(name);
+	int length = flat || index < 0
+		? snprintf(path, sizeof(path), "/recordings/%s.rec", name)
+		: snprintf(
+			  path, sizeof(path), "/recordings/%03d/%s.rec",
+			  index / STORAGE_BUCKET_SIZE, name);
+
+	return length > 0 && (size_t) length < sizeof(path);
+}
+
+// Bucket a recording path is in, -1 for the top level
+static int parse_path_bucket(const std::string& path) {
+	size_t start = sizeof("/recordings/") - 1;
+
+	if (path.size() > start + 4 && path[start + 3] == '/') {
+		return parse_bucket(path.substr(start, 3).data());
+	}
+
+	return -1;
+}
+
+static bool name_less(const char* a, const char* b) {
+	return strcmp(a, b) < 0;
+}
+
+static bool name_greater(const char* a, const char* b) {
+	return strcmp(a, b) > 0;
+}
+
+// Keeps the max recordings that come first in the given order after the
+// given name sorted in recordings, nullptr for no name
+template <typename Order>
+static void insert_bounded(
+	std::vector<StorageEntry>& recordings,
+	StorageEntry entry,
+	const char* after,
+	size_t max,
+	Order order) {
+	if ((after != nullptr && !order(after, entry.get_name())) ||
+		(recordings.size() >= max &&
+		 !order(entry.get_name(), recordings.back().get_name()))) {
+		return;
+	}
+
+	recordings.insert(
+		std::upper_bound(
+			recordings.begin(), recordings.end(), entry,
+			[&](const StorageEntry& a, const StorageEntry& b) {
+				return order(a.get_name(), b.get_name());
+			}),
+		std::move(entry));
+
+	if (recordings.size() > max) {
+		recordings.pop_back();
+	}
+}
+
 Storage::Storage(SPIClass& spi, std::mutex& spi_mutex)
 	: _spi(spi), _spi_mutex(spi_mutex) {
 	if (!init()) {
 		log_e("First init failed");
 	}
-
-	// float data[9] = { 0.0, 1.0, 2.0 };
-	// for (int i = 0; i < 3; i++) {
-	// 	if (create_new_recording()) {
-	// 		for (int j = 0; j < i + 1; j++) {
-	// 			write_record(data, 3);
-	// 		}
-	// 		close_recording();
-	// 	}
-	// }
-	//
-	// Serial.println("List recs:");
-	// for (auto& rec : list_recordings()) {
-	// 	Serial.printf("- %s (%d)\n", rec.get_name(), rec.get_size());
-	// 	remove_recording(rec.get_name());
-	// 	if (open_recording(rec.get_name())) {
-	// 		int len;
-	// 		do {
-	// 			len = read_record(data, 9);
-	//
-	// 			for (int i = 0; i < len; i++) {
-	// 				Serial.printf("%f;", data[i]);
-	// 			}
-	//
-	// 			if (len > 0) {
-	// 				Serial.println();
-	// 			}
-	// 		} while (len >= 1);
-	// 		close_recording();
-	// 	}
-	// }
 }
 
 Storage::~Storage() {}
@@ -91,7 +279,7 @@ Storage::~Storage() {}
 bool Storage::init() {
 	std::lock_guard<std::mutex> lock(_spi_mutex);
 
-	if (!SD.begin(SD_CS, _spi)) {
+	if (!SD.begin(SD_CS, _spi, 4000000, "/sd", STORAGE_MAX_OPEN_FILES)) {
 		log_e("begin error");
 		set_error(StorageError::CanNotInitialize);
 
@@ -107,11 +295,141 @@ bool Storage::init() {
 		}
 	}
 
+	if (!scan_locked()) {
+		log_e("can not read /recordings dir");
+		set_error(StorageError::FileSystemError);
+
+		return false;
+	}
+
+	// Walks the whole allocation table, only done once per mount
+	[[maybe_unused]] uint32_t start = millis();
+	_total_bytes = SD.totalBytes();
+	_used_bytes = SD.usedBytes();
+	log_i(
+		"card usage: %llu of %llu bytes, computed in %u ms",
+		_used_bytes.load(),
+		_total_bytes.load(),
+		millis() - start);
+
+	load_quota_locked();
+
+	// A catalog cached before a reboot or card change must not match
+	_catalog_generation.store(esp_random(), std::memory_order_relaxed);
+
 	_state = StorageState::Idle;
 
 	return true;
 }
 
+bool Storage::scan_locked() {
+	// Only the top level and the newest bucket are read, so mounting stays
+	// fast however many recordings there are
+	std::vector<std::string> tmp_names;
+	std::vector<std::string> part_names;
+	int max_index = -1;
+
+	_max_bucket = -1;
+	_flat_recordings = 0;
+	_recording_count = -1;
+
+	bool scanned = for_each_entry("/recordings", [&](File& entry, const char* name) {
+		if (entry.isDirectory()) {
+			_max_bucket = std::max(_max_bucket, parse_bucket(name));
+		} else if (has_extension(name, ".rec")) {
+			_flat_recordings++;
+			max_index = std::max(
+				max_index, parse_recording_index(name, strlen(name) - 4));
+		} else if (has_extension(name, ".tmp")) {
+			tmp_names.emplace_back(name, strlen(name) - 4);
+		} else if (has_extension(name, ".part")) {
+			part_names.emplace_back(name);
+		}
+	});
+
+	if (!scanned) {
+		return false;
+	}
+
+	if (_max_bucket >= 0) {
+		for_each_entry(
+			build_bucket_path(_max_bucket).data(),
+			[&](File& entry, const char* name) {
+				if (!entry.isDirectory() && has_extension(name, ".rec")) {
+					max_index = std::max(
+						max_index,
+						parse_recording_index(name, strlen(name) - 4));
+				}
+			});
+	}
+
+	_next_file_index = max_index + 1;
+
+	log_i(
+		"%u flat recordings, newest bucket: %d, next recording: %05d",
+		_flat_recordings,
+		_max_bucket,
+		_next_file_index);
+
+	for (auto& name : tmp_names) {
+		auto tmp_path = build_flat_path(name.data(), ".tmp");
+
+		// The original is only removed once the converted file is complete
+		if (!find_recording_path_locked(name.data()).empty()) {
+			log_w("discarding interrupted conversion of %s", name.data());
+			SD.remove(tmp_path.data());
+		} else if (make_bucket_locked(name.data())) {
+			log_w("finishing interrupted conversion of %s", name.data());
+			SD.rename(tmp_path.data(), build_recording_path(name.data()).data());
+		}
+	}
+
+	// Uploads are only moved in place once complete
+	for (auto& name : part_names) {
+		log_w("discarding interrupted upload %s", name.data());
+		SD.remove(("/recordings/" + name).data());
+	}
+
+	return true;
+}
+
+std::string Storage::find_recording_path_locked(const char* name) const {
+	char path[STORAGE_PATH_SIZE];
+
+	return find_recording_path_locked(name, path) ? path : "";
+}
+
+bool Storage::find_recording_path_locked(
+	const char* name, char (&path)[STORAGE_PATH_SIZE]) const {
+	if (format_recording_path(path, name, false) && SD.exists(path)) {
+		return true;
+	}
+
+	// Recordings from before the bucket layout, skipped once there are none
+	return _flat_recordings > 0 && parse_recording_index(name) >= 0 &&
+		format_recording_path(path, name, true) && SD.exists(path);
+}
+
+bool Storage::make_bucket_locked(const char* name) {
+	int index = parse_recording_index(name);
+
+	if (index < 0) {
+		return true;
+	}
+
+	int bucket = index / STORAGE_BUCKET_SIZE;
+	auto path = build_bucket_path(bucket);
+
+	if (!SD.exists(path.data()) && !SD.mkdir(path.data())) {
+		log_e("mkdir %s error", path.data());
+		return false;
+	}
+
+	_max_bucket = std::max(_max_bucket, bucket);
+
+	return true;
+}
+
 void Storage::set_error(StorageError error) {
 	log_e("%s", storage_error_to_str(error));
 	_state = StorageState::Error;
@@ -133,97 +451,271 @@ bool Storage::clear_error() {
 	return true;
 }
 
-std::vector<StorageEntry> Storage::list_recordings() {
-	STORAGE_CHECK_STATE(_state, StorageState::Idle, {});
+bool Storage::list_recordings(
+	std::vector<StorageEntry>& recordings, const char* after, size_t max) {
+	recordings.clear();
+
+	STORAGE_CHECK_NO_ERROR(_state, false);
+
+	// Keeps only the max smallest names, memory stays bounded however many
+	// recordings there are
+	auto add_recording = [&](File& entry, const char* name) {
+		if (!entry.isDirectory() && has_extension(name, ".rec")) {
+			insert_bounded(
+				recordings,
+				StorageEntry(std::string(name, strlen(name) - 4), entry.size()),
+				after,
+				max,
+				name_less);
+		}
+	};
 
-	std::lock_guard<std::mutex> lock(_spi_mutex);
+	{
+		std::lock_guard<std::mutex> lock(_spi_mutex);
 
-	File dir = SD.open("/recordings");
+		if (_flat_recordings > 0 && !for_each_entry("/recordings", add_recording)) {
+			log_e("Can not open /recordings dir");
+			set_error(StorageError::CanNotOpenFile);
+			recordings.clear();
+			return false;
+		}
+	}
 
-	if (!dir) {
-		log_e("Can not open /recordings dir");
-		set_error(StorageError::CanNotOpenFile);
-		return {};
+	// Buckets sort like the names in them, only the ones that can still
+	// contribute are read, one at a time with the bus released in between
+	int after_index = parse_recording_index(after);
+	int first_bucket = after_index < 0 ? 0 : after_index / STORAGE_BUCKET_SIZE;
+
+	for (int bucket = first_bucket;; bucket++) {
+		yield_to_writer();
+		std::lock_guard<std::mutex> lock(_spi_mutex);
+
+		if (bucket > _max_bucket ||
+			(recordings.size() >= max &&
+			 parse_recording_index(recordings.back().get_name()) <
+				 bucket * STORAGE_BUCKET_SIZE)) {
+			break;
+		}
+
+		for_each_entry(build_bucket_path(bucket).data(), add_recording);
 	}
 
-	File entry = dir.openNextFile();
+	return true;
+}
+
+bool Storage::list_recordings_before(
+	std::vector<StorageEntry>& recordings, const char* before, size_t max) {
+	recordings.clear();
+
+	STORAGE_CHECK_NO_ERROR(_state, false);
+
+	// Keeps only the max largest names
+	auto add_recording = [&](File& entry, const char* name) {
+		if (!entry.isDirectory() && has_extension(name, ".rec")) {
+			insert_bounded(
+				recordings,
+				StorageEntry(std::string(name, strlen(name) - 4), entry.size()),
+				before,
+				max,
+				name_greater);
+		}
+	};
+
+	int bucket;
+
+	{
+		std::lock_guard<std::mutex> lock(_spi_mutex);
+
+		if (_flat_recordings > 0 && !for_each_entry("/recordings", add_recording)) {
+			log_e("Can not open /recordings dir");
+			set_error(StorageError::CanNotOpenFile);
+			recordings.clear();
+			return false;
+		}
+
+		int before_index = before == nullptr ? -1 : parse_recording_index(before);
+		bucket = before_index < 0
+			? _max_bucket
+			: std::min(before_index / STORAGE_BUCKET_SIZE, _max_bucket);
+	}
+
+	// Down from the bucket of the given name until the ones left only hold
+	// smaller names than the page already has
+	for (; bucket >= 0; bucket--) {
+		yield_to_writer();
+		std::lock_guard<std::mutex> lock(_spi_mutex);
+
+		if (recordings.size() >= max &&
+			parse_recording_index(recordings.back().get_name()) >=
+				(bucket + 1) * STORAGE_BUCKET_SIZE) {
+			break;
+		}
+
+		for_each_entry(build_bucket_path(bucket).data(), add_recording);
+	}
+
+	return true;
+}
+
+std::vector<std::string> Storage::list_recording_names(
+	const char* after, size_t max) {
 	std::vector<StorageEntry> recordings;
+	std::vector<std::string> names;
 
-	while (entry) {
-		if (!entry.isDirectory()) {
-			const char* entry_name = entry.name();
-			log_d("checking entry path: %s", entry_name);
-
-			if (strncmp(entry_name, "/recordings/", 12) == 0) {
-				entry_name += 12;
-				log_d("checking entry file name: %s", entry_name);
-
-				int entry_name_len = strlen(entry_name);
-				if ((entry_name_len >= 4) &&
-					(0 ==
-					 strcasecmp(entry_name + entry_name_len - 4, ".rec"))) {
-					std::string recording_name(entry_name, entry_name_len - 4);
-					log_d("found recording: %s", recording_name.data());
-					recordings.emplace_back(
-						StorageEntry(std::move(recording_name), entry.size()));
-				}
-			}
+	if (list_recordings(recordings, after, max)) {
+		names.reserve(recordings.size());
+		for (auto& recording : recordings) {
+			names.push_back(std::move(recording._name));
 		}
+	}
 
-		entry.close();
-		entry = dir.openNextFile();
+	return names;
+}
+
+size_t Storage::get_recording_count() {
+	STORAGE_CHECK_NO_ERROR(_state, 0);
+
+	// One count at a time, a second caller gets its result
+	std::lock_guard<std::mutex> count_lock(_count_mutex);
+
+	{
+		std::lock_guard<std::mutex> lock(_spi_mutex);
+
+		if (_recording_count >= 0) {
+			return _recording_count;
+		}
+
+		// The top level is counted at mount
+		_counting = true;
+		_counted_bucket = -1;
+		_counted_recordings = _flat_recordings;
 	}
 
-	dir.close();
+	// One directory at a time, the recording writer gets the bus in between
+	for (int bucket = 0;; bucket++) {
+		yield_to_writer();
+		std::lock_guard<std::mutex> lock(_spi_mutex);
+
+		if (bucket > _max_bucket) {
+			_recording_count = _counted_recordings;
+			_counting = false;
+			return _recording_count;
+		}
 
-	return recordings;
+		for_each_entry(
+			build_bucket_path(bucket).data(), [&](File& entry, const char* name) {
+				if (!entry.isDirectory() && has_extension(name, ".rec")) {
+					_counted_recordings++;
+				}
+			});
+		_counted_bucket = bucket;
+	}
 }
 
-static std::string build_recording_path(const char* name) {
-	std::string path = "/recordings/";
-	path += name;
-	path += ".rec";
-	return path;
+void Storage::count_recording_locked(const std::string& path, int change) {
+	if (_recording_count >= 0) {
+		_recording_count += change;
+	} else if (_counting && parse_path_bucket(path) <= _counted_bucket) {
+		_counted_recordings += change;
+	}
+}
+
+bool Storage::is_in_use_locked(const char* name) const {
+	if ((_state == StorageState::Recording && _current_recording_name == name) ||
+		_upload_name == name) {
+		return true;
+	}
+
+	for (auto reader : _readers) {
+		if (strcmp(reader->_name, name) == 0) {
+			return true;
+		}
+	}
+
+	return false;
 }
 
 bool Storage::remove_recording(const char* name) {
-	STORAGE_CHECK_STATE(_state, StorageState::Idle, false);
+	size_t size;
+
+	return remove_recording(name, size);
+}
+
+bool Storage::remove_recording(const char* name, size_t& size) {
+	size = 0;
+
+	STORAGE_CHECK_NO_ERROR(_state, false);
 
 	std::lock_guard<std::mutex> lock(_spi_mutex);
 
-	auto path = build_recording_path(name);
+	if (is_in_use_locked(name)) {
+		log_w("recording is in use: %s", name);
+		return false;
+	}
+
+	// Freeing the clusters of a long recording holds the bus the longest
+	uint32_t start = micros();
+	auto path = find_recording_path_locked(name);
+
+	if (!path.empty()) {
+		File file = SD.open(path.data());
+		size = file ? file.size() : 0;
+		file.close();
 
-	if (SD.exists(path.data())) {
 		if (!SD.remove(path.data())) {
 			log_e("can't remove file: %s", path.data());
 			set_error(StorageError::CanNotRemoveFile);
+			size = 0;
 
 			return false;
 		}
 
+		metrics.card_remove.observe(micros() - start);
+		metrics.recordings_removed.fetch_add(1, std::memory_order_relaxed);
+
+		if (path == build_flat_path(name) && _flat_recordings > 0) {
+			_flat_recordings--;
+		}
+
+		count_recording_locked(path, -1);
+		account_locked(-(int64_t) size);
+
 		return true;
 	}
 
 	return false;
 }
 
-const char* Storage::create_new_recording() {
+const char* Storage::create_new_recording(recording_format::BlockCodec codec) {
 	STORAGE_CHECK_STATE(_state, StorageState::Idle, nullptr);
 
 	std::lock_guard<std::mutex> lock(_spi_mutex);
 
-	char recording_name[6];
-	char recording_path[22];
+	if (get_usage().level == StorageUsageLevel::Full) {
+		log_e("storage quota reached, not starting a recording");
+		return nullptr;
+	}
+
+	// Room for any int, the names never have more than 5 digits
+	char recording_name[12];
+	std::string recording_path;
 	bool new_file_found = false;
 
-	for (int i = _last_file_index; i < 10000; i++) {
-		snprintf(recording_name, 6, "%05d", i);
-		snprintf(recording_path, 22, "/recordings/%s.rec", recording_name);
-		log_d("checking file path: %s", recording_path);
+	// The next index is known from the mount, normally the first try is free
+	for (int i = _next_file_index; i < STORAGE_MAX_RECORDINGS; i++) {
+		snprintf(recording_name, sizeof(recording_name), "%05d", i);
+		log_d("checking recording: %s", recording_name);
 
-		if (!SD.exists(recording_path)) {
-			log_d("file doesn't exist %s", recording_path);
+		if (_upload_name != recording_name &&
+			find_recording_path_locked(recording_name).empty()) {
+			if (!make_bucket_locked(recording_name)) {
+				set_error(StorageError::FileSystemError);
+				return nullptr;
+			}
+
+			recording_path = build_recording_path(recording_name);
 			_current_recording_name = recording_name;
+			_next_file_index = i + 1;
 			new_file_found = true;
 			break;
 		}
@@ -235,22 +727,45 @@ const char* Storage::create_new_recording() {
 		return nullptr;
 	}
 
-	log_i("opening: %s", recording_path);
-	_current_file = SD.open(recording_path, FILE_WRITE);
+	log_i("opening: %s", recording_path.data());
+	File file = SD.open(recording_path.data(), FILE_WRITE);
 
-	if (!_current_file) {
-		log_e("can not open file: %s", recording_path);
+	if (!file) {
+		log_e("can not open file: %s", recording_path.data());
 		set_error(StorageError::CanNotOpenFile);
 		return nullptr;
 	}
 
+	if (!_writer.begin(file, codec)) {
+		set_error(StorageError::FileSystemError);
+		return nullptr;
+	}
+
+	_live = std::make_shared<LiveRecording>();
+	_accounted_size = 0;
 	_state = StorageState::Recording;
+	count_recording_locked(recording_path, 1);
+
+	publish_locked();
 
 	log_i("created new recording: %s", recording_name);
 
 	return _current_recording_name.data();
 }
 
+void Storage::lock_for_writer(std::unique_lock<std::mutex>& lock) {
+	// Background work checks this between its steps and stays off the bus
+	_writer_waiting.store(true, std::memory_order_relaxed);
+	lock.lock();
+	_writer_waiting.store(false, std::memory_order_relaxed);
+}
+
+void Storage::yield_to_writer() {
+	while (_writer_waiting.load(std::memory_order_relaxed)) {
+		delay(1);
+	}
+}
+
 bool Storage::write_record(const float data[], uint8_t length) {
 	STORAGE_CHECK_STATE(_state, StorageState::Recording, false);
 
@@ -259,61 +774,860 @@ bool Storage::write_record(const float data[], uint8_t length) {
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(_spi_mutex);
+	std::unique_lock<std::mutex> lock(_spi_mutex, std::defer_lock);
+	lock_for_writer(lock);
 
-	if (!_current_file.write(length)) {
-		log_e("couldn't write length to file");
-		set_error(StorageError::FileSystemError);
+	// The reserve below the quota still takes the last block and the index
+	if (_reported_level == StorageUsageLevel::Full) {
+		log_w("storage quota reached, closing recording");
+		metrics.records_dropped.fetch_add(1, std::memory_order_relaxed);
+		close_recording_locked();
 		return false;
 	}
 
-	if (!_current_file.write((const uint8_t*) data, sizeof(float) * length)) {
-		log_e("couldn't write data to file");
+	size_t written_size = _writer.get_written_size();
+
+	if (!_writer.append(data, length)) {
+		metrics.records_dropped.fetch_add(1, std::memory_order_relaxed);
 		set_error(StorageError::FileSystemError);
 		return false;
 	}
 
+	metrics.records_stored.fetch_add(1, std::memory_order_relaxed);
+
+	if (_writer.get_written_size() != written_size) {
+		publish_locked();
+	}
+
 	return true;
 }
 
-bool Storage::open_recording(const char* name) {
-	STORAGE_CHECK_STATE(_state, StorageState::Idle, false);
+void Storage::publish_locked() {
+	_writer.sync();
 
-	std::lock_guard<std::mutex> lock(_spi_mutex);
+	// Publish only after the flush, the directory entry of the file carries
+	// the size another handle sees when it is opened
+	_live->committed_records.store(
+		_writer.get_written_records(), std::memory_order_release);
+	_live->committed_size.store(
+		_writer.get_written_size(), std::memory_order_release);
+
+	account_locked(_writer.get_written_size() - _accounted_size);
+	_accounted_size = _writer.get_written_size();
+}
 
-	auto path = build_recording_path(name);
+void Storage::account_locked(int64_t bytes) {
+	// Every change of a recording or the quota passes through here
+	_catalog_generation.fetch_add(1, std::memory_order_relaxed);
 
-	if (SD.exists(path.data())) {
-		if ((_current_file = SD.open(path.data()))) {
-			_state = StorageState::Reading;
+	uint64_t used = _used_bytes.load(std::memory_order_relaxed);
+	_used_bytes.store(
+		bytes < 0 && (uint64_t) -bytes > used ? 0 : used + bytes,
+		std::memory_order_relaxed);
 
-			return true;
-		} else {
-			log_e("can not open recording: %s", path.data());
+	StorageUsageLevel level = get_usage().level;
+
+	if (level != _reported_level) {
+		if (level > _reported_level) {
+			log_w("storage usage: %s", storage_usage_level_to_str(level));
 		}
+		_reported_level = level;
+	}
+}
+
+uint32_t Storage::get_catalog_generation() const {
+	return _catalog_generation.load(std::memory_order_relaxed);
+}
+
+StorageUsage Storage::get_usage() const {
+	StorageUsage usage;
+	usage.total_bytes = _total_bytes.load(std::memory_order_relaxed);
+	usage.used_bytes = _used_bytes.load(std::memory_order_relaxed);
+	usage.quota_bytes = _quota_bytes.load(std::memory_order_relaxed);
+
+	if (usage.quota_bytes == 0 || usage.quota_bytes > usage.total_bytes) {
+		usage.quota_bytes = usage.total_bytes;
+	}
+
+	uint64_t limit = usage.quota_bytes > STORAGE_QUOTA_RESERVE
+		? usage.quota_bytes - STORAGE_QUOTA_RESERVE
+		: 0;
+	usage.free_bytes =
+		usage.used_bytes < limit ? limit - usage.used_bytes : 0;
+
+	if (usage.free_bytes == 0) {
+		usage.level = StorageUsageLevel::Full;
+	} else if (
+		usage.used_bytes * 100 >= usage.quota_bytes * STORAGE_CRITICAL_PERCENT) {
+		usage.level = StorageUsageLevel::Critical;
+	} else if (
+		usage.used_bytes * 100 >= usage.quota_bytes * STORAGE_WARNING_PERCENT) {
+		usage.level = StorageUsageLevel::Warning;
 	} else {
-		log_e("no such recording: %s", path.data());
+		usage.level = StorageUsageLevel::Normal;
 	}
 
-	return false;
+	return usage;
 }
 
-int Storage::read_record(float data[], uint8_t length) {
-	STORAGE_CHECK_STATE(_state, StorageState::Reading, 0);
+bool Storage::set_quota(uint64_t bytes) {
+	_quota_bytes.store(bytes, std::memory_order_relaxed);
 
 	std::lock_guard<std::mutex> lock(_spi_mutex);
+	account_locked(0);
 
-	int data_length;
-
-	if ((data_length = _current_file.peek()) == -1) {
-		// log_d("can't read length, assuming end of file");
+	File file = SD.open("/recordings/.quota", FILE_WRITE);
 
-		return 0;
+	if (!file) {
+		log_e("can not save quota");
+		return false;
 	}
 
-	// log_d("reading %d floats", data_length);
+	char text[24];
+	int length =
+		snprintf(text, sizeof(text), "%llu", (unsigned long long) bytes);
+	file.write((const uint8_t*) text, length);
+	file.close();
 
-	if (data_length >= length) {
+	return true;
+}
+
+void Storage::load_quota_locked() {
+	File file = SD.open("/recordings/.quota");
+
+	if (!file) {
+		return;
+	}
+
+	char text[24];
+	size_t length = file.read((uint8_t*) text, sizeof(text) - 1);
+	file.close();
+	text[length] = '\0';
+
+	unsigned long long bytes;
+
+	if (sscanf(text, "%llu", &bytes) != 1) {
+		log_w("ignoring invalid quota");
+		return;
+	}
+
+	_quota_bytes.store(bytes, std::memory_order_relaxed);
+}
+
+uint32_t Storage::get_remaining_recording_seconds(
+	recording_format::BlockCodec codec) const {
+	using recording_format::BlockCodec;
+
+	// Rough sizes, the delta codec usually saves about a quarter
+	uint32_t sample_size;
+
+	switch (codec) {
+	case BlockCodec::Int16:
+		sample_size = 2;
+		break;
+	case BlockCodec::Int24:
+	case BlockCodec::DeltaFloat32:
+		sample_size = 3;
+		break;
+	default:
+		sample_size = 4;
+		break;
+	}
+
+	// One length byte per record plus the block headers
+	uint64_t bytes_per_second =
+		ECG_SAMPLE_RATE_HZ * (1 + ECG_CHANNELS * sample_size) * 101 / 100;
+
+	return get_usage().free_bytes / bytes_per_second;
+}
+
+bool Storage::flush_recording() {
+	STORAGE_CHECK_STATE(_state, StorageState::Recording, false);
+
+	std::unique_lock<std::mutex> lock(_spi_mutex, std::defer_lock);
+	lock_for_writer(lock);
+
+	if (!_writer.write_block()) {
+		set_error(StorageError::FileSystemError);
+		return false;
+	}
+
+	publish_locked();
+
+	return true;
+}
+
+bool Storage::is_recording_open() const {
+	return _state == StorageState::Recording;
+}
+
+bool Storage::get_live_record_count(const char* name, uint32_t& record_count) {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	if (_state != StorageState::Recording || _current_recording_name != name) {
+		return false;
+	}
+
+	record_count = _live->committed_records.load(std::memory_order_relaxed);
+
+	return true;
+}
+
+bool Storage::close_recording() {
+	STORAGE_CHECK_STATE(_state, StorageState::Recording, false);
+
+	log_d("stopping recording");
+
+	std::unique_lock<std::mutex> lock(_spi_mutex, std::defer_lock);
+	lock_for_writer(lock);
+
+	return close_recording_locked();
+}
+
+bool Storage::close_recording_locked() {
+	bool closed = _writer.finish();
+
+	if (closed) {
+		_state = StorageState::Idle;
+	} else {
+		// The file stays as far as it was flushed, a reader treats it like a
+		// recording cut short
+		_writer.abort();
+		set_error(StorageError::FileSystemError);
+	}
+
+	account_locked(_writer.get_written_size() - _accounted_size);
+
+	_live->committed_records.store(
+		_writer.get_written_records(), std::memory_order_release);
+	_live->committed_size.store(
+		_writer.get_written_size(), std::memory_order_release);
+	_live->closed.store(true, std::memory_order_release);
+	_live.reset();
+
+	_current_recording_name.clear();
+
+	return closed;
+}
+
+std::unique_ptr<RecordingReader> Storage::open_recording(const char* name) {
+	STORAGE_CHECK_NO_ERROR(_state, nullptr);
+
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	// Opened for every download, so nothing here takes memory from the heap
+	// but the file system
+	char path[STORAGE_PATH_SIZE];
+
+	if (!find_recording_path_locked(name, path)) {
+		log_e("no such recording: %s", name);
+		return nullptr;
+	}
+
+	File file = SD.open(path);
+
+	if (!file) {
+		log_e("can not open recording: %s", path);
+		return nullptr;
+	}
+
+	std::shared_ptr<const LiveRecording> live;
+
+	if (_state == StorageState::Recording && _current_recording_name == name) {
+		live = _live;
+	}
+
+	std::unique_ptr<RecordingReader> reader(new (std::nothrow) RecordingReader(
+		*this, _spi_mutex, name, path, file, std::move(live)));
+	if (!reader) {
+		log_e("no memory to read recording: %s", name);
+		file.close();
+		return nullptr;
+	}
+	_readers.push_back(reader.get());
+
+	return reader;
+}
+
+std::unique_ptr<RecordingUpload> Storage::create_upload(
+	const char* name, size_t size, UploadError& error) {
+	if (_state == StorageState::Error) {
+		error = UploadError::FileSystemError;
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	if (parse_recording_index(name) < 0) {
+		error = UploadError::InvalidName;
+		return nullptr;
+	}
+
+	if (!_upload_name.empty()) {
+		error = UploadError::Busy;
+		return nullptr;
+	}
+
+	if (is_in_use_locked(name) || !find_recording_path_locked(name).empty()) {
+		error = UploadError::Exists;
+		return nullptr;
+	}
+
+	// The live recording keeps the reserve below the quota
+	if (size > get_usage().free_bytes) {
+		log_w("upload of %s over the quota, %u bytes", name, (unsigned) size);
+		error = UploadError::NoSpace;
+		return nullptr;
+	}
+
+	auto path = build_flat_path(name, ".part");
+	File file = SD.open(path.data(), FILE_WRITE);
+
+	if (!file) {
+		log_e("can not open file: %s", path.data());
+		error = UploadError::FileSystemError;
+		return nullptr;
+	}
+
+	_upload_name = name;
+	account_locked(size);
+	log_i("receiving upload %s, %u bytes", name, size);
+
+	error = UploadError::None;
+	return std::unique_ptr<RecordingUpload>(new RecordingUpload(
+		*this, _spi_mutex, name, std::move(path), file, size));
+}
+
+void Storage::unregister_reader_locked(const RecordingReader* reader) {
+	_readers.erase(
+		std::remove(_readers.begin(), _readers.end(), reader), _readers.end());
+}
+
+bool Storage::verify_recording(const char* name, VerifyReport& report) {
+	auto reader = open_recording(name);
+
+	if (!reader) {
+		return false;
+	}
+
+	return reader->verify(report);
+}
+
+bool Storage::convert_recording(const char* name, ConversionStats& stats) {
+	uint32_t start = millis();
+	auto reader = open_recording(name);
+
+	if (!reader || reader->get_version() != 1) {
+		return false;
+	}
+
+	auto tmp_path = build_flat_path(name, ".tmp");
+	std::unique_ptr<RecordingWriter> writer(new RecordingWriter());
+
+	{
+		std::lock_guard<std::mutex> lock(_spi_mutex);
+
+		File file = SD.open(tmp_path.data(), FILE_WRITE);
+
+		if (!file) {
+			log_e("can not open file: %s", tmp_path.data());
+			return false;
+		}
+
+		if (!writer->begin(file, recording_format::BlockCodec::DeltaFloat32)) {
+			writer->abort();
+			SD.remove(tmp_path.data());
+			return false;
+		}
+	}
+
+	float data[UINT8_MAX];
+	int length;
+	bool written = true;
+
+	do {
+		yield_to_writer();
+		length = reader->read_record(data, UINT8_MAX);
+
+		if (length > 0) {
+			std::lock_guard<std::mutex> lock(_spi_mutex);
+			written = writer->append(data, length);
+		}
+	} while (length > 0 && written);
+
+	// A read error looks like the end of the file
+	bool complete = written && reader->is_complete();
+	size_t bytes_in = reader->get_size();
+	reader.reset();
+
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	if (!complete || !writer->finish()) {
+		log_e("conversion of %s failed", name);
+		writer->abort();
+		SD.remove(tmp_path.data());
+		return false;
+	}
+
+	if (is_in_use_locked(name)) {
+		log_w("recording is in use, conversion postponed: %s", name);
+		SD.remove(tmp_path.data());
+		return false;
+	}
+
+	// Converted recordings move from the flat layout into their bucket
+	auto path = find_recording_path_locked(name);
+	auto new_path = build_recording_path(name);
+
+	if (!SD.remove(path.data()) || !make_bucket_locked(name) ||
+		!SD.rename(tmp_path.data(), new_path.data())) {
+		log_e("can not replace %s, finished on next mount", path.data());
+		return false;
+	}
+
+	if (path != new_path && _flat_recordings > 0) {
+		_flat_recordings--;
+	}
+
+	if (path != new_path) {
+		count_recording_locked(path, -1);
+		count_recording_locked(new_path, 1);
+	}
+
+	account_locked((int64_t) writer->get_written_size() - (int64_t) bytes_in);
+
+	uint32_t duration_ms = millis() - start;
+
+	stats.files++;
+	stats.bytes_in += bytes_in;
+	stats.bytes_out += writer->get_written_size();
+	stats.duration_ms += duration_ms;
+
+	log_i(
+		"converted %s: %u -> %u bytes in %u ms (%u KB/s)",
+		name,
+		bytes_in,
+		writer->get_written_size(),
+		duration_ms,
+		duration_ms ? bytes_in / duration_ms : 0);
+
+	return true;
+}
+
+std::string Storage::load_conversion_cursor() {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	File file = SD.open("/recordings/.convert");
+
+	if (!file) {
+		return "";
+	}
+
+	char name[32];
+	size_t length = file.read((uint8_t*) name, sizeof(name) - 1);
+	file.close();
+
+	return std::string(name, length);
+}
+
+bool Storage::save_conversion_cursor(const char* name) {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	File file = SD.open("/recordings/.convert", FILE_WRITE);
+
+	if (!file) {
+		log_e("can not save conversion cursor");
+		return false;
+	}
+
+	file.write((const uint8_t*) name, strlen(name));
+	file.close();
+
+	return true;
+}
+
+RetentionPolicy Storage::load_retention_policy() {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	RetentionPolicy policy;
+	File file = SD.open("/recordings/.retention");
+
+	if (!file) {
+		return policy;
+	}
+
+	char text[32];
+	size_t length = file.read((uint8_t*) text, sizeof(text) - 1);
+	file.close();
+	text[length] = '\0';
+
+	unsigned keep_days;
+	unsigned max_percent;
+
+	if (sscanf(text, "%u %u", &keep_days, &max_percent) != 2 ||
+		keep_days > UINT16_MAX || max_percent > 100) {
+		log_w("ignoring invalid retention policy");
+		return policy;
+	}
+
+	policy.keep_days = keep_days;
+	policy.max_percent = max_percent;
+
+	return policy;
+}
+
+bool Storage::save_retention_policy(const RetentionPolicy& policy) {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	File file = SD.open("/recordings/.retention", FILE_WRITE);
+
+	if (!file) {
+		log_e("can not save retention policy");
+		return false;
+	}
+
+	char text[32];
+	int length = snprintf(
+		text, sizeof(text), "%u %u", (unsigned) policy.keep_days,
+		(unsigned) policy.max_percent);
+	file.write((const uint8_t*) text, length);
+	file.close();
+
+	return true;
+}
+
+bool RecordingWriter::begin(File file, recording_format::BlockCodec codec) {
+	_file = file;
+	_codec = codec;
+	_written_size = 0;
+	_next_record = 0;
+	_block.clear();
+	_index.clear();
+
+	recording_format::FileHeader header;
+	recording_format::init_file_header(header, esp_random());
+
+	return write(&header, sizeof(header));
+}
+
+bool RecordingWriter::write(const void* data, size_t length) {
+	uint32_t start = micros();
+	size_t written = _file.write((const uint8_t*) data, length);
+	metrics.card_write.observe(micros() - start);
+
+	if (written != length) {
+		log_e("couldn't write to file");
+		return false;
+	}
+
+	_written_size += length;
+
+	return true;
+}
+
+bool RecordingWriter::append(const float data[], uint8_t length) {
+	if (!_block.fits(length) && !write_block()) {
+		return false;
+	}
+
+	_block.append(data, length);
+
+	return true;
+}
+
+bool RecordingWriter::write_block() {
+	if (_block.record_count == 0) {
+		return true;
+	}
+
+	recording_format::BlockHeader header;
+	size_t payload_size = recording_format::encode_block(
+		_block, _codec, _next_record, header, _payload);
+
+	_index.add(_written_size, _next_record);
+
+	if (!write(&header, sizeof(header)) || !write(_payload, payload_size)) {
+		return false;
+	}
+
+	_next_record += _block.record_count;
+	_block.clear();
+
+	return true;
+}
+
+void RecordingWriter::sync() {
+	uint32_t start = micros();
+	_file.flush();
+	metrics.card_sync.observe(micros() - start);
+}
+
+bool RecordingWriter::finish() {
+	if (!write_block()) {
+		return false;
+	}
+
+	recording_format::BlockHeader header;
+	size_t payload_size = recording_format::encode_index(
+		_index, _next_record, _written_size, header, _payload);
+
+	if (!write(&header, sizeof(header)) || !write(_payload, payload_size)) {
+		return false;
+	}
+
+	_file.close();
+
+	return true;
+}
+
+void RecordingWriter::abort() {
+	_file.close();
+}
+
+size_t RecordingWriter::get_written_size() const {
+	return _written_size;
+}
+
+uint32_t RecordingWriter::get_written_records() const {
+	return _next_record;
+}
+
+RecordingReader::RecordingReader(
+	Storage& storage,
+	std::mutex& spi_mutex,
+	const char* name,
+	const char* path,
+	File file,
+	std::shared_ptr<const LiveRecording> live)
+	: _storage(storage), _spi_mutex(spi_mutex), _file(file),
+	  _file_size(file.size()), _live(std::move(live)) {
+	snprintf(_name, sizeof(_name), "%s", name);
+	snprintf(_path, sizeof(_path), "%s", path);
+}
+
+RecordingReader::~RecordingReader() {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	_file.close();
+	_storage.unregister_reader_locked(this);
+}
+
+void* RecordingReader::operator new(size_t size) {
+	return response_pool.allocate(size);
+}
+
+void* RecordingReader::operator new(size_t size, const std::nothrow_t&) noexcept {
+	return response_pool.allocate(size, std::nothrow);
+}
+
+void RecordingReader::operator delete(void* block) {
+	response_pool.release(block);
+}
+
+void RecordingReader::operator delete(void* block, const std::nothrow_t&) noexcept {
+	response_pool.release(block);
+}
+
+const char* RecordingReader::get_name() const {
+	return _name;
+}
+
+uint8_t RecordingReader::get_version() {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	if (_version == 0 && !_damaged) {
+		read_header(readable_size());
+	}
+
+	return _version;
+}
+
+bool RecordingReader::is_complete() const {
+	return !_damaged && _position == readable_size();
+}
+
+bool RecordingReader::is_live() const {
+	return _live && !_live->closed.load(std::memory_order_acquire);
+}
+
+size_t RecordingReader::get_position() const {
+	return _position;
+}
+
+size_t RecordingReader::get_size() const {
+	return readable_size();
+}
+
+uint32_t RecordingReader::get_corrupt_blocks() const {
+	return _corrupt_blocks;
+}
+
+bool RecordingReader::get_fingerprint(uint32_t& fingerprint) {
+	using namespace recording_format;
+
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	size_t limit = readable_size();
+	if (is_live() || _damaged || (_version == 0 && !read_header(limit)) ||
+		_version != FILE_VERSION) {
+		return false;
+	}
+
+	// The header CRC covers the payload, so two blocks stand for the data at
+	// the start and the layout of the whole file. Recordings cut short have
+	// no index and are known by their first block and size alone. The id
+	// tells apart recordings with the same name and the same start.
+	BlockHeader header;
+	if (!read_bytes(_data_offset, &header, sizeof(header), limit) ||
+		!check_block_header(header)) {
+		return false;
+	}
+	fingerprint = crc32(&_recording_id, sizeof(_recording_id));
+	fingerprint = crc32_update(fingerprint, &header.crc, sizeof(header.crc));
+
+	IndexTrailer trailer;
+	if (read_index_trailer(limit, trailer) &&
+		read_bytes(trailer.block_offset, &header, sizeof(header), limit) &&
+		check_block_header(header)) {
+		fingerprint = crc32_update(fingerprint, &header.crc, sizeof(header.crc));
+	}
+
+	return true;
+}
+
+size_t RecordingReader::readable_size() const {
+	if (_live) {
+		return _live->committed_size.load(std::memory_order_acquire);
+	}
+
+	return _file_size;
+}
+
+bool RecordingReader::reopen() {
+	// A handle only sees the file size it had when it was opened
+	_file.close();
+	_file = SD.open(_path);
+
+	if (!_file) {
+		log_e("can not reopen recording: %s", _path);
+		return false;
+	}
+
+	_file_size = _file.size();
+
+	return true;
+}
+
+bool RecordingReader::read_bytes(
+	size_t offset, void* data, size_t length, size_t limit) {
+	if (offset + length > limit) {
+		return false;
+	}
+
+	if (offset + length > _file_size && !reopen()) {
+		return false;
+	}
+
+	if (_file.position() != offset && !_file.seek(offset)) {
+		log_e("can not seek in recording: %s", _path);
+		return false;
+	}
+
+	if (_file.read((uint8_t*) data, length) != length) {
+		log_e("couldn't read data from file: %s", _path);
+		return false;
+	}
+
+	return true;
+}
+
+bool RecordingReader::read_header(size_t limit) {
+	uint8_t first;
+
+	if (!read_bytes(0, &first, 1, limit)) {
+		return false;
+	}
+
+	if (first != recording_format::FILE_MAGIC[0]) {
+		_version = 1;
+		return true;
+	}
+
+	recording_format::FileHeader header;
+
+	if (!read_bytes(0, &header, recording_format::FILE_HEADER_BASE_SIZE, limit)) {
+		return false;
+	}
+
+	if (!recording_format::check_file_header(header) ||
+		header.version != recording_format::FILE_VERSION) {
+		log_e("invalid header in recording: %s", _path);
+		_damaged = true;
+		return false;
+	}
+
+	// Files written before the id have none
+	header.recording_id = 0;
+	if (header.header_size >= sizeof(header) &&
+		!read_bytes(
+			recording_format::FILE_HEADER_BASE_SIZE, &header.recording_id,
+			sizeof(header.recording_id), limit)) {
+		return false;
+	}
+
+	_version = header.version;
+	_recording_id = header.recording_id;
+	_data_offset = header.header_size;
+	_position = _data_offset;
+
+	return true;
+}
+
+bool RecordingReader::read_block(size_t limit) {
+	recording_format::BlockHeader header;
+
+	if (!read_bytes(_position, &header, sizeof(header), limit)) {
+		return false;
+	}
+
+	if (!recording_format::check_block_header(header)) {
+		log_e("damaged block at %u in %s", (unsigned) _position, _path);
+		_damaged = true;
+		return false;
+	}
+
+	// Fails while the block is not flushed yet or the file was cut short
+	if (!read_bytes(
+			_position + sizeof(header),
+			_payload,
+			header.payload_size,
+			limit)) {
+		return false;
+	}
+
+	_block_record = 0;
+	_block_sample = 0;
+
+	if (!recording_format::check_block_crc(header, _payload) ||
+		!recording_format::decode_block(header, _payload, _block)) {
+		log_e("corrupt block at %u in %s, skipping", (unsigned) _position, _path);
+		_corrupt_blocks++;
+		_block.clear();
+	}
+
+	_position += sizeof(header) + header.payload_size;
+
+	return true;
+}
+
+int RecordingReader::read_v1_record(float data[], uint8_t length, size_t limit) {
+	uint8_t data_length;
+
+	if (!read_bytes(_position, &data_length, 1, limit)) {
+		return 0;
+	}
+
+	if (data_length > length) {
 		log_w(
 			"not enough space for reading, space: %d, needed: %d",
 			length,
@@ -322,53 +1636,580 @@ int Storage::read_record(float data[], uint8_t length) {
 		return -data_length;
 	}
 
-	if ((data_length = _current_file.read()) == -1) {
-		log_e("couldn't read data from file");
-		set_error(StorageError::FileSystemError);
+	// Fails while the record is not completely flushed yet
+	if (!read_bytes(
+			_position + 1, data, sizeof(float) * data_length, limit)) {
+		return 0;
+	}
+
+	_position += 1 + sizeof(float) * data_length;
+
+	return data_length;
+}
+
+int RecordingReader::read_record(float data[], uint8_t length) {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
 
+	if (_damaged) {
 		return 0;
 	}
 
-	if (!_current_file.read((uint8_t*) data, sizeof(float) * data_length)) {
-		set_error(StorageError::FileSystemError);
+	size_t limit = readable_size();
 
+	if (_version == 0 && !read_header(limit)) {
 		return 0;
 	}
 
+	if (_version == 1) {
+		return read_v1_record(data, length, limit);
+	}
+
+	while (_block_record >= _block.record_count) {
+		if (!read_block(limit)) {
+			return 0;
+		}
+	}
+
+	uint8_t data_length = _block.lengths[_block_record];
+
+	if (data_length > length) {
+		log_w(
+			"not enough space for reading, space: %d, needed: %d",
+			length,
+			data_length);
+
+		return -data_length;
+	}
+
+	memcpy(data, _block.samples + _block_sample, sizeof(float) * data_length);
+	_block_record++;
+	_block_sample += data_length;
+
 	return data_length;
 }
 
-bool Storage::is_recording_open() const {
-	return _state == StorageState::Recording || _state == StorageState::Reading;
+uint32_t RecordingReader::get_record_count() {
+	using namespace recording_format;
+
+	// Without touching the card, the writer keeps the bus
+	if (_live) {
+		return _live->committed_records.load(std::memory_order_acquire);
+	}
+
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	size_t limit = readable_size();
+
+	if (_damaged || (_version == 0 && !read_header(limit))) {
+		return 0;
+	}
+
+	uint32_t count = 0;
+
+	if (_version == 1) {
+		uint8_t length;
+		size_t position = 0;
+
+		while (read_bytes(position, &length, 1, limit)) {
+			size_t record_size = 1 + sizeof(float) * length;
+
+			// Fixed record length, see seek_v1_record()
+			if (position == 0 && limit % record_size == 0) {
+				return limit / record_size;
+			}
+
+			position += record_size;
+			if (position > limit) {
+				break;
+			}
+			count++;
+		}
+
+		return count;
+	}
+
+	IndexTrailer trailer;
+	if (read_index_trailer(limit, trailer)) {
+		return trailer.record_count;
+	}
+
+	BlockHeader header;
+	size_t position = _data_offset;
+
+	while (read_bytes(position, &header, sizeof(header), limit) &&
+		   check_block_header(header) &&
+		   static_cast<BlockCodec>(header.codec) != BlockCodec::Index &&
+		   position + sizeof(header) + header.payload_size <= limit) {
+		count = header.first_record + header.record_count;
+		position += sizeof(header) + header.payload_size;
+	}
+
+	return count;
 }
 
-bool Storage::close_recording() {
-	switch (_state) {
-	case StorageState::Recording:
-		log_d("stopping recording");
+bool RecordingReader::seek_record(uint32_t record) {
+	std::unique_lock<std::mutex> lock(_spi_mutex);
 
-		{
-			std::lock_guard<std::mutex> lock(_spi_mutex);
-			_current_file.close();
+	if (_damaged) {
+		return false;
+	}
+
+	size_t limit = readable_size();
+
+	if (_version == 0 && !read_header(limit)) {
+		return false;
+	}
+
+	if (_version == 1) {
+		return seek_v1_record(record, limit, lock);
+	}
+
+	return seek_block_record(record, limit, lock);
+}
+
+void RecordingReader::yield_seek(uint32_t step, std::unique_lock<std::mutex>& lock) {
+	// The file and the limit stay valid, a reader open on a recording keeps
+	// it from being removed and committed data only grows
+	if (step % STORAGE_SEEK_STEP == STORAGE_SEEK_STEP - 1) {
+		lock.unlock();
+		_storage.yield_to_writer();
+		lock.lock();
+	}
+}
+
+bool RecordingReader::seek_v1_record(
+	uint32_t record, size_t limit, std::unique_lock<std::mutex>& lock) {
+	uint8_t length;
+
+	if (!read_bytes(0, &length, 1, limit)) {
+		return false;
+	}
+
+	// Version 1 recordings were written with one record length throughout,
+	// then the offset is computed. Otherwise the length bytes are followed.
+	size_t record_size = 1 + sizeof(float) * length;
+	size_t position = (size_t) record * record_size;
+	uint8_t check;
+
+	if (limit % record_size != 0 || position >= limit ||
+		!read_bytes(position, &check, 1, limit) || check != length) {
+		position = 0;
+
+		for (uint32_t i = 0; i < record; i++) {
+			yield_seek(i, lock);
+
+			if (!read_bytes(position, &check, 1, limit)) {
+				return false;
+			}
+			position += 1 + sizeof(float) * check;
 		}
+	}
 
-		_state = StorageState::Idle;
-		_last_file_index++;
-		_current_recording_name.clear();
+	if (position >= limit) {
+		return false;
+	}
+
+	_position = position;
+
+	return true;
+}
+
+bool RecordingReader::read_index_trailer(
+	size_t limit, recording_format::IndexTrailer& trailer) {
+	// Recordings that are still written or were cut short have no index
+	return !is_live() &&
+		limit >= _data_offset + sizeof(recording_format::BlockHeader) +
+				sizeof(trailer) &&
+		read_bytes(limit - sizeof(trailer), &trailer, sizeof(trailer), limit) &&
+		trailer.magic == recording_format::INDEX_MAGIC &&
+		trailer.block_offset >= _data_offset &&
+		trailer.block_offset < limit;
+}
+
+size_t RecordingReader::find_indexed_block(uint32_t record, size_t limit) {
+	using namespace recording_format;
+
+	IndexTrailer trailer;
+	BlockHeader header;
+
+	if (!read_index_trailer(limit, trailer) ||
+		!read_bytes(trailer.block_offset, &header, sizeof(header), limit) ||
+		!check_block_header(header) ||
+		static_cast<BlockCodec>(header.codec) != BlockCodec::Index ||
+		header.payload_size < sizeof(trailer) ||
+		!read_bytes(
+			trailer.block_offset + sizeof(header),
+			_payload,
+			header.payload_size,
+			limit) ||
+		!check_block_crc(header, _payload)) {
+		return _data_offset;
+	}
+
+	// Last entry starting at or before the record, entries are in order
+	size_t count = (header.payload_size - sizeof(trailer)) / sizeof(IndexEntry);
+	size_t low = 0;
+	size_t high = count;
+
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		IndexEntry entry;
+		memcpy(&entry, _payload + middle * sizeof(entry), sizeof(entry));
+
+		if (entry.first_record <= record) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	if (low == 0) {
+		return _data_offset;
+	}
+
+	IndexEntry entry;
+	memcpy(&entry, _payload + (low - 1) * sizeof(entry), sizeof(entry));
+
+	return entry.offset;
+}
+
+bool RecordingReader::seek_block_record(
+	uint32_t record, size_t limit, std::unique_lock<std::mutex>& lock) {
+	using namespace recording_format;
+
+	size_t position = find_indexed_block(record, limit);
+	BlockHeader header;
+
+	// Blocks before the record are passed by their header alone
+	for (uint32_t step = 0;; step++) {
+		yield_seek(step, lock);
+
+		if (!read_bytes(position, &header, sizeof(header), limit)) {
+			return false;
+		}
+
+		if (!check_block_header(header)) {
+			log_e("damaged block at %u in %s", (unsigned) position, _path);
+			_damaged = true;
+			return false;
+		}
+
+		if (static_cast<BlockCodec>(header.codec) == BlockCodec::Index) {
+			return false;
+		}
+
+		if (record < header.first_record + header.record_count) {
+			break;
+		}
 
+		position += sizeof(header) + header.payload_size;
+	}
+
+	_position = position;
+	_block.clear();
+
+	if (!read_block(limit)) {
+		return false;
+	}
+
+	while (_block_record < _block.record_count &&
+		   header.first_record + _block_record < record) {
+		_block_sample += _block.lengths[_block_record];
+		_block_record++;
+	}
+
+	return true;
+}
+
+size_t RecordingReader::read_raw(size_t offset, uint8_t* buffer, size_t length) {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	size_t limit = readable_size();
+
+	if (offset >= limit) {
+		return 0;
+	}
+
+	length = std::min(length, limit - offset);
+
+	if (!read_bytes(offset, buffer, length, limit)) {
+		return 0;
+	}
+
+	return length;
+}
+
+bool RecordingReader::verify(VerifyReport& report) {
+	using namespace recording_format;
+
+	constexpr size_t max_block_size = sizeof(BlockHeader) + BLOCK_MAX_PAYLOAD;
+	constexpr size_t window_size = 4 * max_block_size;
+
+	report = VerifyReport();
+	uint32_t start = millis();
+
+	size_t limit = readable_size();
+	FileHeader file_header;
+
+	{
+		std::lock_guard<std::mutex> lock(_spi_mutex);
+
+		if (!read_bytes(0, &file_header, FILE_HEADER_BASE_SIZE, limit) ||
+			file_header.magic[0] != FILE_MAGIC[0]) {
+			log_w("no checksums in version 1 recording: %s", _path);
+			return false;
+		}
+	}
+
+	if (!check_file_header(file_header)) {
+		log_e("invalid header in recording: %s", _path);
+		report.corrupt_ranges.push_back({ 0, limit, 0, 0 });
+		report.bytes = limit;
 		return true;
-	case StorageState::Reading:
-		log_d("stopping reading");
+	}
 
-		{
-			std::lock_guard<std::mutex> lock(_spi_mutex);
-			_current_file.close();
+	std::unique_ptr<uint8_t[]> window(new uint8_t[window_size]);
+	size_t window_offset = 0;
+	size_t window_fill = 0;
+	size_t offset = file_header.header_size;
+	uint32_t block_index = 0;
+
+	auto mark_corrupt = [&](size_t size, uint32_t blocks) {
+		auto& ranges = report.corrupt_ranges;
+
+		if (!ranges.empty() &&
+			ranges.back().offset + ranges.back().size == offset) {
+			ranges.back().size += size;
+			ranges.back().blocks += blocks;
+		} else {
+			ranges.push_back({ offset, size, block_index, blocks });
 		}
 
-		_state = StorageState::Idle;
+		report.corrupt_blocks += blocks;
+	};
+
+	while (offset < limit) {
+		size_t window_end = window_offset + window_fill;
+
+		// Refill in large sequential reads, keeping the unparsed tail
+		if (offset + max_block_size > window_end && window_end < limit) {
+			size_t keep = window_end > offset ? window_end - offset : 0;
+			memmove(window.get(), window.get() + (offset - window_offset), keep);
+			window_offset = offset;
+			window_fill = keep;
+
+			size_t wanted = std::min(window_size - keep, limit - offset - keep);
+
+			while (wanted > 0) {
+				size_t chunk = std::min(wanted, STORAGE_READ_CHUNK);
+				std::lock_guard<std::mutex> lock(_spi_mutex);
+
+				if (!read_bytes(
+						window_offset + window_fill,
+						window.get() + window_fill,
+						chunk,
+						limit)) {
+					return false;
+				}
+
+				window_fill += chunk;
+				wanted -= chunk;
+			}
+		}
+
+		const uint8_t* p = window.get() + (offset - window_offset);
+		size_t available = window_offset + window_fill - offset;
+		BlockHeader header;
+
+		if (available >= sizeof(header)) {
+			memcpy(&header, p, sizeof(header));
+		}
+
+		if (available >= sizeof(header) && check_block_header(header) &&
+			available >= sizeof(header) + header.payload_size) {
+			size_t block_size = sizeof(header) + header.payload_size;
+
+			if (!check_block_crc(header, p + sizeof(header))) {
+				mark_corrupt(block_size, 1);
+			}
+
+			report.blocks++;
+			block_index++;
+			offset += block_size;
+		} else {
+			// Damaged header or truncated block, resynchronize on the next
+			// block magic
+			size_t skip = 1;
+
+			while (skip + sizeof(BLOCK_MAGIC) <= available &&
+				   memcmp(p + skip, &BLOCK_MAGIC, sizeof(BLOCK_MAGIC)) != 0) {
+				skip++;
+			}
+
+			if (skip + sizeof(BLOCK_MAGIC) > available) {
+				bool more = offset + available < limit;
+				skip = more ? available - sizeof(BLOCK_MAGIC) + 1 : available;
+			}
+
+			mark_corrupt(skip, 0);
+			offset += skip;
+		}
+	}
+
+	report.bytes = limit;
+	report.duration_ms = millis() - start;
+
+	log_i(
+		"verified %s: %u blocks, %u corrupt, %u bytes in %u ms",
+		_name,
+		report.blocks,
+		report.corrupt_blocks,
+		report.bytes,
+		report.duration_ms);
+
+	return true;
+}
+
+RecordingUpload::RecordingUpload(
+	Storage& storage,
+	std::mutex& spi_mutex,
+	std::string name,
+	std::string path,
+	File file,
+	size_t size)
+	: _storage(storage), _spi_mutex(spi_mutex), _name(std::move(name)),
+	  _path(std::move(path)), _file(file), _size(size), _start_ms(millis()),
+	  _validator(new recording_format::FileValidator()),
+	  _buffer(new uint8_t[STORAGE_WRITE_CHUNK]) {}
+
+RecordingUpload::~RecordingUpload() {
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	if (!_finished) {
+		_file.close();
+		SD.remove(_path.data());
+		_storage.account_locked(-(int64_t) _size);
+		log_w("discarded upload %s after %u bytes", _name.data(), (unsigned) _received);
+	}
+
+	_storage._upload_name.clear();
+}
+
+bool RecordingUpload::fail(UploadError error) {
+	if (_error == UploadError::None) {
+		_error = error;
+	}
+
+	return false;
+}
+
+bool RecordingUpload::write_buffer() {
+	if (_buffered == 0) {
 		return true;
-	default:
-		log_e("ERROR: current state: %s", storage_state_to_str(_state));
+	}
+
+	// Recording goes first, the upload waits between its pieces
+	_storage.yield_to_writer();
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	if (_file.write(_buffer.get(), _buffered) != _buffered) {
+		log_e("couldn't write upload: %s", _path.data());
+		return fail(UploadError::FileSystemError);
+	}
+
+	_buffered = 0;
+
+	return true;
+}
+
+bool RecordingUpload::write(const uint8_t data[], size_t length) {
+	if (_error != UploadError::None || _finished) {
+		return false;
+	}
+
+	if (length > _size - _received) {
+		return fail(UploadError::InvalidFormat);
+	}
+
+	// Checked before anything reaches the card
+	if (!_validator->update(data, length)) {
+		log_w("upload %s is no recording at byte %u", _name.data(), (unsigned) _received);
+		return fail(UploadError::InvalidFormat);
+	}
+
+	_received += length;
+
+	while (length > 0) {
+		size_t count = std::min(length, STORAGE_WRITE_CHUNK - _buffered);
+		memcpy(_buffer.get() + _buffered, data, count);
+		_buffered += count;
+		data += count;
+		length -= count;
+
+		if (_buffered == STORAGE_WRITE_CHUNK && !write_buffer()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool RecordingUpload::finish() {
+	if (_error != UploadError::None || _finished) {
+		return false;
+	}
+
+	if (_received != _size || !_validator->is_complete()) {
+		log_w("upload %s ends inside a record or block", _name.data());
+		return fail(UploadError::InvalidFormat);
+	}
+
+	if (!write_buffer()) {
 		return false;
 	}
+
+	std::lock_guard<std::mutex> lock(_spi_mutex);
+
+	_file.close();
+
+	auto path = build_recording_path(_name.data());
+	if (!_storage.make_bucket_locked(_name.data()) ||
+		!SD.rename(_path.data(), path.data())) {
+		log_e("can not move upload to %s", path.data());
+		return fail(UploadError::FileSystemError);
+	}
+
+	// New recordings are numbered after it
+	int index = parse_recording_index(_name.data());
+	_storage._next_file_index = std::max(_storage._next_file_index, index + 1);
+	_storage.count_recording_locked(path, 1);
+	_storage.account_locked(0);
+	_finished = true;
+
+	_duration_ms = millis() - _start_ms;
+	log_i(
+		"stored upload %s: %u records, %u bytes in %u ms (%u KB/s)",
+		_name.data(),
+		_validator->get_record_count(),
+		_size,
+		_duration_ms,
+		_duration_ms ? _size / _duration_ms : 0);
+
+	return true;
+}
+
+UploadError RecordingUpload::get_error() const {
+	return _error;
+}
+
+const char* RecordingUpload::get_name() const {
+	return _name.data();
+}
+
+size_t RecordingUpload::get_size() const {
+	return _size;
+}
+
+uint32_t RecordingUpload::get_duration_ms() const {
+	return _finished ? _duration_ms : millis() - _start_ms;
 }
@@ -0,0 +1,245 @@
+#include "textFormat.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t powers_of_10[] = {
+	1,
+	10,
+	100,
+	1000,
+	10000,
+	100000,
+	1000000,
+	10000000,
+	100000000,
+	1000000000,
+};
+
+size_t format_uint(char* out, uint32_t value) {
+	char digits[10];
+	size_t count = 0;
+
+	do {
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	for (size_t i = 0; i < count; i++) {
+		out[i] = digits[count - 1 - i];
+	}
+
+	return count;
+}
+
+// Integers from 2^32 on, which as a float are a 24 bit mantissa shifted
+// left by up to 104 bits, 39 digits at most
+static size_t format_large_uint(char* out, uint32_t mantissa, int shift) {
+	uint32_t words[4] = {};
+	uint64_t shifted = (uint64_t) mantissa << (shift % 32);
+	words[shift / 32] = shifted;
+	if (shift / 32 < 3) {
+		words[shift / 32 + 1] = shifted >> 32;
+	}
+
+	// Groups of 9 digits from the lowest, by long division
+	uint32_t groups[5];
+	size_t group_count = 0;
+	bool zero;
+
+	do {
+		uint64_t remainder = 0;
+		zero = true;
+
+		for (int i = 3; i >= 0; i--) {
+			uint64_t current = remainder << 32 | words[i];
+			words[i] = current / powers_of_10[9];
+			remainder = current % powers_of_10[9];
+			zero &= words[i] == 0;
+		}
+
+		groups[group_count++] = remainder;
+	} while (!zero);
+
+	size_t length = format_uint(out, groups[group_count - 1]);
+
+	for (size_t g = group_count - 1; g > 0; g--) {
+		uint32_t group = groups[g - 1];
+		for (int i = 8; i >= 0; i--) {
+			out[length + i] = '0' + group % 10;
+			group /= 10;
+		}
+		length += 9;
+	}
+
+	return length;
+}
+
+size_t format_fixed(char* out, float value, uint8_t decimals) {
+	if (decimals > 9) {
+		decimals = 9;
+	}
+
+	if (isnan(value)) {
+		memcpy(out, "nan", 3);
+		return 3;
+	}
+
+	size_t length = 0;
+
+	if (signbit(value)) {
+		out[length++] = '-';
+		value = -value;
+	}
+
+	if (isinf(value)) {
+		memcpy(out + length, "inf", 3);
+		return length + 3;
+	}
+
+	// Split exactly into integer part and fraction, which are formatted
+	// separately in integers. The ESP32 has no double precision FPU, and
+	// scaling the whole value in float would round away its low digits.
+	if (value >= 4294967296.0f) {
+		// No fraction left at this size
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		length += format_large_uint(
+			out + length, (bits & 0x7fffff) | 0x800000, (bits >> 23) - 150);
+		if (decimals > 0) {
+			out[length++] = '.';
+			memset(out + length, '0', decimals);
+			length += decimals;
+		}
+		return length;
+	}
+
+	uint32_t integer = (uint32_t) value;
+	float fraction = value - (float) integer;
+
+	// The fraction is mantissa / 2^shift with a shift of at least 24
+	uint32_t bits;
+	memcpy(&bits, &fraction, sizeof(bits));
+	int exponent = bits >> 23;
+	uint64_t mantissa = exponent ? (bits & 0x7fffff) | 0x800000 : bits;
+	int shift = exponent ? 150 - exponent : 149;
+
+	// Below 2^54, so anything shifted by 64 or more rounds to 0
+	uint64_t scaled = mantissa * powers_of_10[decimals];
+	uint32_t digits = 0;
+
+	if (shift < 64) {
+		digits = scaled >> shift;
+		uint64_t rest = scaled & ((1ull << shift) - 1);
+		uint64_t half = 1ull << (shift - 1);
+
+		// To the nearest, ties to even like printf, which without decimals
+		// is the integer part
+		bool odd = (decimals > 0 ? digits : integer) & 1;
+		if (rest > half || (rest == half && odd)) {
+			digits++;
+		}
+	}
+
+	// A fraction only remains below 2^23, carrying can not overflow
+	if (digits == powers_of_10[decimals]) {
+		digits = 0;
+		integer++;
+	}
+
+	length += format_uint(out + length, integer);
+
+	if (decimals > 0) {
+		out[length++] = '.';
+
+		for (uint8_t i = decimals; i > 0; i--) {
+			out[length + i - 1] = '0' + digits % 10;
+			digits /= 10;
+		}
+		length += decimals;
+	}
+
+	return length;
+}
+
+TextWriter::TextWriter(char* out, size_t size) : _out(out), _size(size) {
+	if (_size > 0) {
+		_out[0] = '\0';
+	}
+}
+
+char* TextWriter::get_end() const {
+	return _out + std::min(_length, _size);
+}
+
+size_t TextWriter::get_room() const {
+	return _length < _size ? _size - _length : 0;
+}
+
+void TextWriter::add(size_t length) {
+	_length += length;
+}
+
+void TextWriter::append(const char* text) {
+	append(text, strlen(text));
+}
+
+void TextWriter::append(const char* text, size_t length) {
+	size_t room = get_room();
+
+	if (room > 0) {
+		size_t count = std::min(length, room - 1);
+		memcpy(_out + _length, text, count);
+		_out[_length + count] = '\0';
+	}
+
+	_length += length;
+}
+
+void TextWriter::print(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(get_end(), get_room(), format, args);
+	va_end(args);
+
+	if (length > 0) {
+		_length += length;
+	}
+}
+
+void TextWriter::append_json_string(const char* text) {
+	append("\"", 1);
+
+	while (*text != '\0') {
+		// Characters that need no escape go in one piece
+		size_t plain = 0;
+		while (text[plain] != '\0' && text[plain] != '"' && text[plain] != '\\' &&
+			   (unsigned char) text[plain] >= 0x20) {
+			plain++;
+		}
+		append(text, plain);
+		text += plain;
+
+		if (*text == '"' || *text == '\\') {
+			char escaped[2] = { '\\', *text };
+			append(escaped, 2);
+			text++;
+		} else if (*text != '\0') {
+			print("\\u%04x", (unsigned) (unsigned char) *text);
+			text++;
+		}
+	}
+
+	append("\"", 1);
+}
+
+size_t TextWriter::get_length() const {
+	return _length;
+}
+
+bool TextWriter::is_truncated() const {
+	return _length >= _size;
+}
@@ -8,6 +8,7 @@
 #endif
 
 #include "ecg_isd_config.h"
+#include "storage.h"
 
 UIScreen::UIScreen(std::string title) : _title(title) {}
 
@@ -138,6 +139,53 @@ public:
 	}
 };
 
+class UIStorageScreen : public UIScreen {
+	std::shared_ptr<Storage> _storage;
+
+public:
+	UIStorageScreen() : UIScreen("Storage") {}
+
+	void set_storage(std::shared_ptr<Storage> storage) {
+		_storage = std::move(storage);
+	}
+
+	bool on_event(UIEvent event, UI& ui) override {
+		return false;
+	}
+
+	void draw(Adafruit_GFX& gfx) override {
+		if (!_storage) {
+			gfx.println("UI has no connection to storage");
+			return;
+		}
+
+		// Cached by Storage, drawing never touches the card
+		auto usage = _storage->get_usage();
+		uint32_t minutes = _storage->get_remaining_recording_seconds() / 60;
+
+		gfx.printf(
+			"Used: %u / %u MB\n",
+			(unsigned) (usage.used_bytes >> 20),
+			(unsigned) (usage.quota_bytes >> 20));
+		gfx.printf("Free: %u MB\n", (unsigned) (usage.free_bytes >> 20));
+		gfx.printf("Left: %uh %02umin\n", minutes / 60, minutes % 60);
+
+		switch (usage.level) {
+		case StorageUsageLevel::Warning:
+			gfx.println("Card almost full");
+			break;
+		case StorageUsageLevel::Critical:
+			gfx.println("Card nearly full!");
+			break;
+		case StorageUsageLevel::Full:
+			gfx.println("Card full!");
+			break;
+		default:
+			break;
+		}
+	}
+};
+
 UI::UI(SPIClass& spi, std::mutex& spi_mutex)
 	: _spi(spi), _spi_mutex(spi_mutex)
 #ifdef ARDUINO_NodeMCU_32S
@@ -175,10 +223,15 @@ UI::UI(SPIClass& spi, std::mutex& spi_mutex)
 		"Measurement",
 		[=](UI& ui) { ui.push(_measurement_menu); },
 	});
+	choices.push_back({
+		"Storage",
+		[=](UI& ui) { ui.push(_storage_screen); },
+	});
 	_main_menu =
 		std::make_shared<UIMenuScreen>(std::string("ECG ISD ESP32"), choices);
 
 	_wifi_menu = std::make_shared<UIWiFiApScreen>();
+	_storage_screen = std::make_shared<UIStorageScreen>();
 
 	choices.clear();
 	choices.push_back({
@@ -205,6 +258,15 @@ void UI::set_setup_wifi(std::shared_ptr<SetupWiFi> setup_wifi) {
 	}
 }
 
+void UI::set_storage(std::shared_ptr<Storage> storage) {
+	_storage = std::move(storage);
+
+	if (auto storage_screen =
+			std::static_pointer_cast<UIStorageScreen>(_storage_screen)) {
+		storage_screen->set_storage(_storage);
+	}
+}
+
 void UI::pop(unsigned num) {
 	for (int i = 0; i < _min((unsigned long) num, _stack.size() - 1); i++) {
 		_stack.back()->on_leave();
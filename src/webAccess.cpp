@@ -1,130 +1,1571 @@
 #include "webAccess.h"
+#include "ecg_isd_config.h"
+#include "exportStream.h"
+#include "liveStream.h"
+#include "recordingCleaner.h"
+#include "responsePool.h"
+#include "textFormat.h"
+#include "webAssets.h"
 
+#include <algorithm>
 #include <string>
-#include <iostream>
-#include <sstream>
-#include <iomanip>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <WiFi.h>
-#include <WiFiClient.h>
-#include <WebServer.h>
 #include <ESPmDNS.h>
-#include <uri/UriBraces.h>
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <esp_app_desc.h>
+#else
+#include <esp_ota_ops.h>
+#endif
 
-WebAccess::WebAccess(std::shared_ptr<Storage> storage) : _server(80), _storage(storage) {
-    _server.on("/", HTTP_GET, std::bind(&WebAccess::handleRoot, this));     // Call the 'handleRoot' function when a client requests URI "/"
-    _server.on(UriBraces("/recordings/{}.csv"), HTTP_GET, std::bind(&WebAccess::handleRecordingCsv, this));
-    _server.on(UriBraces("/recordings/{}.csv/remove"), HTTP_GET, std::bind(&WebAccess::handleRemoveRecording, this));
-    _server.onNotFound(std::bind(&WebAccess::handleNotFound, this));        // When a client requests an unknown URI (i.e. something other than "/"), call function "handleNotFound"
-    _server.begin(); // Actually start the server
+// Parses a single range "bytes=first-last", "bytes=first-" or "bytes=-count".
+// Several ranges at once are not supported, such a request gets the whole body.
+static bool parse_range(const char* header, ByteRange& range) {
+	if (strncmp(header, "bytes=", 6) != 0 || strchr(header, ',') != nullptr) {
+		return false;
+	}
+
+	const char* text = header + 6;
+	char* end;
+
+	range.suffix = *text == '-';
+	range.first = 0;
+
+	if (!range.suffix) {
+		if (!isdigit((unsigned char) *text)) {
+			return false;
+		}
+		range.first = strtoul(text, &end, 10);
+		if (*end != '-') {
+			return false;
+		}
+		text = end;
+	}
+
+	text++;
+	if (*text == '\0') {
+		range.last = SIZE_MAX;
+		return !range.suffix;
+	}
+
+	if (!isdigit((unsigned char) *text)) {
+		return false;
+	}
+	range.last = strtoul(text, &end, 10);
+
+	return *end == '\0' && (range.suffix || range.last >= range.first);
+}
+
+// Applies a range to a body of size bytes, end is exclusive
+static bool resolve_range(
+	const ByteRange& range, size_t size, size_t& first, size_t& end) {
+	if (range.suffix) {
+		if (range.last == 0 || size == 0) {
+			return false;
+		}
+		first = size - std::min(range.last, size);
+		end = size;
+		return true;
+	}
+
+	if (range.first >= size) {
+		return false;
+	}
+
+	first = range.first;
+	end = range.last == SIZE_MAX ? size : std::min(range.last + 1, size);
+
+	return true;
+}
+
+// Seconds since the start of a recording, fractions allowed, to a record index
+static bool parse_seconds(const char* text, uint32_t& record) {
+	char* end;
+	double seconds = strtod(text, &end);
+
+	if (*text == '\0' || *end != '\0' || !(seconds >= 0) ||
+		seconds * ECG_SAMPLE_RATE_HZ >= UINT32_MAX) {
+		return false;
+	}
+
+	record = (uint32_t) (seconds * ECG_SAMPLE_RATE_HZ);
+
+	return true;
+}
+
+// Comma separated channel indexes, starting at 0
+static bool parse_channels(const char* item, ExportSelection& selection) {
+	selection.channel_count = 0;
+
+	while (true) {
+		char* end;
+		if (!isdigit((unsigned char) *item) ||
+			selection.channel_count == UINT8_MAX) {
+			return false;
+		}
+
+		unsigned long channel = strtoul(item, &end, 10);
+		if (channel >= ECG_CHANNELS) {
+			return false;
+		}
+		selection.channels[selection.channel_count++] = channel;
+
+		if (*end == '\0') {
+			return true;
+		}
+		if (*end != ',') {
+			return false;
+		}
+		item = end + 1;
+	}
+}
+
+// A decimal number without sign
+static bool parse_count(const char* text, uint32_t& value) {
+	char* end;
+	unsigned long parsed = strtoul(text, &end, 10);
+
+	if (!isdigit((unsigned char) *text) || *end != '\0' || parsed > UINT32_MAX) {
+		return false;
+	}
+
+	value = parsed;
+
+	return true;
+}
+
+static const esp_app_desc_t* app_description() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+	return esp_app_get_description();
+#else
+	return esp_ota_get_app_description();
+#endif
+}
+
+// File extension of an export, also the variant of its tag
+static const char* range_export_extension(RangeExport kind) {
+	switch (kind) {
+	case RangeExport::Edf:
+		return "edf";
+	case RangeExport::WfdbData:
+		return "dat";
+	default:
+		return "hea";
+	}
+}
+
+static void send_upload_error(HttpResponse& response, UploadError error) {
+	switch (error) {
+	case UploadError::InvalidName:
+		response.send(400, "text/plain", "400: Recordings are named by five digits");
+		break;
+	case UploadError::Exists:
+		response.send(409, "text/plain", "409: Recording exists");
+		break;
+	case UploadError::Busy:
+		response.send(503, "text/plain", "503: Another upload is running");
+		break;
+	case UploadError::NoSpace:
+		response.send(507, "text/plain", "507: Over the storage quota");
+		break;
+	case UploadError::InvalidFormat:
+		response.send(400, "text/plain", "400: Not a complete recording");
+		break;
+	default:
+		response.send(500, "text/plain", "500: Internal server error");
+		break;
+	}
+}
+
+// Takes a PUT body straight into the card, a piece at a time
+class UploadSink : public HttpBodySink {
+	std::unique_ptr<RecordingUpload> _upload;
+
+public:
+	explicit UploadSink(std::unique_ptr<RecordingUpload> upload)
+		: _upload(std::move(upload)) {}
+
+	bool consume(const uint8_t* data, size_t length) override {
+		return _upload->write(data, length);
+	}
+
+	void respond(HttpResponse& response) override {
+		if (!_upload->finish()) {
+			send_upload_error(response, _upload->get_error());
+			return;
+		}
+
+		uint32_t duration_ms = _upload->get_duration_ms();
+		char text[HTTP_TEXT_SIZE];
+		snprintf(
+			text, sizeof(text), "201: Stored %s, %u bytes in %u ms (%u KB/s)\n",
+			_upload->get_name(), (unsigned) _upload->get_size(),
+			(unsigned) duration_ms,
+			(unsigned) (duration_ms ? _upload->get_size() / duration_ms : 0));
+
+		char location[48];
+		snprintf(location, sizeof(location), "/recordings/%s.rec", _upload->get_name());
+		response.set_header("Location", location);
+		response.send(201, "text/plain", text);
+	}
+};
+
+// A range of a CSV export. Its length is only known after formatting the
+// whole selection once, unless it is remembered, and the bytes in front of
+// the range are formatted again. Nothing of that goes over the air.
+class CsvRangePreparation : public HttpPreparation {
+	WebAccess& _web;
+	std::unique_ptr<CsvExport> _csv;
+	char _name[HTTP_PATH_ARG_SIZE];
+	ExportSelection _selection;
+	char _key[WEB_SELECTION_KEY_SIZE];
+	size_t _size;
+	ByteRange _range;
+
+	bool _counted;
+	bool _found = true;
+	size_t _length = 0;
+	size_t _first = 0;
+	size_t _end = 0;
+	size_t _skipped = 0;
+
+public:
+	CsvRangePreparation(
+		WebAccess& web,
+		std::unique_ptr<CsvExport> csv,
+		const char* name,
+		const ExportSelection& selection,
+		const char* key,
+		size_t size,
+		const ByteRange& range)
+		: _web(web), _csv(std::move(csv)), _selection(selection), _size(size),
+		  _range(range) {
+		snprintf(_name, sizeof(_name), "%s", name);
+		snprintf(_key, sizeof(_key), "%s", key);
+		_counted = _web.cachedCsvLength(_key, _size, _length);
+	}
+
+	bool step() override {
+		if (!_counted) {
+			size_t count = _csv->skip(WEB_PREPARATION_STEP);
+			_length += count;
+
+			if (count == WEB_PREPARATION_STEP) {
+				return false;
+			}
+
+			_counted = true;
+			_web.rememberCsvLength(_key, _size, _length);
+
+			// Counting used up the export, the range is taken from a new one
+			auto reader = _web._storage->open_recording(_name);
+			_found = reader != nullptr;
+			_csv.reset(_found ? new (std::nothrow) CsvExport(std::move(reader), _selection) : nullptr);
+		}
+
+		if (!_csv || !resolve_range(_range, _length, _first, _end)) {
+			return true;
+		}
+
+		size_t count = _csv->skip(std::min(WEB_PREPARATION_STEP, _first - _skipped));
+		_skipped += count;
+
+		return _skipped == _first || count == 0;
+	}
+
+	void respond(HttpResponse& response) override {
+		if (!_found) {
+			response.send(404, "text/plain", "404: Not found");
+			return;
+		}
+
+		if (!_csv) {
+			response.send_no_memory();
+			return;
+		}
+
+		if (!resolve_range(_range, _length, _first, _end)) {
+			_web.sendRangeNotSatisfiable(response, _length);
+			return;
+		}
+
+		_web.setContentRange(response, _first, _end, _length);
+		response.send(206, "text/csv", std::move(_csv), _end - _first);
+	}
+};
+
+// Finds the channel ranges of an EDF+ or WFDB selection a step per server
+// turn, and for a WFDB header the sums of the signal file after them. Then
+// sends the export as if both had been remembered.
+class RangePreparation : public HttpPreparation {
+	WebAccess& _web;
+	RangeExport _kind;
+	char _name[HTTP_PATH_ARG_SIZE];
+	ExportSelection _selection;
+	WfdbFormat _format;
+	char _key[WEB_SELECTION_KEY_SIZE];
+	size_t _size;
+
+	SelectionScan _scan;
+	bool _scanned;
+	SelectionRange _range;
+	// The signal file, encoded without sending it
+	std::unique_ptr<WfdbExport> _data;
+	WfdbSums _sums;
+	bool _found = true;
+
+public:
+	// range is nullptr unless it is remembered
+	RangePreparation(
+		WebAccess& web,
+		RangeExport kind,
+		std::unique_ptr<RecordingReader> reader,
+		const char* name,
+		const ExportSelection& selection,
+		WfdbFormat format,
+		const char* key,
+		size_t size,
+		const SelectionRange* range)
+		: _web(web), _kind(kind), _selection(selection), _format(format),
+		  _size(size),
+		  _scan(range ? nullptr : std::move(reader), selection),
+		  _scanned(range != nullptr) {
+		snprintf(_name, sizeof(_name), "%s", name);
+		snprintf(_key, sizeof(_key), "%s", key);
+
+		// A remembered range only lacks the sums of a header
+		if (range != nullptr) {
+			_range = *range;
+			_data.reset(new (std::nothrow) WfdbExport(std::move(reader), _selection, _range, _format));
+		}
+	}
+
+	bool step() override {
+		if (!_scanned) {
+			if (!_scan.step(WEB_SCAN_STEP)) {
+				return false;
+			}
+
+			_scanned = true;
+			_range = _scan.get_range();
+			if (_kind != RangeExport::WfdbHeader) {
+				return true;
+			}
+
+			// Scanning used up the reader, the signal file is encoded from a
+			// new one
+			auto reader = _web._storage->open_recording(_name);
+			if (!reader) {
+				_found = false;
+				return true;
+			}
+			_data.reset(new (std::nothrow) WfdbExport(std::move(reader), _selection, _range, _format));
+			return false;
+		}
+
+		if (!_data) {
+			return true;
+		}
+
+		if (_data->skip(WEB_PREPARATION_STEP) == WEB_PREPARATION_STEP) {
+			return false;
+		}
+
+		_data->get_sums(_sums);
+		return true;
+	}
+
+	void respond(HttpResponse& response) override {
+		if (!_found) {
+			response.send(404, "text/plain", "404: Not found");
+			return;
+		}
+
+		// A header needs the signal file for its sums
+		if (_kind == RangeExport::WfdbHeader && !_data) {
+			response.send_no_memory();
+			return;
+		}
+
+		_web.rememberRange(_key, _size, _range, _data ? &_sums : nullptr);
+
+		// The header is all sums, the other exports read from a new reader
+		std::unique_ptr<RecordingReader> reader;
+		if (_kind != RangeExport::WfdbHeader) {
+			reader = _web._storage->open_recording(_name);
+			if (!reader) {
+				response.send(404, "text/plain", "404: Not found");
+				return;
+			}
+		}
+
+		_web.respondRangeExport(
+			response, _kind, _name, _selection, _format, _range, _sums,
+			std::move(reader));
+	}
+};
+
+WebAccess::WebAccess(std::shared_ptr<Storage> storage, uint16_t port)
+	: _server(port), _storage(storage) {
+	using namespace std::placeholders;
+
+	memcpy(&_firmware_tag, app_description()->app_elf_sha256, sizeof(_firmware_tag));
+
+	_server.on("/", HttpMethod::Get, std::bind(&WebAccess::handleAsset, this, _1, _2));
+	_server.on("/assets/{}", HttpMethod::Get, std::bind(&WebAccess::handleAsset, this, _1, _2));
+	_server.on("/api/recordings", HttpMethod::Get, std::bind(&WebAccess::handleCatalog, this, _1, _2));
+	_server.on("/recordings/{}.csv", HttpMethod::Get, std::bind(&WebAccess::handleRecordingCsv, this, _1, _2));
+	_server.on("/recordings/{}.rec", HttpMethod::Get, std::bind(&WebAccess::handleRecordingRaw, this, _1, _2));
+	_server.on("/recordings/{}.edf", HttpMethod::Get, std::bind(&WebAccess::handleRecordingEdf, this, _1, _2));
+	_server.on("/recordings/{}.dat", HttpMethod::Get, std::bind(&WebAccess::handleRecordingWfdbData, this, _1, _2));
+	_server.on("/recordings/{}.hea", HttpMethod::Get, std::bind(&WebAccess::handleRecordingWfdbHeader, this, _1, _2));
+	_server.on("/recordings.zip", HttpMethod::Get, std::bind(&WebAccess::handleArchive, this, _1, _2));
+	_server.on("/recordings/{}/preview", HttpMethod::Get, std::bind(&WebAccess::handleRecordingPreview, this, _1, _2));
+	_server.on("/live", HttpMethod::Get, std::bind(&WebAccess::handleLive, this, _1, _2));
+	_server.on("/metrics", HttpMethod::Get, std::bind(&WebAccess::handleMetrics, this, _1, _2));
+	_server.on("/recordings/{}.rec", HttpMethod::Put, std::bind(&WebAccess::handleUpload, this, _1, _2));
+	_server.on("/recordings/{}", HttpMethod::Put, std::bind(&WebAccess::handleUpload, this, _1, _2));
+	_server.on("/recordings/{}.csv/remove", HttpMethod::Get, std::bind(&WebAccess::handleRemoveRecording, this, _1, _2));
+	_server.on("/api/recordings", HttpMethod::Delete, std::bind(&WebAccess::handleRemoveRecordings, this, _1, _2));
+	_server.on("/api/retention", HttpMethod::Get, std::bind(&WebAccess::handleRetention, this, _1, _2));
+	_server.on("/api/retention", HttpMethod::Put, std::bind(&WebAccess::handleSetRetention, this, _1, _2));
+	_server.on("/api/quota", HttpMethod::Get, std::bind(&WebAccess::handleQuota, this, _1, _2));
+	_server.on("/api/quota", HttpMethod::Put, std::bind(&WebAccess::handleSetQuota, this, _1, _2));
+	// Any other URI gets 404
+	_server.on_not_found(std::bind(&WebAccess::handleNotFound, this, _1, _2));
 }
 
 WebAccess::~WebAccess() {}
 
+void WebAccess::setLiveSamples(std::shared_ptr<const LiveSamples> live_samples) {
+	_live_samples = live_samples;
+}
+
+void WebAccess::setRecordingCleaner(std::shared_ptr<RecordingCleaner> cleaner) {
+	_cleaner = cleaner;
+}
+
 void WebAccess::loop() {
+	// Sockets can only be opened once the network interface is up
+	while (WiFi.getMode() == WIFI_MODE_NULL) {
+		delay(1000);
+	}
+
 	while (true) {
-        _server.handleClient(); // Listen for HTTP requests from clients
-	}
-}
-
-void WebAccess::handleRoot() { // When URI / is requested, send a web page with a button to list the recordings
-    _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
-    _server.send(200, "text/html",
-        "<html>\n" // defines the whole document
-        "   <head>\n" // (not shown) contains meta information about the document
-        "       <title>ESP-ISD-ECG</title>\n" // specifies a title for the document
-        "   </head>\n"
-        "   <body>\n" // defines the document body.
-        "       <h1>ESP-ISD-ECG SD CARD</h1>\n" // heading
-        "       <ul>\n" // unordered/bullet list, followed by <li> (List Items, empty tag)
-    );
-    
-    for (auto& recordings : _storage->list_recordings()) { // return obj
-        // <a href='/recordings/000xx.csv'>000xx</a> --- link & Button
-        // Links
-        std::string msg = "<li><a href='/recordings/"; // content = C-string
-        msg += recordings.get_name();
-        msg += ".csv'>"; 
-        msg += recordings.get_name();
-        msg += "</a>\n";
-        
-        msg += "&nbsp;&nbsp;&nbsp;&nbsp;&nbsp\n"; // spaces
-        msg += "<a href='/recordings/"; // Links
-        msg += recordings.get_name();
-        msg += ".csv/remove'>"; 
-        msg += "Click here to remove";
-        msg += "</a>\n";
-        
-        _server.sendContent(msg.data()); // method = String, parameter = C-string
-    }
-    
-    _server.sendContent("</ul></body></html>\n");
-    
-    // Send zero length chunk to terminate the HTTP body
-    _server.sendContent("");
-}    
-
-void WebAccess::handleRecordingCsv() { // If a POST request is made to URI /recordings/000xx.csv
-    //   STORAGE_CHECK_STATE(_state, StorageState::Idle, {});
-    //   std::lock_guard<std::mutex> lock(_spi_mutex);
-
-    String recording_name = _server.pathArg(0); // get 000xx tks to UriBraces
-
-    int len;
-	float data[7];
-	char fl_to_str[10];
-
-    _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
-    _server.send(200, "text/csv", "");
-    WiFiClient client = _server.client();
-    
-    if (_storage->open_recording(recording_name.c_str())) { // if can open
-        do {
-            std::string msg;
-            // then read, put to "data" & return length
-            len = _storage->read_record(data, 7); 
-            
-            for (int i = 0; i < len; i++) {
-                snprintf(fl_to_str, 9, "%f", data[i]); // float to string
-                // _server.sendContent(fl_to_str);
-                msg += fl_to_str; // Links
-                if (i == len - 1) { // for every read_record()
-                    msg += "\n";
-                } else {
-                    msg += ",";
-                }
-            }
-        _server.sendContent(msg.data());
-        } while (len >= 1);
-        
-        // Send zero length chunk to terminate the HTTP body
-        _server.sendContent("");
-        _storage->close_recording();
-    } else {
-        _server.send(404, "text/plain", "404: Not found"); // Send HTTP status 404 (Not Found) when there's no handler for the URI in the request
-    }
-}
-
-void WebAccess::handleRemoveRecording() { // If a POST request is made to URI /recordings/000xx.csv
-    //   STORAGE_CHECK_STATE(_state, StorageState::Idle, {});
-    //   std::lock_guard<std::mutex> lock(_spi_mutex);
-    String recording_name = _server.pathArg(0); // get 000xx tks to UriBraces
-
-    // if (_storage->open_recording(recording_name.c_str())) {}      // if can open
-    bool isRemoved = _storage->remove_recording(recording_name.c_str());
-    if (!isRemoved)
-    {
-        _storage->close_recording();
-        _server.send(503, "text/plain", "500: Internal Server Error"); // SD cannot delete
-        // log_e already inside remove_recording()
-        return;
-    }
-    _storage->close_recording();
-    
-    _server.sendHeader("Location","/");        // Add a header to respond with a new location for the browser to go to the home page again
-    _server.send(303);                         // Send it back to the browser with an HTTP status 303 (See Other) to redirect
-}
-
-void WebAccess::handleNotFound() {
-    _server.send(404, "text/plain", "404: Not found"); // Send HTTP status 404 (Not Found) when there's no handler for the URI in the request
+		// Sleeps until a client connects, sends a request or has room for
+		// more of a download
+		_server.poll();
+
+		// Without clients the memory kept for their responses goes back to
+		// the heap
+		if (_server.get_connection_count() > 0) {
+			_last_connection = millis();
+		} else if (millis() - _last_connection > WEB_POOL_TRIM_MS) {
+			response_pool.trim();
+		}
+	}
+}
+
+// GET / and the viewer files below /assets
+void WebAccess::handleAsset(HttpRequest& request, HttpResponse& response) {
+	const WebAsset* asset = nullptr;
+	for (size_t i = 0; i < WEB_ASSET_COUNT; i++) {
+		if (strcmp(WEB_ASSETS[i].path, request.get_path()) == 0) {
+			asset = &WEB_ASSETS[i];
+			break;
+		}
+	}
+
+	if (asset == nullptr) {
+		handleNotFound(request, response);
+		return;
+	}
+
+	// Scripts and styles are named after their content, the page refers to
+	// the current names and is checked on every load
+	response.set_header("ETag", asset->etag);
+	response.set_header(
+		"Cache-Control",
+		asset->immutable ? "public, max-age=31536000, immutable" : "no-cache");
+
+	if (isNotModified(request, asset->etag)) {
+		response.send(304);
+		return;
+	}
+
+	// Only stored compressed, every browser accepts gzip
+	response.set_header("Content-Encoding", "gzip");
+	response.send(
+		200, asset->content_type,
+		std::unique_ptr<ExportStream>(new (std::nothrow) MemoryExport(asset->data, asset->length)),
+		asset->length);
+}
+
+// GET /api/recordings?offset=0&limit=50
+void WebAccess::handleCatalog(HttpRequest& request, HttpResponse& response) {
+	uint32_t offset = 0;
+	uint32_t limit = WEB_CATALOG_LIMIT;
+
+	if ((request.has_arg("offset") && !parse_count(request.arg("offset"), offset)) ||
+		(request.has_arg("limit") && !parse_count(request.arg("limit"), limit)) ||
+		limit < 1 || limit > WEB_CATALOG_MAX_LIMIT) {
+		response.send(400, "text/plain", "400: Invalid offset or limit");
+		return;
+	}
+
+	// Taken before listing, a change while listing only makes the next
+	// request list again
+	uint32_t generation = _storage->get_catalog_generation();
+	char etag[16];
+	snprintf(etag, sizeof(etag), "\"%08x\"", (unsigned) generation);
+	response.set_header("ETag", etag);
+	response.set_header("Cache-Control", "no-cache");
+
+	// Unchanged since the client asked last, costs no card access
+	if (isNotModified(request, etag)) {
+		response.send(304);
+		return;
+	}
+
+	// The same page of an unchanged catalog is not listed again
+	if (!_catalog_listed || generation != _catalog_generation ||
+		offset != _catalog_offset || limit != _catalog_limit) {
+		_catalog_listed = listCatalogPage(offset, limit, generation);
+		_catalog_generation = generation;
+		_catalog_offset = offset;
+		_catalog_limit = limit;
+
+		if (!_catalog_listed) {
+			response.send(500, "text/plain", "500: Can not list the recordings");
+			return;
+		}
+	}
+
+	auto usage = _storage->get_usage();
+	std::unique_ptr<TextExport> json(new (std::nothrow) TextExport());
+	if (!json) {
+		response.send_no_memory();
+		return;
+	}
+	TextWriter& out = json->get_writer();
+
+	out.print(
+		"{\"total\":%u,\"offset\":%u,\"limit\":%u",
+		(unsigned) _storage->get_recording_count(), (unsigned) offset,
+		(unsigned) limit);
+	out.print(
+		",\"usage\":{\"used_bytes\":%llu,\"quota_bytes\":%llu,\"remaining_seconds\":%u}",
+		(unsigned long long) usage.used_bytes,
+		(unsigned long long) usage.quota_bytes,
+		(unsigned) _storage->get_remaining_recording_seconds());
+	out.append(",\"recordings\":[");
+
+	for (auto& entry : _catalog) {
+		if (&entry != &_catalog.front()) {
+			out.append(",");
+		}
+
+		out.append("{\"name\":");
+		out.append_json_string(entry.name.data());
+
+		// Seconds since the start of the recording, the device has no clock
+		// that would date it
+		out.print(
+			",\"size\":%u,\"duration\":%u.%03u,\"live\":%s}",
+			(unsigned) entry.size,
+			(unsigned) (entry.record_count / ECG_SAMPLE_RATE_HZ),
+			(unsigned) (entry.record_count % ECG_SAMPLE_RATE_HZ * 1000 /
+						ECG_SAMPLE_RATE_HZ),
+			entry.live ? "true" : "false");
+	}
+
+	out.append("]}");
+
+	if (!json->is_complete()) {
+		log_e("catalog page needs %u bytes", (unsigned) out.get_length() + 1);
+		response.send(500, "text/plain", "500: Catalog page too large, ask for fewer");
+		return;
+	}
+
+	size_t length = json->get_length();
+	response.send(200, "application/json", std::move(json), length);
+}
+
+// Lists the catalog page at offset into _catalog. The recordings before it
+// are skipped a page at a time, from where the last page ended as long as
+// the catalog did not change since.
+bool WebAccess::listCatalogPage(uint32_t offset, uint32_t limit, uint32_t generation) {
+	if (generation != _cursor_generation || _cursor_offset > offset) {
+		_cursor_name.clear();
+		_cursor_offset = 0;
+		_cursor_generation = generation;
+	}
+
+	while (_cursor_offset < offset) {
+		uint32_t count = std::min(offset - _cursor_offset, WEB_CATALOG_MAX_LIMIT);
+		if (!_storage->list_recordings(_listing, _cursor_name.data(), count)) {
+			return false;
+		}
+
+		// An offset after the last recording gets an empty page
+		if (_listing.empty()) {
+			break;
+		}
+
+		_cursor_offset += _listing.size();
+		_cursor_name = _listing.back().get_name();
+
+		if (_listing.size() < count) {
+			break;
+		}
+	}
+
+	// Built next to the last page, both keep their memory
+	_catalog_next.clear();
+
+	if (_cursor_offset == offset) {
+		if (!_storage->list_recordings(_listing, _cursor_name.data(), limit)) {
+			return false;
+		}
+
+		if (!_listing.empty()) {
+			_cursor_offset += _listing.size();
+			_cursor_name = _listing.back().get_name();
+		}
+	} else {
+		_listing.clear();
+	}
+
+	for (const StorageEntry& recording : _listing) {
+		auto cached = std::find_if(
+			_catalog.begin(), _catalog.end(), [&](const CatalogEntry& entry) {
+				return entry.size == recording.get_size() &&
+					entry.name == recording.get_name();
+			});
+
+		if (cached != _catalog.end()) {
+			_catalog_next.push_back(std::move(*cached));
+			continue;
+		}
+
+		// The live recording is counted as it is written, closed ones have
+		// their count in the index trailer
+		uint32_t record_count;
+		if (_storage->get_live_record_count(recording.get_name(), record_count)) {
+			_catalog_next.push_back(
+				{ recording.get_name(), recording.get_size(), record_count, true });
+			continue;
+		}
+
+		auto reader = _storage->open_recording(recording.get_name());
+		_catalog_next.push_back(
+			{ recording.get_name(), recording.get_size(),
+			  reader ? reader->get_record_count() : 0,
+			  reader && reader->is_live() });
+	}
+
+	std::swap(_catalog, _catalog_next);
+
+	return true;
+}
+
+// Name that sorts right before a numbered recording name, so that listing
+// after it starts with that recording. Empty for other names.
+static void name_before(const char* name, size_t length, char (&before)[12]) {
+	before[0] = '\0';
+
+	if (length == 5 && strspn(name, "0123456789") >= length && atoi(name) > 0) {
+		snprintf(before, sizeof(before), "%05d", atoi(name) - 1);
+	}
+}
+
+// Lists the recording called name and adds it with its size to recordings.
+// Only the directory it is in is read for a numbered name.
+bool WebAccess::appendRecording(
+	const char* name, size_t length, std::vector<StorageEntry>& recordings) {
+	char before[12];
+	name_before(name, length, before);
+
+	std::string after = before;
+	size_t count = *before != '\0' ? 1 : WEB_CATALOG_MAX_LIMIT;
+
+	while (_storage->list_recordings(_listing, after.data(), count) &&
+		   !_listing.empty()) {
+		for (const StorageEntry& entry : _listing) {
+			int order = strncmp(entry.get_name(), name, length);
+			if (order == 0 && entry.get_name()[length] == '\0') {
+				recordings.push_back(entry);
+				return true;
+			}
+			if (order > 0) {
+				return false;
+			}
+		}
+
+		after = _listing.back().get_name();
+	}
+
+	return false;
+}
+
+// GET /recordings/000xx.csv
+void WebAccess::handleRecordingCsv(HttpRequest& request, HttpResponse& response) {
+	// 000xx from the {} of the route
+	const char* recording_name = request.path_arg(0);
+
+	ExportSelection selection;
+	if (!requestedSelection(request, selection)) {
+		response.send(400, "text/plain", "400: Invalid from, to or channels");
+		return;
+	}
+
+	// Own read handle, works while a measurement is being recorded
+	auto reader = _storage->open_recording(recording_name);
+	if (!reader) {
+		response.send(404, "text/plain", "404: Not found");
+		return;
+	}
+
+	// The CSV of a recording that is still growing has no stable length,
+	// ranges are only served for closed recordings
+	bool live = reader->is_live();
+	size_t size = reader->get_size();
+
+	ByteRange range;
+	bool partial = !live && requestedRange(request, range);
+	bool gzip = !partial && sendsGzip(request);
+	if (revalidateRecording(request, response, *reader, gzip ? "csv.gz" : "csv")) {
+		return;
+	}
+
+	// Holds a line buffer, too large for the task stack
+	std::unique_ptr<CsvExport> csv(new (std::nothrow) CsvExport(std::move(reader), selection));
+	if (!csv) {
+		response.send_no_memory();
+		return;
+	}
+
+	if (!partial) {
+		if (!live) {
+			response.set_header("Accept-Ranges", "bytes");
+		}
+		sendCompressible(request, response, std::move(csv), "text/csv");
+		return;
+	}
+
+	// Counted and skipped a step per server turn, not in the handler
+	char key[WEB_SELECTION_KEY_SIZE];
+	if (!selectionKey(request, recording_name, key, sizeof(key))) {
+		key[0] = '\0';
+	}
+
+	response.prepare(std::unique_ptr<HttpPreparation>(new (std::nothrow) CsvRangePreparation(
+		*this, std::move(csv), recording_name, selection, key, size, range)));
+}
+
+// GET /recordings/000xx.rec, see doc/recording-format.md
+void WebAccess::handleRecordingRaw(HttpRequest& request, HttpResponse& response) {
+	const char* recording_name = request.path_arg(0);
+
+	ExportSelection selection;
+	if (!requestedSelection(request, selection)) {
+		response.send(400, "text/plain", "400: Invalid from, to or channels");
+		return;
+	}
+
+	auto reader = _storage->open_recording(recording_name);
+	if (!reader) {
+		response.send(404, "text/plain", "404: Not found");
+		return;
+	}
+
+	if (revalidateRecording(request, response, *reader, "rec")) {
+		return;
+	}
+
+	char disposition[64];
+	snprintf(
+		disposition, sizeof(disposition), "attachment; filename=\"%s.rec\"",
+		recording_name);
+	response.set_header("Content-Disposition", disposition);
+
+	if (!selection.is_everything()) {
+		// A new recording holding the selection, its length is not known
+		// up front
+		response.send(
+			200, "application/octet-stream",
+			std::unique_ptr<ExportStream>(
+				new (std::nothrow) SelectionExport(std::move(reader), selection)));
+		return;
+	}
+
+	std::unique_ptr<RawExport> raw(new (std::nothrow) RawExport(std::move(reader)));
+	if (!raw) {
+		response.send_no_memory();
+		return;
+	}
+
+	// A recording that is still being written is sent as far as it is flushed
+	size_t size = raw->get_length();
+	size_t first = 0;
+	size_t end = size;
+
+	ByteRange range;
+	bool partial = requestedRange(request, range);
+	if (partial && !resolve_range(range, size, first, end)) {
+		sendRangeNotSatisfiable(response, size);
+		return;
+	}
+
+	// Seeks in the file, the bytes before the range are never read
+	raw->skip(first);
+
+	response.set_header("Accept-Ranges", "bytes");
+
+	if (partial) {
+		setContentRange(response, first, end, size);
+	}
+
+	response.send(
+		partial ? 206 : 200, "application/octet-stream", std::move(raw),
+		end - first);
+}
+
+// GET /recordings/000xx.edf, EDF+ for clinical tools
+void WebAccess::handleRecordingEdf(HttpRequest& request, HttpResponse& response) {
+	ExportSelection selection;
+	if (!requestedSelection(request, selection)) {
+		response.send(400, "text/plain", "400: Invalid from, to or channels");
+		return;
+	}
+
+	sendRangeExport(
+		request, response, RangeExport::Edf, request.path_arg(0), selection,
+		WfdbFormat::Packed212);
+}
+
+// GET /recordings/000xx.dat?format=212, WFDB signal file
+void WebAccess::handleRecordingWfdbData(HttpRequest& request, HttpResponse& response) {
+	ExportSelection selection;
+	WfdbFormat format;
+	if (!requestedSelection(request, selection) ||
+		!requestedWfdbFormat(request, format)) {
+		response.send(400, "text/plain", "400: Invalid from, to, channels or format");
+		return;
+	}
+
+	sendRangeExport(
+		request, response, RangeExport::WfdbData, request.path_arg(0), selection,
+		format);
+}
+
+// GET /recordings/000xx.hea?format=212, WFDB header
+void WebAccess::handleRecordingWfdbHeader(HttpRequest& request, HttpResponse& response) {
+	ExportSelection selection;
+	WfdbFormat format;
+	if (!requestedSelection(request, selection) ||
+		!requestedWfdbFormat(request, format)) {
+		response.send(400, "text/plain", "400: Invalid from, to, channels or format");
+		return;
+	}
+
+	sendRangeExport(
+		request, response, RangeExport::WfdbHeader, request.path_arg(0), selection,
+		format);
+}
+
+void WebAccess::sendRangeExport(
+	const HttpRequest& request,
+	HttpResponse& response,
+	RangeExport kind,
+	const char* recording_name,
+	const ExportSelection& selection,
+	WfdbFormat format) {
+	auto reader = _storage->open_recording(recording_name);
+	if (!reader) {
+		response.send(404, "text/plain", "404: Not found");
+		return;
+	}
+
+	if (revalidateRecording(request, response, *reader, range_export_extension(kind))) {
+		return;
+	}
+
+	char key[WEB_SELECTION_KEY_SIZE];
+	if (!selectionKey(request, recording_name, key, sizeof(key))) {
+		key[0] = '\0';
+	}
+
+	size_t size = reader->get_size();
+	const RangeScan* scan = cachedRange(key, size);
+	bool summed = scan != nullptr && scan->summed && scan->sums.format == format;
+	if (scan != nullptr && (kind != RangeExport::WfdbHeader || summed)) {
+		respondRangeExport(
+			response, kind, recording_name, selection, format, scan->range,
+			scan->sums, std::move(reader));
+		return;
+	}
+
+	// The selection is read a step per server turn, not in the handler
+	response.prepare(std::unique_ptr<HttpPreparation>(new (std::nothrow) RangePreparation(
+		*this, kind, std::move(reader), recording_name, selection, format, key,
+		size, scan != nullptr ? &scan->range : nullptr)));
+}
+
+void WebAccess::respondRangeExport(
+	HttpResponse& response,
+	RangeExport kind,
+	const char* recording_name,
+	const ExportSelection& selection,
+	WfdbFormat format,
+	const SelectionRange& range,
+	const WfdbSums& sums,
+	std::unique_ptr<RecordingReader> reader) {
+	char disposition[64];
+	snprintf(
+		disposition, sizeof(disposition), "attachment; filename=\"%s.%s\"",
+		recording_name, range_export_extension(kind));
+
+	if (kind == RangeExport::Edf) {
+		response.set_header("Content-Disposition", disposition);
+
+		size_t length = EdfExport::get_length(range);
+		response.send(
+			200, "application/octet-stream",
+			std::unique_ptr<ExportStream>(
+				new (std::nothrow) EdfExport(std::move(reader), selection, range)),
+			length);
+		return;
+	}
+
+	if (kind == RangeExport::WfdbData) {
+		// Gain and baseline of every signal follow from its range, the
+		// header request finds the same one
+		response.set_header("Content-Disposition", disposition);
+
+		size_t length = WfdbExport::get_length(range, format);
+		response.send(
+			200, "application/octet-stream",
+			std::unique_ptr<ExportStream>(
+				new (std::nothrow) WfdbExport(std::move(reader), selection, range, format)),
+			length);
+		return;
+	}
+
+	// The checksum and first sample of every signal were found with the
+	// range
+	std::unique_ptr<TextExport> header(new (std::nothrow) TextExport());
+	if (!header) {
+		response.send_no_memory();
+		return;
+	}
+	TextWriter& out = header->get_writer();
+	out.add(format_wfdb_header(
+		out.get_end(), out.get_room(), recording_name, selection, range, sums));
+
+	if (!header->is_complete()) {
+		log_e("WFDB header needs %u bytes", (unsigned) out.get_length() + 1);
+		response.send(500, "text/plain", "500: Internal server error");
+		return;
+	}
+
+	response.set_header("Content-Disposition", disposition);
+
+	size_t length = header->get_length();
+	response.send(200, "text/plain", std::move(header), length);
+}
+
+// Recordings named in names=00001,00002, in that order, or in the range
+// first=00001&last=00010 with either end open. Answers the request itself
+// if a name does not exist. Stops after one more than max, which the caller
+// turns down.
+bool WebAccess::selectedRecordings(
+	const HttpRequest& request,
+	HttpResponse& response,
+	std::vector<StorageEntry>& selected,
+	size_t max) {
+	if (request.has_arg("names")) {
+		// A list keeps its order, every name has to exist
+		const char* name = request.arg("names");
+		while (*name != '\0' && selected.size() <= max) {
+			size_t length = strcspn(name, ",");
+			if (length > 0 && !appendRecording(name, length, selected)) {
+				char text[HTTP_TEXT_SIZE];
+				snprintf(
+					text, sizeof(text), "404: No recording %.*s", (int) length, name);
+				response.send(404, "text/plain", text);
+				return false;
+			}
+
+			name += length;
+			if (*name == ',') {
+				name++;
+			}
+		}
+	} else {
+		// An inclusive range of names, either end may be left open. Listed a
+		// page at a time from the first name until one more than max.
+		const char* first = request.arg("first");
+		const char* last = request.arg("last");
+
+		char before[12];
+		name_before(first, strlen(first), before);
+		std::string after = before;
+
+		while (selected.size() <= max &&
+			   _storage->list_recordings(_listing, after.data(), WEB_CATALOG_MAX_LIMIT) &&
+			   !_listing.empty()) {
+			for (const StorageEntry& recording : _listing) {
+				if (*last != '\0' && strcmp(recording.get_name(), last) > 0) {
+					return true;
+				}
+				if (strcmp(recording.get_name(), first) >= 0) {
+					selected.push_back(recording);
+				}
+			}
+
+			after = _listing.back().get_name();
+		}
+	}
+
+	return true;
+}
+
+// GET /recordings.zip?names=00001,00002 or ?first=00001&last=00010
+void WebAccess::handleArchive(HttpRequest& request, HttpResponse& response) {
+	std::vector<StorageEntry> selected;
+	if (!selectedRecordings(request, response, selected, WEB_ARCHIVE_MAX_RECORDINGS)) {
+		return;
+	}
+
+	if (selected.size() > WEB_ARCHIVE_MAX_RECORDINGS) {
+		response.send(400, "text/plain", "400: Too many recordings for one archive");
+		return;
+	}
+
+	std::unique_ptr<ZipExport> zip(new (std::nothrow) ZipExport(_storage, std::move(selected)));
+	if (!zip) {
+		response.send_no_memory();
+		return;
+	}
+
+	// No ZIP64, offsets and the length have to fit 32 bits
+	if (zip->get_length() >= UINT32_MAX) {
+		response.send(400, "text/plain", "400: Archive over 4 GB, select fewer recordings");
+		return;
+	}
+
+	// Stored, recordings hardly compress and the card is the limit anyway.
+	// The length is known up front, so clients show progress.
+	size_t length = zip->get_length();
+	response.set_header("Content-Disposition", "attachment; filename=\"recordings.zip\"");
+	response.send(200, "application/zip", std::move(zip), length);
+}
+
+// GET /recordings/000xx/preview?width=1000
+void WebAccess::handleRecordingPreview(HttpRequest& request, HttpResponse& response) {
+	const char* recording_name = request.path_arg(0);
+
+	ExportSelection selection;
+	long width = request.has_arg("width") ? atol(request.arg("width"))
+										  : WEB_PREVIEW_WIDTH;
+	if (!requestedSelection(request, selection) || width < 1 ||
+		width > WEB_PREVIEW_MAX_WIDTH) {
+		response.send(400, "text/plain", "400: Invalid width, from, to or channels");
+		return;
+	}
+
+	auto reader = _storage->open_recording(recording_name);
+	if (!reader) {
+		response.send(404, "text/plain", "404: Not found");
+		return;
+	}
+
+	if (revalidateRecording(
+			request, response, *reader,
+			sendsGzip(request) ? "preview.gz" : "preview")) {
+		return;
+	}
+
+	// Buckets are sized from the records in the window, taken from the
+	// index of closed recordings and from the writer for the live one
+	uint32_t available = reader->get_record_count();
+	uint32_t count = available > selection.first_record
+		? std::min(available - selection.first_record, selection.record_count)
+		: 0;
+
+	sendCompressible(
+		request, response,
+		std::unique_ptr<ExportStream>(
+			new (std::nothrow) PreviewExport(std::move(reader), selection, count, width)),
+		"text/csv");
+}
+
+// GET /live?channels=0,1&decimation=4
+void WebAccess::handleLive(HttpRequest& request, HttpResponse& response) {
+	ExportSelection selection;
+	uint32_t decimation = 1;
+
+	if ((request.has_arg("channels") &&
+		 !parse_channels(request.arg("channels"), selection)) ||
+		(request.has_arg("decimation") &&
+		 !parse_count(request.arg("decimation"), decimation)) ||
+		decimation < 1 || decimation > LIVE_MAX_DECIMATION) {
+		response.send(400, "text/plain", "400: Invalid channels or decimation");
+		return;
+	}
+
+	if (!_live_samples) {
+		response.send(503, "text/plain", "503: No live samples");
+		return;
+	}
+
+	// Server-sent events for clients that can not open a WebSocket
+	if (strcasecmp(request.header("Upgrade"), "websocket") != 0) {
+		response.set_header("Cache-Control", "no-cache");
+		response.push(
+			200, "text/event-stream",
+			std::unique_ptr<HttpPushSource>(
+				new (std::nothrow) LiveEventStream(_live_samples, selection, decimation)));
+		return;
+	}
+
+	const char* key = request.header("Sec-WebSocket-Key");
+	if (strcmp(request.header("Sec-WebSocket-Version"), "13") != 0 || *key == '\0') {
+		response.set_header("Sec-WebSocket-Version", "13");
+		response.send(426, "text/plain", "426: WebSocket version 13 required");
+		return;
+	}
+
+	char accept[WEBSOCKET_ACCEPT_SIZE];
+	websocket_accept(key, accept);
+
+	response.set_header("Upgrade", "websocket");
+	response.set_header("Connection", "Upgrade");
+	response.set_header("Sec-WebSocket-Accept", accept);
+	response.push(
+		101, nullptr,
+		std::unique_ptr<HttpPushSource>(
+			new (std::nothrow) LiveWebSocket(_live_samples, selection, decimation)));
+}
+
+bool WebAccess::requestedSelection(
+	const HttpRequest& request, ExportSelection& selection) {
+	uint32_t to = UINT32_MAX;
+
+	if ((request.has_arg("from") &&
+		 !parse_seconds(request.arg("from"), selection.first_record)) ||
+		(request.has_arg("to") && !parse_seconds(request.arg("to"), to)) ||
+		to <= selection.first_record ||
+		(request.has_arg("channels") &&
+		 !parse_channels(request.arg("channels"), selection))) {
+		return false;
+	}
+
+	if (to != UINT32_MAX) {
+		selection.record_count = to - selection.first_record;
+	}
+
+	return true;
+}
+
+bool WebAccess::requestedRange(const HttpRequest& request, ByteRange& range) {
+	return request.has_header("Range") &&
+		   parse_range(request.header("Range"), range);
+}
+
+void WebAccess::sendRangeNotSatisfiable(HttpResponse& response, size_t size) {
+	char content_range[32];
+	snprintf(content_range, sizeof(content_range), "bytes */%u", (unsigned) size);
+
+	response.set_header("Content-Range", content_range);
+	response.send(416, "text/plain", "416: Range not satisfiable");
+}
+
+void WebAccess::setContentRange(
+	HttpResponse& response, size_t first, size_t end, size_t size) {
+	char content_range[48];
+	snprintf(
+		content_range, sizeof(content_range), "bytes %u-%u/%u", (unsigned) first,
+		(unsigned) (end - 1), (unsigned) size);
+
+	response.set_header("Content-Range", content_range);
+}
+
+bool WebAccess::requestedWfdbFormat(const HttpRequest& request, WfdbFormat& format) {
+	// Format 212 unless asked otherwise, it is the one every WFDB tool reads
+	format = WfdbFormat::Packed212;
+
+	if (!request.has_arg("format")) {
+		return true;
+	}
+
+	return wfdb_parse_format(request.arg("format"), format);
+}
+
+bool WebAccess::cachedCsvLength(const char* key, size_t size, size_t& length) {
+	// Every selection has its own length, selections without a key are
+	// never found
+	for (auto& entry : _csv_lengths) {
+		if (key[0] != '\0' && entry.size == size && strcmp(entry.key, key) == 0) {
+			length = entry.length;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void WebAccess::rememberCsvLength(const char* key, size_t size, size_t length) {
+	CsvLength& entry = _csv_lengths[_csv_length_next];
+	_csv_length_next = (_csv_length_next + 1) % WEB_CSV_LENGTH_CACHE;
+	strcpy(entry.key, key);
+	entry.size = size;
+	entry.length = length;
+}
+
+bool WebAccess::selectionKey(
+	const HttpRequest& request, const char* recording_name, char* key, size_t size) {
+	// The query is part of the key
+	int length = snprintf(
+		key, size, "%s?%s&%s&%s", recording_name, request.arg("from"),
+		request.arg("to"), request.arg("channels"));
+
+	return length > 0 && (size_t) length < size;
+}
+
+WebAccess::RangeScan* WebAccess::cachedRange(const char* key, size_t size) {
+	for (auto& entry : _ranges) {
+		if (key[0] != '\0' && entry.size == size && strcmp(entry.key, key) == 0) {
+			return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+void WebAccess::rememberRange(
+	const char* key, size_t size, const SelectionRange& range, const WfdbSums* sums) {
+	// The sums of another format replace those of the same selection
+	RangeScan* entry = cachedRange(key, size);
+	if (entry == nullptr) {
+		entry = &_ranges[_range_next];
+		_range_next = (_range_next + 1) % WEB_RANGE_CACHE;
+		strcpy(entry->key, key);
+		entry->size = size;
+		entry->summed = false;
+	}
+
+	entry->range = range;
+	if (sums != nullptr) {
+		entry->summed = true;
+		entry->sums = *sums;
+	}
+}
+
+bool WebAccess::isNotModified(const HttpRequest& request, const char* etag) {
+	const char* accepted = request.header("If-None-Match");
+
+	// A list of tags or "*", weak tags match as well
+	return strcmp(accepted, "*") == 0 || strstr(accepted, etag) != nullptr;
+}
+
+bool WebAccess::revalidateRecording(
+	const HttpRequest& request,
+	HttpResponse& response,
+	RecordingReader& reader,
+	const char* variant) {
+	// Recordings that still grow or get converted are sent without a tag
+	uint32_t fingerprint;
+	if (!reader.get_fingerprint(fingerprint)) {
+		return false;
+	}
+
+	// A strong tag, it names the exact bytes of the variant: the recording,
+	// the firmware that formats it and the encoding. A name used again
+	// after a removal has a different fingerprint.
+	char etag[80];
+	snprintf(
+		etag, sizeof(etag), "\"%s-%x-%08x-%08x-%s\"", reader.get_name(),
+		(unsigned) reader.get_size(), (unsigned) fingerprint,
+		(unsigned) _firmware_tag, variant);
+	response.set_header("ETag", etag);
+	response.set_header("Cache-Control", "public, max-age=31536000, immutable");
+
+	if (!isNotModified(request, etag)) {
+		return false;
+	}
+
+	// Answered without reading a record
+	response.send(304);
+	return true;
+}
+
+bool WebAccess::acceptsGzip(const HttpRequest& request) {
+	const char* gzip = strstr(request.header("Accept-Encoding"), "gzip");
+	if (gzip == nullptr) {
+		return false;
+	}
+
+	const char* parameters = gzip + 4;
+	while (*parameters == ' ') {
+		parameters++;
+	}
+	if (*parameters != ';') {
+		return true;
+	}
+
+	// "gzip;q=0" explicitly refuses it
+	const char* quality = strstr(parameters, "q=");
+	const char* next = strchr(parameters, ',');
+
+	return quality == nullptr || (next != nullptr && quality > next) ||
+		strtod(quality + 2, nullptr) > 0;
+}
+
+// Without a board with PSRAM the heap only has room for a few compressors
+bool WebAccess::sendsGzip(const HttpRequest& request) {
+	return acceptsGzip(request) &&
+		GzipExport::get_open_count() < WEB_MAX_GZIP_STREAMS;
+}
+
+void WebAccess::sendCompressible(
+	const HttpRequest& request,
+	HttpResponse& response,
+	std::unique_ptr<ExportStream> stream,
+	const char* content_type) {
+	response.set_header("Vary", "Accept-Encoding");
+
+	if (!stream || !sendsGzip(request)) {
+		response.send(200, content_type, std::move(stream));
+		return;
+	}
+
+	// CSV text shrinks to less than half, which is worth the CPU time as long
+	// as Wi-Fi is the slower part. The compressor is too large for the stack.
+	std::unique_ptr<ExportStream> gzip(new (std::nothrow) GzipExport(std::move(stream)));
+	if (!gzip) {
+		response.send_no_memory();
+		return;
+	}
+
+	response.set_header("Content-Encoding", "gzip");
+	response.send(200, content_type, std::move(gzip));
+}
+
+// GET /metrics, Prometheus text format
+void WebAccess::handleMetrics(HttpRequest& request, HttpResponse& response) {
+	// Acquisition counts every record it hands to live viewers
+	uint32_t records_acquired = _live_samples ? _live_samples->get_position() : 0;
+
+	std::unique_ptr<MetricsExport> page(new (std::nothrow) MetricsExport(records_acquired));
+	if (!page) {
+		response.send_no_memory();
+		return;
+	}
+	size_t length = page->get_length();
+
+	response.set_header("Cache-Control", "no-store");
+	response.send(200, "text/plain; version=0.0.4", std::move(page), length);
+}
+
+// PUT /recordings/000xx.rec, a .rec file to restore or replay
+void WebAccess::handleUpload(HttpRequest& request, HttpResponse& response) {
+	const char* recording_name = request.path_arg(0);
+
+	// The whole size is reserved against the quota before anything is written
+	size_t size = request.get_content_length();
+	if (size == HTTP_LENGTH_UNKNOWN) {
+		response.send(411, "text/plain", "411: Content-Length required");
+		return;
+	}
+
+	UploadError error;
+	auto upload = _storage->create_upload(recording_name, size, error);
+	if (!upload) {
+		send_upload_error(response, error);
+		return;
+	}
+
+	// The body is checked and written while it arrives, never held whole
+	response.receive(
+		std::unique_ptr<HttpBodySink>(new (std::nothrow) UploadSink(std::move(upload))));
+}
+
+// GET /recordings/000xx.csv/remove
+void WebAccess::handleRemoveRecording(HttpRequest& request, HttpResponse& response) {
+	// 000xx from the {} of the route
+	const char* recording_name = request.path_arg(0);
+
+	// Fails for the recording being written and for recordings being
+	// downloaded, remove_recording() logs why
+	bool isRemoved = _storage->remove_recording(recording_name);
+	if (!isRemoved) {
+		response.send(503, "text/plain", "503: Recording in use");
+		return;
+	}
+
+	// Back to the viewer with 303 See Other
+	response.set_header("Location", "/");
+	response.send(303);
+}
+
+// DELETE /api/recordings?names=00001,00002 or ?first=00001&last=00010
+void WebAccess::handleRemoveRecordings(HttpRequest& request, HttpResponse& response) {
+	if (!_cleaner) {
+		response.send(503, "text/plain", "503: Removal not available");
+		return;
+	}
+
+	// Unlike an archive, all recordings are never taken by default
+	if (!request.has_arg("names") && !request.has_arg("first") &&
+		!request.has_arg("last")) {
+		response.send(400, "text/plain", "400: Select recordings by names, first or last");
+		return;
+	}
+
+	std::vector<StorageEntry> selected;
+	if (!selectedRecordings(request, response, selected, CLEANER_MAX_RECORDINGS)) {
+		return;
+	}
+
+	if (selected.empty()) {
+		response.send(404, "text/plain", "404: No recordings selected");
+		return;
+	}
+
+	if (selected.size() > CLEANER_MAX_RECORDINGS) {
+		response.send(400, "text/plain", "400: Too many recordings, select fewer");
+		return;
+	}
+
+	std::vector<std::string> names;
+	names.reserve(selected.size());
+	for (auto& recording : selected) {
+		names.emplace_back(recording.get_name());
+	}
+
+	// Removed by the cleaner task between the writes of the recording, the
+	// progress is at /api/retention
+	if (!_cleaner->remove(std::move(names))) {
+		response.send(503, "text/plain", "503: Another removal is running");
+		return;
+	}
+
+	response.set_header("Location", "/api/retention");
+	sendRetention(response, 202);
+}
+
+// GET /api/retention, the policy and the last removal job
+void WebAccess::handleRetention(HttpRequest& request, HttpResponse& response) {
+	if (!_cleaner) {
+		response.send(503, "text/plain", "503: Removal not available");
+		return;
+	}
+
+	sendRetention(response, 200);
+}
+
+// PUT /api/retention?keep_days=30&max_percent=90, 0 turns a limit off
+void WebAccess::handleSetRetention(HttpRequest& request, HttpResponse& response) {
+	if (!_cleaner) {
+		response.send(503, "text/plain", "503: Removal not available");
+		return;
+	}
+
+	// A limit left out stays as it is
+	RetentionPolicy policy = _cleaner->get_policy();
+	uint32_t keep_days = policy.keep_days;
+	uint32_t max_percent = policy.max_percent;
+
+	if ((request.has_arg("keep_days") && !parse_count(request.arg("keep_days"), keep_days)) ||
+		(request.has_arg("max_percent") && !parse_count(request.arg("max_percent"), max_percent)) ||
+		keep_days > UINT16_MAX || max_percent > 100) {
+		response.send(400, "text/plain", "400: Invalid keep_days or max_percent");
+		return;
+	}
+
+	policy.keep_days = keep_days;
+	policy.max_percent = max_percent;
+	_cleaner->set_policy(policy);
+
+	sendRetention(response, 200);
+}
+
+void WebAccess::sendRetention(HttpResponse& response, int status) {
+	RetentionPolicy policy = _cleaner->get_policy();
+	RemovalProgress progress = _cleaner->get_progress();
+
+	std::unique_ptr<TextExport> json(new (std::nothrow) TextExport());
+	if (!json) {
+		response.send_no_memory();
+		return;
+	}
+	TextWriter& out = json->get_writer();
+
+	out.print(
+		"{\"keep_days\":%u,\"max_percent\":%u", (unsigned) policy.keep_days,
+		(unsigned) policy.max_percent);
+	out.print(
+		",\"removal\":{\"running\":%s,\"retention\":%s,\"total\":%u,\"removed\":%u,\"skipped\":%u",
+		progress.running ? "true" : "false", progress.retention ? "true" : "false",
+		(unsigned) progress.total, (unsigned) progress.removed,
+		(unsigned) progress.skipped);
+	out.print(
+		",\"bytes\":%llu,\"duration_ms\":%u,\"bytes_per_second\":%llu}}",
+		(unsigned long long) progress.bytes, (unsigned) progress.duration_ms,
+		(unsigned long long) (progress.duration_ms
+			? progress.bytes * 1000 / progress.duration_ms
+			: 0));
+
+	response.set_header("Cache-Control", "no-store");
+	size_t length = json->get_length();
+	response.send(status, "application/json", std::move(json), length);
+}
+
+// GET /api/quota, the bytes the recordings may take and use on the card
+void WebAccess::handleQuota(HttpRequest& request, HttpResponse& response) {
+	sendQuota(response);
+}
+
+// PUT /api/quota?megabytes=2048, 0 for the whole card
+void WebAccess::handleSetQuota(HttpRequest& request, HttpResponse& response) {
+	uint32_t megabytes;
+
+	if (!request.has_arg("megabytes") || !parse_count(request.arg("megabytes"), megabytes)) {
+		response.send(400, "text/plain", "400: Invalid megabytes");
+		return;
+	}
+
+	if (!_storage->set_quota((uint64_t) megabytes << 20)) {
+		response.send(500, "text/plain", "500: Can not save the quota");
+		return;
+	}
+
+	sendQuota(response);
+}
+
+void WebAccess::sendQuota(HttpResponse& response) {
+	auto usage = _storage->get_usage();
+	char json[160];
+
+	snprintf(
+		json, sizeof(json),
+		"{\"quota_bytes\":%llu,\"used_bytes\":%llu,\"free_bytes\":%llu,\"total_bytes\":%llu}",
+		(unsigned long long) usage.quota_bytes,
+		(unsigned long long) usage.used_bytes,
+		(unsigned long long) usage.free_bytes,
+		(unsigned long long) usage.total_bytes);
+
+	response.set_header("Cache-Control", "no-store");
+	response.send(200, "application/json", json);
+}
+
+void WebAccess::handleNotFound(HttpRequest& request, HttpResponse& response) {
+	response.send(404, "text/plain", "404: Not found");
 }
@@ -0,0 +1,283 @@
+// Generated by tools/embed_web_assets.py from web/, do not edit
+#include "webAssets.h"
+
+namespace {
+// viewer.css, 905 bytes uncompressed
+
+constexpr uint8_t asset_0[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x52, 0xd1, 0x6e, 0xa3, 0x30,
+	0x10, 0x7c, 0x0e, 0x5f, 0x61, 0x29, 0xaa, 0xd4, 0x93, 0x8e, 0x08, 0xda, 0x34, 0x0f, 0xf4, 0x6b,
+	0x16, 0x7b, 0x81, 0x55, 0x17, 0x2f, 0xb2, 0x4d, 0xd2, 0x5c, 0xd5, 0x7f, 0xaf, 0x0d, 0x24, 0x21,
+	0x6d, 0xef, 0x05, 0xec, 0xb5, 0x67, 0x76, 0x76, 0x3c, 0xb5, 0x98, 0xb3, 0xfa, 0xc8, 0x36, 0x3d,
+	0xb8, 0x96, 0x6c, 0xa5, 0x8a, 0xd7, 0x6c, 0xd3, 0x88, 0x0d, 0x79, 0x03, 0x3d, 0xf1, 0xb9, 0x52,
+	0x1e, 0xac, 0xcf, 0x3d, 0x3a, 0x6a, 0x2e, 0x27, 0x9e, 0xfe, 0x61, 0xa5, 0xca, 0xfd, 0xf0, 0xfe,
+	0x9a, 0x7d, 0x66, 0x59, 0x87, 0x60, 0xd0, 0x25, 0x0e, 0x43, 0x7e, 0x60, 0x88, 0x98, 0x86, 0x31,
+	0x9e, 0x6d, 0x80, 0xa9, 0xb5, 0x39, 0x05, 0xec, 0x7d, 0xa5, 0x6a, 0xf0, 0xc8, 0x64, 0x31, 0xd6,
+	0x5b, 0x18, 0x22, 0x1e, 0xfb, 0xb8, 0x1c, 0xc0, 0x18, 0xb2, 0x6d, 0xec, 0xbb, 0x14, 0x6a, 0xd0,
+	0x6f, 0xad, 0x93, 0xd1, 0x9a, 0x4a, 0x6d, 0x9f, 0x9e, 0xf7, 0xb1, 0xa4, 0x85, 0xc5, 0xc5, 0x5d,
+	0xd3, 0x34, 0xeb, 0x86, 0x5d, 0x99, 0x7a, 0xae, 0x15, 0xed, 0x9e, 0x12, 0x45, 0xbc, 0xd1, 0x03,
+	0xd9, 0xdf, 0x04, 0x75, 0x48, 0x6d, 0x17, 0x2a, 0xa5, 0x81, 0xf5, 0x63, 0x59, 0x14, 0xc7, 0x4e,
+	0xe5, 0xea, 0x79, 0xf7, 0x82, 0xfd, 0x9f, 0x09, 0x67, 0xe1, 0x98, 0x60, 0x27, 0x32, 0xa1, 0x8b,
+	0x7c, 0x87, 0x49, 0x91, 0x1c, 0xd1, 0x35, 0x2c, 0xa7, 0x3c, 0xf2, 0xc0, 0x18, 0x24, 0x89, 0x14,
+	0x17, 0x15, 0xe4, 0x6e, 0x66, 0x2b, 0x87, 0x77, 0xe5, 0x85, 0xc9, 0xa8, 0xad, 0xd6, 0xfa, 0x4a,
+	0x34, 0x72, 0xe2, 0x62, 0xf2, 0x51, 0x5f, 0x38, 0x73, 0x14, 0x68, 0x65, 0x1a, 0x7f, 0x6d, 0xf5,
+	0x6d, 0xfe, 0x2b, 0x8e, 0x29, 0xe1, 0x6e, 0x07, 0xbb, 0x3d, 0xf6, 0x8b, 0x39, 0x7a, 0x74, 0x3e,
+	0x59, 0x31, 0x08, 0xd9, 0x80, 0x6e, 0x05, 0xa9, 0xba, 0x24, 0xf3, 0xef, 0xb2, 0xdb, 0x45, 0xab,
+	0x51, 0x07, 0x34, 0x89, 0xe9, 0xce, 0x51, 0x83, 0xcd, 0xba, 0x91, 0xef, 0x81, 0xf9, 0xce, 0xa9,
+	0x9a, 0x45, 0xbf, 0xad, 0x4c, 0x3f, 0x1c, 0x0e, 0x13, 0xc0, 0x47, 0x3e, 0x92, 0x5f, 0x5d, 0x4d,
+	0xbf, 0xe8, 0xc2, 0xb2, 0xca, 0x0d, 0xb9, 0xf9, 0x6e, 0xf4, 0x59, 0x78, 0xec, 0x6d, 0x1a, 0x99,
+	0x6c, 0xbe, 0xb8, 0x7a, 0x3f, 0x75, 0xf2, 0x7e, 0xe2, 0xdf, 0x06, 0x11, 0xae, 0xc1, 0xfd, 0xaf,
+	0x41, 0x7e, 0x72, 0x29, 0x35, 0xe9, 0xfb, 0x3d, 0x59, 0x1a, 0x67, 0x33, 0xe6, 0x5c, 0xad, 0x28,
+	0x75, 0x07, 0xd6, 0x22, 0x7b, 0xc5, 0x50, 0x23, 0xdf, 0x52, 0x7e, 0x79, 0xb8, 0xdb, 0x55, 0x0d,
+	0xf6, 0x08, 0x7e, 0xca, 0xd3, 0x75, 0x98, 0x4b, 0x0a, 0x8a, 0xe2, 0x61, 0x99, 0xe0, 0x12, 0x9f,
+	0x62, 0xf5, 0x14, 0xad, 0x83, 0x7a, 0xee, 0xe6, 0x03, 0x84, 0x71, 0xe2, 0xf8, 0xee, 0xdd, 0xd6,
+	0xc8, 0xc9, 0xb2, 0x80, 0xf1, 0x0a, 0x7e, 0xaa, 0x28, 0x67, 0x0d, 0x5f, 0x55, 0xfe, 0xf1, 0xa2,
+	0x89, 0x03, 0x00, 0x00,
+};
+
+// viewer.js, 8835 bytes uncompressed
+
+constexpr uint8_t asset_1[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xb5, 0x5a, 0x7b, 0x73, 0xdb, 0x36,
+	0x12, 0xff, 0xdb, 0xfa, 0x14, 0xc8, 0xb4, 0x35, 0xa9, 0x58, 0xa6, 0x24, 0xd7, 0xc9, 0xf9, 0xac,
+	0x3a, 0x19, 0xc7, 0x71, 0x9a, 0xcc, 0x38, 0x8f, 0x8b, 0xd3, 0xa6, 0x57, 0x9f, 0xc7, 0x03, 0x93,
+	0x90, 0x85, 0x86, 0x22, 0x54, 0x12, 0xf4, 0xa3, 0xa9, 0xbf, 0x7b, 0x77, 0x17, 0x4f, 0xca, 0xb2,
+	0xef, 0xe6, 0xe6, 0x6e, 0x26, 0x63, 0x8a, 0xc0, 0x62, 0xb1, 0xd8, 0xe7, 0x6f, 0xc1, 0x24, 0x6d,
+	0x23, 0x58, 0xa3, 0x6b, 0x99, 0xeb, 0x64, 0xd2, 0xeb, 0x0d, 0x87, 0xec, 0x6d, 0xdb, 0x68, 0x36,
+	0xe7, 0x3a, 0x9f, 0xb1, 0xc3, 0x83, 0x1f, 0xcf, 0x8e, 0xf7, 0xdf, 0x7e, 0x38, 0x3a, 0x3c, 0xfb,
+	0xb8, 0xff, 0xe9, 0xf0, 0xec, 0xf5, 0xaf, 0x8c, 0x57, 0x05, 0x0d, 0x1f, 0xbc, 0xde, 0x7f, 0xf7,
+	0xee, 0xf0, 0xe8, 0xb8, 0x97, 0xab, 0x0a, 0xe8, 0x23, 0x2a, 0xb6, 0xc7, 0x9e, 0x8c, 0x46, 0x13,
+	0x3b, 0xe1, 0xe8, 0x60, 0x74, 0xc7, 0x8d, 0x7d, 0xd8, 0xff, 0xf1, 0xf0, 0xec, 0xf8, 0xcd, 0xaf,
+	0x86, 0xd4, 0x8d, 0x1e, 0xbd, 0xf9, 0x19, 0x46, 0x0f, 0x0f, 0xde, 0xbf, 0x7b, 0x89, 0xd4, 0xe3,
+	0xc0, 0xe2, 0xfd, 0xd1, 0xfb, 0x8f, 0x38, 0x74, 0x92, 0x7c, 0x93, 0x8f, 0x46, 0xc9, 0x80, 0x25,
+	0xdf, 0x8c, 0x9e, 0xda, 0xe7, 0x28, 0xa7, 0x67, 0x6e, 0xdf, 0x9f, 0x8e, 0xfe, 0x6e, 0xc6, 0x77,
+	0x76, 0xe8, 0xb9, 0xb3, 0x63, 0xc6, 0xb7, 0xb7, 0xb7, 0x93, 0x53, 0x38, 0x9f, 0xe1, 0xf8, 0x2d,
+	0x30, 0x93, 0x05, 0xdb, 0x7b, 0xc6, 0x0a, 0x95, 0xb7, 0x73, 0x51, 0xe9, 0xec, 0x42, 0xe8, 0xc3,
+	0x52, 0xe0, 0xcf, 0x17, 0x37, 0x6f, 0x8a, 0x54, 0x16, 0x7d, 0xb7, 0x7d, 0xce, 0xab, 0x4b, 0xde,
+	0xc0, 0x8a, 0x6f, 0xd3, 0x64, 0x51, 0x2a, 0x9d, 0x84, 0x19, 0x55, 0x69, 0x71, 0xad, 0x61, 0xca,
+	0xd0, 0x20, 0x93, 0x03, 0x33, 0x96, 0x26, 0x5b, 0x05, 0x12, 0xf6, 0x4a, 0xa1, 0x99, 0x9a, 0x4e,
+	0x1b, 0x81, 0x64, 0x70, 0x24, 0x7c, 0xaf, 0x45, 0xae, 0xea, 0x42, 0x56, 0x17, 0x30, 0x54, 0xb5,
+	0x65, 0x69, 0x46, 0x2f, 0xa5, 0xb8, 0x82, 0x81, 0xaf, 0x6c, 0x5a, 0xab, 0xf9, 0x2e, 0x1b, 0x0d,
+	0x98, 0x56, 0xf0, 0x60, 0xb7, 0x66, 0xba, 0x11, 0xa5, 0xc8, 0xb5, 0x00, 0xa9, 0xd9, 0x7e, 0x5d,
+	0xf3, 0x9b, 0x0c, 0xc9, 0xd2, 0xaf, 0xac, 0x14, 0xd5, 0x85, 0x9e, 0xed, 0x06, 0x45, 0xdf, 0x0e,
+	0x58, 0x7a, 0x36, 0x60, 0xb2, 0x8f, 0xe7, 0x93, 0x7d, 0xb3, 0x5a, 0x54, 0x97, 0xa2, 0x54, 0x0b,
+	0xd1, 0xd9, 0xb1, 0x16, 0xbf, 0xb7, 0xa2, 0xd1, 0x9d, 0xb1, 0x52, 0x5e, 0x06, 0xa2, 0xde, 0xb4,
+	0xad, 0x72, 0x2d, 0x55, 0xc5, 0xa6, 0xaa, 0x06, 0x97, 0xf8, 0x24, 0xe7, 0x22, 0x6d, 0x40, 0xfa,
+	0xaa, 0x68, 0xfa, 0xec, 0x6b, 0x6f, 0xcd, 0xe8, 0x61, 0x2e, 0xab, 0x56, 0x0b, 0x54, 0xd1, 0x5b,
+	0xae, 0x67, 0xd9, 0xb4, 0x54, 0xaa, 0x76, 0x64, 0x6c, 0xc8, 0x9e, 0x8e, 0x40, 0x88, 0xb5, 0x5a,
+	0xe8, 0xb6, 0xae, 0x3c, 0xed, 0x06, 0x4b, 0x76, 0x13, 0xf8, 0xeb, 0xe9, 0xbe, 0x43, 0xba, 0x4c,
+	0xab, 0x57, 0xf2, 0x5a, 0x14, 0xe9, 0xb8, 0x9f, 0x2d, 0x78, 0x71, 0xac, 0x79, 0xad, 0xd3, 0x6d,
+	0x30, 0xe0, 0x08, 0x95, 0x79, 0x1b, 0x09, 0x34, 0x17, 0x17, 0xfc, 0xfc, 0x06, 0x38, 0xa5, 0xf4,
+	0x97, 0xa4, 0xb1, 0x5b, 0x98, 0x11, 0xd8, 0x78, 0x3c, 0xda, 0xde, 0x79, 0xf2, 0xb7, 0xa7, 0x31,
+	0x57, 0xdc, 0x97, 0xbd, 0x7d, 0x91, 0x74, 0x99, 0x95, 0x8a, 0x17, 0x07, 0x5c, 0xf3, 0x52, 0x5d,
+	0xa4, 0xc4, 0x69, 0x2a, 0xc0, 0xfd, 0xd3, 0x64, 0xc8, 0x17, 0x72, 0xe8, 0xad, 0xd5, 0x3c, 0x37,
+	0x86, 0xdc, 0x43, 0xb9, 0xad, 0x4d, 0x81, 0xdd, 0x7a, 0x29, 0xe7, 0xd2, 0x0c, 0x7a, 0xc7, 0xee,
+	0xf7, 0xd6, 0xd6, 0x32, 0x3d, 0x13, 0x55, 0x5a, 0x8b, 0x66, 0x01, 0x4a, 0x12, 0x68, 0x0c, 0xf7,
+	0x3b, 0xfb, 0xad, 0x51, 0x55, 0xda, 0x0f, 0x44, 0xb9, 0xd9, 0x1b, 0x69, 0x60, 0xf3, 0x35, 0xab,
+	0xd6, 0xb6, 0xe1, 0x17, 0x82, 0x9c, 0x8b, 0x66, 0x33, 0x7a, 0x9f, 0x84, 0xf9, 0x95, 0x6a, 0x27,
+	0xa2, 0xac, 0x16, 0x73, 0x2e, 0x2b, 0x90, 0xf9, 0x6c, 0xd9, 0x0c, 0x6b, 0x6b, 0xe0, 0xc6, 0x44,
+	0x94, 0x80, 0x5e, 0xc0, 0x53, 0xc9, 0x61, 0x2b, 0x74, 0x82, 0xa0, 0x52, 0xc3, 0x04, 0x32, 0x43,
+	0x71, 0x66, 0xb5, 0x8b, 0x6a, 0x53, 0x53, 0xf8, 0xb3, 0x81, 0x2c, 0xd6, 0x96, 0x49, 0x7f, 0x6f,
+	0x95, 0xe6, 0x31, 0x2d, 0xae, 0x1d, 0xb0, 0x5a, 0xa9, 0x39, 0xba, 0x8e, 0x5f, 0x17, 0x09, 0xea,
+	0xa4, 0x27, 0xc1, 0x70, 0xcd, 0x0c, 0xa9, 0xfc, 0xa1, 0xd0, 0x1d, 0x70, 0x14, 0xde, 0x31, 0x2f,
+	0xf9, 0x43, 0x97, 0x92, 0x1c, 0x16, 0x0e, 0x11, 0xec, 0x92, 0x98, 0x83, 0xe1, 0x14, 0x9c, 0x7c,
+	0x51, 0xf2, 0x5c, 0x1c, 0xcc, 0x64, 0x59, 0xd4, 0xa0, 0x5a, 0x33, 0x85, 0x32, 0xa4, 0x86, 0x01,
+	0x9c, 0xb5, 0xbe, 0xc1, 0xb3, 0x38, 0xb5, 0x06, 0x3e, 0x7d, 0xa3, 0x7d, 0xbb, 0x93, 0xd4, 0x62,
+	0x0e, 0x3b, 0xf9, 0x0c, 0x91, 0xd7, 0x82, 0x6b, 0x61, 0x93, 0x44, 0x9a, 0x94, 0xd2, 0x6e, 0x6b,
+	0xc9, 0x0b, 0xa1, 0xb9, 0x2c, 0x9b, 0x07, 0x56, 0x34, 0x73, 0x5e, 0x96, 0x6e, 0x91, 0x25, 0x5f,
+	0x32, 0x41, 0x14, 0x66, 0x24, 0x67, 0x56, 0xb4, 0x35, 0x47, 0x17, 0x25, 0x0d, 0x0d, 0xbc, 0x1e,
+	0x23, 0x03, 0x18, 0xba, 0x46, 0xfe, 0x21, 0x90, 0xc6, 0xbe, 0x52, 0x14, 0x3f, 0xc7, 0x15, 0xfe,
+	0x74, 0x09, 0xdb, 0x65, 0x89, 0xdb, 0x1d, 0xcf, 0x96, 0xf1, 0xc5, 0x42, 0x54, 0x85, 0x5d, 0x51,
+	0xf1, 0xb9, 0x18, 0xb8, 0x43, 0xc4, 0x54, 0x79, 0xc9, 0x9b, 0xe6, 0x08, 0x55, 0xab, 0xd5, 0xc5,
+	0x45, 0x29, 0xe0, 0x1c, 0x36, 0x13, 0xc5, 0xdc, 0xd9, 0xfa, 0x7a, 0x78, 0x21, 0x66, 0x6c, 0x6f,
+	0x8f, 0x05, 0xd6, 0x31, 0x47, 0x55, 0xe5, 0xa5, 0xcc, 0xbf, 0xc0, 0x71, 0x53, 0xca, 0x51, 0x86,
+	0x9f, 0x91, 0x63, 0x40, 0x6a, 0xb7, 0xd4, 0x64, 0x50, 0x2b, 0x65, 0x18, 0xbe, 0xed, 0x59, 0x2f,
+	0x5e, 0xd4, 0xe2, 0x52, 0xaa, 0x16, 0xcc, 0x9f, 0xcd, 0x64, 0x51, 0x88, 0x0a, 0x38, 0xba, 0x54,
+	0x4b, 0xb9, 0xd6, 0x90, 0x55, 0xa0, 0xe1, 0x15, 0x24, 0x51, 0xb4, 0xb2, 0x67, 0x21, 0xc8, 0x34,
+	0x38, 0x72, 0x89, 0x4b, 0x6f, 0x97, 0x12, 0xce, 0x0a, 0x29, 0xd1, 0x5d, 0x1a, 0xad, 0x16, 0x47,
+	0xa0, 0x6d, 0x72, 0xb4, 0xc8, 0xcd, 0x14, 0x04, 0x76, 0x8d, 0x6e, 0xe6, 0xbd, 0x01, 0x72, 0x6d,
+	0x7d, 0x73, 0x4c, 0x5c, 0x54, 0xbd, 0x5f, 0x96, 0x20, 0x19, 0xbf, 0x64, 0xe8, 0x46, 0xc6, 0xef,
+	0x68, 0xc5, 0xc3, 0xea, 0x36, 0x4c, 0xe1, 0x70, 0x4e, 0x1b, 0xa8, 0x8b, 0xb8, 0x9a, 0x90, 0x74,
+	0x30, 0xbe, 0xba, 0x96, 0x50, 0xf4, 0xcd, 0xf9, 0xf5, 0x92, 0x6f, 0x0d, 0xd8, 0x18, 0xa2, 0x30,
+	0xaa, 0xe0, 0x7d, 0xac, 0x39, 0xa8, 0x3a, 0x2d, 0x75, 0x79, 0x37, 0x4f, 0x04, 0xab, 0x62, 0x60,
+	0x9a, 0xe3, 0x2e, 0x80, 0x35, 0x4c, 0x25, 0x51, 0xb6, 0x1c, 0x62, 0x38, 0x8b, 0x2a, 0x57, 0x85,
+	0xf8, 0xe9, 0xe3, 0x9b, 0x03, 0x35, 0x87, 0xdc, 0x87, 0x71, 0xd0, 0x75, 0x0a, 0x1b, 0x3c, 0xea,
+	0xaa, 0xc2, 0x24, 0x6c, 0xcb, 0xac, 0x7f, 0x25, 0x7f, 0xf5, 0x6f, 0x2b, 0x83, 0x3b, 0xd2, 0xf9,
+	0xc9, 0xac, 0x16, 0x53, 0x38, 0x2a, 0x48, 0x7b, 0x8a, 0xaa, 0x3f, 0x39, 0x21, 0xb1, 0x20, 0x72,
+	0xb2, 0xbc, 0xb9, 0xc4, 0xf0, 0x39, 0x38, 0xfe, 0x39, 0x39, 0x1d, 0xb0, 0x30, 0x0e, 0xe2, 0xe2,
+	0xf8, 0x0b, 0x59, 0xf1, 0xfa, 0x26, 0x39, 0x3d, 0x35, 0xa6, 0x70, 0xa9, 0xa6, 0xfa, 0xf2, 0x40,
+	0x38, 0x73, 0x13, 0x4c, 0x48, 0x95, 0xe1, 0xc6, 0x40, 0x8a, 0x0f, 0x3f, 0xd6, 0x55, 0x1a, 0xbe,
+	0xe1, 0x54, 0x38, 0x8c, 0x75, 0x6c, 0xa4, 0x35, 0xa6, 0xb4, 0xdb, 0x42, 0xee, 0x56, 0x54, 0x83,
+	0x1f, 0xde, 0xd8, 0x90, 0xb9, 0x9d, 0xe3, 0x83, 0x0e, 0xcd, 0x54, 0x12, 0x88, 0xba, 0xa2, 0x24,
+	0x1f, 0x97, 0xe7, 0x97, 0x23, 0x12, 0x04, 0x99, 0xca, 0x7a, 0x9e, 0x5a, 0x4a, 0x66, 0x2c, 0xe9,
+	0xcc, 0x86, 0xfb, 0x3c, 0x5f, 0xb2, 0x8c, 0x3d, 0x8c, 0xe1, 0x87, 0xb8, 0x67, 0x0d, 0xc7, 0x0f,
+	0x2d, 0xea, 0x48, 0x97, 0x62, 0x09, 0xdd, 0xf3, 0x1f, 0x18, 0x0e, 0x69, 0x5c, 0xb7, 0x13, 0x74,
+	0x56, 0xaa, 0xa3, 0x38, 0x4f, 0xf8, 0xc6, 0x57, 0xee, 0xef, 0x29, 0x01, 0xae, 0x6b, 0x15, 0xe6,
+	0xb5, 0xea, 0xcc, 0x82, 0x6e, 0x93, 0xf5, 0x7c, 0xc6, 0xab, 0x4a, 0x94, 0x0d, 0x51, 0xb9, 0xc0,
+	0xc9, 0x7e, 0x53, 0xb2, 0x4a, 0x93, 0x81, 0x85, 0x10, 0x08, 0x71, 0x65, 0x35, 0x84, 0x38, 0x60,
+	0x0b, 0x88, 0xa6, 0x05, 0x70, 0x28, 0xe1, 0xc4, 0x65, 0x3b, 0x87, 0x48, 0x80, 0x00, 0x83, 0x24,
+	0x78, 0x29, 0x73, 0x78, 0x28, 0x28, 0x43, 0xf8, 0x5e, 0x8b, 0xa2, 0x25, 0xb9, 0xbb, 0x80, 0x21,
+	0x1c, 0x0e, 0xcf, 0x20, 0xa7, 0x2c, 0x7d, 0x14, 0x42, 0xf1, 0xcf, 0x3f, 0xc3, 0xf6, 0x06, 0xa1,
+	0x51, 0x4e, 0x32, 0xee, 0x75, 0x07, 0x8c, 0x81, 0x5b, 0xd4, 0xfc, 0xca, 0xd4, 0x2a, 0xa3, 0x0c,
+	0x1b, 0xdb, 0xc8, 0xd5, 0xa2, 0x34, 0xb3, 0xd4, 0xbe, 0x64, 0xfc, 0x5c, 0x01, 0x32, 0xb2, 0x7e,
+	0x13, 0xe1, 0x38, 0x08, 0xfb, 0x7d, 0x9c, 0x42, 0x6b, 0xd7, 0xaa, 0x2c, 0x45, 0x9d, 0xf6, 0x43,
+	0x94, 0x5e, 0xc9, 0x82, 0xc2, 0xd4, 0x24, 0x02, 0x89, 0xc0, 0x83, 0x70, 0x2b, 0x8d, 0x0f, 0xd8,
+	0xf6, 0x68, 0x34, 0x0a, 0x31, 0xd9, 0xd6, 0xe5, 0x7f, 0x18, 0xd1, 0xdd, 0xc4, 0x6f, 0x6d, 0x31,
+	0xa4, 0xf4, 0x2c, 0xae, 0x9e, 0x13, 0x73, 0x32, 0x88, 0xd9, 0x1e, 0xed, 0xe8, 0x8c, 0x68, 0x9d,
+	0xc0, 0x64, 0x9b, 0x46, 0x73, 0x4d, 0xd9, 0xfc, 0xde, 0x9a, 0xe8, 0xfd, 0xc2, 0x80, 0x0c, 0xad,
+	0xc8, 0x33, 0x97, 0x09, 0xb4, 0xa2, 0x23, 0x1b, 0x0c, 0x07, 0xa7, 0x18, 0x40, 0x1e, 0x6c, 0xe4,
+	0x45, 0xc5, 0xcb, 0x5d, 0x07, 0x79, 0x33, 0xf3, 0xce, 0x6e, 0xff, 0x0d, 0x50, 0x23, 0x28, 0x1f,
+	0x01, 0x35, 0x03, 0xf7, 0x3b, 0x28, 0x0d, 0xe2, 0x97, 0x30, 0x18, 0x4e, 0x65, 0xd0, 0x47, 0xcd,
+	0xd3, 0x7e, 0xd6, 0x2c, 0x4a, 0x09, 0x81, 0xfa, 0xaf, 0x0a, 0x0e, 0xd3, 0x40, 0x64, 0x09, 0x40,
+	0x9e, 0x54, 0x8e, 0x22, 0xcb, 0xd3, 0x3a, 0xc8, 0xc6, 0x0b, 0xcc, 0x00, 0xb4, 0x2b, 0x3e, 0xdd,
+	0x52, 0x70, 0x56, 0x9a, 0x7b, 0xd7, 0xce, 0xcf, 0x45, 0xdd, 0x37, 0xab, 0x83, 0x93, 0x18, 0xb9,
+	0x73, 0x6c, 0xd2, 0x52, 0x51, 0xd7, 0x90, 0x02, 0x9d, 0x50, 0xe8, 0x31, 0x34, 0x62, 0x42, 0xf5,
+	0x11, 0x58, 0x90, 0x1c, 0xe2, 0x10, 0xc7, 0x12, 0x87, 0x70, 0xee, 0xd7, 0x76, 0x72, 0x04, 0xae,
+	0x8d, 0x1e, 0x3c, 0x05, 0x20, 0x00, 0x45, 0xc7, 0x96, 0xdc, 0xbb, 0xf5, 0x10, 0x74, 0x04, 0x98,
+	0x23, 0x8d, 0xda, 0x00, 0xaa, 0x26, 0xc0, 0xe2, 0x4a, 0x56, 0x90, 0x18, 0x32, 0x13, 0x46, 0x1f,
+	0x30, 0xbc, 0x3e, 0xd2, 0x0c, 0xc4, 0xc4, 0x18, 0xbd, 0x2b, 0xf2, 0xb9, 0xd0, 0x3a, 0x41, 0x02,
+	0x02, 0x01, 0x3e, 0xd3, 0xe0, 0x63, 0xc3, 0x2a, 0xd0, 0xce, 0x84, 0xbc, 0x98, 0xe9, 0x65, 0xe2,
+	0xd7, 0x66, 0xd4, 0x53, 0x9b, 0xd8, 0x3e, 0xbc, 0x04, 0x97, 0x62, 0x36, 0x11, 0x30, 0xe8, 0xc8,
+	0x1a, 0xc6, 0x59, 0xc9, 0x41, 0xc5, 0x4d, 0xce, 0xe1, 0x44, 0xe8, 0x35, 0x12, 0x06, 0x21, 0x75,
+	0xc1, 0xc2, 0xea, 0x42, 0x84, 0x23, 0xa1, 0x7e, 0x8f, 0x80, 0xb2, 0x49, 0x4d, 0x3a, 0x68, 0x06,
+	0xec, 0x92, 0x97, 0xad, 0xd8, 0xd7, 0xd1, 0x29, 0x89, 0x95, 0x97, 0xc4, 0x4a, 0x36, 0x5c, 0x8e,
+	0x76, 0x13, 0x45, 0xe4, 0x13, 0x79, 0x29, 0x78, 0xfd, 0x11, 0xb1, 0x03, 0x94, 0x61, 0xf8, 0xd7,
+	0x8d, 0xb9, 0x0e, 0x9f, 0x7e, 0xb4, 0x0c, 0xbd, 0xe1, 0xb3, 0xd5, 0xd1, 0x18, 0xfd, 0xd9, 0xef,
+	0x00, 0xfe, 0x7e, 0xc8, 0xc1, 0xf0, 0xa9, 0x3d, 0x24, 0xa0, 0x91, 0xaa, 0x10, 0xd7, 0x7d, 0xe7,
+	0x03, 0xd4, 0xc6, 0x29, 0xac, 0xff, 0x6f, 0x20, 0x8d, 0x57, 0x52, 0xdf, 0x4c, 0xec, 0xe8, 0x0c,
+	0x36, 0x81, 0xe1, 0xcd, 0x78, 0x9c, 0xea, 0x27, 0x4e, 0x5e, 0x53, 0x83, 0x0a, 0x8f, 0x1f, 0x6c,
+	0x36, 0x6c, 0xe0, 0x65, 0x63, 0xa3, 0x1f, 0x3b, 0xfb, 0x09, 0x24, 0x8d, 0x01, 0x83, 0xd4, 0x79,
+	0x0a, 0xc4, 0x56, 0x37, 0xe9, 0xb5, 0x13, 0x60, 0xe2, 0x1c, 0x50, 0x36, 0xaf, 0x90, 0xbf, 0x40,
+	0x90, 0x0f, 0xe8, 0xc6, 0x08, 0xe3, 0x93, 0x0e, 0xbc, 0x0e, 0x10, 0xe7, 0xaf, 0xa2, 0xe7, 0xd7,
+	0x40, 0x6f, 0xc5, 0xf4, 0x70, 0x05, 0xdf, 0x69, 0x57, 0xe3, 0xfb, 0x3d, 0xb3, 0xe8, 0x11, 0x8d,
+	0x23, 0x76, 0x03, 0x86, 0x16, 0x43, 0x85, 0xec, 0x69, 0x60, 0xa2, 0x91, 0xba, 0x59, 0x70, 0x04,
+	0x7e, 0x44, 0xbe, 0x49, 0xd2, 0x58, 0x57, 0xb4, 0xf3, 0x00, 0xe1, 0xf0, 0x42, 0x00, 0xcf, 0x00,
+	0xde, 0x44, 0x06, 0xde, 0x60, 0xdb, 0x61, 0x9e, 0x1c, 0x07, 0x8b, 0x23, 0x4d, 0x6d, 0xb2, 0x9d,
+	0x3e, 0x1a, 0x1c, 0x98, 0x4e, 0xec, 0x1e, 0x64, 0xb0, 0x06, 0x12, 0xee, 0x17, 0x71, 0xac, 0x6f,
+	0x88, 0xd6, 0x5c, 0x5a, 0x9c, 0x38, 0x3f, 0xfc, 0xce, 0x0e, 0x58, 0xf7, 0x38, 0x9d, 0x44, 0x0b,
+	0xcf, 0xc5, 0x85, 0xac, 0x3e, 0xc0, 0x61, 0x4d, 0x6c, 0xff, 0xaf, 0x0d, 0x62, 0x01, 0x1a, 0x72,
+	0xc3, 0xe3, 0x75, 0xc2, 0x6f, 0xe8, 0x39, 0x5b, 0x4a, 0x12, 0x08, 0x6b, 0xf8, 0x27, 0x95, 0x2e,
+	0xae, 0x07, 0xa4, 0x1a, 0xe8, 0x2a, 0xac, 0xea, 0xd0, 0x04, 0xc0, 0x82, 0xf4, 0xd1, 0xef, 0x2c,
+	0x41, 0x6f, 0x5d, 0xbd, 0x04, 0xec, 0xec, 0x96, 0xc0, 0xf0, 0xd8, 0x9b, 0xb0, 0xab, 0x36, 0x53,
+	0xa5, 0xfc, 0xe0, 0x54, 0x96, 0xa5, 0xd3, 0x24, 0x5e, 0xf2, 0x8c, 0x92, 0xc9, 0xd2, 0xec, 0x27,
+	0xba, 0x64, 0x39, 0x30, 0x4d, 0xa3, 0x0f, 0x84, 0x6d, 0xb7, 0xfd, 0x98, 0x0a, 0xd9, 0x72, 0xce,
+	0x32, 0x09, 0xd4, 0x95, 0x6b, 0x6a, 0x92, 0xc0, 0x13, 0x1e, 0xb9, 0xac, 0xec, 0xc1, 0xdf, 0x7f,
+	0x13, 0xb7, 0xdd, 0xc2, 0x1d, 0x52, 0x89, 0x63, 0x6e, 0x2d, 0x3f, 0x60, 0xc1, 0x3c, 0x10, 0xb0,
+	0xb0, 0xee, 0xc4, 0x51, 0x9c, 0x5c, 0x9f, 0x9e, 0x8c, 0x41, 0xf6, 0x2d, 0xd0, 0x17, 0x11, 0x00,
+	0x52, 0x8d, 0xe7, 0xb6, 0x3a, 0x73, 0xa7, 0x4b, 0x67, 0xfb, 0x03, 0x7a, 0xed, 0x74, 0xca, 0xb1,
+	0xb9, 0x00, 0xe9, 0x20, 0x3d, 0x42, 0xd9, 0xb8, 0x0b, 0x4c, 0x1c, 0x8a, 0x88, 0x44, 0xb5, 0x69,
+	0xcd, 0x82, 0x94, 0x10, 0x75, 0xae, 0x98, 0x82, 0x11, 0xa3, 0xba, 0xfb, 0x98, 0xb9, 0x3d, 0x46,
+	0xd9, 0x38, 0x80, 0x05, 0x8e, 0xd9, 0xd9, 0x93, 0xa1, 0xfd, 0xef, 0x59, 0x6d, 0x24, 0xb3, 0x2d,
+	0x8a, 0x21, 0x8e, 0xf6, 0x04, 0x36, 0x9b, 0x4e, 0x14, 0x47, 0x0b, 0x3b, 0xf5, 0x1d, 0xbd, 0x56,
+	0x71, 0x22, 0x89, 0xf7, 0x73, 0xda, 0x0d, 0x58, 0xc4, 0xb7, 0xce, 0x93, 0x87, 0xc1, 0x28, 0x34,
+	0x83, 0xed, 0xe2, 0xc0, 0x02, 0xc7, 0xb8, 0x9e, 0xa1, 0x23, 0x70, 0xf0, 0xeb, 0xda, 0x34, 0x25,
+	0x0e, 0x5b, 0x26, 0xbe, 0xeb, 0xc0, 0x20, 0x75, 0x01, 0x4e, 0xa1, 0xea, 0x5e, 0x7e, 0xf0, 0xb7,
+	0x71, 0x7e, 0xcc, 0xc5, 0xad, 0x2b, 0x22, 0xe7, 0xb4, 0xe6, 0xde, 0xcb, 0x05, 0x9c, 0x37, 0xfd,
+	0x85, 0x59, 0x70, 0xae, 0xae, 0x1f, 0x20, 0x97, 0xd5, 0xa2, 0xd5, 0x86, 0x1c, 0x08, 0x33, 0x7d,
+	0x43, 0x08, 0x03, 0x24, 0x16, 0xf9, 0x17, 0x18, 0x48, 0xdc, 0x04, 0x0d, 0xd0, 0x15, 0xa2, 0xae,
+	0x5b, 0xe1, 0x46, 0x01, 0xfd, 0xcf, 0xb0, 0x10, 0x7a, 0xf8, 0x4f, 0xf9, 0x65, 0xf5, 0x7d, 0xa3,
+	0xd7, 0xc9, 0x8a, 0x76, 0xd6, 0x4a, 0xd1, 0x27, 0x84, 0x41, 0xe8, 0x25, 0xa5, 0xa1, 0xb8, 0x3e,
+	0xd1, 0x80, 0x97, 0xe3, 0xb9, 0x4d, 0xba, 0xbb, 0x6c, 0x73, 0x6c, 0x97, 0x41, 0x6c, 0x83, 0xcd,
+	0x53, 0x33, 0x4e, 0x0b, 0xf0, 0xc7, 0xb3, 0x3d, 0x36, 0x0a, 0xe5, 0x02, 0x03, 0xd7, 0x21, 0x99,
+	0x06, 0xaf, 0x08, 0x7d, 0x03, 0x0e, 0xa9, 0x85, 0x81, 0x89, 0x84, 0x9d, 0x5c, 0x36, 0xbb, 0x83,
+	0x32, 0x54, 0x0f, 0x51, 0xc5, 0xae, 0x6f, 0x01, 0x35, 0xe0, 0xe5, 0x4a, 0x94, 0x4b, 0x9c, 0xee,
+	0xed, 0x69, 0x5d, 0xb3, 0x86, 0x8b, 0x0c, 0xea, 0x36, 0x68, 0xe3, 0x38, 0x47, 0x94, 0x6d, 0xfa,
+	0x04, 0xe8, 0xdc, 0xbb, 0xb7, 0xd8, 0x78, 0x9f, 0x92, 0x4b, 0xc0, 0xa6, 0x06, 0x75, 0x00, 0x66,
+	0x6f, 0x35, 0x03, 0xc8, 0x6c, 0x9d, 0x34, 0xb4, 0x1f, 0x91, 0x33, 0x86, 0xe3, 0xdc, 0xb9, 0x5d,
+	0xc0, 0xa3, 0xdf, 0xdf, 0x54, 0xac, 0x88, 0x69, 0xbb, 0x3b, 0xf2, 0x8d, 0x62, 0x6c, 0x3c, 0x30,
+	0xbf, 0x73, 0x21, 0xcb, 0xb4, 0x73, 0xe9, 0xfe, 0xb8, 0x73, 0x8d, 0x3f, 0xec, 0x64, 0xbc, 0x7e,
+	0x88, 0x75, 0x5b, 0x32, 0xba, 0xf7, 0x8e, 0x0f, 0x32, 0x0a, 0x82, 0x04, 0x2e, 0x8d, 0x02, 0x17,
+	0x70, 0x3d, 0xcb, 0x67, 0x71, 0x7e, 0x4c, 0xef, 0x69, 0x72, 0xd5, 0xec, 0x0e, 0xa9, 0xd1, 0x28,
+	0x55, 0x4e, 0x4b, 0xb2, 0x99, 0x6a, 0xe8, 0xa2, 0x75, 0x88, 0x76, 0x7f, 0x1e, 0xb7, 0x78, 0xbd,
+	0xe0, 0xa6, 0xa1, 0xc9, 0xa3, 0x06, 0x23, 0xec, 0x48, 0x9d, 0x47, 0x57, 0x00, 0xb3, 0x75, 0x76,
+	0x4e, 0x4d, 0xff, 0x27, 0x1b, 0x2c, 0x1c, 0x9d, 0xfc, 0xbc, 0x9d, 0x4e, 0x45, 0x9d, 0x84, 0x8e,
+	0x09, 0x51, 0xb2, 0xa0, 0x9b, 0x14, 0xb3, 0xc8, 0x25, 0x98, 0x66, 0x97, 0x9d, 0x9c, 0xd2, 0x35,
+	0x89, 0xbd, 0x30, 0x27, 0x42, 0xd3, 0xc7, 0xe0, 0xc8, 0x5d, 0x5c, 0x7d, 0x0c, 0xa6, 0x4c, 0x1e,
+	0x6c, 0x74, 0x12, 0xb4, 0x34, 0xed, 0x6d, 0x05, 0x54, 0xd5, 0x5c, 0x34, 0xf6, 0x12, 0x58, 0x5c,
+	0x12, 0xd1, 0xb3, 0x28, 0x89, 0xcc, 0x04, 0x2f, 0x28, 0x39, 0xa1, 0x06, 0x5f, 0x72, 0xcd, 0x7f,
+	0x86, 0x7c, 0x98, 0x12, 0x61, 0x56, 0xc0, 0x2b, 0x55, 0xad, 0xf1, 0x56, 0x94, 0x45, 0x72, 0xd5,
+	0xd2, 0x4e, 0x66, 0x25, 0x7e, 0xae, 0xf8, 0x49, 0x56, 0x7a, 0xfc, 0x14, 0xaf, 0xd8, 0x31, 0x23,
+	0xc4, 0xa4, 0x56, 0xcd, 0x77, 0xa8, 0x77, 0xd2, 0x9d, 0x88, 0xac, 0xe1, 0xf3, 0x45, 0x49, 0xfd,
+	0x0f, 0x0a, 0xf1, 0x0a, 0x02, 0x4e, 0x7f, 0xbf, 0x45, 0xf9, 0xa2, 0x23, 0xc8, 0x78, 0x6b, 0x60,
+	0x37, 0x7f, 0xec, 0x39, 0x77, 0xc1, 0x8e, 0x34, 0x19, 0x54, 0x12, 0xd8, 0x01, 0x42, 0xf8, 0xe9,
+	0xa1, 0x0e, 0xe9, 0xd6, 0xde, 0xd3, 0x36, 0xd9, 0xa2, 0x6d, 0x66, 0xa9, 0xdd, 0x37, 0x6b, 0xda,
+	0x73, 0x32, 0x5c, 0x2a, 0x23, 0xce, 0x50, 0x63, 0x25, 0x61, 0x8d, 0x78, 0x37, 0x0f, 0x3c, 0xba,
+	0xdc, 0xb0, 0xdf, 0x82, 0xfe, 0x6c, 0x34, 0x08, 0x01, 0xd2, 0x25, 0xb0, 0x81, 0xb6, 0xc9, 0x7c,
+	0x4f, 0x30, 0x22, 0x5e, 0xb7, 0x93, 0xc8, 0x4e, 0x79, 0xa9, 0x9a, 0x6e, 0xfe, 0xf4, 0x00, 0x63,
+	0xcf, 0xfa, 0x86, 0x3f, 0x4b, 0x14, 0xd1, 0x28, 0xcf, 0x6d, 0x70, 0xb6, 0x69, 0x4d, 0xf7, 0xa6,
+	0xab, 0xb8, 0x3c, 0xea, 0x72, 0x89, 0x61, 0xee, 0x5a, 0x04, 0x36, 0x56, 0x89, 0x7e, 0x17, 0x71,
+	0xac, 0x9d, 0x74, 0xe8, 0x10, 0x5b, 0x38, 0xbc, 0x71, 0xcf, 0xc4, 0xa9, 0x45, 0x38, 0xd4, 0x3c,
+	0xef, 0x57, 0x36, 0x96, 0x5e, 0xa1, 0xbc, 0x29, 0x49, 0xed, 0x34, 0xf2, 0x30, 0x49, 0xa7, 0xec,
+	0x7a, 0x45, 0xc4, 0x78, 0xcc, 0x9c, 0x0f, 0x7f, 0x65, 0x56, 0xb9, 0xa4, 0xda, 0xd4, 0x5e, 0xb5,
+	0x5d, 0xc6, 0x77, 0x26, 0xf7, 0x86, 0x9a, 0x8d, 0xa3, 0x07, 0xdb, 0xdc, 0xa4, 0x73, 0xeb, 0x42,
+	0xe9, 0x1c, 0xdd, 0x10, 0x46, 0xc2, 0x57, 0xb9, 0x9e, 0x4d, 0x80, 0xaa, 0xba, 0x9a, 0x09, 0xaa,
+	0xd7, 0x71, 0x14, 0x1a, 0xff, 0xc6, 0x5b, 0x0e, 0x78, 0xbe, 0x14, 0x53, 0xde, 0x96, 0xe6, 0x46,
+	0x86, 0x90, 0x98, 0xf5, 0x7e, 0x51, 0x6a, 0xfe, 0x4f, 0xf6, 0x8c, 0x8d, 0xa0, 0xd6, 0x8d, 0xb3,
+	0xad, 0x27, 0x50, 0xea, 0x46, 0xd9, 0xce, 0xc0, 0x30, 0xca, 0xcc, 0x55, 0xf4, 0x2f, 0x21, 0xd5,
+	0x46, 0x5d, 0x30, 0xaa, 0x6b, 0x12, 0x24, 0x98, 0x2b, 0xfc, 0xa4, 0x82, 0x4d, 0x6b, 0x57, 0x0a,
+	0x2b, 0xf0, 0x57, 0x76, 0xbd, 0x6b, 0x99, 0x1a, 0x1e, 0xbf, 0x0c, 0xec, 0xdd, 0xaf, 0x07, 0x49,
+	0xe6, 0x0e, 0xd8, 0xc1, 0xa8, 0x5b, 0x62, 0x0f, 0x15, 0xec, 0x7d, 0x55, 0xde, 0x50, 0xf9, 0x82,
+	0x96, 0x90, 0x97, 0x6c, 0xa1, 0x1a, 0x49, 0xf6, 0x91, 0x0d, 0xdd, 0x72, 0xe1, 0x67, 0x9c, 0x4a,
+	0x69, 0xe4, 0x0d, 0x6d, 0x75, 0xa3, 0xc5, 0x02, 0x2a, 0x18, 0xd1, 0x5f, 0xf1, 0x9b, 0x9e, 0x6d,
+	0xf5, 0xad, 0x78, 0xed, 0x22, 0x76, 0x5e, 0x34, 0x29, 0x49, 0xb7, 0xbe, 0xce, 0x22, 0xa8, 0x06,
+	0x9e, 0x8c, 0xa3, 0xe6, 0x05, 0xd0, 0xb7, 0x13, 0xc8, 0x8d, 0x6b, 0x65, 0x7b, 0xb9, 0x3b, 0xc5,
+	0xfb, 0xd6, 0x9f, 0xd6, 0x98, 0x07, 0xe4, 0xef, 0xee, 0x6f, 0xef, 0x4d, 0x63, 0xf5, 0x10, 0xfa,
+	0xa5, 0x55, 0x08, 0xf4, 0x3b, 0xf7, 0x73, 0xc1, 0xdd, 0xa2, 0xd2, 0xb9, 0x8c, 0x86, 0xad, 0x48,
+	0x10, 0xfe, 0x5e, 0xe8, 0x50, 0xc1, 0x66, 0x72, 0x8a, 0xbe, 0x44, 0xa7, 0xcc, 0xae, 0x81, 0xa6,
+	0x63, 0x80, 0xfe, 0x4a, 0xb3, 0x62, 0x83, 0xe9, 0x6e, 0x08, 0xee, 0x42, 0x60, 0x28, 0x61, 0x3e,
+	0x0d, 0x05, 0x2d, 0x6d, 0x98, 0xad, 0x30, 0xf3, 0xac, 0x02, 0xb8, 0x1e, 0x32, 0x77, 0x61, 0xf2,
+	0x5d, 0x74, 0xfc, 0x7f, 0xb8, 0x66, 0x8b, 0x5d, 0xb4, 0x38, 0x2f, 0xbb, 0xd7, 0xc8, 0xf4, 0x91,
+	0x0e, 0x1c, 0x1c, 0xf6, 0xb2, 0x37, 0xcc, 0xd4, 0xe6, 0xc1, 0x30, 0x86, 0xc8, 0xa6, 0xac, 0xc2,
+	0x84, 0x5f, 0x43, 0xc1, 0x33, 0xca, 0x9e, 0x60, 0x7f, 0xf1, 0x04, 0xa8, 0x1d, 0xb1, 0x6a, 0xf5,
+	0x7d, 0xd4, 0x5b, 0x11, 0xed, 0xd2, 0x7e, 0xcb, 0xfe, 0xb8, 0xd4, 0x07, 0xad, 0xfe, 0x4c, 0xb2,
+	0x42, 0xc3, 0x06, 0x31, 0xde, 0x75, 0xc8, 0x5b, 0xda, 0xd4, 0x66, 0xa1, 0xe5, 0x3d, 0xed, 0x47,
+	0xb8, 0x28, 0xd1, 0xed, 0xb2, 0x0e, 0x5c, 0xed, 0x7e, 0xc3, 0x5a, 0x21, 0xb2, 0xff, 0x8f, 0x03,
+	0xde, 0x29, 0xec, 0xc8, 0x66, 0xf8, 0x78, 0x65, 0xdb, 0xa3, 0xce, 0x27, 0xec, 0x89, 0x15, 0xcc,
+	0x7e, 0xfa, 0xba, 0x9f, 0xf3, 0xc6, 0x5e, 0x60, 0xb4, 0x92, 0x89, 0x0f, 0x30, 0x73, 0xdd, 0x17,
+	0xb3, 0x70, 0x17, 0x80, 0xab, 0xda, 0x2b, 0xb0, 0x72, 0x98, 0x5e, 0x6a, 0xb0, 0x26, 0xbd, 0xa5,
+	0x6d, 0xfe, 0x02, 0xd3, 0x95, 0xe4, 0xce, 0x83, 0x22, 0x00, 0x00,
+};
+
+// index.html, 945 bytes uncompressed
+
+constexpr uint8_t asset_2[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x53, 0xc1, 0x8e, 0xd3, 0x30,
+	0x10, 0x3d, 0xb7, 0x5f, 0x11, 0x7c, 0xe0, 0xc2, 0xa6, 0x51, 0x81, 0x4a, 0x20, 0x9c, 0x5c, 0x76,
+	0x2b, 0x84, 0x84, 0xa0, 0xa2, 0x48, 0x68, 0xb9, 0xb9, 0xf6, 0xb4, 0x31, 0x38, 0x76, 0xe5, 0x71,
+	0x52, 0x96, 0xaf, 0x67, 0x6c, 0x27, 0xdb, 0x2d, 0xab, 0x5e, 0xec, 0xf8, 0xcd, 0xbc, 0x99, 0x79,
+	0xcf, 0x0e, 0x7f, 0x71, 0xf7, 0xf5, 0xf6, 0xfb, 0xfd, 0x66, 0x5d, 0xb4, 0xa1, 0x33, 0xcd, 0x9c,
+	0x4f, 0x1b, 0x08, 0x45, 0x5b, 0x07, 0x41, 0x14, 0xb2, 0x15, 0x1e, 0x21, 0xd4, 0xac, 0x0f, 0xfb,
+	0xf2, 0x1d, 0x9b, 0x60, 0x2b, 0x3a, 0xa8, 0xd9, 0xa0, 0xe1, 0x74, 0x74, 0x3e, 0xb0, 0x42, 0x3a,
+	0x1b, 0xc0, 0x52, 0xda, 0x49, 0xab, 0xd0, 0xd6, 0x0a, 0x06, 0x2d, 0xa1, 0x4c, 0x87, 0x9b, 0x42,
+	0x5b, 0x1d, 0xb4, 0x30, 0x25, 0x4a, 0x61, 0xa0, 0x5e, 0xc6, 0x22, 0x41, 0x07, 0x03, 0xcd, 0x7a,
+	0xbb, 0x29, 0x3f, 0x6d, 0xef, 0xca, 0xf5, 0xed, 0x47, 0x5e, 0x65, 0x68, 0xce, 0x8d, 0xb6, 0xbf,
+	0x0b, 0x0f, 0xa6, 0x66, 0x18, 0x1e, 0x0c, 0x60, 0x0b, 0x40, 0x0d, 0x5a, 0x0f, 0xfb, 0x9a, 0x55,
+	0x02, 0x69, 0x18, 0xac, 0x62, 0x63, 0xf0, 0x0b, 0xf1, 0x7a, 0xbf, 0xdc, 0xc3, 0x6a, 0xb5, 0x90,
+	0x88, 0xb1, 0x6a, 0x35, 0x4e, 0xbe, 0x73, 0xea, 0x61, 0xd4, 0x01, 0xbe, 0x99, 0xcf, 0x78, 0xbb,
+	0xbc, 0xec, 0x45, 0x67, 0x42, 0xf1, 0x28, 0x6c, 0xa1, 0x15, 0x69, 0x43, 0x71, 0x00, 0xd6, 0xf0,
+	0x2a, 0x22, 0x53, 0x9d, 0xc8, 0xe4, 0x9d, 0xd0, 0x36, 0xa6, 0x5a, 0x31, 0xd0, 0x36, 0xe3, 0xbd,
+	0x49, 0x04, 0x0f, 0xd2, 0x79, 0xa5, 0xed, 0x01, 0x23, 0xab, 0x37, 0x29, 0x76, 0x8c, 0xeb, 0x8c,
+	0xef, 0xfa, 0x10, 0x5c, 0xae, 0x7b, 0xf4, 0xe4, 0x83, 0xeb, 0x91, 0xc6, 0xd7, 0x4a, 0x81, 0x6d,
+	0x36, 0x23, 0xc0, 0xab, 0x9c, 0xf5, 0x8c, 0x61, 0xe1, 0x4f, 0x78, 0xcc, 0xfe, 0x42, 0x87, 0xa7,
+	0x99, 0xbc, 0x8a, 0x2d, 0x78, 0x95, 0x87, 0xe1, 0x08, 0x32, 0xe8, 0x31, 0xa2, 0xf4, 0x90, 0xf8,
+	0xc1, 0x39, 0xb3, 0x13, 0x9e, 0xe5, 0xc2, 0x18, 0xbc, 0xb3, 0x87, 0x1c, 0x88, 0xee, 0xb2, 0x66,
+	0x0b, 0x86, 0x58, 0x85, 0x28, 0x1e, 0x15, 0x90, 0xe8, 0x94, 0x35, 0x32, 0x26, 0x4b, 0xe8, 0xde,
+	0xad, 0x05, 0x83, 0x67, 0x57, 0xfe, 0x9b, 0xf4, 0xaf, 0x73, 0x5d, 0xe9, 0x7a, 0x9a, 0x36, 0x95,
+	0xae, 0xd9, 0x4f, 0x02, 0x8a, 0x08, 0x34, 0x2f, 0x3b, 0x6d, 0x7b, 0xfc, 0x70, 0x55, 0x64, 0xa2,
+	0x6a, 0x7b, 0xc9, 0xa4, 0x73, 0xf3, 0xea, 0x2a, 0xc5, 0x03, 0xc2, 0xb9, 0xd5, 0x8f, 0xd6, 0x19,
+	0x38, 0x4b, 0x60, 0xcd, 0xb7, 0x18, 0xbe, 0x4a, 0x36, 0x7a, 0x20, 0xe9, 0x9f, 0x69, 0xbd, 0x74,
+	0x93, 0x4c, 0x4b, 0x1f, 0x52, 0xd8, 0x41, 0x60, 0xbe, 0x31, 0xe3, 0x42, 0x94, 0x9c, 0xa1, 0x0b,
+	0x6b, 0x31, 0x88, 0xd0, 0x27, 0x3f, 0x26, 0xde, 0x14, 0x51, 0xee, 0x64, 0x8d, 0x13, 0xea, 0x49,
+	0x90, 0x4c, 0x9b, 0x6e, 0x87, 0x57, 0xf9, 0x11, 0x71, 0x94, 0x5e, 0x1f, 0x43, 0x81, 0x5e, 0x3e,
+	0x7b, 0xc8, 0x12, 0xe0, 0xed, 0xfb, 0x95, 0x7a, 0xb3, 0xf8, 0x95, 0x0d, 0x4f, 0x99, 0x91, 0x3a,
+	0xbe, 0xe4, 0x2a, 0xff, 0x99, 0xff, 0x00, 0xbb, 0x4a, 0x24, 0xb8, 0xb1, 0x03, 0x00, 0x00,
+};
+}
+
+const WebAsset WEB_ASSETS[] = {
+	{ "/assets/viewer.a2f1fe55.css", "text/css", asset_0, sizeof(asset_0), "\"037b6569\"", true },
+	{ "/assets/viewer.cee495d3.js", "text/javascript", asset_1, sizeof(asset_1), "\"0b76787f\"", true },
+	{ "/", "text/html", asset_2, sizeof(asset_2), "\"36ae5cd5\"", false },
+};
+
+const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);
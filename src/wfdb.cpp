@@ -0,0 +1,230 @@
+#include "wfdb.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The gain is written with this many significant digits
+static const char* GAIN_FORMAT = "%.5g";
+
+// Largest digital value, the negated value is the smallest. One below it
+// marks an invalid sample.
+static int32_t digital_limit(WfdbFormat format) {
+	return format == WfdbFormat::Packed212 ? 2047 : 32767;
+}
+
+bool wfdb_parse_format(const char* text, WfdbFormat& format) {
+	if (strcmp(text, "212") == 0) {
+		format = WfdbFormat::Packed212;
+		return true;
+	}
+	if (strcmp(text, "16") == 0) {
+		format = WfdbFormat::Int16;
+		return true;
+	}
+	return false;
+}
+
+WfdbSignal wfdb_scaling(WfdbFormat format, float min, float max) {
+	WfdbSignal signal;
+
+	// A flat signal still needs a range
+	double span = max > min ? (double) max - min : 1.0;
+	double gain = 2.0 * digital_limit(format) / span;
+
+	// Rounded down, so the range still fits
+	double unit = pow(10.0, floor(log10(gain)) - 4);
+	gain = floor(gain / unit) * unit;
+
+	char text[32];
+	snprintf(text, sizeof(text), GAIN_FORMAT, gain);
+	signal.gain = strtof(text, nullptr);
+	signal.baseline = -(int32_t) lround(((double) min + max) / 2 * signal.gain);
+
+	return signal;
+}
+
+uint64_t wfdb_data_size(WfdbFormat format, uint64_t sample_count) {
+	return format == WfdbFormat::Packed212 ? (sample_count + 1) / 2 * 3
+										   : sample_count * sizeof(int16_t);
+}
+
+WfdbEncoder::WfdbEncoder(
+	WfdbFormat format, uint8_t channel_count, const WfdbSignal signals[])
+	: _format(format), _channel_count(channel_count) {
+	for (uint8_t i = 0; i < channel_count; i++) {
+		_signals[i] = signals[i];
+		_signals[i].initial_value = 0;
+		_signals[i].checksum = 0;
+		_gain[i] = signals[i].gain;
+		_baseline[i] = signals[i].baseline;
+		_sums[i] = 0;
+	}
+}
+
+size_t WfdbEncoder::encode(const float samples[], size_t frame_count, uint8_t out[]) {
+	const int32_t limit = digital_limit(_format);
+	const float low = -limit;
+	const float high = limit;
+	const int32_t invalid = -limit - 1;
+
+	// The sample a previous block left over goes first
+	int16_t* digital = _digital + (_pending ? 1 : 0);
+	size_t count = frame_count * _channel_count;
+
+	for (size_t frame = 0; frame < frame_count; frame++) {
+		const float* in = samples + frame * _channel_count;
+		int16_t* quantized = digital + frame * _channel_count;
+
+		for (uint8_t i = 0; i < _channel_count; i++) {
+			float value = std::min(std::max(low, in[i] * _gain[i] + _baseline[i]), high);
+			// Rounded by truncating a positive value
+			int32_t rounded = (int32_t) (value + (float) limit + 0.5f) - limit;
+			int32_t sample = in[i] == in[i] ? rounded : invalid;
+
+			quantized[i] = sample;
+			_sums[i] += sample;
+		}
+	}
+
+	if (!_started && frame_count > 0) {
+		for (uint8_t i = 0; i < _channel_count; i++) {
+			_signals[i].initial_value = digital[i];
+		}
+		_started = true;
+	}
+
+	for (uint8_t i = 0; i < _channel_count; i++) {
+		_signals[i].checksum = _sums[i];
+	}
+
+	if (_format == WfdbFormat::Int16) {
+		// Both the ESP32 and hosts are little endian
+		memcpy(out, digital, count * sizeof(int16_t));
+		return count * sizeof(int16_t);
+	}
+
+	size_t total = count + (_pending ? 1 : 0);
+	uint8_t* packed = out;
+
+	for (size_t i = 0; i + 1 < total; i += 2) {
+		uint16_t first = _digital[i] & 0xfff;
+		uint16_t second = _digital[i + 1] & 0xfff;
+
+		packed[0] = first;
+		packed[1] = (first >> 8) | ((second >> 8) << 4);
+		packed[2] = second;
+		packed += 3;
+	}
+
+	_pending = total % 2 == 1;
+	if (_pending) {
+		_digital[0] = _digital[total - 1];
+	}
+
+	return packed - out;
+}
+
+size_t WfdbEncoder::finish(uint8_t out[]) {
+	if (!_pending) {
+		return 0;
+	}
+
+	// Paired with a 0 nobody reads, the header has the number of samples
+	uint16_t last = _digital[0] & 0xfff;
+	out[0] = last;
+	out[1] = last >> 8;
+	out[2] = 0;
+	_pending = false;
+
+	return 3;
+}
+
+WfdbFormat WfdbEncoder::get_format() const {
+	return _format;
+}
+
+uint8_t WfdbEncoder::get_channel_count() const {
+	return _channel_count;
+}
+
+const WfdbSignal& WfdbEncoder::get_signal(uint8_t channel) const {
+	return _signals[channel];
+}
+
+template <typename SignalAt>
+static size_t format_header(
+	char* out,
+	size_t size,
+	const char* record_name,
+	uint32_t frequency,
+	uint32_t frame_count,
+	WfdbFormat format,
+	uint8_t channel_count,
+	SignalAt signal_at,
+	const uint8_t channels[],
+	const char* units) {
+	size_t length = 0;
+	auto print = [&](const char* text, auto... args) {
+		int count = snprintf(
+			out + std::min(length, size), length < size ? size - length : 0,
+			text, args...);
+		if (count > 0) {
+			length += count;
+		}
+	};
+
+	print("%s %u %u %u\n", record_name, channel_count, (unsigned) frequency, (unsigned) frame_count);
+
+	for (uint8_t i = 0; i < channel_count; i++) {
+		const WfdbSignal& signal = signal_at(i);
+		char gain[32];
+		snprintf(gain, sizeof(gain), GAIN_FORMAT, signal.gain);
+
+		// File, format, gain(baseline)/units, ADC resolution and zero,
+		// initial value, checksum, block size and description
+		print(
+			"%s.dat %u %s(%d)/%s %u 0 %d %d 0 ECG %u\n", record_name,
+			(unsigned) format, gain, (int) signal.baseline, units,
+			format == WfdbFormat::Packed212 ? 12u : 16u,
+			(int) signal.initial_value, (int) (int16_t) signal.checksum,
+			(unsigned) channels[i]);
+	}
+
+	return length;
+}
+
+size_t wfdb_format_header(
+	char* out,
+	size_t size,
+	const char* record_name,
+	uint32_t frequency,
+	uint32_t frame_count,
+	const WfdbEncoder& encoder,
+	const uint8_t channels[],
+	const char* units) {
+	return format_header(
+		out, size, record_name, frequency, frame_count, encoder.get_format(),
+		encoder.get_channel_count(),
+		[&](uint8_t i) -> const WfdbSignal& { return encoder.get_signal(i); },
+		channels, units);
+}
+
+size_t wfdb_format_header(
+	char* out,
+	size_t size,
+	const char* record_name,
+	uint32_t frequency,
+	uint32_t frame_count,
+	WfdbFormat format,
+	uint8_t channel_count,
+	const WfdbSignal signals[],
+	const uint8_t channels[],
+	const char* units) {
+	return format_header(
+		out, size, record_name, frequency, frame_count, format, channel_count,
+		[&](uint8_t i) -> const WfdbSignal& { return signals[i]; }, channels,
+		units);
+}
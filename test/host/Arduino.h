@@ -0,0 +1,47 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// The parts of the Arduino core for the ESP32 that the storage and web code
+// use, so that they build and run on a computer for tests
+
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include <freertos/FreeRTOS.h>
+
+// Errors and warnings go to stderr, the rest would drown the test output
+#define log_e(format, ...) fprintf(stderr, "[E] " format "\n", ##__VA_ARGS__)
+#define log_w(format, ...) fprintf(stderr, "[W] " format "\n", ##__VA_ARGS__)
+#define log_i(format, ...) ((void) 0)
+#define log_d(format, ...) ((void) 0)
+#define log_v(format, ...) ((void) 0)
+
+inline std::chrono::steady_clock::time_point host_start_time() {
+	static const auto start = std::chrono::steady_clock::now();
+	return start;
+}
+
+inline uint32_t millis() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+			   std::chrono::steady_clock::now() - host_start_time())
+		.count();
+}
+
+inline uint32_t micros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			   std::chrono::steady_clock::now() - host_start_time())
+		.count();
+}
+
+inline void delay(uint32_t ms) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void yield() {}
+
+#endif
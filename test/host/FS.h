@@ -0,0 +1,199 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+// Files of the card as files below a directory of the computer
+
+#include <Arduino.h>
+#include <dirent.h>
+#include <errno.h>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+namespace fs {
+
+// Calls into the card driver on this thread. The driver of the device
+// allocates a handle for every open file as well, tests that count the
+// allocations of the firmware leave out those made while this is above 0.
+inline thread_local int driver_calls = 0;
+
+struct DriverCall {
+	DriverCall() { driver_calls++; }
+	~DriverCall() { driver_calls--; }
+};
+
+class File {
+	struct Handle {
+		std::string path;
+		FILE* file = nullptr;
+		DIR* dir = nullptr;
+		std::string host_path;
+
+		~Handle() {
+			if (file != nullptr) {
+				fclose(file);
+			}
+			if (dir != nullptr) {
+				closedir(dir);
+			}
+		}
+	};
+
+	std::shared_ptr<Handle> _handle;
+
+	explicit File(std::shared_ptr<Handle> handle) : _handle(handle) {}
+
+	friend class FS;
+
+public:
+	File() = default;
+
+	size_t write(const uint8_t* data, size_t length) {
+		return _handle && _handle->file ? fwrite(data, 1, length, _handle->file) : 0;
+	}
+
+	size_t read(uint8_t* data, size_t length) {
+		return _handle && _handle->file ? fread(data, 1, length, _handle->file) : 0;
+	}
+
+	bool seek(uint32_t position, SeekMode mode = SeekSet) {
+		return _handle && _handle->file && fseek(_handle->file, position, mode) == 0;
+	}
+
+	size_t position() const {
+		return _handle && _handle->file ? ftell(_handle->file) : 0;
+	}
+
+	size_t size() const {
+		if (!_handle || !_handle->file) {
+			return 0;
+		}
+
+		long position = ftell(_handle->file);
+		fseek(_handle->file, 0, SEEK_END);
+		long size = ftell(_handle->file);
+		fseek(_handle->file, position, SEEK_SET);
+		return size;
+	}
+
+	void flush() {
+		if (_handle && _handle->file) {
+			fflush(_handle->file);
+		}
+	}
+
+	void close() { _handle.reset(); }
+
+	operator bool() const { return (bool) _handle; }
+
+	const char* path() const { return _handle ? _handle->path.c_str() : ""; }
+
+	const char* name() const {
+		if (!_handle) {
+			return "";
+		}
+		return _handle->path.c_str() + _handle->path.rfind('/') + 1;
+	}
+
+	bool isDirectory() const { return _handle && _handle->dir; }
+
+	File openNextFile(const char* mode = FILE_READ);
+};
+
+class FS {
+	std::string _root = "/tmp/sd";
+
+public:
+	// Directory of the computer that stands for the root of the card
+	void set_host_root(const std::string& root) { _root = root; }
+
+	std::string host_path(const char* path) const { return _root + path; }
+
+	File open(const char* path, const char* mode = FILE_READ, bool create = false) {
+		DriverCall call;
+		auto handle = std::make_shared<File::Handle>();
+		handle->path = path;
+		handle->host_path = host_path(path);
+
+		struct stat status;
+		if (stat(handle->host_path.c_str(), &status) == 0 && S_ISDIR(status.st_mode)) {
+			handle->dir = opendir(handle->host_path.c_str());
+			return handle->dir ? File(handle) : File();
+		}
+
+		const char* host_mode = "rb";
+		if (strcmp(mode, FILE_WRITE) == 0) {
+			host_mode = "w+b";
+		} else if (strcmp(mode, FILE_APPEND) == 0) {
+			host_mode = "a+b";
+		}
+
+		handle->file = fopen(handle->host_path.c_str(), host_mode);
+		return handle->file ? File(handle) : File();
+	}
+
+	bool exists(const char* path) const {
+		DriverCall call;
+		struct stat status;
+		return stat(host_path(path).c_str(), &status) == 0;
+	}
+
+	bool remove(const char* path) {
+		DriverCall call;
+		return unlink(host_path(path).c_str()) == 0;
+	}
+
+	bool rename(const char* from, const char* to) {
+		DriverCall call;
+		return ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+	}
+
+	bool mkdir(const char* path) {
+		DriverCall call;
+		return ::mkdir(host_path(path).c_str(), 0777) == 0 || errno == EEXIST;
+	}
+
+	bool rmdir(const char* path) {
+		DriverCall call;
+		return ::rmdir(host_path(path).c_str()) == 0;
+	}
+};
+
+inline File File::openNextFile(const char* mode) {
+	DriverCall call;
+	if (!_handle || !_handle->dir) {
+		return File();
+	}
+
+	while (dirent* entry = readdir(_handle->dir)) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+			continue;
+		}
+
+		std::string path = _handle->path;
+		if (path != "/") {
+			path += "/";
+		}
+		path += entry->d_name;
+
+		FS fs;
+		fs.set_host_root(_handle->host_path.substr(
+			0, _handle->host_path.size() - _handle->path.size()));
+		return fs.open(path.c_str(), mode);
+	}
+	return File();
+}
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+
+enum wifi_mode_t { WIFI_MODE_NULL, WIFI_MODE_STA, WIFI_MODE_AP, WIFI_MODE_APSTA };
+
+// The access point is always up, the computer's interfaces serve it
+class WiFiClass {
+public:
+	wifi_mode_t getMode() { return WIFI_MODE_AP; }
+};
+
+inline WiFiClass WiFi;
+
+#endif
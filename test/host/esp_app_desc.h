@@ -0,0 +1,15 @@
+#ifndef HOST_ESP_APP_DESC_H
+#define HOST_ESP_APP_DESC_H
+
+#include <stdint.h>
+
+struct esp_app_desc_t {
+	uint8_t app_elf_sha256[32];
+};
+
+inline const esp_app_desc_t* esp_app_get_description() {
+	static const esp_app_desc_t description = { { 0x12, 0x34, 0x56, 0x78 } };
+	return &description;
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+// Figures of an ESP32 without PSRAM after start
+inline size_t heap_caps_get_total_size(uint32_t caps) {
+	return caps & MALLOC_CAP_SPIRAM ? 0 : 300000;
+}
+
+inline size_t heap_caps_get_free_size(uint32_t caps) {
+	return caps & MALLOC_CAP_SPIRAM ? 0 : 150000;
+}
+
+inline size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+	return caps & MALLOC_CAP_SPIRAM ? 0 : 120000;
+}
+
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) {
+	return caps & MALLOC_CAP_SPIRAM ? 0 : 110000;
+}
+
+#endif
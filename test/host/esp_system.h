@@ -0,0 +1,9 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+inline uint32_t esp_random() { return (uint32_t) random(); }
+
+#endif
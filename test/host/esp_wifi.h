@@ -0,0 +1,24 @@
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+struct wifi_sta_info_t {
+	uint8_t mac[6];
+	int8_t rssi;
+};
+
+struct wifi_sta_list_t {
+	wifi_sta_info_t sta[10];
+	int num;
+};
+
+inline esp_err_t esp_wifi_ap_get_sta_list(wifi_sta_list_t* list) {
+	list->num = 0;
+	return ESP_OK;
+}
+
+#endif
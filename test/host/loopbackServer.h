@@ -0,0 +1,248 @@
+#ifndef HOST_LOOPBACK_SERVER_H
+#define HOST_LOOPBACK_SERVER_H
+
+// The web server of the firmware on the computer for the web tests: the card
+// is a temporary directory, lwIP's sockets are the computer's on the
+// loopback, and a blocking client requests from it like a browser.
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <SD.h>
+#include <SPI.h>
+#include <lwip/sockets.h>
+
+#include "storage.h"
+#include "testTiming.h"
+#include "webAccess.h"
+
+struct LoopbackResponse {
+	int status = 0;
+	size_t length = 0;
+	double seconds = 0;
+	bool gzip = false;
+};
+
+// A blocking HTTP/1.1 client on the loopback that keeps its connection,
+// reads responses with a Content-Length or in chunks
+class LoopbackClient {
+	int _socket = -1;
+	std::string _buffer;
+
+	bool fill() {
+		char data[16384];
+		ssize_t count = recv(_socket, data, sizeof(data), 0);
+		if (count <= 0) {
+			return false;
+		}
+		_buffer.append(data, count);
+		return true;
+	}
+
+	bool read_line(std::string& line) {
+		size_t end;
+		while ((end = _buffer.find("\r\n")) == std::string::npos) {
+			if (!fill()) {
+				return false;
+			}
+		}
+		line = _buffer.substr(0, end);
+		_buffer.erase(0, end + 2);
+		return true;
+	}
+
+	// Reads and drops length bytes, at most bytes_per_second fast if given
+	bool skip(size_t length, size_t bytes_per_second) {
+		auto start = std::chrono::steady_clock::now();
+		size_t done = 0;
+
+		while (done < length) {
+			if (_buffer.empty() && !fill()) {
+				return false;
+			}
+			size_t count = std::min(length - done, _buffer.size());
+			_buffer.erase(0, count);
+			done += count;
+
+			if (bytes_per_second > 0) {
+				double ahead = (double) done / bytes_per_second - seconds_since(start);
+				if (ahead > 0) {
+					std::this_thread::sleep_for(std::chrono::duration<double>(ahead));
+				}
+			}
+		}
+		return true;
+	}
+
+public:
+	// A small receive buffer keeps a slow client from taking a whole body
+	// into the kernel at once
+	explicit LoopbackClient(uint16_t port, int receive_buffer = 0) {
+		_socket = socket(AF_INET, SOCK_STREAM, 0);
+		if (receive_buffer > 0) {
+			setsockopt(
+				_socket, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+		}
+
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (connect(_socket, (sockaddr*) &address, sizeof(address)) != 0) {
+			close(_socket);
+			_socket = -1;
+		}
+	}
+
+	~LoopbackClient() {
+		if (_socket >= 0) {
+			close(_socket);
+		}
+	}
+
+	LoopbackClient(const LoopbackClient&) = delete;
+	LoopbackClient& operator=(const LoopbackClient&) = delete;
+
+	// Ends the connection in the middle of a response, a get() blocked in
+	// another thread returns
+	void abort() {
+		if (_socket >= 0) {
+			shutdown(_socket, SHUT_RDWR);
+		}
+	}
+
+	// headers are added to the request, each ending in \r\n
+	LoopbackResponse get(
+		const std::string& path, size_t bytes_per_second = 0, const char* headers = "") {
+		LoopbackResponse response;
+		auto start = std::chrono::steady_clock::now();
+
+		std::string request = "GET " + path + " HTTP/1.1\r\nHost: test\r\n" + headers + "\r\n";
+		if (_socket < 0 || send(_socket, request.data(), request.size(), 0) < 0) {
+			return response;
+		}
+
+		std::string line;
+		if (!read_line(line) || sscanf(line.c_str(), "HTTP/1.1 %d", &response.status) != 1) {
+			response.status = 0;
+			return response;
+		}
+
+		bool chunked = false;
+		while (read_line(line) && !line.empty()) {
+			if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0) {
+				response.length = strtoul(line.c_str() + 15, nullptr, 10);
+			} else if (strncasecmp(line.c_str(), "Transfer-Encoding: chunked", 26) == 0) {
+				chunked = true;
+			} else if (strncasecmp(line.c_str(), "Content-Encoding: gzip", 22) == 0) {
+				response.gzip = true;
+			}
+		}
+
+		if (!chunked) {
+			if (!skip(response.length, bytes_per_second)) {
+				response.status = 0;
+			}
+		} else {
+			response.length = 0;
+			while (read_line(line)) {
+				size_t size = strtoul(line.c_str(), nullptr, 16);
+				if (!skip(size + 2, bytes_per_second)) {
+					response.status = 0;
+					break;
+				}
+				response.length += size;
+				if (size == 0) {
+					break;
+				}
+			}
+		}
+
+		response.seconds = seconds_since(start);
+		return response;
+	}
+};
+
+// Storage on a temporary directory with recordings of sines, and the web
+// server on its own task
+class LoopbackServer {
+	std::string _root;
+	uint16_t _port;
+
+public:
+	std::shared_ptr<Storage> storage;
+	std::shared_ptr<WebAccess> web;
+	std::vector<std::string> names;
+
+	explicit LoopbackServer(uint16_t port) : _port(port) {}
+
+	// Mounts an empty card in a new directory named after the test
+	bool mount(const char* test_name) {
+		std::string pattern = std::string("/tmp/") + test_name + "_XXXXXX";
+		std::vector<char> root(pattern.begin(), pattern.end());
+		root.push_back('\0');
+		if (mkdtemp(root.data()) == nullptr) {
+			return false;
+		}
+		_root = root.data();
+		SD.set_host_root(_root);
+
+		static SPIClass spi(HSPI);
+		static std::mutex spi_mutex;
+		storage = std::make_shared<Storage>(spi, spi_mutex);
+		return true;
+	}
+
+	// Closed recordings of count records, each channel a sine of its own
+	// frequency
+	void add_recordings(int recordings, int count) {
+		float record[ECG_CHANNELS];
+		for (int i = 0; i < recordings; i++) {
+			names.push_back(
+				storage->create_new_recording(recording_format::BlockCodec::DeltaFloat32));
+			for (int r = 0; r < count; r++) {
+				for (int channel = 0; channel < ECG_CHANNELS; channel++) {
+					record[channel] = sinf(r * 0.01f * (channel + 1)) * 1.5f;
+				}
+				storage->write_record(record, ECG_CHANNELS);
+			}
+			storage->close_recording();
+		}
+	}
+
+	// Runs the server on a task that never returns, like on the device, and
+	// waits until it listens. on_task runs first on that task.
+	void start(void (*on_task)() = nullptr) {
+		web = std::make_shared<WebAccess>(storage, _port);
+		std::thread([this, on_task] {
+			if (on_task != nullptr) {
+				on_task();
+			}
+			web->loop();
+		}).detach();
+
+		for (int i = 0; i < 100 && LoopbackClient(_port).get("/api/recordings").status != 200;
+			 i++) {
+			usleep(10000);
+		}
+	}
+
+	uint16_t get_port() const { return _port; }
+
+	// Removes the card. The server keeps running under its task, the test
+	// leaves with _exit().
+	void remove() { std::filesystem::remove_all(_root); }
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef HOST_LWIP_SOCKETS_H
+#define HOST_LWIP_SOCKETS_H
+
+// lwIP's BSD sockets are the computer's
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// lwIP keeps about 5.7 KB unacknowledged per connection, the computer's
+// kernel grows its buffers to megabytes and would hide slow clients
+inline int host_accept(int socket, struct sockaddr* address, socklen_t* length) {
+	int connection = ::accept(socket, address, length);
+	if (connection >= 0) {
+		int size = 5744;
+		setsockopt(connection, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	}
+	return connection;
+}
+
+#define accept host_accept
+
+#endif
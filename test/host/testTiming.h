@@ -0,0 +1,13 @@
+#ifndef HOST_TEST_TIMING_H
+#define HOST_TEST_TIMING_H
+
+// Timing shared by the tests that print figures
+
+#include <chrono>
+
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+		.count();
+}
+
+#endif
@@ -0,0 +1,192 @@
+// CRC-32 of the recording blocks: known values, and what it costs next to
+// writing the blocks. Run with `pio test -e native -f test_crc32 -v` to see
+// the figures.
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <unity.h>
+
+#include "crc32.h"
+#include "recordingFormat.h"
+#include "testTiming.h"
+
+using namespace recording_format;
+
+// Recorded signal pushed through the benchmarks
+constexpr size_t BENCHMARK_BYTES = 64 * 1024 * 1024;
+
+// Storage::init() runs the card at 4 MHz, one bit per clock, so it takes at
+// most 500 KB/s
+constexpr double CARD_BYTES_PER_SECOND = 4000000 / 8;
+// How much slower the 240 MHz ESP32 is than a desktop core at table driven
+// CRC, generously
+constexpr double ESP32_SLOWDOWN = 50;
+
+static uint32_t crc32_bitwise(const uint8_t* data, size_t length) {
+	uint32_t crc = 0xffffffff;
+
+	for (size_t i = 0; i < length; i++) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+		}
+	}
+
+	return ~crc;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_known_values() {
+	TEST_ASSERT_EQUAL_HEX32(0x00000000, crc32("", 0));
+	TEST_ASSERT_EQUAL_HEX32(0xcbf43926, crc32("123456789", 9));
+	TEST_ASSERT_EQUAL_HEX32(
+		0x414fa339, crc32("The quick brown fox jumps over the lazy dog", 43));
+}
+
+void test_matches_bitwise_crc() {
+	std::vector<uint8_t> data(4099);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = rand();
+	}
+
+	// Every tail length of the slicing-by-8 loop
+	for (size_t length = 0; length < data.size(); length += 37) {
+		TEST_ASSERT_EQUAL_HEX32(
+			crc32_bitwise(data.data(), length), crc32(data.data(), length));
+	}
+}
+
+void test_update_in_pieces() {
+	std::vector<uint8_t> data(1000);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = i * 7 + 3;
+	}
+
+	uint32_t whole = crc32(data.data(), data.size());
+
+	for (size_t split = 0; split <= data.size(); split += 13) {
+		uint32_t crc = crc32_update(0, data.data(), split);
+		crc = crc32_update(crc, data.data() + split, data.size() - split);
+		TEST_ASSERT_EQUAL_HEX32(whole, crc);
+	}
+}
+
+// A block with one damaged byte anywhere is refused
+void test_block_crc_detects_damage() {
+	BlockBuffer block;
+	float record[8];
+	for (int r = 0; r < 100; r++) {
+		for (int c = 0; c < 8; c++) {
+			record[c] = sinf(r * 0.05f + c);
+		}
+		block.append(record, 8);
+	}
+
+	BlockHeader header;
+	std::vector<uint8_t> payload(BLOCK_MAX_PAYLOAD);
+	size_t size = encode_block(block, BlockCodec::Float32, 0, header, payload.data());
+
+	TEST_ASSERT_TRUE(check_block_header(header));
+	TEST_ASSERT_TRUE(check_block_crc(header, payload.data()));
+
+	for (size_t i = 0; i < size; i += 17) {
+		payload[i] ^= 0x10;
+		TEST_ASSERT_FALSE(check_block_crc(header, payload.data()));
+		payload[i] ^= 0x10;
+	}
+}
+
+// The recorder encodes a block with its CRC and writes it to the card. The
+// host measures both without the card, which is then added at its clock
+// rate. The CRC, taken ESP32_SLOWDOWN times slower than here, has to stay
+// below 5% of writing, and verifying has to keep up with reading the card.
+void test_benchmark_crc_against_writing() {
+	BlockBuffer block;
+	float record[8];
+	for (int r = 0; r < 128; r++) {
+		for (int c = 0; c < 8; c++) {
+			record[c] = sinf(r * 0.05f + c) * 1.5f;
+		}
+		block.append(record, 8);
+	}
+
+	BlockHeader header;
+	std::vector<uint8_t> payload(BLOCK_MAX_PAYLOAD);
+	size_t block_size =
+		sizeof(header) +
+		encode_block(block, BlockCodec::Float32, 0, header, payload.data());
+	size_t blocks = BENCHMARK_BYTES / block_size;
+
+	FILE* file = tmpfile();
+	TEST_ASSERT_NOT_NULL(file);
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < blocks; i++) {
+		size_t size = encode_block(
+			block, BlockCodec::Float32, i * 128, header, payload.data());
+		fwrite(&header, sizeof(header), 1, file);
+		fwrite(payload.data(), 1, size, file);
+		// The writer flushes after every block
+		fflush(file);
+	}
+	double write_seconds = seconds_since(start);
+	fclose(file);
+
+	uint32_t crc = 0;
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < blocks; i++) {
+		crc = crc32_update(crc, payload.data(), block_size - sizeof(header));
+	}
+	double crc_seconds = seconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	size_t verified = 0;
+	for (size_t i = 0; i < blocks; i++) {
+		verified += check_block_crc(header, payload.data());
+	}
+	double verify_seconds = seconds_since(start);
+	TEST_ASSERT_EQUAL_size_t(blocks, verified);
+
+	double bytes = (double) blocks * block_size;
+	double card_seconds = bytes / CARD_BYTES_PER_SECOND;
+	double device_crc_seconds = crc_seconds * ESP32_SLOWDOWN;
+	double device_write_seconds = write_seconds * ESP32_SLOWDOWN + card_seconds;
+
+	char text[240];
+	snprintf(
+		text, sizeof(text),
+		"host: crc %.0f MB/s, verify %.0f MB/s, encode and write %.0f MB/s (%08x)",
+		bytes / 1e6 / crc_seconds, bytes / 1e6 / verify_seconds,
+		bytes / 1e6 / write_seconds, (unsigned) crc);
+	TEST_MESSAGE(text);
+	snprintf(
+		text, sizeof(text),
+		"device estimate: crc %.2f%% of writing to the card, verify at %.0fx the card rate",
+		100 * device_crc_seconds / device_write_seconds,
+		card_seconds / (verify_seconds * ESP32_SLOWDOWN));
+	TEST_MESSAGE(text);
+
+	TEST_ASSERT_TRUE_MESSAGE(
+		device_crc_seconds < device_write_seconds * 0.05,
+		"CRC over 5% of writing");
+	TEST_ASSERT_TRUE_MESSAGE(
+		verify_seconds * ESP32_SLOWDOWN < card_seconds,
+		"verifying slower than the card");
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_known_values);
+	RUN_TEST(test_matches_bitwise_crc);
+	RUN_TEST(test_update_in_pieces);
+	RUN_TEST(test_block_crc_detects_damage);
+	RUN_TEST(test_benchmark_crc_against_writing);
+	return UNITY_END();
+}
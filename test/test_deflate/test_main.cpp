@@ -0,0 +1,414 @@
+// The streaming compressor behind gzip responses: everything it writes
+// inflates back to the input, and what each level costs on ECG CSV. Run with
+// `pio test -e native -f test_deflate -v` to see the figures.
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <unity.h>
+
+#include "deflate.h"
+#include "testTiming.h"
+#include "textFormat.h"
+
+// CSV compressed per level by the benchmark
+constexpr size_t BENCHMARK_BYTES = 16 * 1024 * 1024;
+
+// How much slower the 240 MHz ESP32 is than a desktop core, generously
+constexpr double ESP32_SLOWDOWN = 50;
+
+// A minimal inflater (RFC 1951) to check the output against, after Mark
+// Adler's puff
+class Inflater {
+	struct Huffman {
+		uint16_t count[16];
+		uint16_t symbol[288];
+	};
+
+	const uint8_t* _in;
+	size_t _length;
+	size_t _position = 0;
+	uint32_t _bits = 0;
+	int _bit_count = 0;
+	bool _error = false;
+
+	int bits(int need) {
+		while (_bit_count < need) {
+			if (_position == _length) {
+				_error = true;
+				return 0;
+			}
+			_bits |= (uint32_t) _in[_position++] << _bit_count;
+			_bit_count += 8;
+		}
+
+		int value = _bits & ((1u << need) - 1);
+		_bits >>= need;
+		_bit_count -= need;
+		return value;
+	}
+
+	// False for an over-subscribed set of lengths
+	static bool build(Huffman& huffman, const uint8_t* lengths, int count) {
+		memset(huffman.count, 0, sizeof(huffman.count));
+		for (int i = 0; i < count; i++) {
+			huffman.count[lengths[i]]++;
+		}
+
+		int left = 1;
+		for (int length = 1; length < 16; length++) {
+			left = 2 * left - huffman.count[length];
+			if (left < 0) {
+				return false;
+			}
+		}
+
+		uint16_t offsets[16];
+		offsets[1] = 0;
+		for (int length = 1; length < 15; length++) {
+			offsets[length + 1] = offsets[length] + huffman.count[length];
+		}
+		for (int i = 0; i < count; i++) {
+			if (lengths[i] != 0) {
+				huffman.symbol[offsets[lengths[i]]++] = i;
+			}
+		}
+
+		return true;
+	}
+
+	int decode(const Huffman& huffman) {
+		int code = 0;
+		int first = 0;
+		int index = 0;
+
+		for (int length = 1; length < 16; length++) {
+			code |= bits(1);
+			int count = huffman.count[length];
+			if (code - count < first) {
+				return huffman.symbol[index + (code - first)];
+			}
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+
+		_error = true;
+		return 0;
+	}
+
+	bool codes(const Huffman& literals, const Huffman& distances) {
+		static const uint16_t length_base[29] = {
+			3,	4,	5,	6,	7,	8,	9,	10,	 11,  13,  15,	17,	 19,  23,  27,
+			31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+		};
+		static const uint8_t length_extra[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+		};
+		static const uint16_t distance_base[30] = {
+			1,	  2,	3,	  4,	5,	  7,	9,	  13,	 17,	25,
+			33,	  49,	65,	  97,	129,  193,	257,  385,	 513,	769,
+			1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+		};
+		static const uint8_t distance_extra[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+		};
+
+		while (!_error) {
+			int symbol = decode(literals);
+			if (symbol < 256) {
+				output.push_back(symbol);
+				continue;
+			}
+			if (symbol == 256) {
+				return true;
+			}
+
+			symbol -= 257;
+			if (symbol >= 29) {
+				return false;
+			}
+			int length = length_base[symbol] + bits(length_extra[symbol]);
+
+			symbol = decode(distances);
+			if (symbol >= 30) {
+				return false;
+			}
+			size_t distance = distance_base[symbol] + bits(distance_extra[symbol]);
+			if (distance > output.size()) {
+				return false;
+			}
+
+			while (length-- > 0) {
+				output.push_back(output[output.size() - distance]);
+			}
+		}
+
+		return false;
+	}
+
+	bool stored() {
+		_bits = 0;
+		_bit_count = 0;
+
+		if (_position + 4 > _length) {
+			return false;
+		}
+		uint16_t length = _in[_position] | _in[_position + 1] << 8;
+		uint16_t complement = _in[_position + 2] | _in[_position + 3] << 8;
+		_position += 4;
+
+		if (length != (uint16_t) ~complement || _position + length > _length) {
+			return false;
+		}
+		output.insert(output.end(), _in + _position, _in + _position + length);
+		_position += length;
+		return true;
+	}
+
+	bool fixed() {
+		uint8_t lengths[288 + 30];
+		for (int i = 0; i < 288 + 30; i++) {
+			lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : i < 288 ? 8 : 5;
+		}
+
+		Huffman literals, distances;
+		build(literals, lengths, 288);
+		build(distances, lengths + 288, 30);
+		return codes(literals, distances);
+	}
+
+	bool dynamic() {
+		static const uint8_t order[19] = {
+			16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+		};
+
+		int literal_count = bits(5) + 257;
+		int distance_count = bits(5) + 1;
+		int code_count = bits(4) + 4;
+		if (literal_count > 286 || distance_count > 30) {
+			return false;
+		}
+
+		uint8_t lengths[320] = {};
+		for (int i = 0; i < code_count; i++) {
+			lengths[order[i]] = bits(3);
+		}
+
+		Huffman code_lengths;
+		if (!build(code_lengths, lengths, 19)) {
+			return false;
+		}
+
+		int index = 0;
+		while (index < literal_count + distance_count && !_error) {
+			int symbol = decode(code_lengths);
+			if (symbol < 16) {
+				lengths[index++] = symbol;
+				continue;
+			}
+
+			int length = 0;
+			int repeat;
+			if (symbol == 16) {
+				if (index == 0) {
+					return false;
+				}
+				length = lengths[index - 1];
+				repeat = 3 + bits(2);
+			} else if (symbol == 17) {
+				repeat = 3 + bits(3);
+			} else {
+				repeat = 11 + bits(7);
+			}
+			if (index + repeat > literal_count + distance_count) {
+				return false;
+			}
+			while (repeat-- > 0) {
+				lengths[index++] = length;
+			}
+		}
+
+		Huffman literals, distances;
+		return lengths[256] != 0 && build(literals, lengths, literal_count) &&
+			build(distances, lengths + literal_count, distance_count) &&
+			codes(literals, distances);
+	}
+
+public:
+	std::vector<uint8_t> output;
+
+	Inflater(const std::vector<uint8_t>& input)
+		: _in(input.data()), _length(input.size()) {}
+
+	// False for anything but one complete, valid stream
+	bool run() {
+		bool last;
+		do {
+			last = bits(1);
+			int type = bits(2);
+			bool ok = type == 0 ? stored()
+				: type == 1		? fixed()
+				: type == 2		? dynamic()
+								: false;
+			if (!ok || _error) {
+				return false;
+			}
+		} while (!last);
+
+		return _position == _length;
+	}
+};
+
+// Feeds the input in pieces of chunk bytes and pulls the output in pieces
+// of 700, like GzipExport does with its buffers
+static std::vector<uint8_t> compress(
+	const std::vector<uint8_t>& input, uint8_t level, size_t chunk) {
+	std::unique_ptr<Deflate> deflate(new Deflate(level));
+
+	std::vector<uint8_t> output;
+	uint8_t buffer[700];
+	size_t position = 0;
+	size_t count;
+
+	while (position < input.size()) {
+		position += deflate->write(
+			input.data() + position, std::min(chunk, input.size() - position));
+		while ((count = deflate->read(buffer, sizeof(buffer))) > 0) {
+			output.insert(output.end(), buffer, buffer + count);
+		}
+	}
+
+	deflate->finish();
+	while ((count = deflate->read(buffer, sizeof(buffer))) > 0) {
+		output.insert(output.end(), buffer, buffer + count);
+	}
+	TEST_ASSERT_TRUE(deflate->is_done());
+
+	return output;
+}
+
+static void check_round_trip(const std::vector<uint8_t>& input, uint8_t level, size_t chunk) {
+	std::vector<uint8_t> compressed = compress(input, level, chunk);
+	Inflater inflater(compressed);
+
+	TEST_ASSERT_TRUE_MESSAGE(inflater.run(), "not a valid deflate stream");
+	TEST_ASSERT_EQUAL_size_t(input.size(), inflater.output.size());
+	TEST_ASSERT_TRUE(input == inflater.output);
+}
+
+// 8 channels of a synthetic ECG with noise, formatted like CsvExport
+static std::vector<uint8_t> ecg_csv(size_t size) {
+	std::vector<uint8_t> csv;
+	csv.reserve(size + 8 * (FORMAT_MAX_LENGTH + 1));
+	uint32_t noise = 1;
+
+	for (uint32_t record = 0; csv.size() < size; record++) {
+		float t = (record % 400) / 400.0f;
+		// P wave, QRS complex and T wave of a beat at 75 per minute
+		float beat = 0.15f * expf(-powf((t - 0.2f) / 0.03f, 2)) +
+			1.2f * expf(-powf((t - 0.4f) / 0.01f, 2)) +
+			0.3f * expf(-powf((t - 0.65f) / 0.05f, 2));
+
+		for (int channel = 0; channel < 8; channel++) {
+			noise = noise * 1664525 + 1013904223;
+			float value = beat * (1.0f - channel * 0.1f) +
+				(noise >> 8) * (0.02f / 16777216.0f);
+
+			char text[FORMAT_MAX_LENGTH];
+			size_t length = format_fixed(text, value, 6);
+			csv.insert(csv.end(), text, text + length);
+			csv.push_back(channel == 7 ? '\n' : ',');
+		}
+	}
+
+	return csv;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_edge_inputs_round_trip() {
+	std::vector<uint8_t> random(200000);
+	srand(1);
+	for (auto& byte : random) {
+		byte = rand();
+	}
+
+	const std::vector<std::vector<uint8_t>> inputs = {
+		{},
+		{ 'a' },
+		{ 'a', 'b' },
+		std::vector<uint8_t>(100000, 'x'),
+		random,
+	};
+
+	for (auto& input : inputs) {
+		for (uint8_t level : { 1, 4, 32 }) {
+			for (size_t chunk : { 1, 37, 5000 }) {
+				check_round_trip(input, level, chunk);
+			}
+		}
+	}
+}
+
+void test_csv_round_trip() {
+	std::vector<uint8_t> csv = ecg_csv(1024 * 1024);
+
+	for (uint8_t level : { (uint8_t) 1, DEFLATE_DEFAULT_LEVEL, (uint8_t) 255 }) {
+		check_round_trip(csv, level, 512);
+	}
+}
+
+// Ratio, throughput and CPU time per MB of input of every level, to choose
+// the level of the device. The default has to come within 2% of the ratio
+// of level 32 and be faster.
+void test_benchmark_levels() {
+	std::vector<uint8_t> csv = ecg_csv(BENCHMARK_BYTES);
+	double default_ratio = 0;
+	double default_seconds = 0;
+
+	for (uint8_t level : { 1, 2, 4, 8, 16, 32 }) {
+		auto start = std::chrono::steady_clock::now();
+		size_t compressed = compress(csv, level, 512).size();
+		double seconds = seconds_since(start);
+
+		double megabytes = csv.size() / 1e6;
+		double ratio = (double) csv.size() / compressed;
+		char text[200];
+		snprintf(
+			text, sizeof(text),
+			"level %2u: ratio %.2f, %.1f MB/s, %.1f ms CPU per MB, device estimate %.0f ms per MB",
+			level, ratio, megabytes / seconds, seconds * 1e3 / megabytes,
+			seconds * 1e3 / megabytes * ESP32_SLOWDOWN);
+		TEST_MESSAGE(text);
+
+		if (level == DEFLATE_DEFAULT_LEVEL) {
+			default_ratio = ratio;
+			default_seconds = seconds;
+		}
+		if (level == 32) {
+			TEST_ASSERT_TRUE_MESSAGE(
+				default_ratio >= ratio * 0.96, "default level compresses too little");
+			TEST_ASSERT_TRUE_MESSAGE(
+				default_seconds < seconds, "default level not faster than 32");
+		}
+	}
+
+	TEST_ASSERT_TRUE_MESSAGE(default_ratio > 2, "CSV hardly compressed");
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_edge_inputs_round_trip);
+	RUN_TEST(test_csv_round_trip);
+	RUN_TEST(test_benchmark_levels);
+	return UNITY_END();
+}
@@ -0,0 +1,207 @@
+// The retention policy of the recording cleaner on the stand-ins in
+// test/host, the card is a directory: which recordings it removes by age and
+// by share of the quota, that the newest one stays, and how much one job
+// takes. Run with `pio test -e native -f test_recording_cleaner -v`.
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <SD.h>
+#include <SPI.h>
+#include <unity.h>
+
+#include "ecg_isd_config.h"
+#include "recordingCleaner.h"
+#include "storage.h"
+
+// Records in a day, and in recordings of which a little more than a page
+// hold a day
+constexpr uint64_t DAY_RECORDS = 24ull * 3600 * ECG_SAMPLE_RATE_HZ;
+constexpr uint32_t LONG_RECORDS = DAY_RECORDS / (CLEANER_LIST_PAGE + 8);
+
+// Any share of it is less than a recording
+constexpr uint64_t TINY_QUOTA = 100;
+
+static std::string sd_root;
+static std::shared_ptr<Storage> storage;
+
+// Closed recordings of count records of one channel, oldest first
+static std::vector<std::string> add_recordings(size_t recordings, uint32_t count) {
+	std::vector<std::string> names;
+	float record[1] = { 0.5f };
+
+	for (size_t i = 0; i < recordings; i++) {
+		names.push_back(
+			storage->create_new_recording(recording_format::BlockCodec::DeltaFloat32));
+		for (uint32_t r = 0; r < count; r++) {
+			storage->write_record(record, 1);
+		}
+		storage->close_recording();
+	}
+	return names;
+}
+
+static size_t recording_size(const std::string& name) {
+	std::vector<StorageEntry> recordings;
+	storage->list_recordings_before(recordings, nullptr, 1);
+	TEST_ASSERT_EQUAL_STRING(name.c_str(), recordings.front().get_name());
+	return recordings.front().get_size();
+}
+
+static RetentionPolicy policy(uint32_t keep_days, uint32_t max_percent) {
+	RetentionPolicy policy;
+	policy.keep_days = keep_days;
+	policy.max_percent = max_percent;
+	return policy;
+}
+
+// Every test starts on an empty card with the whole card as quota
+void setUp() {
+	std::vector<StorageEntry> recordings;
+	while (storage->list_recordings(recordings, "", CLEANER_LIST_PAGE) &&
+		   !recordings.empty()) {
+		for (auto& recording : recordings) {
+			storage->remove_recording(recording.get_name());
+		}
+	}
+	storage->set_quota(0);
+}
+
+void tearDown() {}
+
+void test_nothing_without_policy() {
+	add_recordings(3, 1000);
+	RecordingCleaner cleaner(storage);
+	std::vector<std::string> names = { "stale" };
+
+	cleaner.find_expired(policy(0, 0), names);
+	TEST_ASSERT_EQUAL_size_t(0, names.size());
+
+	// A day is far more than the three hold
+	cleaner.find_expired(policy(1, 0), names);
+	TEST_ASSERT_EQUAL_size_t(0, names.size());
+}
+
+// Newest first over more than a page of recordings until a day is kept,
+// the older ones go
+void test_keep_days_over_pages() {
+	const size_t recordings = CLEANER_LIST_PAGE + 20;
+	std::vector<std::string> added = add_recordings(recordings, LONG_RECORDS);
+	size_t kept = (DAY_RECORDS + LONG_RECORDS - 1) / LONG_RECORDS;
+	RecordingCleaner cleaner(storage);
+	std::vector<std::string> names;
+
+	cleaner.find_expired(policy(1, 0), names);
+	TEST_ASSERT_EQUAL_size_t(recordings - kept, names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		TEST_ASSERT_EQUAL_STRING(added[i].c_str(), names[i].c_str());
+	}
+
+	// The counts of the kept recordings are remembered for the next check
+	cleaner.find_expired(policy(1, 0), names);
+	TEST_ASSERT_EQUAL_size_t(recordings - kept, names.size());
+}
+
+// The records of the live recording count as soon as they are on the card
+void test_keep_days_counts_live_recording() {
+	std::vector<std::string> added = add_recordings(2, DAY_RECORDS / 2);
+	storage->create_new_recording(recording_format::BlockCodec::DeltaFloat32);
+	float record[1] = { 0.5f };
+	RecordingCleaner cleaner(storage);
+	std::vector<std::string> names;
+
+	cleaner.find_expired(policy(1, 0), names);
+	TEST_ASSERT_EQUAL_size_t(0, names.size());
+
+	// Half a day more and the oldest is no longer needed, a minute over it
+	// for the block still being filled
+	for (uint32_t r = 0; r < DAY_RECORDS / 2 + 60 * ECG_SAMPLE_RATE_HZ; r++) {
+		storage->write_record(record, 1);
+	}
+	cleaner.find_expired(policy(1, 0), names);
+	storage->close_recording();
+
+	TEST_ASSERT_EQUAL_size_t(1, names.size());
+	TEST_ASSERT_EQUAL_STRING(added[0].c_str(), names[0].c_str());
+}
+
+// Oldest first until the rest fits in the share of the quota
+void test_max_percent_cut() {
+	std::vector<std::string> added = add_recordings(6, 20000);
+	uint64_t size = recording_size(added.back());
+	uint64_t used = storage->get_usage().used_bytes;
+	// Half of it leaves room for two and a half recordings less than used
+	storage->set_quota(2 * used - 5 * size);
+	RecordingCleaner cleaner(storage);
+	std::vector<std::string> names;
+
+	cleaner.find_expired(policy(0, 50), names);
+	TEST_ASSERT_EQUAL_size_t(3, names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		TEST_ASSERT_EQUAL_STRING(added[i].c_str(), names[i].c_str());
+	}
+
+	// Either rule removes a recording
+	cleaner.find_expired(policy(365, 50), names);
+	TEST_ASSERT_EQUAL_size_t(3, names.size());
+}
+
+void test_newest_recording_kept() {
+	std::vector<std::string> added = add_recordings(3, 20000);
+	storage->set_quota(TINY_QUOTA);
+	RecordingCleaner cleaner(storage);
+	std::vector<std::string> names;
+
+	cleaner.find_expired(policy(0, 1), names);
+	TEST_ASSERT_EQUAL_size_t(2, names.size());
+	TEST_ASSERT_EQUAL_STRING(added[0].c_str(), names[0].c_str());
+	TEST_ASSERT_EQUAL_STRING(added[1].c_str(), names[1].c_str());
+}
+
+// A job takes at most CLEANER_MAX_RECORDINGS, the next check the rest
+void test_max_recordings_cut() {
+	std::vector<std::string> added = add_recordings(CLEANER_MAX_RECORDINGS + 5, 10);
+	storage->set_quota(TINY_QUOTA);
+	RecordingCleaner cleaner(storage);
+	std::vector<std::string> names;
+
+	cleaner.find_expired(policy(0, 1), names);
+	TEST_ASSERT_EQUAL_size_t(CLEANER_MAX_RECORDINGS, names.size());
+	TEST_ASSERT_EQUAL_STRING(added.front().c_str(), names.front().c_str());
+	TEST_ASSERT_EQUAL_STRING(
+		added[CLEANER_MAX_RECORDINGS - 1].c_str(), names.back().c_str());
+
+	for (auto& name : names) {
+		TEST_ASSERT_TRUE(storage->remove_recording(name.c_str()));
+	}
+	cleaner.find_expired(policy(0, 1), names);
+	TEST_ASSERT_EQUAL_size_t(4, names.size());
+	TEST_ASSERT_EQUAL_STRING(added[CLEANER_MAX_RECORDINGS].c_str(), names.front().c_str());
+}
+
+int main() {
+	char root[] = "/tmp/test_recording_cleaner_XXXXXX";
+	TEST_ASSERT_NOT_NULL(mkdtemp(root));
+	sd_root = root;
+	SD.set_host_root(sd_root);
+
+	static SPIClass spi(HSPI);
+	static std::mutex spi_mutex;
+	storage = std::make_shared<Storage>(spi, spi_mutex);
+
+	UNITY_BEGIN();
+	RUN_TEST(test_nothing_without_policy);
+	RUN_TEST(test_keep_days_over_pages);
+	RUN_TEST(test_keep_days_counts_live_recording);
+	RUN_TEST(test_max_percent_cut);
+	RUN_TEST(test_newest_recording_kept);
+	RUN_TEST(test_max_recordings_cut);
+	int failures = UNITY_END();
+
+	std::filesystem::remove_all(sd_root);
+	return failures;
+}
@@ -0,0 +1,400 @@
+// Block codecs of the recording format: every codec round trips, the integer
+// codecs clamp and fall back on NaN, both file headers are taken, and what
+// packing costs. Run with
+// `pio test -e native -f test_recording_format -v` to see the figures.
+
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <unity.h>
+
+#include "crc32.h"
+#include "recordingFormat.h"
+#include "testTiming.h"
+
+using namespace recording_format;
+
+// Samples pushed through the benchmark
+constexpr size_t BENCHMARK_SAMPLES = 64 * 1024 * 1024;
+
+// Acquisition as in ecg_isd_config.h, which needs the Arduino core
+constexpr uint32_t ECG_SAMPLE_RATE_HZ = 500;
+constexpr uint8_t ECG_CHANNELS = 8;
+
+// How much slower the 240 MHz ESP32 is than a desktop core, generously
+constexpr double ESP32_SLOWDOWN = 50;
+
+static const BlockCodec CODECS[] = {
+	BlockCodec::Float32,
+	BlockCodec::DeltaFloat32,
+	BlockCodec::Int16,
+	BlockCodec::Int24,
+};
+
+// Records of varying length with a slow signal on every channel
+static void fill_block(BlockBuffer& block, float amplitude) {
+	block.clear();
+
+	float record[ECG_CHANNELS];
+	for (int r = 0; block.fits(ECG_CHANNELS); r++) {
+		uint8_t length = 1 + r % ECG_CHANNELS;
+		for (uint8_t c = 0; c < length; c++) {
+			record[c] = amplitude * sinf(r * 0.03f + c) + c * 0.25f;
+		}
+		block.append(record, length);
+	}
+}
+
+static void round_trip(
+	const BlockBuffer& block, BlockCodec codec, BlockHeader& header, BlockBuffer& decoded) {
+	static uint8_t payload[BLOCK_MAX_PAYLOAD];
+
+	size_t size = encode_block(block, codec, 1234, header, payload);
+
+	TEST_ASSERT_EQUAL_UINT32(size, header.payload_size);
+	TEST_ASSERT_TRUE(check_block_header(header));
+	TEST_ASSERT_TRUE(check_block_crc(header, payload));
+	TEST_ASSERT_EQUAL_UINT32(1234, header.first_record);
+	TEST_ASSERT_TRUE(decode_block(header, payload, decoded));
+
+	TEST_ASSERT_EQUAL_UINT16(block.record_count, decoded.record_count);
+	TEST_ASSERT_EQUAL_UINT16(block.sample_count, decoded.sample_count);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(block.lengths, decoded.lengths, block.record_count);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_lossless_codecs_round_trip() {
+	static BlockBuffer block;
+	static BlockBuffer decoded;
+	BlockHeader header;
+
+	fill_block(block, 1.5f);
+
+	for (BlockCodec codec : { BlockCodec::Float32, BlockCodec::DeltaFloat32 }) {
+		round_trip(block, codec, header, decoded);
+		TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(codec), header.codec);
+		TEST_ASSERT_EQUAL_MEMORY(
+			block.samples, decoded.samples, sizeof(float) * block.sample_count);
+	}
+}
+
+// The error of a sample is at most half a step of the block's scale
+void test_integer_codecs_round_trip() {
+	static BlockBuffer block;
+	static BlockBuffer decoded;
+	static uint8_t payload[BLOCK_MAX_PAYLOAD];
+	BlockHeader header;
+
+	fill_block(block, 1.5f);
+
+	for (BlockCodec codec : { BlockCodec::Int16, BlockCodec::Int24 }) {
+		round_trip(block, codec, header, decoded);
+		TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(codec), header.codec);
+
+		encode_block(block, codec, 0, header, payload);
+		IntScaling scaling;
+		memcpy(&scaling, payload + block.record_count, sizeof(scaling));
+
+		// Plus the rounding of offset + scale * q in float
+		float q_max = codec == BlockCodec::Int16 ? 32767.0f : 8388607.0f;
+		float rounding =
+			2 * FLT_EPSILON * (fabsf(scaling.offset) + scaling.scale * q_max);
+
+		for (uint16_t i = 0; i < block.sample_count; i++) {
+			TEST_ASSERT_FLOAT_WITHIN(
+				scaling.scale * 0.5f + rounding, block.samples[i],
+				decoded.samples[i]);
+		}
+	}
+}
+
+// The integer codecs shrink a block to about a half and three quarters
+void test_integer_codecs_save_space() {
+	static BlockBuffer block;
+	static uint8_t payload[BLOCK_MAX_PAYLOAD];
+	BlockHeader header;
+
+	fill_block(block, 1.5f);
+
+	size_t raw = encode_block(block, BlockCodec::Float32, 0, header, payload);
+	size_t int16 = encode_block(block, BlockCodec::Int16, 0, header, payload);
+	size_t int24 = encode_block(block, BlockCodec::Int24, 0, header, payload);
+
+	size_t lengths = block.record_count + sizeof(IntScaling);
+	TEST_ASSERT_EQUAL_size_t(lengths + 2 * block.sample_count, int16);
+	TEST_ASSERT_EQUAL_size_t(lengths + 3 * block.sample_count, int24);
+	TEST_ASSERT_TRUE(int16 < int24 && int24 < raw);
+}
+
+// The smallest and largest sample map to the ends of the integer range and
+// nothing rounds past them, whatever the magnitude
+void test_integer_codecs_clamp() {
+	const float limits[] = { 1e-30f, 1.0f, 3e5f, FLT_MAX / 4, FLT_MAX };
+
+	for (int bytes = 2; bytes <= 3; bytes++) {
+		const int32_t q_max = bytes == 2 ? INT16_MAX : 0x7fffff;
+
+		for (float limit : limits) {
+			float samples[5] = { -limit, limit, 0.0f, limit * 0.999999f, -limit * 0.5f };
+			uint8_t packed[5 * 3];
+			float unpacked[5];
+
+			IntScaling scaling = pack_ints(samples, 5, bytes, packed);
+			TEST_ASSERT_TRUE(isfinite(scaling.scale) && scaling.scale > 0.0f);
+
+			int32_t q[5];
+			for (int i = 0; i < 5; i++) {
+				if (bytes == 2) {
+					q[i] = (int16_t) (packed[2 * i] | packed[2 * i + 1] << 8);
+				} else {
+					q[i] = (int32_t) ((uint32_t) packed[3 * i] << 8 |
+									  (uint32_t) packed[3 * i + 1] << 16 |
+									  (uint32_t) packed[3 * i + 2] << 24) >>
+						8;
+				}
+				TEST_ASSERT_TRUE(q[i] >= -q_max && q[i] <= q_max);
+			}
+			TEST_ASSERT_EQUAL_INT32(-q_max, q[0]);
+			TEST_ASSERT_EQUAL_INT32(q_max, q[1]);
+
+			unpack_ints(packed, 5, bytes, scaling, unpacked);
+			for (int i = 0; i < 5; i++) {
+				TEST_ASSERT_TRUE(isfinite(unpacked[i]));
+				TEST_ASSERT_FLOAT_WITHIN(
+					scaling.scale + limit * 1e-6f, samples[i], unpacked[i]);
+			}
+		}
+	}
+}
+
+// A block of one value has nothing to scale and comes back exactly
+void test_integer_codecs_constant_block() {
+	for (int bytes = 2; bytes <= 3; bytes++) {
+		float samples[64];
+		for (float& sample : samples) {
+			sample = -0.8125f;
+		}
+
+		uint8_t packed[64 * 3];
+		float unpacked[64];
+		IntScaling scaling = pack_ints(samples, 64, bytes, packed);
+		unpack_ints(packed, 64, bytes, scaling, unpacked);
+
+		TEST_ASSERT_EQUAL_FLOAT(1.0f, scaling.scale);
+		TEST_ASSERT_EQUAL_FLOAT_ARRAY(samples, unpacked, 64);
+	}
+}
+
+// NaN and infinity have no integer, such a block is stored as Float32 and
+// keeps them
+void test_integer_codecs_fall_back_on_nan() {
+	static BlockBuffer block;
+	static BlockBuffer decoded;
+	BlockHeader header;
+
+	for (float special : { NAN, INFINITY, -INFINITY }) {
+		fill_block(block, 1.5f);
+		block.samples[17] = special;
+
+		for (BlockCodec codec : CODECS) {
+			round_trip(block, codec, header, decoded);
+			TEST_ASSERT_NOT_EQUAL(
+				static_cast<uint8_t>(BlockCodec::Int16), header.codec);
+			TEST_ASSERT_NOT_EQUAL(
+				static_cast<uint8_t>(BlockCodec::Int24), header.codec);
+			TEST_ASSERT_EQUAL_MEMORY(
+				block.samples, decoded.samples, sizeof(float) * block.sample_count);
+		}
+	}
+}
+
+// Differences of the bit patterns at the ends of the zigzag range take five
+// byte varints and still decode to the same bits
+void test_delta_zigzag_extremes() {
+	static BlockBuffer block;
+	static BlockBuffer decoded;
+	BlockHeader header;
+
+	const uint32_t patterns[] = {
+		0x00000000, 0x7fffffff, 0x80000000, 0xffffffff, 0x00000001,
+		0x80000001, 0x7f800000, 0xff800000, 0x7fc00000, 0x80000000,
+	};
+
+	block.clear();
+	float value = 0.0f;
+	for (int r = 0; block.fits(1); r++) {
+		// Long runs of one value keep the block smaller than Float32
+		if (r % 20 == 0) {
+			uint32_t bits = patterns[(r / 20) % (sizeof(patterns) / sizeof(patterns[0]))];
+			memcpy(&value, &bits, sizeof(value));
+		}
+		block.append(&value, 1);
+	}
+
+	round_trip(block, BlockCodec::DeltaFloat32, header, decoded);
+	TEST_ASSERT_EQUAL_UINT8(
+		static_cast<uint8_t>(BlockCodec::DeltaFloat32), header.codec);
+	TEST_ASSERT_EQUAL_MEMORY(
+		block.samples, decoded.samples, sizeof(float) * block.sample_count);
+}
+
+// Differences that do not pay off are stored as Float32
+void test_delta_falls_back_to_float() {
+	static BlockBuffer block;
+	static BlockBuffer decoded;
+	BlockHeader header;
+
+	block.clear();
+	uint32_t bits = 1;
+	while (block.fits(1)) {
+		bits = bits * 1664525 + 1013904223;
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		block.append(&value, 1);
+	}
+
+	round_trip(block, BlockCodec::DeltaFloat32, header, decoded);
+	TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(BlockCodec::Float32), header.codec);
+	TEST_ASSERT_EQUAL_MEMORY(
+		block.samples, decoded.samples, sizeof(float) * block.sample_count);
+}
+
+// A full block of every codec is taken apart again the same way
+void test_all_codecs_full_block() {
+	static BlockBuffer block;
+	static BlockBuffer decoded;
+	BlockHeader header;
+
+	block.clear();
+	float record[ECG_CHANNELS];
+	while (block.fits(ECG_CHANNELS)) {
+		for (uint8_t c = 0; c < ECG_CHANNELS; c++) {
+			record[c] = block.record_count * 0.001f - c;
+		}
+		block.append(record, ECG_CHANNELS);
+	}
+	TEST_ASSERT_EQUAL_UINT16(BLOCK_MAX_SAMPLES, block.sample_count);
+
+	for (BlockCodec codec : CODECS) {
+		round_trip(block, codec, header, decoded);
+		TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(codec), header.codec);
+	}
+}
+
+// The header of a file and its first block, as the validator of uploads
+// takes them
+static bool validate(const FileHeader& file_header, size_t header_size) {
+	static BlockBuffer block;
+	static uint8_t payload[BLOCK_MAX_PAYLOAD];
+	static FileValidator validator;
+	BlockHeader header;
+
+	fill_block(block, 1.0f);
+	size_t size = encode_block(block, BlockCodec::DeltaFloat32, 0, header, payload);
+
+	validator = FileValidator();
+	return validator.update((const uint8_t*) &file_header, header_size) &&
+		validator.update((const uint8_t*) &header, sizeof(header)) &&
+		validator.update(payload, size) && validator.is_complete();
+}
+
+// Files with a recording id pass readers of the older 12 byte header, and
+// those files stay valid
+void test_file_header_with_and_without_id() {
+	FileHeader header;
+	init_file_header(header, 0x12345678);
+	TEST_ASSERT_EQUAL_UINT16(sizeof(FileHeader), header.header_size);
+	TEST_ASSERT_EQUAL_UINT32(0x12345678, header.recording_id);
+	TEST_ASSERT_TRUE(check_file_header(header));
+	TEST_ASSERT_TRUE(validate(header, sizeof(header)));
+
+	// What the older firmware checks
+	FileHeader copy = header;
+	copy.crc = 0;
+	TEST_ASSERT_EQUAL_UINT32(header.crc, crc32(&copy, FILE_HEADER_BASE_SIZE));
+
+	// As the older firmware wrote it
+	header.header_size = FILE_HEADER_BASE_SIZE;
+	header.crc = 0;
+	header.crc = crc32(&header, FILE_HEADER_BASE_SIZE);
+	TEST_ASSERT_TRUE(check_file_header(header));
+	TEST_ASSERT_TRUE(validate(header, FILE_HEADER_BASE_SIZE));
+
+	header.header_size = FILE_HEADER_BASE_SIZE - 1;
+	TEST_ASSERT_FALSE(check_file_header(header));
+}
+
+// Packing runs for every stored block and unpacking for every block read.
+// Both have to leave the ESP32, taken ESP32_SLOWDOWN times slower than here,
+// far more than the acquired samples per second.
+void test_benchmark_pack_unpack() {
+	std::vector<float> samples(BLOCK_MAX_SAMPLES);
+	for (size_t i = 0; i < samples.size(); i++) {
+		samples[i] = sinf(i * 0.01f) * 2.0f;
+	}
+
+	std::vector<uint8_t> packed(BLOCK_MAX_SAMPLES * 3);
+	std::vector<float> unpacked(BLOCK_MAX_SAMPLES);
+	const size_t blocks = BENCHMARK_SAMPLES / BLOCK_MAX_SAMPLES;
+	const double acquired = (double) ECG_SAMPLE_RATE_HZ * ECG_CHANNELS;
+
+	for (int bytes = 2; bytes <= 3; bytes++) {
+		IntScaling scaling;
+		float check = 0.0f;
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t b = 0; b < blocks; b++) {
+			samples[b % BLOCK_MAX_SAMPLES] += 1e-6f;
+			scaling = pack_ints(samples.data(), BLOCK_MAX_SAMPLES, bytes, packed.data());
+		}
+		double pack_seconds = seconds_since(start);
+
+		start = std::chrono::steady_clock::now();
+		for (size_t b = 0; b < blocks; b++) {
+			packed[b % packed.size()] ^= 1;
+			unpack_ints(packed.data(), BLOCK_MAX_SAMPLES, bytes, scaling, unpacked.data());
+			check += unpacked[b % BLOCK_MAX_SAMPLES];
+		}
+		double unpack_seconds = seconds_since(start);
+
+		double pack_rate = BENCHMARK_SAMPLES / pack_seconds;
+		double unpack_rate = BENCHMARK_SAMPLES / unpack_seconds;
+
+		char text[200];
+		snprintf(
+			text, sizeof(text),
+			"int%d: pack %.0f Msamples/s, unpack %.0f Msamples/s, device estimate %.0fx and %.0fx acquisition (%g)",
+			bytes * 8, pack_rate / 1e6, unpack_rate / 1e6,
+			pack_rate / ESP32_SLOWDOWN / acquired,
+			unpack_rate / ESP32_SLOWDOWN / acquired, check);
+		TEST_MESSAGE(text);
+
+		TEST_ASSERT_TRUE_MESSAGE(
+			pack_rate / ESP32_SLOWDOWN > 100 * acquired, "packing too slow");
+		TEST_ASSERT_TRUE_MESSAGE(
+			unpack_rate / ESP32_SLOWDOWN > 100 * acquired, "unpacking too slow");
+	}
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_lossless_codecs_round_trip);
+	RUN_TEST(test_integer_codecs_round_trip);
+	RUN_TEST(test_integer_codecs_save_space);
+	RUN_TEST(test_integer_codecs_clamp);
+	RUN_TEST(test_integer_codecs_constant_block);
+	RUN_TEST(test_integer_codecs_fall_back_on_nan);
+	RUN_TEST(test_delta_zigzag_extremes);
+	RUN_TEST(test_delta_falls_back_to_float);
+	RUN_TEST(test_all_codecs_full_block);
+	RUN_TEST(test_file_header_with_and_without_id);
+	RUN_TEST(test_benchmark_pack_unpack);
+	return UNITY_END();
+}
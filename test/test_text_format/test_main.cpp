@@ -0,0 +1,208 @@
+// format_fixed() against printf, and CSV formatting against the per-record
+// snprintf() and std::string it replaced. Run with
+// `pio test -e native -f test_text_format -v` to see the figures.
+
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "testTiming.h"
+#include "textFormat.h"
+
+// Records formatted by the benchmark, 7 samples each like the old export
+constexpr size_t BENCHMARK_RECORDS = 2 * 1000 * 1000;
+constexpr int BENCHMARK_CHANNELS = 7;
+
+static float from_bits(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// Compares with printf, which formats the exact value of the float
+static void check_like_printf(float value, uint8_t decimals) {
+	char expected[FORMAT_MAX_LENGTH + 32];
+	snprintf(expected, sizeof(expected), "%.*f", decimals, (double) value);
+
+	char actual[FORMAT_MAX_LENGTH + 1];
+	size_t length = format_fixed(actual, value, decimals);
+	TEST_ASSERT_TRUE(length <= FORMAT_MAX_LENGTH);
+	actual[length] = '\0';
+
+	if (strcmp(expected, actual) != 0) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		char message[160];
+		snprintf(
+			message, sizeof(message), "%08x with %u decimals: expected %s was %s",
+			(unsigned) bits, decimals, expected, actual);
+		TEST_FAIL_MESSAGE(message);
+	}
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_known_values() {
+	char out[FORMAT_MAX_LENGTH + 1];
+
+	out[format_fixed(out, 4294.0f, 6)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("4294.000000", out);
+	out[format_fixed(out, 1000.123f, 6)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("1000.122986", out);
+	out[format_fixed(out, -0.0f, 2)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("-0.00", out);
+	out[format_fixed(out, 0.999999f, 3)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("1.000", out);
+	out[format_fixed(out, 2.5f, 0)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("2", out);
+	out[format_fixed(out, 3.5f, 0)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("4", out);
+	out[format_fixed(out, NAN, 6)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("nan", out);
+	out[format_fixed(out, -INFINITY, 6)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("-inf", out);
+	out[format_fixed(out, 1e10f, 1)] = '\0';
+	TEST_ASSERT_EQUAL_STRING("10000000000.0", out);
+	// The longest output
+	TEST_ASSERT_EQUAL_size_t(FORMAT_MAX_LENGTH, format_fixed(out, -FLT_MAX, 9));
+}
+
+// Every float up to 16 with a small step, the range of ECG samples in mV
+void test_small_values_like_printf() {
+	const uint32_t end = 0x41800000;
+
+	for (uint32_t bits = 0; bits < end; bits += 997) {
+		for (uint8_t decimals = 0; decimals <= 9; decimals++) {
+			check_like_printf(from_bits(bits), decimals);
+			check_like_printf(-from_bits(bits), decimals);
+		}
+	}
+}
+
+// Ties of the exact value round to even like printf
+void test_ties_like_printf() {
+	for (int i = 0; i < 4096; i++) {
+		float value = i / 64.0f;
+		for (uint8_t decimals = 0; decimals <= 6; decimals++) {
+			check_like_printf(value, decimals);
+		}
+	}
+}
+
+// Large values stay in fixed notation, up to the largest float
+void test_large_values_like_printf() {
+	const float values[] = {
+		4294.97f, 16777216.0f, 4294967040.0f, 4294967296.0f, 1e20f, 3e38f, FLT_MAX,
+	};
+
+	for (float value : values) {
+		for (uint8_t decimals = 0; decimals <= 9; decimals++) {
+			check_like_printf(value, decimals);
+			check_like_printf(-value, decimals);
+		}
+	}
+
+	for (uint32_t bits = 0x4b800000; bits < 0x7f800000; bits += 104729) {
+		check_like_printf(from_bits(bits), 6);
+	}
+}
+
+void test_random_values_like_printf() {
+	uint32_t bits = 12345;
+
+	for (int i = 0; i < 200000; i++) {
+		bits = bits * 1664525 + 1013904223;
+		float value = from_bits(bits);
+
+		if (isfinite(value)) {
+			check_like_printf(value, i % 10);
+		}
+	}
+}
+
+// The old export formatted every sample with snprintf("%f") into a 10 byte
+// buffer and collected a record in a std::string. Now a record goes
+// through format_fixed() into a 4 KB chunk.
+void test_benchmark_csv() {
+	std::vector<float> samples(BENCHMARK_CHANNELS * 1024);
+	for (size_t i = 0; i < samples.size(); i++) {
+		samples[i] = sinf(i * 0.01f) * 1.5f + (i % BENCHMARK_CHANNELS);
+	}
+
+	size_t old_bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < BENCHMARK_RECORDS; r++) {
+		const float* data = &samples[(r % 1024) * BENCHMARK_CHANNELS];
+		char fl_to_str[10];
+		std::string msg;
+
+		for (int i = 0; i < BENCHMARK_CHANNELS; i++) {
+			snprintf(fl_to_str, 9, "%f", data[i]);
+			msg += fl_to_str;
+			msg += i == BENCHMARK_CHANNELS - 1 ? "\n" : ",";
+		}
+		old_bytes += msg.size();
+	}
+	double old_seconds = seconds_since(start);
+
+	char chunk[4096];
+	size_t used = 0;
+	size_t new_bytes = 0;
+	start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < BENCHMARK_RECORDS; r++) {
+		const float* data = &samples[(r % 1024) * BENCHMARK_CHANNELS];
+		char line[BENCHMARK_CHANNELS * (FORMAT_MAX_LENGTH + 1)];
+		char* out = line;
+
+		for (int i = 0; i < BENCHMARK_CHANNELS; i++) {
+			out += format_fixed(out, data[i], 6);
+			*out++ = i == BENCHMARK_CHANNELS - 1 ? '\n' : ',';
+		}
+
+		for (char* pos = line; pos < out;) {
+			size_t count = std::min<size_t>(out - pos, sizeof(chunk) - used);
+			memcpy(chunk + used, pos, count);
+			used += count;
+			pos += count;
+			if (used == sizeof(chunk)) {
+				new_bytes += used;
+				used = 0;
+			}
+		}
+	}
+	new_bytes += used;
+	double new_seconds = seconds_since(start);
+
+	char text[160];
+	snprintf(
+		text, sizeof(text),
+		"old snprintf export %.1f MB/s, format_fixed export %.1f MB/s, %.1fx",
+		old_bytes / 1e6 / old_seconds, new_bytes / 1e6 / new_seconds,
+		(new_bytes / new_seconds) / (old_bytes / old_seconds));
+	TEST_MESSAGE(text);
+
+	TEST_ASSERT_TRUE_MESSAGE(
+		new_bytes / new_seconds > 2 * old_bytes / old_seconds,
+		"format_fixed export not faster");
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_known_values);
+	RUN_TEST(test_small_values_like_printf);
+	RUN_TEST(test_ties_like_printf);
+	RUN_TEST(test_large_values_like_printf);
+	RUN_TEST(test_random_values_like_printf);
+	RUN_TEST(test_benchmark_csv);
+	return UNITY_END();
+}
@@ -0,0 +1,141 @@
+// Heap allocations of the web server task per request once it is warmed up.
+// Every operator new in the server task is counted while requests run, the
+// storage and web code run on the stand-ins in test/host like in
+// test_web_load. Run with `pio test -e native -f test_web_alloc -v`.
+//
+// A long running device fragments its heap with every allocation that does
+// not come back in the same size, so responses take their memory from the
+// response pool and buffers kept between requests.
+
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#include <unity.h>
+
+#include "loopbackServer.h"
+
+constexpr uint16_t TEST_PORT = 18081;
+constexpr int TEST_RECORDINGS = 5;
+// 10 s of 8 channels, about 400 KB of CSV
+constexpr int TEST_RECORDS = 5000;
+// Requests before counting, they fill the pool and the caches
+constexpr int WARM_UP_REQUESTS = 5;
+constexpr int COUNTED_REQUESTS = 20;
+
+static thread_local bool server_task = false;
+static std::atomic<size_t> server_allocations{ 0 };
+
+void* operator new(size_t size) {
+	if (server_task && fs::driver_calls == 0) {
+		server_allocations++;
+	}
+	void* block = malloc(size > 0 ? size : 1);
+	if (block == nullptr) {
+		throw std::bad_alloc();
+	}
+	return block;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* block) noexcept {
+	free(block);
+}
+
+void operator delete[](void* block) noexcept {
+	free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+	free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+	free(block);
+}
+
+static LoopbackServer server(TEST_PORT);
+
+// Allocations of the server task while count requests for path run, after
+// the warm up
+static size_t count_allocations(const std::string& path) {
+	LoopbackClient client(TEST_PORT);
+	for (int i = 0; i < WARM_UP_REQUESTS; i++) {
+		TEST_ASSERT_EQUAL_INT(200, client.get(path).status);
+	}
+
+	size_t before = server_allocations;
+	for (int i = 0; i < COUNTED_REQUESTS; i++) {
+		TEST_ASSERT_EQUAL_INT(200, client.get(path).status);
+	}
+	size_t allocations = server_allocations - before;
+
+	char text[160];
+	snprintf(
+		text, sizeof(text), "%u allocations in %d requests for %s",
+		(unsigned) allocations, COUNTED_REQUESTS, path.c_str());
+	TEST_MESSAGE(text);
+	return allocations;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_catalog_without_allocation() {
+	TEST_ASSERT_EQUAL_size_t(0, count_allocations("/api/recordings"));
+	TEST_ASSERT_EQUAL_size_t(0, count_allocations("/api/recordings?offset=2&limit=2"));
+}
+
+void test_csv_without_allocation() {
+	TEST_ASSERT_EQUAL_size_t(0, count_allocations("/recordings/" + server.names[0] + ".csv"));
+	TEST_ASSERT_EQUAL_size_t(
+		0, count_allocations("/recordings/" + server.names[1] + ".csv?from=2&to=8&channels=0,3"));
+}
+
+void test_downloads_without_allocation() {
+	TEST_ASSERT_EQUAL_size_t(0, count_allocations("/recordings/" + server.names[0] + ".rec"));
+	TEST_ASSERT_EQUAL_size_t(
+		0, count_allocations("/recordings/" + server.names[1] + "/preview?width=500"));
+}
+
+void test_pages_without_allocation() {
+	TEST_ASSERT_EQUAL_size_t(0, count_allocations("/"));
+	TEST_ASSERT_EQUAL_size_t(0, count_allocations("/metrics"));
+}
+
+// Once the pool keeps the blocks of every other response up to
+// RESPONSE_POOL_MAX_BYTES, the WFDB signal file and the 16 KB text of its
+// header do not fit any more and take one block each from the heap
+void test_conversions_within_the_pool() {
+	TEST_ASSERT_EQUAL_size_t(0, count_allocations("/recordings/" + server.names[2] + ".edf"));
+	TEST_ASSERT_TRUE(
+		count_allocations("/recordings/" + server.names[3] + ".dat") <= COUNTED_REQUESTS);
+	TEST_ASSERT_TRUE(
+		count_allocations("/recordings/" + server.names[4] + ".hea") <= COUNTED_REQUESTS);
+}
+
+int main() {
+	TEST_ASSERT_TRUE(server.mount("test_web_alloc"));
+	server.add_recordings(TEST_RECORDINGS, TEST_RECORDS);
+	server.start([] { server_task = true; });
+
+	UNITY_BEGIN();
+	RUN_TEST(test_catalog_without_allocation);
+	RUN_TEST(test_csv_without_allocation);
+	RUN_TEST(test_downloads_without_allocation);
+	RUN_TEST(test_pages_without_allocation);
+	RUN_TEST(test_conversions_within_the_pool);
+	int failures = UNITY_END();
+
+	server.remove();
+	// Leaves without tearing down the server under its task
+	fflush(stdout);
+	_exit(failures);
+}
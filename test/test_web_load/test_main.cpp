@@ -0,0 +1,337 @@
+// The web server under load on the computer: the storage and web code run
+// unchanged on the stand-ins in test/host, the card is a directory and
+// lwIP's sockets are the computer's on the loopback. Run with
+// `pio test -e native -f test_web_load -v` to see the figures.
+//
+// Against a device, tools/http_load.py measures the latency of requests from
+// a computer on its network, for example while a download runs in a browser:
+//
+//     python tools/http_load.py 192.168.4.1 /api/recordings -n 200
+//
+// The host's CPU and loopback are much faster than the ESP32 and Wi-Fi, so
+// only the relations hold there: small requests are not held up by
+// downloads and slow clients, and every client is served.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <unity.h>
+
+#include "exportStream.h"
+#include "loopbackServer.h"
+
+constexpr uint16_t TEST_PORT = 18080;
+constexpr int TEST_RECORDINGS = 3;
+// 200 s of 8 channels, about 8 MB of CSV
+constexpr int TEST_RECORDS = 100000;
+// Rate at which a slow client reads
+constexpr size_t SLOW_CLIENT_BYTES_PER_SECOND = 100 * 1000;
+// How much slower the 240 MHz ESP32 is than a desktop core, generously
+constexpr double ESP32_SLOWDOWN = 50;
+
+static LoopbackServer server(TEST_PORT);
+
+// Latencies of catalog requests on one connection until done is set. Runs
+// beside the test, which asserts that none failed.
+static std::vector<double> request_catalog_until(
+	const std::atomic<bool>& done, int& failures) {
+	std::vector<double> latencies;
+	LoopbackClient client(TEST_PORT);
+	failures = 0;
+
+	while (!done) {
+		LoopbackResponse response = client.get("/api/recordings");
+		if (response.status != 200) {
+			failures++;
+		}
+		latencies.push_back(response.seconds);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return latencies;
+}
+
+static double percentile(std::vector<double> values, double fraction) {
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (size_t) (values.size() * fraction))];
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_parallel_downloads() {
+	const int downloads = TEST_RECORDINGS;
+	std::vector<LoopbackResponse> responses(downloads);
+	std::vector<std::thread> threads;
+	std::atomic<bool> done{ false };
+
+	for (int i = 0; i < downloads; i++) {
+		threads.emplace_back([i, &responses] {
+			LoopbackClient client(TEST_PORT);
+			std::string path = "/recordings/" + server.names[i] + ".csv";
+			responses[i] = client.get(path.c_str());
+		});
+	}
+
+	std::vector<double> latencies;
+	int failures;
+	std::thread catalog([&] { latencies = request_catalog_until(done, failures); });
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	done = true;
+	catalog.join();
+	TEST_ASSERT_EQUAL_INT(0, failures);
+
+	for (const LoopbackResponse& response : responses) {
+		TEST_ASSERT_EQUAL_INT(200, response.status);
+		TEST_ASSERT_TRUE(response.length > 0);
+
+		char text[120];
+		snprintf(
+			text, sizeof(text), "CSV download of %.1f MB in %.2f s, %.1f MB/s",
+			response.length / 1e6, response.seconds,
+			response.length / 1e6 / response.seconds);
+		TEST_MESSAGE(text);
+	}
+
+	char text[120];
+	snprintf(
+		text, sizeof(text),
+		"%u catalog requests beside them: median %.1f ms, 99th %.1f ms",
+		(unsigned) latencies.size(), percentile(latencies, 0.5) * 1e3,
+		percentile(latencies, 0.99) * 1e3);
+	TEST_MESSAGE(text);
+
+	TEST_ASSERT_TRUE(latencies.size() > 10);
+	TEST_ASSERT_TRUE_MESSAGE(
+		percentile(latencies, 0.99) < 0.1, "catalog held up by downloads");
+}
+
+void test_slow_clients() {
+	std::unique_ptr<LoopbackClient> slow_clients[2];
+	std::vector<std::thread> slow;
+
+	// Two clients on bad links keep their connections busy for a long time
+	for (int i = 0; i < 2; i++) {
+		slow_clients[i].reset(new LoopbackClient(TEST_PORT, 8192));
+		slow.emplace_back([i, &slow_clients] {
+			std::string path = "/recordings/" + server.names[i] + ".csv";
+			slow_clients[i]->get(path.c_str(), SLOW_CLIENT_BYTES_PER_SECOND);
+		});
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+	LoopbackClient client(TEST_PORT);
+	std::string path = "/recordings/" + server.names[2] + ".rec";
+	LoopbackResponse raw = client.get(path.c_str());
+	TEST_ASSERT_EQUAL_INT(200, raw.status);
+
+	std::atomic<bool> done{ false };
+	std::vector<double> latencies;
+	int failures;
+	std::thread catalog([&] { latencies = request_catalog_until(done, failures); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	done = true;
+	catalog.join();
+
+	// They give up in the middle of the body
+	for (auto& slow_client : slow_clients) {
+		slow_client->abort();
+	}
+	for (auto& thread : slow) {
+		thread.join();
+	}
+
+	char text[160];
+	snprintf(
+		text, sizeof(text),
+		"beside two clients at 100 KB/s: %.1f MB .rec in %.0f ms, catalog median %.1f ms, 99th %.1f ms",
+		raw.length / 1e6, raw.seconds * 1e3, percentile(latencies, 0.5) * 1e3,
+		percentile(latencies, 0.99) * 1e3);
+	TEST_MESSAGE(text);
+
+	TEST_ASSERT_EQUAL_INT(0, failures);
+	TEST_ASSERT_TRUE(raw.length > 0);
+	TEST_ASSERT_TRUE_MESSAGE(raw.seconds < 2, "download held up by slow clients");
+	TEST_ASSERT_TRUE_MESSAGE(
+		percentile(latencies, 0.99) < 0.1, "catalog held up by slow clients");
+}
+
+// Time of the fastest of three runs of body
+template <typename Body> static double best_of_three(Body body) {
+	double best = INFINITY;
+	for (int run = 0; run < 3; run++) {
+		auto start = std::chrono::steady_clock::now();
+		body();
+		best = std::min(best, seconds_since(start));
+	}
+	return best;
+}
+
+// Reads an export to its end, returns its length
+static size_t drain(ExportStream& stream) {
+	static uint8_t buffer[HTTP_CHUNK_SIZE];
+	size_t length = 0;
+	size_t count;
+	while ((count = stream.read(buffer, sizeof(buffer))) > 0) {
+		length += count;
+	}
+	return length;
+}
+
+// EDF+ needs the range of every channel first, found a step per server turn
+// without holding up other requests
+void test_edf_download() {
+	std::string path = "/recordings/" + server.names[1] + ".edf";
+
+	std::atomic<bool> done{ false };
+	std::vector<double> latencies;
+	int failures;
+	std::thread catalog([&] { latencies = request_catalog_until(done, failures); });
+	LoopbackClient client(TEST_PORT);
+	LoopbackResponse scanned = client.get(path.c_str());
+	done = true;
+	catalog.join();
+
+	// The range is remembered, the same download only converts
+	LoopbackResponse converted = client.get(path.c_str());
+
+	char text[160];
+	snprintf(
+		text, sizeof(text),
+		"EDF+ of %.1f MB in %.0f ms with the range scan, %.0f ms without; catalog median %.1f ms, 99th %.1f ms",
+		converted.length / 1e6, scanned.seconds * 1e3, converted.seconds * 1e3,
+		percentile(latencies, 0.5) * 1e3, percentile(latencies, 0.99) * 1e3);
+	TEST_MESSAGE(text);
+
+	TEST_ASSERT_EQUAL_INT(200, scanned.status);
+	TEST_ASSERT_EQUAL_INT(200, converted.status);
+	TEST_ASSERT_EQUAL_size_t(scanned.length, converted.length);
+	TEST_ASSERT_EQUAL_INT(0, failures);
+	TEST_ASSERT_TRUE_MESSAGE(
+		percentile(latencies, 0.99) < 0.1, "catalog held up by the range scan");
+}
+
+// Converting to EDF+ beside sending the raw recording. Both read the card,
+// EDF+ also decodes every block, which takes most of its time.
+void test_benchmark_edf() {
+	const char* name = server.names[1].c_str();
+	ExportSelection selection;
+	SelectionScan scan(server.storage->open_recording(name), selection);
+	while (!scan.step(UINT32_MAX)) {}
+	const SelectionRange& range = scan.get_range();
+
+	size_t raw_length = 0;
+	double raw_seconds = best_of_three([&] {
+		RawExport raw(server.storage->open_recording(name));
+		raw_length = drain(raw);
+	});
+
+	double decode_seconds = best_of_three([&] {
+		auto reader = server.storage->open_recording(name);
+		float record[UINT8_MAX];
+		while (reader->read_record(record, UINT8_MAX) > 0) {}
+	});
+
+	size_t edf_length = 0;
+	double edf_seconds = best_of_three([&] {
+		EdfExport edf(server.storage->open_recording(name), selection, range);
+		edf_length = drain(edf);
+	});
+
+	char text[200];
+	snprintf(
+		text, sizeof(text),
+		".rec %.0f MB/s, decoding %.0f ms, EDF+ %.0f MB/s in %.0f ms, device estimate %.1f MB/s",
+		raw_length / 1e6 / raw_seconds, decode_seconds * 1e3,
+		edf_length / 1e6 / edf_seconds, edf_seconds * 1e3,
+		edf_length / 1e6 / edf_seconds / ESP32_SLOWDOWN);
+	TEST_MESSAGE(text);
+
+	TEST_ASSERT_EQUAL_size_t(EdfExport::get_length(range), edf_length);
+	TEST_ASSERT_TRUE_MESSAGE(
+		edf_seconds < 2 * decode_seconds, "EDF+ conversion slower than decoding twice");
+}
+
+// Clients beyond HTTP_MAX_CONNECTIONS wait in the backlog until a
+// connection is free, then they are served like the others
+void test_more_clients_than_connections() {
+	const int clients = HTTP_MAX_CONNECTIONS + 2;
+	std::vector<LoopbackResponse> responses(clients);
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < clients; i++) {
+		threads.emplace_back([i, &responses] {
+			LoopbackClient client(TEST_PORT);
+			std::string path = "/recordings/" + server.names[i % TEST_RECORDINGS] + ".rec";
+			responses[i] = client.get(path.c_str());
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	for (const LoopbackResponse& response : responses) {
+		TEST_ASSERT_EQUAL_INT(200, response.status);
+		TEST_ASSERT_TRUE(response.length > 0);
+	}
+}
+
+// A compressor takes tens of KB, only WEB_MAX_GZIP_STREAMS of them run and
+// other clients get the CSV uncompressed meanwhile
+void test_one_gzip_stream() {
+	const char* gzip = "Accept-Encoding: gzip\r\n";
+	LoopbackClient slow_client(TEST_PORT, 8192);
+	LoopbackResponse slow;
+	std::thread slow_thread([&] {
+		std::string path = "/recordings/" + server.names[0] + ".csv";
+		slow = slow_client.get(path, SLOW_CLIENT_BYTES_PER_SECOND, gzip);
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+	LoopbackClient client(TEST_PORT);
+	std::string path = "/recordings/" + server.names[1] + ".csv?to=1000";
+	LoopbackResponse beside = client.get(path, 0, gzip);
+
+	slow_client.abort();
+	slow_thread.join();
+
+	TEST_ASSERT_TRUE(slow.gzip);
+	TEST_ASSERT_EQUAL_INT(200, beside.status);
+	TEST_ASSERT_FALSE(beside.gzip);
+
+	// Compressed again once the slow client is gone
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	LoopbackResponse after = client.get(path, 0, gzip);
+	TEST_ASSERT_EQUAL_INT(200, after.status);
+	TEST_ASSERT_TRUE(after.gzip);
+}
+
+int main() {
+	TEST_ASSERT_TRUE(server.mount("test_web_load"));
+	server.add_recordings(TEST_RECORDINGS, TEST_RECORDS);
+	server.start();
+
+	UNITY_BEGIN();
+	RUN_TEST(test_parallel_downloads);
+	RUN_TEST(test_slow_clients);
+	RUN_TEST(test_edf_download);
+	RUN_TEST(test_benchmark_edf);
+	RUN_TEST(test_more_clients_than_connections);
+	RUN_TEST(test_one_gzip_stream);
+	int failures = UNITY_END();
+
+	server.remove();
+	// Leaves without tearing down the server under its task
+	fflush(stdout);
+	_exit(failures);
+}
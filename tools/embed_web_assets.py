@@ -0,0 +1,113 @@
+"""Compresses the viewer in web/ into src/webAssets.cpp.
+
+Runs before every PlatformIO build (extra_scripts in platformio.ini) and can
+be run by hand with `python tools/embed_web_assets.py`. The output is only
+rewritten when it changes, so unchanged assets cause no rebuild.
+
+Scripts and style sheets get the start of their CRC32 in the name, so they
+can be cached forever. The page is rewritten to refer to those names.
+"""
+
+import gzip
+import os
+import re
+import zlib
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "text/javascript",
+    ".css": "text/css",
+}
+
+
+def compress(data):
+    # No name and no time in the header, the output only depends on the input
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def c_array(name, data):
+    lines = []
+    for start in range(0, len(data), 16):
+        chunk = data[start:start + 16]
+        lines.append("\t" + ", ".join("0x%02x" % b for b in chunk) + ",")
+    return "constexpr uint8_t %s[] = {\n%s\n};\n" % (name, "\n".join(lines))
+
+
+def embed(project_dir):
+    web_dir = os.path.join(project_dir, "web")
+    output = os.path.join(project_dir, "src", "webAssets.cpp")
+
+    names = sorted(
+        name for name in os.listdir(web_dir)
+        if os.path.splitext(name)[1] in CONTENT_TYPES)
+
+    assets = []
+    renamed = {}
+
+    for name in names:
+        if name.endswith(".html"):
+            continue
+        with open(os.path.join(web_dir, name), "rb") as file:
+            data = file.read()
+        base, extension = os.path.splitext(name)
+        path = "/assets/%s.%08x%s" % (base, zlib.crc32(data), extension)
+        renamed[name] = path
+        assets.append((path, name, data, True))
+
+    for name in names:
+        if not name.endswith(".html"):
+            continue
+        with open(os.path.join(web_dir, name), "rb") as file:
+            text = file.read().decode("utf-8")
+        for original, path in renamed.items():
+            text = re.sub(
+                r'(href|src)="%s"' % re.escape(original),
+                r'\1="%s"' % path, text)
+        path = "/" if name == "index.html" else "/" + name
+        assets.append((path, name, text.encode("utf-8"), False))
+
+    arrays = []
+    entries = []
+
+    for index, (path, name, data, immutable) in enumerate(assets):
+        compressed = compress(data)
+        variable = "asset_%d" % index
+        arrays.append("// %s, %d bytes uncompressed\n" % (name, len(data)))
+        arrays.append(c_array(variable, compressed))
+        entries.append(
+            '\t{ "%s", "%s", %s, sizeof(%s), "\\"%08x\\"", %s },' % (
+                path, CONTENT_TYPES[os.path.splitext(name)[1]], variable,
+                variable, zlib.crc32(compressed),
+                "true" if immutable else "false"))
+
+    source = (
+        "// Generated by tools/embed_web_assets.py from web/, do not edit\n"
+        "#include \"webAssets.h\"\n"
+        "\n"
+        "namespace {\n"
+        + "\n".join(arrays) +
+        "}\n"
+        "\n"
+        "const WebAsset WEB_ASSETS[] = {\n"
+        + "\n".join(entries) + "\n"
+        "};\n"
+        "\n"
+        "const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);\n")
+
+    try:
+        with open(output) as file:
+            if file.read() == source:
+                return
+    except FileNotFoundError:
+        pass
+
+    with open(output, "w") as file:
+        file.write(source)
+    print("embed_web_assets: wrote %s" % output)
+
+
+try:
+    Import("env")  # noqa: F821, only defined when run by PlatformIO
+    embed(env.subst("$PROJECT_DIR"))  # noqa: F821
+except NameError:
+    embed(os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")))
@@ -0,0 +1,181 @@
+"""Measures request latency of the web server from a computer.
+
+Fetches a list of paths over and over, the way the viewer does on a page
+load, and prints latency percentiles and requests per second for each way
+of using connections:
+
+    close      a new connection for every request, like before keep-alive
+    keepalive  one connection, a request after the previous response
+    pipeline   one connection, DEPTH requests sent before reading answers
+
+    python tools/http_load.py 192.168.4.1 /api/recordings \\
+        "/recordings/00001/preview?width=500" -n 200 --depth 4
+
+Only the standard library is used. Latency is from sending a request to
+the end of its response, for pipelined requests from sending the batch.
+"""
+
+import argparse
+import socket
+import time
+
+
+class Connection:
+    def __init__(self, host, port, timeout):
+        self.socket = socket.create_connection((host, port), timeout=timeout)
+        self.socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buffer = b""
+        self.closed = False
+
+    def send(self, data):
+        self.socket.sendall(data)
+
+    def fill(self):
+        data = self.socket.recv(65536)
+        if not data:
+            raise ConnectionError("connection closed")
+        self.buffer += data
+
+    def read_until(self, separator):
+        while separator not in self.buffer:
+            self.fill()
+        line, self.buffer = self.buffer.split(separator, 1)
+        return line
+
+    def read_exactly(self, length):
+        while len(self.buffer) < length:
+            self.fill()
+        data, self.buffer = self.buffer[:length], self.buffer[length:]
+        return data
+
+    def read_to_end(self):
+        try:
+            while True:
+                self.fill()
+        except ConnectionError:
+            pass
+        data, self.buffer = self.buffer, b""
+        return data
+
+    def read_response(self, head):
+        """Returns status and body size of the next response."""
+        lines = self.read_until(b"\r\n\r\n").decode("latin-1").split("\r\n")
+        status = int(lines[0].split(" ")[1])
+        headers = {}
+        for line in lines[1:]:
+            name, _, value = line.partition(":")
+            headers[name.strip().lower()] = value.strip()
+
+        if headers.get("connection", "").lower() == "close":
+            self.closed = True
+
+        if head or status in (204, 304):
+            return status, 0
+        if "content-length" in headers:
+            return status, len(self.read_exactly(int(headers["content-length"])))
+        if headers.get("transfer-encoding", "").lower() == "chunked":
+            size = 0
+            while True:
+                length = int(self.read_until(b"\r\n").split(b";")[0], 16)
+                self.read_exactly(length + 2)
+                size += length
+                if length == 0:
+                    return status, size
+        self.closed = True
+        return status, len(self.read_to_end())
+
+    def close(self):
+        self.socket.close()
+
+
+def request_text(host, path, close):
+    connection = "Connection: close\r\n" if close else ""
+    return (
+        "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n" % (path, host, connection)
+    ).encode("latin-1")
+
+
+def run(args, mode):
+    latencies = []
+    errors = 0
+    size = 0
+    connections = 0
+    connection = None
+    paths = [args.paths[i % len(args.paths)] for i in range(args.count)]
+    depth = args.depth if mode == "pipeline" else 1
+    start = time.perf_counter()
+
+    for first in range(0, len(paths), depth):
+        batch = paths[first:first + depth]
+
+        if connection is None or connection.closed or mode == "close":
+            if connection is not None:
+                connection.close()
+            connection = Connection(args.host, args.port, args.timeout)
+            connections += 1
+
+        sent = time.perf_counter()
+        connection.send(
+            b"".join(request_text(args.host, path, mode == "close") for path in batch)
+        )
+
+        for index, path in enumerate(batch):
+            try:
+                status, length = connection.read_response(False)
+            except (ConnectionError, socket.timeout, OSError):
+                # The rest of the batch is sent again on a new connection
+                errors += len(batch) - index
+                connection.closed = True
+                break
+            latencies.append(time.perf_counter() - sent)
+            size += length
+            if status >= 400:
+                errors += 1
+            if connection.closed and index + 1 < len(batch):
+                errors += len(batch) - index - 1
+                break
+
+    duration = time.perf_counter() - start
+    if connection is not None:
+        connection.close()
+    return latencies, errors, size, connections, duration
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("host")
+    parser.add_argument("paths", nargs="+")
+    parser.add_argument("-p", "--port", type=int, default=80)
+    parser.add_argument("-n", "--count", type=int, default=100)
+    parser.add_argument("--depth", type=int, default=4)
+    parser.add_argument("--timeout", type=float, default=10)
+    parser.add_argument(
+        "--modes", default="close,keepalive,pipeline",
+        help="comma separated, of close, keepalive and pipeline")
+    args = parser.parse_args()
+
+    print("%-10s %8s %8s %8s %8s %8s %6s %6s" % (
+        "mode", "p50 ms", "p90 ms", "p99 ms", "req/s", "KB/s", "conns", "errors"))
+    for mode in args.modes.split(","):
+        latencies, errors, size, connections, duration = run(args, mode)
+        if not latencies:
+            print("%-10s no responses" % mode)
+            continue
+        print("%-10s %8.2f %8.2f %8.2f %8.1f %8.1f %6d %6d" % (
+            mode,
+            percentile(latencies, 0.5) * 1000,
+            percentile(latencies, 0.9) * 1000,
+            percentile(latencies, 0.99) * 1000,
+            len(latencies) / duration,
+            size / 1024 / duration,
+            connections,
+            errors))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,245 @@
+// Converts a .rec recording to a WFDB record, a <record>.hea header and a
+// <record>.dat signal file, with the encoder the web server uses.
+//
+//   g++ -std=gnu++17 -O2 -Iinclude -o rec2wfdb tools/rec2wfdb.cpp
+//       src/wfdb.cpp src/recordingFormat.cpp src/crc32.cpp
+//   ./rec2wfdb [-f 212|16] 00012.rec [record]
+//
+// The record is named after the input unless given.
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "recordingFormat.h"
+#include "wfdb.h"
+
+using namespace recording_format;
+
+// ECG_SAMPLE_RATE_HZ and ECG_SAMPLE_UNIT, ecg_isd_config.h needs Arduino
+constexpr uint32_t SAMPLE_RATE_HZ = 500;
+constexpr const char* SAMPLE_UNIT = "mV";
+
+// Reads the records of a version 1 or 2 recording one after another. A
+// version 2 recording ends at its index or at the first damaged block.
+class RecordingFile {
+	FILE* _file;
+	bool _blocks = false;
+
+	BlockBuffer _block;
+	uint8_t _payload[BLOCK_MAX_PAYLOAD];
+	uint16_t _block_record = 0;
+	uint16_t _block_sample = 0;
+
+	bool read_block() {
+		BlockHeader header;
+		if (fread(&header, sizeof(header), 1, _file) != 1 ||
+			!check_block_header(header) ||
+			fread(_payload, 1, header.payload_size, _file) != header.payload_size ||
+			!check_block_crc(header, _payload) ||
+			!decode_block(header, _payload, _block)) {
+			return false;
+		}
+
+		_block_record = 0;
+		_block_sample = 0;
+		return true;
+	}
+
+public:
+	explicit RecordingFile(FILE* file) : _file(file) {}
+
+	bool open() {
+		FileHeader header;
+		if (fread(&header, FILE_HEADER_BASE_SIZE, 1, _file) != 1) {
+			return false;
+		}
+
+		// Version 1 starts with a length byte, which is never 0
+		_blocks = header.magic[0] == 0;
+		if (!_blocks) {
+			return fseek(_file, 0, SEEK_SET) == 0;
+		}
+
+		return check_file_header(header) &&
+			fseek(_file, header.header_size, SEEK_SET) == 0;
+	}
+
+	// Returns the number of samples, 0 at the end
+	int read_record(float out[]) {
+		if (!_blocks) {
+			uint8_t length;
+			if (fread(&length, 1, 1, _file) != 1 || length == 0 ||
+				fread(out, sizeof(float), length, _file) != length) {
+				return 0;
+			}
+			return length;
+		}
+
+		// The index block decodes to an empty block and ends the recording
+		if (_block_record == _block.record_count &&
+			(!read_block() || _block.record_count == 0)) {
+			return 0;
+		}
+
+		uint8_t length = _block.lengths[_block_record++];
+		memcpy(out, _block.samples + _block_sample, sizeof(float) * length);
+		_block_sample += length;
+		return length;
+	}
+};
+
+static int usage() {
+	fprintf(stderr, "Usage: rec2wfdb [-f 212|16] input.rec [record]\n");
+	return 2;
+}
+
+int main(int argc, char** argv) {
+	WfdbFormat format = WfdbFormat::Packed212;
+	int arg = 1;
+
+	if (arg + 1 < argc && strcmp(argv[arg], "-f") == 0) {
+		if (!wfdb_parse_format(argv[arg + 1], format)) {
+			return usage();
+		}
+		arg += 2;
+	}
+	if (arg >= argc || argc - arg > 2) {
+		return usage();
+	}
+
+	const char* input = argv[arg];
+	std::string record;
+	if (arg + 1 < argc) {
+		record = argv[arg + 1];
+	} else {
+		const char* base = strrchr(input, '/');
+		record = base != nullptr ? base + 1 : input;
+		record = record.substr(0, record.rfind('.'));
+	}
+
+	FILE* file = fopen(input, "rb");
+	if (file == nullptr) {
+		perror(input);
+		return 1;
+	}
+
+	// The first pass finds the range of every channel for the gain, the
+	// second one converts
+	RecordingFile recording(file);
+	if (!recording.open()) {
+		fprintf(stderr, "%s: not a recording\n", input);
+		fclose(file);
+		return 1;
+	}
+
+	static float data[UINT8_MAX];
+	float min[UINT8_MAX];
+	float max[UINT8_MAX];
+	uint8_t channel_count = 0;
+	uint32_t frame_count = 0;
+	int length;
+
+	while ((length = recording.read_record(data)) > 0) {
+		for (int i = channel_count; i < length; i++) {
+			min[i] = INFINITY;
+			max[i] = -INFINITY;
+		}
+		channel_count = std::max<int>(channel_count, length);
+
+		for (int i = 0; i < length; i++) {
+			if (isfinite(data[i])) {
+				min[i] = std::min(min[i], data[i]);
+				max[i] = std::max(max[i], data[i]);
+			}
+		}
+
+		frame_count++;
+	}
+
+	WfdbSignal signals[UINT8_MAX];
+	uint8_t channels[UINT8_MAX];
+	for (uint8_t i = 0; i < channel_count; i++) {
+		if (min[i] > max[i]) {
+			min[i] = max[i] = 0;
+		}
+		signals[i] = wfdb_scaling(format, min[i], max[i]);
+		channels[i] = i;
+	}
+
+	std::string data_name = record + ".dat";
+	FILE* out = fopen(data_name.c_str(), "wb");
+	if (out == nullptr) {
+		perror(data_name.c_str());
+		fclose(file);
+		return 1;
+	}
+
+	rewind(file);
+	RecordingFile second(file);
+	if (!second.open()) {
+		fprintf(stderr, "%s: read failed\n", input);
+		fclose(out);
+		fclose(file);
+		return 1;
+	}
+
+	WfdbEncoder encoder(format, channel_count, signals);
+	size_t frame_capacity = channel_count > 0 ? WFDB_BLOCK_SAMPLES / channel_count : 0;
+	static float frames[WFDB_BLOCK_SAMPLES];
+	static uint8_t packed[WFDB_BLOCK_BYTES];
+	uint32_t frames_read = 0;
+	bool ok = true;
+
+	while (frames_read < frame_count && frame_capacity > 0) {
+		size_t count = 0;
+
+		for (; count < frame_capacity && frames_read < frame_count; count++) {
+			length = second.read_record(data);
+
+			float* frame = frames + count * channel_count;
+			for (uint8_t i = 0; i < channel_count; i++) {
+				frame[i] = i < length ? data[i] : NAN;
+			}
+			frames_read++;
+		}
+
+		size_t size = encoder.encode(frames, count, packed);
+		ok = ok && fwrite(packed, 1, size, out) == size;
+	}
+
+	size_t size = encoder.finish(packed);
+	ok = ok && fwrite(packed, 1, size, out) == size;
+	ok = fclose(out) == 0 && ok;
+	fclose(file);
+
+	std::string header_name = record + ".hea";
+	std::string header;
+	header.resize(wfdb_format_header(
+		nullptr, 0, record.c_str(), SAMPLE_RATE_HZ, frame_count, encoder,
+		channels, SAMPLE_UNIT));
+	wfdb_format_header(
+		&header[0], header.size() + 1, record.c_str(), SAMPLE_RATE_HZ,
+		frame_count, encoder, channels, SAMPLE_UNIT);
+
+	out = fopen(header_name.c_str(), "w");
+	if (out == nullptr) {
+		perror(header_name.c_str());
+		return 1;
+	}
+	ok = fwrite(header.data(), 1, header.size(), out) == header.size() && ok;
+	ok = fclose(out) == 0 && ok;
+
+	if (!ok) {
+		fprintf(stderr, "%s: write failed\n", record.c_str());
+		return 1;
+	}
+
+	printf(
+		"%s: %u signals, %u frames at %u Hz, format %u\n", record.c_str(),
+		channel_count, (unsigned) frame_count, (unsigned) SAMPLE_RATE_HZ,
+		(unsigned) format);
+	return 0;
+}
@@ -0,0 +1,318 @@
+'use strict';
+
+// Must match ECG_SAMPLE_RATE_HZ and ECG_CHANNELS
+const SAMPLE_RATE = 500;
+const CHANNELS = 8;
+const PAGE_SIZE = 50;
+const LIVE_SECONDS = 10;
+const COLORS = ['#c00', '#060', '#00c', '#c60', '#609', '#088', '#880', '#444'];
+
+const $ = id => document.getElementById(id);
+const canvas = $('plot');
+const context = canvas.getContext('2d');
+
+let offset = 0;
+let recording = null;
+let view = { from: 0, to: 0 };
+let selected = Array.from({ length: CHANNELS }, (_, i) => i);
+let envelope = null;
+let request = null;
+let live = null;
+
+function formatTime(seconds) {
+	const minutes = Math.floor(seconds / 60);
+	return minutes + ':' + (seconds % 60).toFixed(1).padStart(4, '0');
+}
+
+function megabytes(bytes) {
+	return (bytes / 1048576).toFixed(1) + ' MB';
+}
+
+function loadCatalog() {
+	fetch('/api/recordings?offset=' + offset + '&limit=' + PAGE_SIZE)
+		.then(response => response.json())
+		.then(catalog => {
+			const usage = catalog.usage;
+			const minutes = Math.floor(usage.remaining_seconds / 60);
+			$('usage').textContent = megabytes(usage.used_bytes) + ' of ' +
+				megabytes(usage.quota_bytes) + ' used, room for ' +
+				Math.floor(minutes / 60) + 'h ' + minutes % 60 + 'min';
+
+			const list = $('recordings');
+			list.replaceChildren();
+			for (const entry of catalog.recordings) {
+				const item = document.createElement('li');
+				const details = document.createElement('small');
+				details.textContent = formatTime(entry.duration) + ', ' +
+					megabytes(entry.size) + (entry.live ? ', recording' : '');
+				item.append(entry.name, details);
+				item.classList.toggle('selected', recording && recording.name == entry.name);
+				item.onclick = () => select(entry, item);
+				list.append(item);
+			}
+
+			$('previous').hidden = offset == 0;
+			$('next').hidden = offset + PAGE_SIZE >= catalog.total;
+		});
+}
+
+function select(entry, item) {
+	stopLive();
+	for (const other of document.querySelectorAll('nav li')) {
+		other.classList.toggle('selected', other == item);
+	}
+
+	recording = entry;
+	view = { from: 0, to: Math.max(entry.duration, 1 / SAMPLE_RATE) };
+	$('title').textContent = entry.name;
+
+	const path = '/recordings/' + encodeURIComponent(entry.name);
+	const downloads = $('downloads');
+	downloads.replaceChildren();
+	for (const [href, text] of [[path + '.csv', 'CSV'], [path + '.rec', 'Binary']]) {
+		const link = document.createElement('a');
+		link.href = href;
+		link.textContent = text;
+		downloads.append(link);
+	}
+	const remove = document.createElement('a');
+	remove.href = path + '.csv/remove';
+	remove.textContent = 'Remove';
+	remove.onclick = () => confirm('Remove ' + entry.name + '?');
+	downloads.append(remove);
+
+	loadEnvelope();
+}
+
+function viewQuery() {
+	return 'from=' + view.from.toFixed(3) + '&to=' + view.to.toFixed(3) +
+		'&channels=' + selected.join(',');
+}
+
+// Min/max per pixel column, the device does the reduction
+function loadEnvelope() {
+	if (!recording || selected.length == 0) {
+		envelope = null;
+		draw();
+		return;
+	}
+
+	if (request) {
+		request.abort();
+	}
+	request = new AbortController();
+
+	const width = Math.min(canvas.width, 4000);
+	const url = '/recordings/' + encodeURIComponent(recording.name) +
+		'/preview?width=' + width + '&' + viewQuery();
+	$('status').textContent = formatTime(view.from) + ' to ' + formatTime(view.to);
+
+	fetch(url, { signal: request.signal })
+		.then(response => response.text())
+		.then(text => {
+			const lines = text.trim().split('\n').slice(1);
+			envelope = lines.map(line => line.split(',').map(Number));
+			draw();
+		})
+		.catch(error => {
+			if (error.name != 'AbortError') {
+				$('status').textContent = 'Loading failed';
+			}
+		});
+}
+
+function resize() {
+	const ratio = window.devicePixelRatio || 1;
+	canvas.width = canvas.clientWidth * ratio;
+	canvas.height = canvas.clientHeight * ratio;
+}
+
+// Every channel gets a lane scaled to its own range
+function drawLanes(columns, valueAt) {
+	const lane = canvas.height / selected.length;
+	context.clearRect(0, 0, canvas.width, canvas.height);
+	context.lineWidth = 1;
+
+	selected.forEach((channel, index) => {
+		let low = Infinity;
+		let high = -Infinity;
+		for (let x = 0; x < columns; x++) {
+			const [min, max] = valueAt(x, index);
+			if (isFinite(min)) low = Math.min(low, min);
+			if (isFinite(max)) high = Math.max(high, max);
+		}
+		if (!(high >= low)) {
+			return;
+		}
+
+		const span = high - low || 1;
+		const top = index * lane + 4;
+		const scale = (lane - 8) / span;
+
+		context.strokeStyle = COLORS[channel % COLORS.length];
+		context.beginPath();
+		for (let x = 0; x < columns; x++) {
+			const [min, max] = valueAt(x, index);
+			const px = x * canvas.width / columns;
+			context.moveTo(px, top + (high - max) * scale);
+			context.lineTo(px, top + (high - min) * scale + 1);
+		}
+		context.stroke();
+
+		context.fillStyle = '#000';
+		context.fillText('Ch ' + channel, 4, top + 10);
+	});
+}
+
+function draw() {
+	if (live || !envelope) {
+		context.clearRect(0, 0, canvas.width, canvas.height);
+		return;
+	}
+
+	drawLanes(envelope.length, (x, index) =>
+		[envelope[x][1 + 2 * index], envelope[x][2 + 2 * index]]);
+}
+
+function zoom(factor, center) {
+	if (!recording) {
+		return;
+	}
+
+	const length = Math.max((view.to - view.from) * factor, 0.1);
+	const at = view.from + (view.to - view.from) * center;
+	view.from = Math.max(at - length * center, 0);
+	view.to = Math.min(view.from + length, recording.duration);
+	loadEnvelope();
+}
+
+function setupChannels() {
+	const container = $('channels');
+	for (let channel = 0; channel < CHANNELS; channel++) {
+		const label = document.createElement('label');
+		const box = document.createElement('input');
+		box.type = 'checkbox';
+		box.checked = true;
+		box.onchange = () => {
+			selected = Array.from(container.querySelectorAll('input'))
+				.map((input, index) => input.checked ? index : -1)
+				.filter(index => index >= 0);
+			if (live) {
+				startLive();
+			} else {
+				loadEnvelope();
+			}
+		};
+		label.append(box, ' ' + channel);
+		container.append(label);
+	}
+}
+
+// Scrolls the last LIVE_SECONDS, decimated to about one record per pixel
+function startLive() {
+	stopLive();
+	if (selected.length == 0) {
+		return;
+	}
+
+	const decimation = Math.max(1, Math.ceil(LIVE_SECONDS * SAMPLE_RATE / canvas.width));
+	const columns = Math.floor(LIVE_SECONDS * SAMPLE_RATE / decimation);
+	const socket = new WebSocket('ws://' + location.host + '/live?channels=' +
+		selected.join(',') + '&decimation=' + decimation);
+	socket.binaryType = 'arraybuffer';
+
+	const state = { socket, records: [] };
+	live = state;
+	$('live').textContent = 'Stop';
+	$('status').textContent = 'Live';
+
+	socket.onmessage = event => {
+		const header = new DataView(event.data, 0, 12);
+		const count = header.getUint16(4, true);
+		const channels = header.getUint8(8);
+		const samples = new Float32Array(event.data, 12, count * channels);
+		for (let i = 0; i < count; i++) {
+			state.records.push(samples.subarray(i * channels, (i + 1) * channels));
+		}
+		state.records.splice(0, Math.max(state.records.length - columns, 0));
+	};
+	socket.onclose = () => {
+		if (live == state) {
+			stopLive();
+		}
+	};
+
+	const frame = () => {
+		if (live != state) {
+			return;
+		}
+		drawLanes(state.records.length, (x, index) =>
+			[state.records[x][index], state.records[x][index]]);
+		requestAnimationFrame(frame);
+	};
+	requestAnimationFrame(frame);
+}
+
+function stopLive() {
+	if (live) {
+		live.socket.close();
+		live = null;
+		$('live').textContent = 'Live';
+		$('status').textContent = '';
+		draw();
+	}
+}
+
+let drag = null;
+
+canvas.onwheel = event => {
+	event.preventDefault();
+	zoom(event.deltaY > 0 ? 1.25 : 0.8, event.offsetX / canvas.clientWidth);
+};
+canvas.onmousedown = event => {
+	drag = { x: event.clientX, from: view.from, to: view.to };
+};
+// Only the final position is loaded, not every step on the way
+window.onmouseup = () => {
+	if (drag && (view.from != drag.from || view.to != drag.to)) {
+		loadEnvelope();
+	}
+	drag = null;
+};
+window.onmousemove = event => {
+	if (!drag || !recording || live) {
+		return;
+	}
+	const length = drag.to - drag.from;
+	const shift = (drag.x - event.clientX) / canvas.clientWidth * length;
+	view.from = Math.min(Math.max(drag.from + shift, 0), recording.duration - length);
+	view.to = view.from + length;
+	$('status').textContent = formatTime(view.from) + ' to ' + formatTime(view.to);
+};
+canvas.ondblclick = () => $('reset').onclick();
+
+$('zoom-in').onclick = () => zoom(0.5, 0.5);
+$('zoom-out').onclick = () => zoom(2, 0.5);
+$('reset').onclick = () => {
+	if (recording) {
+		view = { from: 0, to: recording.duration };
+		loadEnvelope();
+	}
+};
+$('live').onclick = () => live ? stopLive() : startLive();
+$('previous').onclick = () => {
+	offset = Math.max(offset - PAGE_SIZE, 0);
+	loadCatalog();
+};
+$('next').onclick = () => {
+	offset += PAGE_SIZE;
+	loadCatalog();
+};
+window.onresize = () => {
+	resize();
+	loadEnvelope();
+};
+
+resize();
+setupChannels();
+loadCatalog();